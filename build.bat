@@ -18,6 +18,8 @@ pushd build\debug
 echo ----------------
 echo building debug:
 cl %cflags% /Feclock_debug.exe /Od /DCLOCK_DEBUG %sources% /link %lflags%
+cl %cflags% /Fetrace2json.exe /Od ..\..\misc\trace2json.cpp /link /INCREMENTAL:NO /subsystem:console
+cl %cflags% /Fereplay.exe /Od ..\..\misc\replay.cpp /link /INCREMENTAL:NO /subsystem:console
 del *.obj
 popd
 
@@ -25,5 +27,6 @@ pushd build\release
 echo ----------------
 echo building release:
 cl %cflags% /Feclock.exe /Oi /O2 %sources% /link %lflags%
+cl %cflags% /Febench.exe /Oi /O2 ..\..\misc\bench.cpp /link /INCREMENTAL:NO /subsystem:console
 del *.obj
 popd
@@ -0,0 +1,3525 @@
+// Benchmarks for the platform-neutral core. Builds anywhere with a C++20
+// compiler, e.g.
+//
+//   g++ -std=c++20 -O2 misc/bench.cpp -o bench
+//
+// Prints one JSON object per line:
+//
+//   {"name":"tick","monitors":4,"windows":1000,"iterations":...,"ns_per_op":...}
+//
+// Measurements that are not timings are printed as
+//
+//   {"name":"compose","metric":"pixels_per_tick","value":...}
+//
+// Pass a name prefix as the first argument to run a subset.
+//
+// The tick_scheduler benchmarks simulate an hour of wakeups at each
+// granularity, and two days at the day granularity, with timer jitter and a
+// busy message loop now and then. They report the wakeups per hour and the
+// latency from each edge of the text to the paint that shows it, against a
+// fixed 1000 ms timer.
+//
+// The surface_cache benchmarks place clocks on 1 to 64 monitors at the same
+// DPI, every third at 150 % and at a mix of DPIs, corners and backdrops, and
+// check that each frame rasterizes one surface per distinct look.
+//
+// The topmost benchmarks replay bursts of foreground changes through the
+// topmost guard, check that no clock is left covered after a batch and count
+// the SetWindowPos calls against raising every clock on every change.
+//
+// The window_index benchmarks check the index against scanning every window
+// after each event of a synthetic stream of window events.
+//
+// The datetime_format benchmarks check compiled pictures against a table of
+// locale outputs and against format_picture over random pictures and times,
+// then time a tick's pictures rendered both ways.
+//
+// The render_queue benchmarks also check the queue under concurrent use and
+// exit with an error if a snapshot arrives torn or out of order, build them
+// with ThreadSanitizer to check for races as well:
+//
+//   g++ -std=c++20 -O1 -g -fsanitize=thread misc/bench.cpp -o bench_tsan
+//   ./bench_tsan render_queue
+//
+// The time_zone benchmarks read compiled tzdata from /usr/share/zoneinfo, or
+// from $ZONEINFO, and outside Windows check every zone in it against the C
+// library's localtime_r.
+//
+// The frame_pacer benchmark simulates a minute of smooth seconds at 60 and
+// 144 Hz with stalls and timer jitter, once with the pacer and once with a
+// plain periodic timer, and times the per-frame rasterization.
+//
+// The clock_face benchmarks check that the SIMD kernels draw the scalar
+// picture over a day of hand positions, each channel within one step of it,
+// before timing every kernel at icon to window sizes.
+//
+// The backdrop benchmarks check that every SIMD kernel hashes and measures
+// random images exactly like the scalar reference before timing them.
+//
+// The clock_table benchmarks compare the per-tick passes over 1 to 64
+// clocks on the table with the array of structs it replaced.
+//
+// The startup benchmark runs the app's startup graph with sleeps standing
+// in for the Windows calls, serially and with workers, and reports the wall
+// time, the time to the first frame and the critical path.
+//
+// The calendar benchmarks generate an .ics export of 100k events, index it
+// from a mapped file, check every range query against expanding each series
+// from its first occurrence and time the cold build, the queries and
+// reindexing after an edit.
+//
+// The timer_wheel benchmarks fuzz the wheel against a priority queue with
+// lazy cancellation, time scheduling, cancelling and expiring a million
+// timers on both, and simulate a day of alarms to count the wakeups.
+//
+// The settings benchmarks check migrating version 1 files, reading files
+// from a newer version, rejecting torn and corrupted files and recovering
+// from a crash at each step of a save, in a directory under the system's
+// temp directory, and time loading hundreds of monitor profiles.
+//
+// The system_metrics benchmarks check the /proc parsers and the rates and
+// line of the sampler against known counters, then sample the live /proc
+// provider and exit with an error if a pass costs more than
+// kMetricsSampleBudgetNs on average.
+//
+// The text_metrics benchmarks simulate a week of frames with the time, the
+// long date and the metrics line at two DPIs through the text metrics
+// cache, measuring with a synthetic font, check every extent against
+// measuring directly and count the window resizes after settle_clock_fit.
+//
+// The power benchmarks check the power state machine with scripted event
+// sequences, then replay a laptop's and a VDI session's day with their
+// display, lock, session and battery notifications, and once more without
+// them, and report the work avoided per day.
+//
+// The clock_api benchmarks check the framing, subscriptions, coalescing and
+// overlays of the local API, time fanning one update out to up to 1000
+// clients, and outside Windows push a few hundred ticks to 500 subscribers
+// on a Unix domain socket, reporting the fan-out latency percentiles and
+// the bytes encoded against the bytes sent.
+//
+// The trace benchmarks emit from 8 threads into one trace buffer while
+// another thread keeps dumping it, exit with an error if a dumped event is
+// torn or out of order, and convert a dump to Chrome trace JSON and back.
+// Build them with ThreadSanitizer like render_queue to check for races.
+
+#include "../src/backdrop.cpp"
+#include "../src/alarms.cpp"
+#include "../src/calendar.cpp"
+#include "../src/clock_api.cpp"
+#include "../src/clock_core.cpp"
+#include "../src/clock_face.cpp"
+#include "../src/clock_table.cpp"
+#include "../src/cpu.cpp"
+#include "../src/datetime_format.cpp"
+#include "../src/event_log.cpp"
+#include "../src/frame_pacer.cpp"
+#include "../src/framebuffer.cpp"
+#include "../src/glyph_atlas.cpp"
+#include "../src/monitor_diff.cpp"
+#include "../src/power_state.cpp"
+#include "../src/render_queue.cpp"
+#include "../src/replay.cpp"
+#include "../src/settings.cpp"
+#include "../src/startup_graph.cpp"
+#include "../src/surface_cache.cpp"
+#include "../src/system_metrics.cpp"
+#include "../src/text_metrics.cpp"
+#include "../src/tick_scheduler.cpp"
+#include "../src/time_zone.cpp"
+#include "../src/timer_wheel.cpp"
+#include "../src/topmost_guard.cpp"
+#include "../src/trace.cpp"
+#include "../src/window_index.cpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <queue>
+#include <random>
+#include <set>
+#include <thread>
+#include <tuple>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  constexpr uint32_t kMonitorCounts[] = {1, 2, 4, 8, 16, 32, 64};
+  constexpr uint32_t kWindowCounts[] = {100, 1000, 5000};
+  constexpr uint64_t kTargetNs = 50'000'000;
+
+  const char* filter = nullptr;
+
+  // @NOTE: Keeps the optimizer from dropping the benchmarked work.
+  volatile uint64_t sink = 0;
+
+  void consume(uint64_t value) { sink = sink + value; }
+
+  uint64_t now_ns() {
+    using namespace std::chrono;
+    return static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+  }
+
+  bool selected(const char* name) {
+    return !filter || (strncmp(name, filter, strlen(filter)) == 0);
+  }
+
+  // True if a benchmark whose name starts with `prefix` can be selected.
+  bool selected_group(const char* prefix) {
+    return !filter || (strncmp(prefix, filter, std::min(strlen(prefix), strlen(filter))) == 0);
+  }
+
+  // Runs `fn` in doubling batches until a batch takes at least kTargetNs.
+  // Returns the time per call, 0 if filtered out.
+
+  template <typename Fn>
+  double run(const char* name, uint32_t monitors, uint32_t windows, Fn&& fn) {
+    if (!selected(name)) return 0.0;
+
+    uint64_t iterations = 1;
+    for (;;) {
+      const uint64_t start = now_ns();
+      for (uint64_t i = 0; i < iterations; ++i) fn(i);
+      const uint64_t elapsed = now_ns() - start;
+
+      if ((elapsed >= kTargetNs) || (iterations >= (1ull << 32))) {
+        const double ns_per_op = static_cast<double>(elapsed) / static_cast<double>(iterations);
+        printf("{\"name\":\"%s\",\"monitors\":%u,\"windows\":%u,\"iterations\":%llu,\"ns_per_op\":%.2f}\n", name, monitors, windows, static_cast<unsigned long long>(iterations), ns_per_op);
+        fflush(stdout);
+        return ns_per_op;
+      }
+      iterations *= 2;
+    }
+  }
+
+  void report(const char* name, const char* metric, double value) {
+    if (!selected(name)) return;
+
+    printf("{\"name\":\"%s\",\"metric\":\"%s\",\"value\":%.2f}\n", name, metric, value);
+    fflush(stdout);
+  }
+
+  void check(bool ok, const char* what) {
+    if (ok) return;
+    fprintf(stderr, "bench: %s\n", what);
+    exit(1);
+  }
+
+  // Monitors side by side, every third one at 150 % scaling.
+  std::vector<Monitor> make_monitors(uint32_t count) {
+    std::vector<Monitor> result;
+    for (uint32_t i = 0; i < count; ++i) {
+      const float dpi = (i % 3 == 2) ? 1.5f : 1.0f;
+      result.push_back(Monitor{.handle = 0x1000 + i, .position = {static_cast<int>(i) * 1920, 0}, .size = {1920, 1080}, .dpi = {dpi, dpi}, .identity = 0x5000 + i});
+    }
+    return result;
+  }
+
+  // Random desktop windows, one in sixteen maximized to a monitor so some of
+  // the monitors are covered.
+  std::vector<WindowState> make_windows(uint32_t count, const std::vector<Monitor>& monitors, std::mt19937& rng) {
+    std::vector<WindowState> result;
+    for (uint32_t i = 0; i < count; ++i) {
+      const Monitor& monitor = monitors[rng() % monitors.size()];
+      WindowState state;
+      if (rng() % 16 == 0) {
+        state.frame = make_rect(monitor.position, monitor.size);
+      } else {
+        const int x = monitor.position.x + static_cast<int>(rng() % 1600);
+        const int y = monitor.position.y + static_cast<int>(rng() % 800);
+        state.frame = {x, y, x + 200 + static_cast<int>(rng() % 600), y + 100 + static_cast<int>(rng() % 400)};
+      }
+      state.visible = (rng() % 4) != 0;
+      result.push_back(state);
+    }
+    return result;
+  }
+
+  LocaleNames make_locale_names() {
+    LocaleNames names;
+    const wchar_t* months[12] = {L"January", L"February", L"March", L"April", L"May", L"June", L"July", L"August", L"September", L"October", L"November", L"December"};
+    const wchar_t* days[7] = {L"Sunday", L"Monday", L"Tuesday", L"Wednesday", L"Thursday", L"Friday", L"Saturday"};
+    for (int i = 0; i < 12; ++i) {
+      names.month_names[i] = months[i];
+      names.genitive_month_names[i] = months[i];
+      names.abbreviated_month_names[i] = std::wstring(months[i], 3);
+    }
+    for (int i = 0; i < 7; ++i) {
+      names.day_names[i] = days[i];
+      names.abbreviated_day_names[i] = std::wstring(days[i], 3);
+    }
+    names.am = L"AM";
+    names.pm = L"PM";
+    return names;
+  }
+
+  CivilTime time_at(uint64_t seconds) {
+    return CivilTime{
+      .year = 2024,
+      .month = 3,
+      .day_of_week = static_cast<uint16_t>((seconds / 86400) % 7),
+      .day = static_cast<uint16_t>(1 + (seconds / 86400) % 28),
+      .hour = static_cast<uint16_t>((seconds / 3600) % 24),
+      .minute = static_cast<uint16_t>((seconds / 60) % 60),
+      .second = static_cast<uint16_t>(seconds % 60),
+      .milliseconds = 3,
+    };
+  }
+
+  // @NOTE: The clock as an array of structs, the way ClockWindow used to
+  // hold it: the hot fields interleaved with the window, the monitor, the
+  // backdrop state and the COM pointers of the render target.
+  struct ClockWindowAos {
+    uintptr_t window = 0;
+    void* resources[4] = { };
+    uint32_t surface = 0;
+    Monitor monitor = { };
+    Rect monitor_rect = { };
+    Corner corner = Corner::BottomRight;
+    bool on_primary_monitor = false;
+    bool hidden = false;
+    BackdropContrast contrast = { };
+    uint32_t generation = 0;
+  };
+
+  ClockTable make_clock_table(const std::vector<Monitor>& monitors) {
+    ClockTable table;
+    for (uint32_t i = 0; i < monitors.size(); ++i) clock_table_push(table, ClockRow{.window = 0x10000 + i * 16, .monitor = monitors[i], .surface = i % 3, .generation = i + 1});
+    return table;
+  }
+
+  void bench_layout() {
+    for (uint32_t monitor_count : kMonitorCounts) {
+      const std::vector<Monitor> monitors = make_monitors(monitor_count);
+      run("layout", monitor_count, 0, [&](uint64_t i) {
+        const Corner corner = static_cast<Corner>(i & 3);
+        for (const Monitor& monitor : monitors) {
+          const Int2 size = compute_clock_window_size(monitor.dpi);
+          const Int2 position = compute_clock_window_position(size, monitor.position, monitor.size, corner);
+          consume(static_cast<uint64_t>(position.x + position.y));
+        }
+      });
+    }
+  }
+
+  void bench_visibility() {
+    std::mt19937 rng(1);
+    for (uint32_t monitor_count : kMonitorCounts) {
+      const std::vector<Monitor> monitors = make_monitors(monitor_count);
+      std::vector<Rect> monitor_rects;
+      for (const Monitor& monitor : monitors) monitor_rects.push_back(make_rect(monitor.position, monitor.size));
+
+      for (uint32_t window_count : kWindowCounts) {
+        const std::vector<WindowState> windows = make_windows(window_count, monitors, rng);
+
+        WindowIndex index;
+        window_index_watch(index, monitor_rects);
+        for (uint32_t i = 0; i < windows.size(); ++i) window_index_update(index, i + 1, windows[i]);
+
+        const Settings settings = { };
+        run("visibility", monitor_count, window_count, [&](uint64_t) {
+          for (const Monitor& monitor : monitors) {
+            const bool covered = window_index_has_covering_window(index, make_rect(monitor.position, monitor.size));
+            consume(is_clock_hidden(settings, is_primary_monitor(monitor), covered));
+          }
+        });
+
+        run("visibility_naive", monitor_count, window_count, [&](uint64_t) {
+          for (const Monitor& monitor : monitors) {
+            const bool covered = naive_has_covering_window(windows, make_rect(monitor.position, monitor.size));
+            consume(is_clock_hidden(settings, is_primary_monitor(monitor), covered));
+          }
+        });
+      }
+    }
+  }
+
+  // @NOTE: The per-tick passes over the clocks, visibility and the snapshot,
+  // on the table and on the array of structs it replaced, and finding a
+  // clock by its window handle.
+  void bench_clock_table() {
+    if (!selected_group("clock_table")) return;
+
+    // @NOTE: More monitors than a snapshot carries: the clocks are placed
+    // on the first ones only and every one of them reaches the snapshot.
+    {
+      const std::vector<Monitor> monitors = clock_table_limit_monitors(make_monitors(kClockTableMaxClocks + 36));
+      check((monitors.size() == kClockTableMaxClocks) && (monitors.back().handle == make_monitors(kClockTableMaxClocks).back().handle), "clocks on more monitors than a snapshot carries");
+      const ClockTable table = make_clock_table(monitors);
+      SurfaceCache surfaces;
+      surfaces.slots.resize(3);
+      FrameSnapshot snapshot;
+      clock_table_fill_snapshot(table, surfaces, snapshot);
+      check((snapshot.clock_count == kClockTableMaxClocks) && (snapshot.clocks[kClockTableMaxClocks - 1].window == table.windows.back()), "a clock is missing from the snapshot");
+    }
+
+    constexpr uint32_t kWindows = 1000;
+    std::mt19937 rng(17);
+    for (uint32_t monitor_count : kMonitorCounts) {
+      const std::vector<Monitor> monitors = make_monitors(monitor_count);
+      ClockTable table = make_clock_table(monitors);
+      std::vector<ClockWindowAos> aos;
+      for (uint32_t i = 0; i < monitor_count; ++i) {
+        aos.push_back(ClockWindowAos{.window = table.windows[i], .surface = table.surfaces[i], .monitor = monitors[i], .monitor_rect = table.monitor_rects[i], .on_primary_monitor = table.on_primary_monitor[i] != 0, .generation = table.generations[i]});
+      }
+      SurfaceCache surfaces;
+      surfaces.slots.resize(3);
+
+      const std::vector<WindowState> windows = make_windows(kWindows, monitors, rng);
+      WindowIndex index;
+      window_index_watch(index, table.monitor_rects);
+      for (uint32_t i = 0; i < windows.size(); ++i) window_index_update(index, i + 1, windows[i]);
+
+      const Settings settings = { };
+      FrameSnapshot snapshot;
+      std::vector<uint32_t> toggled;
+      run("clock_table_tick", monitor_count, kWindows, [&](uint64_t) {
+        toggled.clear();
+        consume(clock_table_update_visibility(table, index, settings, toggled));
+        clock_table_fill_snapshot(table, surfaces, snapshot);
+        consume(snapshot.clocks[0].generation);
+      });
+
+      run("clock_table_tick_aos", monitor_count, kWindows, [&](uint64_t) {
+        uint32_t visible_count = 0;
+        for (ClockWindowAos& clock : aos) {
+          const bool covered = window_index_has_covering_window(index, clock.monitor_rect);
+          clock.hidden = is_clock_hidden(settings, clock.on_primary_monitor, covered);
+          if (!clock.hidden) visible_count++;
+        }
+        consume(visible_count);
+        snapshot.clock_count = 0;
+        for (const ClockWindowAos& clock : aos) {
+          snapshot.clocks[snapshot.clock_count++] = SnapshotClock{.window = clock.window, .surface = clock.surface, .key = surfaces.slots[clock.surface].key, .generation = clock.generation, .visible = !clock.hidden};
+        }
+        consume(snapshot.clocks[0].generation);
+      });
+
+      run("clock_table_find", monitor_count, 0, [&](uint64_t i) {
+        consume(clock_table_find(table, table.windows[i % monitor_count]));
+      });
+
+      run("clock_table_find_linear", monitor_count, 0, [&](uint64_t i) {
+        const uintptr_t window = table.windows[i % monitor_count];
+        for (uint32_t row = 0; row < aos.size(); ++row) {
+          if (aos[row].window == window) {
+            consume(row);
+            break;
+          }
+        }
+      });
+    }
+  }
+
+  void bench_window_index() {
+    std::mt19937 rng(2);
+    for (uint32_t window_count : kWindowCounts) {
+      const std::vector<Monitor> monitors = make_monitors(4);
+      const std::vector<WindowState> windows = make_windows(window_count, monitors, rng);
+
+      WindowIndex index;
+      for (uint32_t i = 0; i < windows.size(); ++i) window_index_update(index, i + 1, windows[i]);
+
+      // @NOTE: One location change event, the window moves by a pixel and back.
+      run("window_index_update", 4, window_count, [&](uint64_t i) {
+        const uint32_t id = static_cast<uint32_t>(i % windows.size());
+        WindowState state = windows[id];
+        if (i & 1) state.frame.left += 1;
+        consume(window_index_update(index, id + 1, state));
+      });
+    }
+
+    // @NOTE: A synthetic WinEvent stream of creates, moves, shows, hides and
+    // destroys, with a display change or a re-enumeration now and then.
+    // After every event the index has to agree with scanning every window.
+    if (selected("window_index_equivalence")) {
+      std::vector<Monitor> monitors = make_monitors(4);
+      std::vector<Rect> monitor_rects;
+      for (const Monitor& monitor : monitors) monitor_rects.push_back(make_rect(monitor.position, monitor.size));
+
+      WindowIndex index;
+      window_index_watch(index, monitor_rects);
+      std::unordered_map<WindowId, WindowState> model;
+      std::vector<WindowState> scanned;
+      std::vector<uint8_t> covered(monitor_rects.size(), 0);
+      WindowId next_id = 1;
+      uint64_t transitions = 0;
+
+      auto random_state = [&] {
+        WindowState state = make_windows(1, monitors, rng)[0];
+        if (rng() % 4 == 0) state.frame = monitor_rects[rng() % monitor_rects.size()]; // @NOTE: more fullscreen windows than make_windows makes
+        return state;
+      };
+
+      constexpr uint32_t kEvents = 200'000;
+      for (uint32_t event = 0; event < kEvents; ++event) {
+        bool changed = false;
+        const uint32_t kind = rng() % 100;
+        if ((kind < 20) || model.empty()) {
+          const WindowState state = random_state();
+          model[next_id] = state;
+          changed = window_index_update(index, next_id++, state);
+        } else if (kind < 97) {
+          auto it = model.begin();
+          std::advance(it, rng() % std::min<size_t>(model.size(), 64));
+          const WindowId id = it->first;
+          if (kind < 40) {
+            model.erase(it);
+            changed = window_index_remove(index, id);
+          } else {
+            WindowState state = it->second;
+            if (kind < 70) state.frame = random_state().frame;
+            else if (kind < 80) state.frame.left += (rng() % 2) ? 1 : -1;
+            else state.visible = !state.visible;
+            it->second = state;
+            changed = window_index_update(index, id, state);
+          }
+        } else if (kind < 99) {
+          monitors = make_monitors(1 + rng() % 6);
+          monitor_rects.clear();
+          for (const Monitor& monitor : monitors) monitor_rects.push_back(make_rect(monitor.position, monitor.size));
+          window_index_watch(index, monitor_rects);
+          covered.assign(monitor_rects.size(), 0);
+          changed = true;
+        } else {
+          window_index_clear(index);
+          for (const auto& [id, state] : model) window_index_update(index, id, state);
+          changed = true;
+        }
+
+        scanned.clear();
+        for (const auto& [id, state] : model) scanned.push_back(state);
+        bool flipped = false;
+        for (size_t m = 0; m < monitor_rects.size(); ++m) {
+          const bool naive = naive_has_covering_window(scanned, monitor_rects[m]);
+          check(window_index_has_covering_window(index, monitor_rects[m]) == naive, "window index lookup differs from the scan");
+          check((index.covered[m] != 0) == naive, "window index covered flag differs from the scan");
+          flipped |= (covered[m] != 0) != naive;
+          covered[m] = static_cast<uint8_t>(naive);
+        }
+        check(changed || !flipped, "window index missed a covered change");
+        check(!changed || flipped || (kind >= 97), "window index reported a covered change that did not happen");
+        transitions += flipped;
+      }
+      report("window_index_equivalence", "events", static_cast<double>(kEvents));
+      report("window_index_equivalence", "covered_transitions", static_cast<double>(transitions));
+    }
+  }
+
+  // @NOTE: Clocks on `monitors` through the clock table and the surface
+  // cache like reconcile_clock_windows places them, then frames rendered
+  // through snapshot_render_frame like render_frame: every visible clock's
+  // surface rasterized once and presented to each clock. Checks the rasterizations per frame against
+  // the distinct looks counted without SurfaceKey and returns them.
+  uint32_t check_surface_sharing(const std::vector<Monitor>& monitors, const std::vector<Corner>& corners, const std::vector<uint8_t>& dark_text, const std::vector<uint8_t>& hidden) {
+    SurfaceCache surfaces;
+    ClockTable table;
+    std::set<std::tuple<uint32_t, Corner, bool>> looks;
+    for (uint32_t i = 0; i < monitors.size(); ++i) {
+      bool created = false;
+      const uint32_t surface = surface_cache_acquire(surfaces, make_surface_key(monitors[i].dpi, corners[i], dark_text[i] != 0, false), &created);
+      clock_table_push(table, ClockRow{.window = 0x10000 + i * 16, .monitor = monitors[i], .corner = corners[i], .surface = surface, .generation = i + 1, .hidden = hidden[i] != 0});
+      if (!hidden[i]) looks.insert({static_cast<uint32_t>(monitors[i].dpi.x * 96.0f + 0.5f), corners[i], dark_text[i] != 0});
+    }
+
+    FrameSnapshot snapshot;
+    clock_table_fill_snapshot(table, surfaces, snapshot);
+    std::vector<uint64_t> rendered_frames(surfaces.slots.size(), 0);
+    uint32_t rasterizations = 0;
+    for (uint64_t frame = 1; frame <= 60; ++frame) {
+      rasterizations = 0;
+      uint32_t presents = 0;
+      auto rendered_frame = [&](uint32_t surface) -> uint64_t& { return rendered_frames[surface]; };
+      auto render = [&](uint32_t) { rasterizations++; };
+      auto present = [&](const SnapshotClock&) { presents++; };
+      snapshot_render_frame(snapshot, frame, rendered_frame, render, present);
+      check(rasterizations == looks.size(), "surface rasterized more than once per frame");
+      check(presents == monitors.size() - static_cast<size_t>(std::count(hidden.begin(), hidden.end(), uint8_t{1})), "clock not presented");
+    }
+    return rasterizations;
+  }
+
+  // @NOTE: Rasterizations per frame against clocks: identical monitors,
+  // every third at 150 %, and a mix of five DPIs, per monitor corners,
+  // light and dark backdrops and covered clocks.
+  void bench_surface_cache() {
+    if (!selected_group("surface_cache")) return;
+
+    std::mt19937 rng(6);
+    for (uint32_t monitor_count : kMonitorCounts) {
+      std::vector<Monitor> monitors = make_monitors(monitor_count);
+      const std::vector<Corner> corners(monitor_count, Corner::BottomRight);
+      const std::vector<uint8_t> none(monitor_count, 0);
+      const uint32_t mixed = check_surface_sharing(monitors, corners, none, none);
+      check(mixed == ((monitor_count >= 3) ? 2u : 1u), "every third monitor at 150 % needs two surfaces");
+
+      for (Monitor& monitor : monitors) monitor.dpi = {1.0f, 1.0f};
+      const uint32_t same = check_surface_sharing(monitors, corners, none, none);
+      check(same == 1, "monitors at the same DPI need one surface");
+
+      constexpr float kScales[] = {1.0f, 1.25f, 1.5f, 1.75f, 2.0f};
+      std::vector<Corner> random_corners;
+      std::vector<uint8_t> dark_text;
+      std::vector<uint8_t> hidden;
+      for (Monitor& monitor : monitors) {
+        const float scale = kScales[rng() % std::size(kScales)];
+        monitor.dpi = {scale, scale};
+        random_corners.push_back((rng() % 4 == 0) ? Corner::TopLeft : Corner::BottomRight);
+        dark_text.push_back(static_cast<uint8_t>(rng() % 3 == 0));
+        hidden.push_back(static_cast<uint8_t>(rng() % 5 == 0));
+      }
+      const uint32_t heterogeneous = check_surface_sharing(monitors, random_corners, dark_text, hidden);
+
+      char name[64];
+      snprintf(name, sizeof(name), "surface_cache_%u_clocks", monitor_count);
+      report(name, "rasterizations_same_dpi", static_cast<double>(same));
+      report(name, "rasterizations_every_third_150", static_cast<double>(mixed));
+      report(name, "rasterizations_heterogeneous", static_cast<double>(heterogeneous));
+    }
+  }
+
+  void bench_monitor_diff() {
+    for (uint32_t monitor_count : kMonitorCounts) {
+      const std::vector<Monitor> previous = make_monitors(monitor_count);
+
+      // @NOTE: Reordered, the first monitor rescaled and the last one unplugged.
+      std::vector<Monitor> current(previous.rbegin(), previous.rend());
+      current.front().dpi = {2.0f, 2.0f};
+      if (current.size() > 1) current.pop_back();
+
+      run("monitor_diff", monitor_count, 0, [&](uint64_t) {
+        consume(diff_monitors(previous, current).size());
+      });
+    }
+
+    // @NOTE: Random display changes: monitors plugged in, unplugged,
+    // reordered, rescaled, moved, mirrored onto another one's rectangle and
+    // re-enumerated with new or swapped handles. Applying the ops to
+    // `previous` the way reconcile_clock_windows does has to give `current`.
+    if (selected("monitor_diff_random")) {
+      std::mt19937 rng(8);
+      uintptr_t next_handle = 0x9000;
+      uint64_t ops[5] = { };
+      uint64_t monitors_seen = 0;
+      for (uint32_t round = 0; round < 20'000; ++round) {
+        const std::vector<Monitor> previous = make_monitors(rng() % 9);
+        std::vector<Monitor> current = previous;
+        const uint32_t changes = 1 + rng() % 4;
+        for (uint32_t c = 0; c < changes; ++c) {
+          const uint32_t kind = rng() % 8;
+          const size_t at = current.empty() ? 0 : rng() % current.size();
+          if ((kind == 0) || current.empty()) {
+            Monitor monitor = {.handle = next_handle++, .position = {static_cast<int>(rng() % 8) * 1920, 1080}, .size = {1920, 1080}, .identity = next_handle};
+            if (!current.empty() && (rng() % 2)) { monitor.position = current[at].position; monitor.size = current[at].size; } // @NOTE: mirrored
+            current.insert(current.begin() + static_cast<ptrdiff_t>(rng() % (current.size() + 1)), monitor);
+          } else if (kind == 1) {
+            current.erase(current.begin() + static_cast<ptrdiff_t>(at));
+          } else if (kind == 2) {
+            std::shuffle(current.begin(), current.end(), rng);
+          } else if (kind == 3) {
+            current[at].dpi = (current[at].dpi.x == 1.0f) ? Float2{1.25f, 1.25f} : Float2{1.0f, 1.0f};
+          } else if (kind == 4) {
+            current[at].position.y += 540;
+          } else if (kind == 5) {
+            current[at].handle = next_handle++;
+          } else if (kind == 6) {
+            std::swap(current[at].handle, current[rng() % current.size()].handle);
+          } else {
+            current[at].size = current[rng() % current.size()].size;
+            current[at].position = current[rng() % current.size()].position;
+          }
+        }
+
+        const std::vector<MonitorDiffOp> diff = diff_monitors(previous, current);
+        std::vector<uint8_t> old_seen(previous.size(), 0);
+        std::vector<Monitor> applied;
+        bool adding = false;
+        for (const MonitorDiffOp& op : diff) {
+          ops[static_cast<uint32_t>(op.change)]++;
+          if (op.change == MonitorChange::Remove) {
+            check(!adding && (op.old_index < previous.size()) && !old_seen[op.old_index]++, "monitor diff remove");
+            continue;
+          }
+          adding = true;
+          check(op.new_index == applied.size(), "monitor diff ops out of order");
+          if (op.change == MonitorChange::Add) {
+            applied.push_back(current[op.new_index]);
+            continue;
+          }
+
+          check((op.old_index < previous.size()) && !old_seen[op.old_index]++, "monitor diff matched a monitor twice");
+          Monitor monitor = previous[op.old_index];
+          const Monitor& target = current[op.new_index];
+          const bool same_rect = make_rect(monitor.position, monitor.size) == make_rect(target.position, target.size);
+          const bool same_dpi = (monitor.dpi.x == target.dpi.x) && (monitor.dpi.y == target.dpi.y);
+          check((monitor.handle == target.handle) || same_rect, "monitor diff matched unrelated monitors");
+          switch (op.change) {
+            case MonitorChange::Keep: check(same_rect && same_dpi, "monitor diff kept a changed monitor"); break;
+            case MonitorChange::Move: check(!same_rect && same_dpi, "monitor diff move"); break;
+            default: check(!same_dpi, "monitor diff rescale"); break;
+          }
+          monitor.handle = target.handle;
+          monitor.position = target.position;
+          monitor.size = target.size;
+          monitor.dpi = target.dpi;
+          monitor.identity = target.identity;
+          applied.push_back(monitor);
+        }
+        check(std::count(old_seen.begin(), old_seen.end(), uint8_t{1}) == static_cast<ptrdiff_t>(previous.size()), "monitor diff lost a monitor");
+        check(applied.size() == current.size(), "monitor diff count");
+        for (size_t i = 0; i < current.size(); ++i) {
+          check((applied[i].handle == current[i].handle) && (make_rect(applied[i].position, applied[i].size) == make_rect(current[i].position, current[i].size)) && (applied[i].dpi.x == current[i].dpi.x), "monitor diff applied differs");
+        }
+
+        // @NOTE: A monitor whose handle, rectangle and DPI did not change
+        // keeps its clock, whatever happened around it.
+        for (size_t i = 0; i < current.size(); ++i) {
+          for (size_t j = 0; j < previous.size(); ++j) {
+            if ((previous[j].handle != current[i].handle) || (make_rect(previous[j].position, previous[j].size) != make_rect(current[i].position, current[i].size)) || (previous[j].dpi.x != current[i].dpi.x)) continue;
+            const MonitorDiffOp& op = diff[diff.size() - current.size() + i];
+            check((op.change == MonitorChange::Keep) && (op.old_index == j), "monitor diff recreated an unchanged monitor");
+          }
+        }
+        monitors_seen += current.size();
+      }
+
+      report("monitor_diff_random", "monitors", static_cast<double>(monitors_seen));
+      report("monitor_diff_random", "keeps", static_cast<double>(ops[static_cast<uint32_t>(MonitorChange::Keep)]));
+      report("monitor_diff_random", "moves", static_cast<double>(ops[static_cast<uint32_t>(MonitorChange::Move)]));
+      report("monitor_diff_random", "rescales", static_cast<double>(ops[static_cast<uint32_t>(MonitorChange::Rescale)]));
+      report("monitor_diff_random", "adds", static_cast<double>(ops[static_cast<uint32_t>(MonitorChange::Add)]));
+      report("monitor_diff_random", "removes", static_cast<double>(ops[static_cast<uint32_t>(MonitorChange::Remove)]));
+    }
+  }
+
+  // A 205x48 clock at 100 % with "H:mm:ss" over a short date, ticking once a
+  // second. Glyphs are synthetic: tabular digits, everything else narrower.
+  void bench_compose() {
+    const LocaleNames names = make_locale_names();
+    const FormatProgram time_program = compile_format(L"H:mm:ss");
+    const FormatProgram date_program = compile_format(L"d.M.yyyy");
+
+    GlyphAtlas atlas;
+    glyph_atlas_init(atlas, kGlyphAtlasSize, kGlyphAtlasSize, 20);
+    auto measure = [](wchar_t ch) { return ((ch >= L'0') && (ch <= L'9')) ? 8 : 4; };
+    auto rasterize = [](wchar_t ch, PixelView tile) {
+      for (int y = 2; y < tile.height - 2; ++y) {
+        for (int x = kGlyphPad; x < tile.width - kGlyphPad; ++x) {
+          const uint32_t a = (static_cast<uint32_t>(ch) * 37u + static_cast<uint32_t>(x * 11 + y * 5)) & 0xff;
+          tile.pixels[y * tile.stride + x] = (a << 24) | (a << 16) | (a << 8) | a;
+        }
+      }
+    };
+
+    Framebuffer fb;
+    framebuffer_alloc(fb, 205, 48);
+    const PixelView target = framebuffer_view(fb);
+    const TextLayout layout = {.left = 0, .right = 190, .top = 4, .align_right = true};
+
+    FormattedText time_text;
+    FormattedText date_text;
+    TextCompositor compositor;
+    auto frame = [&](uint64_t i) {
+      const CivilTime time = time_at(i);
+      render_format(time_program, names, time, time_text);
+      render_format(date_program, names, time, date_text);
+      glyph_atlas_ensure(atlas, time_text.text, time_text.length, measure, rasterize);
+      glyph_atlas_ensure(atlas, date_text.text, date_text.length, measure, rasterize);
+
+      const wchar_t* lines[2] = {time_text.text, date_text.text};
+      const uint32_t lengths[2] = {time_text.length, date_text.length};
+      return compose_text(compositor, atlas, target, layout, lines, lengths, 2);
+    };
+
+    run("compose", 1, 0, [&](uint64_t i) { consume(static_cast<uint64_t>(frame(i).right)); });
+
+    run("compose_full", 1, 0, [&](uint64_t i) {
+      compositor.valid = false;
+      consume(static_cast<uint64_t>(frame(i).right));
+    });
+
+    // @NOTE: Over the whole day the incremental frame must be the redrawn
+    // one byte for byte, whatever the dirty rectangle left out.
+    Framebuffer reference_fb;
+    framebuffer_alloc(reference_fb, 205, 48);
+    const PixelView reference = framebuffer_view(reference_fb);
+    compositor = { };
+    constexpr uint64_t kTicks = 24 * 3600;
+    for (uint64_t i = 0; i < kTicks; ++i) {
+      framebuffer_record_present(fb, frame(i));
+      const wchar_t* lines[2] = {time_text.text, date_text.text};
+      const uint32_t lengths[2] = {time_text.length, date_text.length};
+      compose_text_full(atlas, reference, layout, lines, lengths, 2);
+      for (int y = 0; y < target.height; ++y) {
+        if (memcmp(target.pixels + y * target.stride, reference.pixels + y * reference.stride, static_cast<size_t>(target.width) * sizeof(uint32_t)) != 0) {
+          check(false, "compose_text differs from compose_text_full");
+          break;
+        }
+      }
+    }
+    framebuffer_free(reference_fb);
+    report("compose", "pixels_per_tick", static_cast<double>(compositor.stats.pixels_touched) / static_cast<double>(kTicks));
+    report("compose_full", "pixels_per_tick", static_cast<double>(target.width * target.height));
+
+    // @NOTE: What UpdateLayeredWindow is handed per tick, with the dirty
+    // rectangle vs. the whole surface every time.
+    report("present", "bytes_per_tick", static_cast<double>(fb.stats.bytes_presented) / static_cast<double>(fb.stats.presents));
+    report("present_full", "bytes_per_tick", static_cast<double>(target.width * target.height * 4));
+    framebuffer_free(fb);
+  }
+
+  void bench_framebuffer() {
+    Framebuffer fb;
+    framebuffer_alloc(fb, 205, 48);
+    const PixelView target = framebuffer_view(fb);
+    const Rect bounds = {0, 0, target.width, target.height};
+
+    std::vector<uint32_t> glyph(16 * 20);
+    for (size_t i = 0; i < glyph.size(); ++i) {
+      const uint32_t a = static_cast<uint32_t>(i * 37) & 0xff;
+      glyph[i] = (a << 24) | (a << 16) | (a << 8) | a;
+    }
+    const PixelView source = {.pixels = glyph.data(), .width = 16, .height = 20, .stride = 16};
+
+    run("framebuffer_clear", 1, 0, [&](uint64_t) { fill_pixels(target, bounds, 0); consume(target.pixels[0]); });
+    run("framebuffer_copy_glyph", 1, 0, [&](uint64_t i) { copy_pixels(target, Int2{static_cast<int>(i % 180), 4}, source); consume(target.pixels[0]); });
+    run("framebuffer_blend_glyph", 1, 0, [&](uint64_t i) { blend_pixels(target, Int2{static_cast<int>(i % 180), 4}, source, bounds); consume(target.pixels[0]); });
+    framebuffer_free(fb);
+  }
+
+  // Every field of the snapshot is derived from its serial, so the consumer
+  // can tell a torn or reordered one.
+  FrameSnapshot make_test_snapshot(uint64_t serial, const std::shared_ptr<const FrameFormat>* formats) {
+    FrameSnapshot snapshot;
+    snapshot.serial = serial;
+    snapshot.format = formats[serial % 2];
+    snapshot.analog = (serial % 3) == 0;
+    snapshot.clock_count = static_cast<uint32_t>(serial % kSnapshotMaxClocks) + 1;
+    for (uint32_t i = 0; i < snapshot.clock_count; ++i) {
+      snapshot.clocks[i] = SnapshotClock{.window = serial * 131 + i, .surface = i, .key = { }, .generation = static_cast<uint32_t>(serial), .visible = (i % 2) == 0};
+    }
+    return snapshot;
+  }
+
+  bool is_test_snapshot(const FrameSnapshot& snapshot, const std::shared_ptr<const FrameFormat>* formats) {
+    FrameSnapshot expected = make_test_snapshot(snapshot.serial, formats);
+    return same_frame_state(snapshot, expected);
+  }
+
+  double percentile(std::vector<uint64_t>& values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    return static_cast<double>(values[static_cast<size_t>(p * static_cast<double>(values.size() - 1))]);
+  }
+
+  // @NOTE: The names the golden table needs, over the English ones.
+  LocaleNames make_test_locale_names(std::wstring_view locale) {
+    LocaleNames names = make_locale_names();
+    if (locale == L"de-DE") {
+      names.month_names[2] = names.genitive_month_names[2] = L"M\u00e4rz";
+      names.abbreviated_month_names[2] = L"M\u00e4r";
+      names.day_names[2] = L"Dienstag";
+      names.abbreviated_day_names[2] = L"Di";
+    } else if (locale == L"ru-RU") {
+      names.month_names[2] = L"\u043c\u0430\u0440\u0442";
+      names.genitive_month_names[2] = L"\u043c\u0430\u0440\u0442\u0430";
+      names.day_names[2] = L"\u0432\u0442\u043e\u0440\u043d\u0438\u043a";
+    } else if (locale == L"ko-KR") {
+      names.am = L"\uc624\uc804";
+      names.pm = L"\uc624\ud6c4";
+    }
+    return names;
+  }
+
+  struct FormatGolden {
+    const wchar_t* locale;
+    const wchar_t* picture;
+    uint16_t hour;
+    const wchar_t* expected; // @NOTE: on Tuesday, March 5, 2024, at hh:07:03
+  };
+
+  // @NOTE: The pictures are the ones Windows reports for the locales.
+  constexpr FormatGolden kFormatGoldens[] = {
+    {L"en-US", L"dddd, MMMM d, yyyy", 9, L"Tuesday, March 5, 2024"},
+    {L"en-US", L"M/d/yyyy", 9, L"3/5/2024"},
+    {L"en-US", L"h:mm:ss tt", 9, L"9:07:03 AM"},
+    {L"en-US", L"h:mm tt", 21, L"9:07 PM"},
+    {L"en-US", L"h:mm tt", 0, L"12:07 AM"},
+    {L"en-US", L"ddd, MMM dd yy", 9, L"Tue, Mar 05 24"},
+    {L"en-US", L"h 'o''clock' t", 21, L"9 o'clock P"},
+    {L"en-US", L"g yyyy", 9, L" 2024"}, // @NOTE: the era is dropped, see compile_text
+    {L"en-GB", L"dd/MM/yyyy", 9, L"05/03/2024"},
+    {L"en-GB", L"HH:mm:ss", 9, L"09:07:03"},
+    {L"de-DE", L"dddd, d. MMMM yyyy", 9, L"Dienstag, 5. M\u00e4rz 2024"},
+    {L"de-DE", L"dd.MM.yyyy", 9, L"05.03.2024"},
+    {L"de-DE", L"HH:mm", 21, L"21:07"},
+    {L"ru-RU", L"d MMMM yyyy '\u0433.'", 9, L"5 \u043c\u0430\u0440\u0442\u0430 2024 \u0433."},
+    {L"ru-RU", L"MMMM yyyy", 9, L"\u043c\u0430\u0440\u0442 2024"},
+    {L"ru-RU", L"dddd, d MMMM", 9, L"\u0432\u0442\u043e\u0440\u043d\u0438\u043a, 5 \u043c\u0430\u0440\u0442\u0430"},
+    {L"ja-JP", L"yyyy'\u5e74'M'\u6708'd'\u65e5'", 9, L"2024\u5e743\u67085\u65e5"},
+    {L"ja-JP", L"yyyy/MM/dd", 9, L"2024/03/05"},
+    {L"ja-JP", L"H:mm:ss", 9, L"9:07:03"},
+    {L"ko-KR", L"tt h:mm:ss", 21, L"\uc624\ud6c4 9:07:03"},
+    {L"ko-KR", L"yyyy-MM-dd", 9, L"2024-03-05"},
+  };
+
+  // @NOTE: Pieces of random pictures, every token and the quoting cases.
+  constexpr const wchar_t* kPicturePieces[] = {
+    L"d", L"dd", L"ddd", L"dddd", L"M", L"MM", L"MMM", L"MMMM", L"y", L"yy", L"yyyy", L"yyyyy",
+    L"h", L"hh", L"H", L"HH", L"m", L"mm", L"s", L"ss", L"t", L"tt", L"g", L"gg",
+    L", ", L".", L" ", L"/", L":", L"'de'", L"''", L"'o''clock'", L"'d M'", L"x",
+  };
+
+  void bench_datetime_format() {
+    if (!selected_group("datetime_format")) return;
+
+    for (size_t i = 0; i < std::size(kFormatGoldens); ++i) {
+      const FormatGolden& golden = kFormatGoldens[i];
+      const LocaleNames names = make_test_locale_names(golden.locale);
+      const CivilTime time = {.year = 2024, .month = 3, .day_of_week = 2, .day = 5, .hour = golden.hour, .minute = 7, .second = 3, .milliseconds = 0};
+      FormattedText text;
+      render_format(compile_format(golden.picture), names, time, text);
+      const bool compiled = (std::wstring_view(text.text, text.length) == golden.expected);
+      const bool reference = (format_picture(golden.picture, names, time) == golden.expected);
+      if (!compiled || !reference) fprintf(stderr, "bench: golden %zu (%ls) %s\n", i, golden.locale, compiled ? "format_picture" : "compiled");
+      check(compiled && reference, "datetime_format golden output");
+    }
+    report("datetime_format_golden", "pictures", static_cast<double>(std::size(kFormatGoldens)));
+
+    // @NOTE: Each picture renders into one FormattedText over a run of
+    // times stepping by a second up to a year, so the fields get patched in
+    // place as well as rendered whole.
+    if (selected("datetime_format_equivalence")) {
+      std::mt19937 rng(17);
+      const wchar_t* locales[] = {L"en-US", L"de-DE", L"ru-RU", L"ko-KR"};
+      constexpr uint64_t kSteps[] = {1, 59, 3600, 86400, 86400 * 31, 86400 * 366};
+      uint64_t renders = 0;
+      for (uint32_t p = 0; p < 2000; ++p) {
+        std::wstring picture;
+        const uint32_t pieces = 1 + rng() % 10;
+        for (uint32_t k = 0; k < pieces; ++k) picture += kPicturePieces[rng() % std::size(kPicturePieces)];
+        const LocaleNames names = make_test_locale_names(locales[rng() % std::size(locales)]);
+
+        const FormatProgram program = compile_format(picture);
+        FormattedText text;
+        uint64_t seconds = rng() % (86400 * 365);
+        for (uint32_t step = 0; step < 64; ++step) {
+          seconds += kSteps[rng() % std::size(kSteps)];
+          const uint64_t days = seconds / 86400;
+          const CivilTime time = {
+            .year = static_cast<uint16_t>(1999 + days / 372),
+            .month = static_cast<uint16_t>(1 + (days / 31) % 12),
+            .day_of_week = static_cast<uint16_t>(days % 7),
+            .day = static_cast<uint16_t>(1 + days % 31),
+            .hour = static_cast<uint16_t>((seconds / 3600) % 24),
+            .minute = static_cast<uint16_t>((seconds / 60) % 60),
+            .second = static_cast<uint16_t>(seconds % 60),
+            .milliseconds = 0,
+          };
+          render_format(program, names, time, text);
+          if (std::wstring_view(text.text, text.length) != format_picture(picture, names, time)) fprintf(stderr, "bench: picture \"%ls\" at step %u\n", picture.c_str(), step);
+          check(std::wstring_view(text.text, text.length) == format_picture(picture, names, time), "compiled picture differs from format_picture");
+          renders++;
+        }
+      }
+      report("datetime_format_equivalence", "renders", static_cast<double>(renders));
+    }
+
+    // @NOTE: What a tick formats: both times and both dates.
+    const LocaleNames names = make_locale_names();
+    const std::wstring pictures[4] = {L"H:mm", L"H:mm:ss", L"d.M.yyyy", L"dddd, MMMM d, yyyy"};
+    FormatProgram programs[4];
+    for (int p = 0; p < 4; ++p) programs[p] = compile_format(pictures[p]);
+    FormattedText texts[4];
+    const double compiled_ns = run("datetime_format_compiled", 0, 0, [&](uint64_t i) {
+      const CivilTime time = time_at(i);
+      for (int p = 0; p < 4; ++p) consume(render_format(programs[p], names, time, texts[p]));
+    });
+    const double picture_ns = run("datetime_format_picture", 0, 0, [&](uint64_t i) {
+      const CivilTime time = time_at(i);
+      for (int p = 0; p < 4; ++p) consume(format_picture(pictures[p], names, time).size());
+    });
+    if ((compiled_ns > 0.0) && (picture_ns > 0.0)) report("datetime_format_compiled", "speedup", picture_ns / compiled_ns);
+  }
+
+  void bench_render_queue() {
+    FrameFormat a;
+    a.time = compile_format(L"H:mm:ss");
+    FrameFormat b = a;
+    b.date = compile_format(L"d.M.yyyy");
+    const std::shared_ptr<const FrameFormat> formats[2] = {std::make_shared<FrameFormat>(a), std::make_shared<FrameFormat>(b)};
+
+    {
+      RenderQueue queue;
+      FrameSnapshot latest;
+      const FrameSnapshot snapshot = make_test_snapshot(7, formats);
+      run("render_queue_publish_take", 0, 0, [&](uint64_t) {
+        render_queue_publish(queue, snapshot);
+        consume(render_queue_take_latest(queue, latest));
+      });
+    }
+
+    // @NOTE: Both sides as fast as they can, the producer retries when full.
+    if (selected("render_queue_stress")) {
+      constexpr uint64_t kSnapshots = 200'000;
+      auto queue = std::make_unique<RenderQueue>();
+
+      std::thread producer([&] {
+        for (uint64_t serial = 1; serial <= kSnapshots; ++serial) {
+          const FrameSnapshot snapshot = make_test_snapshot(serial, formats);
+          while (!render_queue_publish(*queue, snapshot)) std::this_thread::yield();
+        }
+      });
+
+      FrameSnapshot latest;
+      uint64_t previous = 0;
+      uint64_t takes = 0;
+      while (previous != kSnapshots) {
+        if (!render_queue_take_latest(*queue, latest)) continue;
+        check(latest.serial > previous, "snapshot out of order");
+        check(is_test_snapshot(latest, formats), "torn snapshot");
+        previous = latest.serial;
+        takes++;
+      }
+      producer.join();
+
+      check(queue->stats.published == kSnapshots, "lost a snapshot");
+      check(queue->stats.consumed == kSnapshots, "consumed count mismatch");
+      report("render_queue_stress", "takes", static_cast<double>(takes));
+      report("render_queue_stress", "superseded", static_cast<double>(queue->stats.superseded));
+      report("render_queue_stress", "rejected", static_cast<double>(queue->stats.rejected));
+    }
+
+    // @NOTE: The consumer renders on a fixed 2 ms cadence while the producer
+    // publishes every 1 ms but stalls for 30 ms every 16th snapshot, like a
+    // slow EnumDesktopWindows or a modal menu on the UI thread. Measures how
+    // long a snapshot waits to be picked up and how late the consumer's
+    // frames are.
+    if (selected("render_queue_stalled")) {
+      constexpr uint64_t kSnapshots = 256;
+      constexpr auto kProducerPeriod = std::chrono::milliseconds(1);
+      constexpr auto kStall = std::chrono::milliseconds(30);
+      constexpr auto kFramePeriod = std::chrono::milliseconds(2);
+
+      auto queue = std::make_unique<RenderQueue>();
+      std::vector<uint64_t> published_ns(kSnapshots + 1, 0);
+      std::atomic<bool> done{false};
+
+      std::thread producer([&] {
+        for (uint64_t serial = 1; serial <= kSnapshots; ++serial) {
+          std::this_thread::sleep_for((serial % 16 == 0) ? kStall : kProducerPeriod);
+          const FrameSnapshot snapshot = make_test_snapshot(serial, formats);
+          published_ns[serial] = now_ns(); // @NOTE: made visible to the consumer by the push
+          while (!render_queue_publish(*queue, snapshot)) std::this_thread::yield();
+        }
+        done.store(true, std::memory_order_release);
+      });
+
+      const LocaleNames names = make_locale_names();
+      FormattedText text;
+      FrameSnapshot latest;
+      std::vector<uint64_t> pickup_us;
+      std::vector<uint64_t> lateness_us;
+      auto deadline = std::chrono::steady_clock::now();
+      while (!done.load(std::memory_order_acquire) || (latest.serial != kSnapshots)) {
+        deadline += kFramePeriod;
+        std::this_thread::sleep_until(deadline);
+        lateness_us.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - deadline).count()));
+
+        if (render_queue_take_latest(*queue, latest)) {
+          check(is_test_snapshot(latest, formats), "torn snapshot");
+          pickup_us.push_back((now_ns() - published_ns[latest.serial]) / 1000);
+        }
+        if (latest.format) consume(render_format(latest.format->time, names, time_at(lateness_us.size()), text));
+      }
+      producer.join();
+
+      report("render_queue_stalled", "pickup_p50_us", percentile(pickup_us, 0.5));
+      report("render_queue_stalled", "pickup_p99_us", percentile(pickup_us, 0.99));
+      report("render_queue_stalled", "frame_lateness_p50_us", percentile(lateness_us, 0.5));
+      report("render_queue_stalled", "frame_lateness_p99_us", percentile(lateness_us, 0.99));
+      report("render_queue_stalled", "frame_lateness_max_us", percentile(lateness_us, 1.0));
+      report("render_queue_stalled", "producer_stall_us", static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(kStall).count()));
+    }
+  }
+
+  void bench_clock_face() {
+    constexpr int kSizes[] = {16, 24, 32, 48, 64, 128, 256, 512};
+    ClockFaceKernel kernels[] = {ClockFaceKernel::Scalar, ClockFaceKernel::Sse2, ClockFaceKernel::Avx2};
+    const ClockFace face = make_clock_face(time_at(10 * 3600 + 42 * 60 + 17), true);
+
+    // @NOTE: Every kernel draws the scalar picture, each channel within one
+    // step of it: the vector kernels never fuse a multiply and an add, the
+    // scalar path may be contracted into FMAs by the compiler.
+    if (selected("clock_face_pixels")) {
+      for (ClockFaceKernel kernel : kernels) {
+        if ((kernel == ClockFaceKernel::Scalar) || (static_cast<int>(kernel) > static_cast<int>(best_clock_face_kernel()))) continue;
+        uint64_t differing = 0;
+        for (int size : kSizes) {
+          for (uint64_t second = 0; second < 86'400; second += 7'919) {
+            const ClockFace tested = make_clock_face(time_at(second), (second & 1) != 0, true);
+            std::vector<uint32_t> expected(static_cast<size_t>(size) * static_cast<size_t>(size));
+            std::vector<uint32_t> actual(expected.size());
+            rasterize_clock_face(PixelView{.pixels = expected.data(), .width = size, .height = size, .stride = size}, tested, ClockFaceKernel::Scalar);
+            rasterize_clock_face(PixelView{.pixels = actual.data(), .width = size, .height = size, .stride = size}, tested, kernel);
+            for (size_t i = 0; i < expected.size(); ++i) {
+              if (expected[i] == actual[i]) continue;
+              differing++;
+              for (uint32_t shift = 0; shift < 32; shift += 8) {
+                const int lhs = static_cast<int>((expected[i] >> shift) & 0xff);
+                const int rhs = static_cast<int>((actual[i] >> shift) & 0xff);
+                check(std::abs(lhs - rhs) <= 1, "a clock face kernel is more than one step off the scalar one");
+              }
+            }
+          }
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "clock_face_pixels_%s", clock_face_kernel_name(kernel));
+        report(name, "differing_pixels", static_cast<double>(differing));
+      }
+    }
+
+    for (ClockFaceKernel kernel : kernels) {
+      // @NOTE: Kernels above the best supported one would fault or fall back.
+      if (static_cast<int>(kernel) > static_cast<int>(best_clock_face_kernel())) continue;
+
+      for (int size : kSizes) {
+        std::vector<uint32_t> pixels(static_cast<size_t>(size) * static_cast<size_t>(size));
+        const PixelView target = {.pixels = pixels.data(), .width = size, .height = size, .stride = size};
+
+        char name[64];
+        snprintf(name, sizeof(name), "clock_face_%s_%d", clock_face_kernel_name(kernel), size);
+        const double ns = run(name, 0, 0, [&](uint64_t) {
+          rasterize_clock_face(target, face, kernel);
+          consume(pixels[static_cast<size_t>(size) * static_cast<size_t>(size) / 2]);
+        });
+        if (ns > 0.0) report(name, "mpix_per_s", static_cast<double>(size * size) / ns * 1000.0);
+      }
+    }
+  }
+
+  // One tick as WM_TIMER runs it, minus the platform calls: plan the pending
+  // flags, render the visible pictures, decide visibility and schedule the
+  // next wakeup.
+  void bench_tick() {
+    std::mt19937 rng(3);
+    const LocaleNames names = make_locale_names();
+    const FormatProgram programs[4] = {compile_format(L"H:mm"), compile_format(L"H:mm:ss"), compile_format(L"d.M.yyyy"), compile_format(L"dddd, MMMM d, yyyy")};
+
+    for (uint32_t monitor_count : kMonitorCounts) {
+      const std::vector<Monitor> monitors = make_monitors(monitor_count);
+      ClockTable clocks = make_clock_table(monitors);
+      SurfaceCache surfaces;
+      surfaces.slots.resize(3);
+
+      for (uint32_t window_count : kWindowCounts) {
+        const std::vector<WindowState> windows = make_windows(window_count, monitors, rng);
+
+        WindowIndex index;
+        window_index_watch(index, clocks.monitor_rects);
+        for (uint32_t i = 0; i < windows.size(); ++i) window_index_update(index, i + 1, windows[i]);
+
+        FormattedText texts[4];
+        FrameSnapshot snapshot;
+        std::vector<uint32_t> toggled;
+        TickScheduler scheduler;
+        const Settings settings = { };
+
+        run("tick", monitor_count, window_count, [&](uint64_t i) {
+          const uint64_t now_ms = i * 1000;
+          const CivilTime time = time_at(i);
+          tick_scheduler_wakeup(scheduler, now_ms);
+
+          const TickActions actions = plan_tick((i % 64 == 0) ? (1u << kTransientAppFlagDisplayChanged) : 0u);
+          consume(actions.reconcile_clocks);
+
+          uint32_t fields = 0;
+          for (int p = 0; p < 4; ++p) {
+            consume(render_format(programs[p], names, time, texts[p]));
+            fields |= programs[p].fields;
+          }
+
+          toggled.clear();
+          const uint32_t visible_count = clock_table_update_visibility(clocks, index, settings, toggled);
+          clock_table_fill_snapshot(clocks, surfaces, snapshot);
+          consume(snapshot.clocks[0].generation);
+
+          const TickGranularity granularity = (visible_count > 0) ? tick_granularity_for(fields) : TickGranularity::Day;
+          consume(tick_scheduler_plan(scheduler, now_ms, time, granularity));
+        });
+      }
+    }
+  }
+  struct TickSimulation {
+    uint64_t wakeups = 0;
+    uint64_t missed = 0; // @NOTE: edges whose text was never painted
+    std::vector<uint64_t> latency_ms; // @NOTE: from each edge to the paint that showed it
+    TickSchedulerStats stats;
+  };
+
+  // @NOTE: The app on a simulated clock: a timer fires up to one 15.6 ms
+  // timer tick late and one wakeup in 200 waits up to 250 ms for a busy
+  // message loop. Each wakeup paints the text of the edge it woke up after.
+  // `period_ms` 0 plans every wakeup with the scheduler, otherwise it is a
+  // periodic timer.
+  TickSimulation simulate_ticks(TickGranularity granularity, uint32_t period_ms, uint64_t duration_ms, std::mt19937& rng) {
+    const uint64_t start_wall_ms = 9 * 3600'000 + 58 * 60'000 + rng() % 1000; // @NOTE: 09:58 on the first of the month, the timer at a random phase
+    const uint64_t edge_ms = (granularity == TickGranularity::Second) ? 1000 : (granularity == TickGranularity::Minute) ? 60'000 : 86'400'000;
+    auto civil_at = [](uint64_t wall_ms) {
+      const uint64_t day_ms = wall_ms % 86'400'000;
+      return CivilTime{
+        .year = 2024,
+        .month = 3,
+        .day_of_week = static_cast<uint16_t>((5 + wall_ms / 86'400'000) % 7),
+        .day = static_cast<uint16_t>(1 + wall_ms / 86'400'000),
+        .hour = static_cast<uint16_t>(day_ms / 3600'000),
+        .minute = static_cast<uint16_t>((day_ms / 60'000) % 60),
+        .second = static_cast<uint16_t>((day_ms / 1000) % 60),
+        .milliseconds = static_cast<uint16_t>(day_ms % 1000),
+      };
+    };
+
+    TickSimulation result;
+    TickScheduler scheduler;
+    uint64_t now_ms = 0;
+    uint64_t deadline_ms = 0;
+    uint64_t painted_edge = start_wall_ms / edge_ms * edge_ms;
+    while (now_ms < duration_ms) {
+      deadline_ms = (period_ms != 0) ? deadline_ms + period_ms : now_ms + tick_scheduler_plan(scheduler, now_ms, civil_at(start_wall_ms + now_ms), granularity);
+      now_ms = std::max(now_ms, deadline_ms + rng() % 16 + ((rng() % 200 == 0) ? rng() % 250 : 0));
+      if (period_ms == 0) tick_scheduler_wakeup(scheduler, now_ms);
+      result.wakeups++;
+
+      const uint64_t wall_ms = start_wall_ms + now_ms;
+      const uint64_t edge = wall_ms / edge_ms * edge_ms;
+      if (edge == painted_edge) continue;
+      result.missed += (edge - painted_edge) / edge_ms - 1;
+      result.latency_ms.push_back(wall_ms - edge);
+      painted_edge = edge;
+    }
+    result.stats = scheduler.stats;
+    return result;
+  }
+
+  void report_tick_simulation(const char* name, TickSimulation& simulation, uint64_t duration_ms) {
+    if (!selected(name)) return;
+    report(name, "wakeups_per_hour", static_cast<double>(simulation.wakeups) * 3600'000.0 / static_cast<double>(duration_ms));
+    report(name, "edge_to_paint_p50_ms", percentile(simulation.latency_ms, 0.5));
+    report(name, "edge_to_paint_p99_ms", percentile(simulation.latency_ms, 0.99));
+    report(name, "edge_to_paint_max_ms", percentile(simulation.latency_ms, 1.0));
+    report(name, "missed_edges", static_cast<double>(simulation.missed));
+    if (simulation.stats.wakeups > 0) report(name, "lateness_p99_ms", static_cast<double>(tick_lateness_percentile(simulation.stats, 0.99)));
+  }
+
+  // @NOTE: Wakeups per hour and edge-to-paint latency of the scheduler for
+  // each granularity against the fixed 1000 ms timer it replaced.
+  void bench_tick_scheduler() {
+    if (!selected_group("tick_scheduler")) return;
+
+    std::mt19937 rng(5);
+    struct Case {
+      const char* name;
+      TickGranularity granularity;
+      uint32_t period_ms;
+      uint64_t duration_ms;
+    };
+    const Case cases[] = {
+      {"tick_scheduler_second", TickGranularity::Second, 0, 3600'000},
+      {"tick_scheduler_minute", TickGranularity::Minute, 0, 3600'000},
+      {"tick_scheduler_day", TickGranularity::Day, 0, 2 * 86'400'000},
+      {"tick_scheduler_fixed_second", TickGranularity::Second, 1000, 3600'000},
+      {"tick_scheduler_fixed_minute", TickGranularity::Minute, 1000, 3600'000},
+    };
+    for (const Case& c : cases) {
+      TickSimulation simulation = simulate_ticks(c.granularity, c.period_ms, c.duration_ms, rng);
+      if (c.period_ms == 0) {
+        // @NOTE: The slack keeps every paint after its edge, a paint before
+        // it would show up as a whole edge of latency or a missed edge.
+        check(simulation.missed == 0, "tick scheduler missed an edge");
+        check(percentile(simulation.latency_ms, 0.0) >= kTickSlackMs, "tick scheduler painted too early");
+        check(percentile(simulation.latency_ms, 1.0) < kTickSlackMs + 16 + 250, "tick scheduler painted too late");
+      }
+      report_tick_simulation(c.name, simulation, c.duration_ms);
+    }
+  }
+
+  // @NOTE: A settings file with `count` profiles on random monitors, every
+  // kind of override.
+  SettingsFile make_settings_file(uint32_t count, std::mt19937& rng) {
+    SettingsFile file;
+    file.settings = {.corner = Corner::TopLeft, .long_time = true, .analog = true};
+    file.generation = 7;
+    for (uint32_t i = 0; i < count; ++i) {
+      const uint64_t identity = (static_cast<uint64_t>(rng()) << 32) | rng();
+      const uint8_t flags = static_cast<uint8_t>(1 + rng() % 3);
+      set_monitor_profile(file.profiles, MonitorProfile{.identity = identity, .flags = flags, .corner = static_cast<Corner>(rng() % 4)});
+    }
+    return file;
+  }
+
+  bool same_settings_file(const SettingsFile& lhs, const SettingsFile& rhs) {
+    return (lhs.settings == rhs.settings) && (lhs.profiles == rhs.profiles) && (lhs.generation == rhs.generation);
+  }
+
+  void write_bytes(const std::filesystem::path& path, const uint8_t* data, size_t size) {
+    FILE* f = fopen(path.string().c_str(), "wb");
+    check(f != nullptr, "cannot write a settings file");
+    fwrite(data, 1, size, f);
+    fclose(f);
+  }
+
+  // Round trips, migrating every size of version 1 file, reading a file from
+  // a newer version with longer records, rejecting torn and corrupted files,
+  // and loading after a crash at each step of a save. Then times loading
+  // files with hundreds of monitor profiles and coalescing a burst of
+  // changes.
+  void bench_settings() {
+    if (!selected_group("settings")) return;
+
+    std::mt19937 rng(21);
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "bench_settings";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::filesystem::path path = directory / "settings.dat";
+    const std::filesystem::path temporary = directory / "settings.dat.tmp";
+
+    const SettingsFile original = make_settings_file(300, rng);
+    const std::vector<uint8_t> encoded = encode_settings(original);
+    SettingsFile decoded;
+    check(decode_settings(encoded.data(), encoded.size(), decoded) && same_settings_file(decoded, original), "settings do not round trip");
+    for (size_t i = 1; i < original.profiles.size(); ++i) {
+      const MonitorProfile& profile = original.profiles[i];
+      check(find_monitor_profile(original.profiles, profile.identity) == &profile, "find_monitor_profile misses a profile");
+    }
+    check(find_monitor_profile(original.profiles, original.profiles.front().identity - 1) == nullptr, "find_monitor_profile finds a missing profile");
+
+    // @NOTE: Version 1 was the bare struct, written by builds with 5 to 8
+    // fields.
+    const Settings old = {.corner = Corner::TopRight, .long_date = true, .on_primary_display = true, .on_fullscreen = true, .analog = true, .smooth_seconds = true, .adaptive_contrast = false};
+    for (size_t size = kSettingsV1MinSize; size <= kSettingsV1MaxSize; ++size) {
+      write_bytes(path, reinterpret_cast<const uint8_t*>(&old), size);
+      SettingsFile migrated = settings_load(path);
+      Settings expected = { };
+      memcpy(&expected, &old, size);
+      check((migrated.generation == 1) && (migrated.settings == expected) && migrated.profiles.empty(), "a version 1 file does not migrate");
+
+      check(settings_save(path, migrated) && !std::filesystem::exists(temporary), "settings_save failed");
+      const SettingsFile reloaded = settings_load(path);
+      check(same_settings_file(reloaded, migrated) && (reloaded.generation == 2), "a migrated file does not reload");
+      check(std::filesystem::file_size(path) == sizeof(SettingsFileHeader) + sizeof(Settings), "a migrated file is not version 2");
+    }
+    std::filesystem::remove(path);
+    check(settings_load(path).generation == 0, "no file does not load the defaults");
+
+    // @NOTE: A newer version appended a field to each record and the header.
+    {
+      constexpr uint16_t kGrowth = 8;
+      SettingsFileHeader header;
+      header.version = kSettingsFileVersion + 1;
+      header.header_size = sizeof(header) + kGrowth;
+      header.settings_size = sizeof(Settings) + kGrowth;
+      header.profile_size = sizeof(MonitorProfile) + kGrowth;
+      header.profile_count = static_cast<uint32_t>(original.profiles.size());
+      header.generation = original.generation;
+
+      std::vector<uint8_t> newer(header.header_size, 0xAB);
+      auto append = [&](const void* record, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(record);
+        newer.insert(newer.end(), bytes, bytes + size);
+        newer.insert(newer.end(), kGrowth, 0xCD);
+      };
+      append(&original.settings, sizeof(Settings));
+      for (const MonitorProfile& profile : original.profiles) append(&profile, sizeof(profile));
+      header.checksum = settings_checksum(header, newer.data() + header.header_size, newer.size() - header.header_size);
+      memcpy(newer.data(), &header, sizeof(header));
+
+      SettingsFile read;
+      check(decode_settings(newer.data(), newer.size(), read) && same_settings_file(read, original), "a newer file does not read");
+    }
+
+    // @NOTE: Bytes that are no bool or Corner under a valid checksum, in a
+    // version 2 file and a version 1 one, fall back to the defaults. A
+    // profile's invalid corner drops its corner flag.
+    {
+      SettingsFile invalid;
+      invalid.generation = 3;
+      invalid.settings = {.corner = Corner::TopLeft, .long_time = true, .analog = true};
+      invalid.profiles = {
+        MonitorProfile{.identity = 10, .flags = kMonitorProfileCorner | kMonitorProfileHidden, .corner = Corner::TopRight},
+        MonitorProfile{.identity = 20, .flags = kMonitorProfileCorner, .corner = Corner::BottomLeft},
+      };
+      std::vector<uint8_t> bytes = encode_settings(invalid);
+      SettingsFileHeader header;
+      memcpy(&header, bytes.data(), sizeof(header));
+      uint8_t* records = bytes.data() + sizeof(header);
+      records[0] = 7; // @NOTE: corner
+      records[1] = 2; // @NOTE: long_date
+      records[2] = 0xff; // @NOTE: long_time
+      records[sizeof(Settings) + offsetof(MonitorProfile, corner)] = 4;
+      header.checksum = settings_checksum(header, records, bytes.size() - sizeof(header));
+      memcpy(bytes.data(), &header, sizeof(header));
+
+      SettingsFile read;
+      const Settings defaults = { };
+      check(decode_settings(bytes.data(), bytes.size(), read), "a file with invalid values does not decode");
+      check((read.settings.corner == defaults.corner) && (read.settings.long_date == defaults.long_date) && (read.settings.long_time == defaults.long_time) && read.settings.analog, "invalid settings values do not fall back to the defaults");
+      check((read.profiles[0].flags == kMonitorProfileHidden) && (read.profiles[0].corner == MonitorProfile{ }.corner) && (read.profiles[1] == invalid.profiles[1]), "an invalid profile corner is used");
+
+      const uint8_t v1[] = {static_cast<uint8_t>(Corner::BottomLeft), 1, 9, 0, 0x80, 1};
+      check(decode_settings(v1, sizeof(v1), read) && read.settings.long_date && (read.settings.long_time == defaults.long_time) && (read.settings.on_fullscreen == defaults.on_fullscreen) && read.settings.analog, "invalid version 1 values do not fall back to the defaults");
+    }
+
+    // @NOTE: Every torn write and every flipped byte, which includes the
+    // generation in the header.
+    for (size_t size = 0; size < encoded.size(); ++size) {
+      SettingsFile read;
+      check(!decode_settings(encoded.data(), size, read), "a torn file decodes");
+    }
+    for (size_t i = 0; i < encoded.size(); ++i) {
+      std::vector<uint8_t> corrupted = encoded;
+      corrupted[i] ^= static_cast<uint8_t>(1 + rng() % 255);
+      SettingsFile read;
+      check(!decode_settings(corrupted.data(), corrupted.size(), read), "a corrupted file decodes");
+    }
+
+    // @NOTE: A crash at each step of a save from generation 7 to 8.
+    SettingsFile next = original;
+    next.settings.corner = Corner::BottomLeft;
+    next.generation++;
+    const std::vector<uint8_t> next_encoded = encode_settings(next);
+
+    write_bytes(path, encoded.data(), encoded.size());
+    write_bytes(temporary, next_encoded.data(), next_encoded.size() / 2);
+    check(same_settings_file(settings_load(path), original), "a torn write replaces the saved file");
+    write_bytes(temporary, next_encoded.data(), next_encoded.size());
+    check(same_settings_file(settings_load(path), next), "a flushed write before the rename is lost");
+    std::filesystem::rename(temporary, path);
+    check(same_settings_file(settings_load(path), next), "a renamed write is lost");
+
+    write_bytes(path, encoded.data(), encoded.size() - 1);
+    write_bytes(temporary, next_encoded.data(), next_encoded.size());
+    check(same_settings_file(settings_load(path), next), "a torn saved file hides the written one");
+    write_bytes(temporary, encoded.data(), encoded.size());
+    write_bytes(path, next_encoded.data(), next_encoded.size());
+    check(same_settings_file(settings_load(path), next), "a stale write replaces a newer saved file");
+    std::filesystem::remove(temporary);
+
+    for (uint32_t count : {0u, 100u, 500u}) {
+      SettingsFile file = make_settings_file(count, rng);
+      file.generation = 0;
+      check(settings_save(path, file), "settings_save failed");
+      run("settings_load", count, 0, [&](uint64_t) {
+        consume(settings_load(path).profiles.size());
+      });
+
+      const std::vector<uint8_t> data = encode_settings(file);
+      run("settings_decode", count, 0, [&](uint64_t) {
+        SettingsFile read;
+        consume(decode_settings(data.data(), data.size(), read));
+      });
+
+      const std::vector<Monitor> monitors = make_monitors(4);
+      run("settings_monitor_corner", count, 0, [&](uint64_t i) {
+        consume(static_cast<uint64_t>(monitor_corner(file.settings, file.profiles, monitors[i & 3])));
+      });
+    }
+
+    // @NOTE: A click every 300 ms for 10 s, then a single one. Checked by
+    // the writes they turn into.
+    SettingsWriteCoalescer coalescer;
+    uint32_t writes = 0;
+    uint64_t last_write_ms = 0;
+    for (uint64_t now = 0; now < 20'000; now += 10) {
+      if (((now < 10'000) && (now % 300 == 0)) || (now == 15'000)) settings_coalescer_change(coalescer, now);
+      if (settings_coalescer_take(coalescer, now)) {
+        writes++;
+        last_write_ms = now;
+      }
+    }
+    check((writes == 3) && (last_write_ms == 15'000 + kSettingsCoalesceMs), "the coalescer writes too often or too late");
+    report("settings_coalesce", "writes_per_34_changes", writes);
+
+    run("settings_save", 0, 0, [&](uint64_t) {
+      SettingsFile file = original;
+      consume(settings_save(path, file));
+    });
+
+    std::filesystem::remove_all(directory);
+  }
+
+  // An hour of a bad afternoon, one event log: a dock that keeps
+  // re-enumerating its monitors, DPI and theme flips, a locale change, a
+  // flood of foreground changes and window moves. The log is written the way
+  // the app writes it, read back and replayed. A shadow model fed while
+  // generating supplies the query answers a real session would have recorded
+  // and must end up with the same stats as the replay.
+  // @NOTE: Bursts of foreground changes, like alt-tabbing through windows or
+  // a launcher flashing past, replayed through the guard on 4 to 64 clocks.
+  // Topmost windows really cover the clocks they overlap until raised, one
+  // foreground change in eight comes without a window. After every batch no
+  // shown clock may be left covered. Counts the SetWindowPos calls against
+  // raising every clock on every foreground change.
+  void bench_topmost() {
+    if (!selected_group("topmost")) return;
+
+    std::mt19937 rng(9);
+    for (uint32_t monitor_count : kMonitorCounts) {
+      if (monitor_count < 4) continue;
+
+      const std::vector<Monitor> monitors = make_monitors(monitor_count);
+      std::vector<Rect> frames;
+      for (const Monitor& monitor : monitors) frames.push_back(make_rect(monitor.position, monitor.size));
+      TopmostGuard guard;
+      topmost_guard_watch(guard, frames);
+      std::vector<uint8_t> hidden(monitor_count, 0);
+      std::vector<uint8_t> covered(monitor_count, 0);
+
+      uint64_t calls = 0;
+      auto is_covered = [&](uint32_t i) { return covered[i] != 0; };
+      auto raise = [&](uint32_t i) {
+        covered[i] = 0;
+        calls++;
+      };
+      auto enforce_due = [&](uint64_t now_ms) {
+        if ((guard.deadline_ms == 0) || (guard.deadline_ms > now_ms)) return;
+        topmost_guard_enforce(guard, hidden, is_covered, raise);
+        for (uint32_t i = 0; i < monitor_count; ++i) check(!covered[i] || hidden[i], "topmost guard left a clock covered");
+      };
+
+      uint64_t now_ms = 0;
+      for (uint32_t burst = 0; burst < 2000; ++burst) {
+        now_ms += 1000 + rng() % 5000;
+        const uint32_t changes = 5 + rng() % 30;
+        for (uint32_t c = 0; c < changes; ++c) {
+          now_ms += rng() % 40;
+          enforce_due(now_ms);
+
+          const std::vector<WindowState> windows = make_windows(1, monitors, rng);
+          const Rect frame = windows[0].frame;
+          const bool topmost = (rng() % 4) == 0;
+          if (topmost) {
+            for (uint32_t i = 0; i < monitor_count; ++i) covered[i] |= static_cast<uint8_t>((frames[i].left < frame.right) && (frame.left < frames[i].right) && (frames[i].top < frame.bottom) && (frame.top < frames[i].bottom));
+          }
+          if (rng() % 8 == 0) topmost_guard_trigger_all(guard, now_ms);
+          else topmost_guard_trigger(guard, now_ms, frame, topmost);
+        }
+        enforce_due(now_ms + guard.coalesce_ms);
+      }
+
+      char name[64];
+      snprintf(name, sizeof(name), "topmost_burst_%u_clocks", monitor_count);
+      report(name, "setwindowpos_calls", static_cast<double>(calls));
+      report(name, "naive_setwindowpos_calls", static_cast<double>(guard.stats.naive_raises));
+      report(name, "checks", static_cast<double>(guard.stats.checks));
+      report(name, "batches", static_cast<double>(guard.stats.enforcements));
+    }
+  }
+
+  void bench_replay() {
+    if (!selected("replay")) return;
+
+    std::mt19937 rng(13);
+    const std::vector<Monitor> docked = make_monitors(4);
+    const std::vector<Monitor> undocked = make_monitors(1);
+    std::vector<Monitor> rescaled = docked;
+    for (Monitor& monitor : rescaled) monitor.dpi = {1.25f, 1.25f};
+
+    std::vector<WindowEntry> windows;
+    for (const WindowState& state : make_windows(500, docked, rng)) windows.push_back(WindowEntry{.id = windows.size() + 1, .state = state});
+
+    const FormatPictures pictures = {.short_date = L"d.M.yyyy", .long_date = L"dddd, MMMM d, yyyy", .short_time = L"H:mm", .long_time = L"H:mm:ss"};
+    const LocaleNames names = make_locale_names();
+
+    FILE* file = tmpfile();
+    check(file != nullptr, "tmpfile failed");
+    EventLogWriter writer;
+    check(event_log_begin(writer, file), "event_log_begin failed");
+
+    auto shadow = std::make_unique<ReplayModel>();
+    uint64_t now_ms = 1'000'000;
+    uint64_t write_ns = 0;
+    const CivilTime start_time = time_at(14 * 3600);
+
+    auto emit = [&](Event& event) {
+      event.time_ms = now_ms;
+      const uint64_t start = now_ns();
+      check(event_log_write(writer, event), "event_log_write failed");
+      write_ns += now_ns() - start;
+      check(replay_event(*shadow, event), "shadow rejected an event");
+    };
+
+    // @NOTE: The expedited tick that follows, with whatever the handlers
+    // would have queried.
+    auto tick = [&](const std::vector<Monitor>& monitors, bool light_theme) {
+      now_ms += 1;
+      const TickActions actions = plan_tick(shadow->transient_flags);
+      Event event = {.kind = EventKind::Tick, .flags = shadow->transient_flags, .civil = civil_time_add_ms(start_time, now_ms - 1'000'000)};
+      if (actions.reload_theme) {
+        event.sections |= kEventSectionTheme;
+        event.light_theme = light_theme;
+      }
+      if (actions.reload_locale) {
+        event.sections |= kEventSectionLocale;
+        event.pictures = pictures;
+        event.names = names;
+      }
+      if (actions.reconcile_clocks) {
+        event.sections |= kEventSectionMonitors;
+        event.monitors = monitors;
+      }
+      if (actions.rebuild_window_index) {
+        event.sections |= kEventSectionWindows;
+        event.windows = windows;
+      }
+      emit(event);
+    };
+
+    Event start = {.kind = EventKind::Start, .sections = kEventSectionTheme | kEventSectionLocale | kEventSectionMonitors | kEventSectionWindows, .civil = start_time, .settings = { }, .pictures = pictures, .names = names, .monitors = docked, .windows = windows};
+    emit(start);
+
+    bool light_theme = false;
+    const std::vector<Monitor>* monitors = &docked;
+    constexpr uint64_t kDurationMs = 3600 * 1000;
+    for (uint64_t elapsed = 0; elapsed < kDurationMs; elapsed += 50) {
+      now_ms = 1'000'000 + elapsed;
+      const uint64_t step = elapsed / 50;
+
+      // @NOTE: Window moves at 20 Hz, a foreground change every 250 ms and
+      // the topmost check that follows it.
+      WindowEntry& window = windows[rng() % windows.size()];
+      const int dx = static_cast<int>(rng() % 21) - 10;
+      const int dy = static_cast<int>(rng() % 21) - 10;
+      window.state.frame = {window.state.frame.left + dx, window.state.frame.top + dy, window.state.frame.right + dx, window.state.frame.bottom + dy};
+      Event update = {.kind = EventKind::WindowUpdate, .windows = {window}};
+      emit(update);
+
+      if (step % 5 == 0) {
+        const WindowEntry& foreground = windows[rng() % windows.size()];
+        Event event = {.kind = EventKind::Foreground, .frame = foreground.state.frame, .has_frame = (rng() % 8) != 0, .topmost = (rng() % 4) == 0};
+        emit(event);
+      }
+      if (step % 5 == 2) {
+        Event event = {.kind = EventKind::TopmostCheck};
+        for (uint32_t i = 0; i < clock_table_size(shadow->clocks); ++i) {
+          if (topmost_guard_is_dirty(shadow->topmost, i) && !shadow->clocks.hidden[i]) event.lost.push_back((rng() % 3) == 0);
+        }
+        emit(event);
+      }
+
+      // @NOTE: The backdrop timer every 2 s, a clock's backdrop changes
+      // now and then, e.g. a window moved behind it.
+      if (step % (kBackdropSampleMs / 50) == 1) {
+        Event event = {.kind = EventKind::Backdrop};
+        for (uint32_t i = 0; i < clock_table_size(shadow->clocks); ++i) {
+          if (shadow->clocks.hidden[i] || ((rng() % 4) != 0)) continue;
+          const BackdropSample sample = {.hash = rng() | 1ull, .mean = static_cast<uint8_t>(rng() % 256), .deviation = static_cast<uint8_t>(rng() % 80)};
+          event.backdrops.push_back(BackdropEntry{.clock = i, .sample = sample});
+        }
+        if (!event.backdrops.empty()) emit(event);
+      }
+
+      // @NOTE: An alarm for the first monitor every 15 minutes, its alert ends
+      // 30 s later.
+      if ((step % 18000 == 9000) || (step % 18000 == 9000 + kAlarmAlertMs / 50)) {
+        Event event = {.kind = EventKind::Alarm};
+        for (uint32_t i = 0; i < clock_table_size(shadow->clocks); ++i) event.alerts.push_back((step % 18000 == 9000) && (i == 0));
+        emit(event);
+      }
+
+      // @NOTE: An API client shows an overlay on every monitor every 10
+      // minutes for 10 s.
+      if ((step % 12000 == 3000) || (step % 12000 == 3200)) {
+        Event event = {.kind = EventKind::Overlay};
+        const uint16_t overlay = (step % 12000 == 3000) ? static_cast<uint16_t>(1 + step / 12000) : 0;
+        for (uint32_t i = 0; i < clock_table_size(shadow->clocks); ++i) event.overlays.push_back(overlay);
+        emit(event);
+      }
+
+      // @NOTE: The dock drops and returns every 20 s with a burst of
+      // WM_DEVICECHANGE, a DPI flip every minute, a theme flip every five
+      // and a locale change once.
+      if (step % 400 == 0) {
+        monitors = (monitors == &undocked) ? &docked : &undocked;
+        for (int i = 0; i < 6; ++i) {
+          Event event = {.kind = (i == 0) ? EventKind::DisplayChange : EventKind::DeviceChange};
+          emit(event);
+        }
+        tick(*monitors, light_theme);
+      }
+      if (step % 1200 == 600) {
+        monitors = (monitors == &rescaled) ? &docked : &rescaled;
+        Event event = {.kind = EventKind::DpiChange};
+        emit(event);
+        tick(*monitors, light_theme);
+      }
+      if (step % 6000 == 3000) {
+        light_theme = !light_theme;
+        Event event = {.kind = EventKind::WinIniChange, .flags = kEventWinIniColorSet};
+        emit(event);
+        tick(*monitors, light_theme);
+      }
+      if (step == 36000) {
+        Event event = {.kind = EventKind::WinIniChange, .flags = kEventWinIniIntl};
+        emit(event);
+        tick(*monitors, light_theme);
+      }
+
+      // @NOTE: The system metrics line on for the last quarter hour.
+      if (step == 54000) {
+        Event event = {.kind = EventKind::SettingsChange, .settings = shadow->settings, .profiles = shadow->profiles};
+        event.settings.system_metrics = true;
+        emit(event);
+        tick(*monitors, light_theme);
+      }
+
+      // @NOTE: Every 10 minutes three quick clicks in the third monitor's
+      // menu: to the top left corner, no clock and back to the defaults.
+      if ((step % 12000 >= 6000) && (step % 12000 < 6003)) {
+        MonitorProfiles profiles = shadow->profiles;
+        const uint8_t flags[] = {kMonitorProfileCorner, kMonitorProfileCorner | kMonitorProfileHidden, 0};
+        set_monitor_profile(profiles, MonitorProfile{.identity = docked[2].identity, .flags = flags[step % 12000 - 6000], .corner = Corner::TopLeft});
+        Event event = {.kind = EventKind::SettingsChange, .settings = shadow->settings, .profiles = profiles};
+        emit(event);
+        tick(*monitors, light_theme);
+      }
+    }
+    replay_advance(*shadow, now_ms);
+
+    rewind(file);
+    EventLogReader reader;
+    check(event_log_open(reader, file), "event_log_open failed");
+
+    const uint64_t replay_start = now_ns();
+    auto model = std::make_unique<ReplayModel>();
+    Event event;
+    uint64_t last_ms = 0;
+    while (event_log_read(reader, event)) {
+      check(replay_event(*model, event), "replay rejected an event");
+      last_ms = event.time_ms;
+    }
+    replay_advance(*model, last_ms);
+    const uint64_t replay_ns = now_ns() - replay_start;
+    fclose(file);
+
+    const ReplayStats& s = model->stats;
+    check(!reader.failed, "event log did not read back");
+    check(s.events == writer.events, "event count mismatch");
+    check(s.divergences == 0, "replay diverged");
+    check(memcmp(&s, &shadow->stats, sizeof(s)) == 0, "replay is not deterministic");
+
+    const double events = static_cast<double>(s.events);
+    report("replay", "events", events);
+    report("replay", "bytes_per_event", static_cast<double>(writer.bytes) / events);
+    report("replay", "write_ns_per_event", static_cast<double>(write_ns) / events);
+    report("replay", "replay_ns_per_event", static_cast<double>(replay_ns) / events);
+    report("replay", "speedup", static_cast<double>(s.simulated_ms) * 1e6 / static_cast<double>(replay_ns));
+    report("replay", "expedites", static_cast<double>(s.expedites));
+    report("replay", "ticks", static_cast<double>(s.ticks));
+    report("replay", "reconciles", static_cast<double>(s.reconciles));
+    report("replay", "clocks_created", static_cast<double>(s.clocks_created));
+    report("replay", "clocks_updated", static_cast<double>(s.clocks_updated));
+    report("replay", "zorder_calls", static_cast<double>(s.zorder_calls));
+    report("replay", "snapshots", static_cast<double>(s.snapshots));
+    report("replay", "frames", static_cast<double>(s.frames));
+    report("replay", "rasterizations", static_cast<double>(s.rasterizations));
+    report("replay", "presents", static_cast<double>(s.presents));
+    report("replay", "backdrop_samples", static_cast<double>(s.backdrop_samples));
+    report("replay", "contrast_changes", static_cast<double>(s.contrast_changes));
+    report("replay", "settings_saves", static_cast<double>(s.settings_saves));
+  }
+  // @NOTE: Compiled tzdata, the system's unless ZONEINFO points elsewhere.
+  const char* zoneinfo_directory() {
+    const char* directory = getenv("ZONEINFO");
+    return directory ? directory : "/usr/share/zoneinfo";
+  }
+
+  std::vector<std::string> list_zones(const std::string& directory) {
+    std::vector<std::string> names;
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(directory, error); !error && (it != std::filesystem::recursive_directory_iterator()); it.increment(error)) {
+      if (!it->is_regular_file(error)) continue;
+      const std::string name = it->path().lexically_relative(directory).generic_string();
+      if ((name.find('.') == std::string::npos) && (name.compare(0, 6, "posix/") != 0) && (name.compare(0, 6, "right/") != 0)) names.push_back(name);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+  }
+
+  #ifndef _WIN32
+  // Compares the engine with the C library, which reads the same files,
+  // around every transition and at random instants between 1900 and 2100.
+  void validate_time_zones(const std::string& directory, const std::vector<std::string>& names) {
+    std::mt19937_64 rng(14);
+    uint64_t zones = 0;
+    uint64_t samples = 0;
+    uint64_t mismatches = 0;
+    for (const std::string& name : names) {
+      TimeZone zone;
+      if (!time_zone_load(directory, name, zone)) continue;
+
+      setenv("TZ", (":" + directory + "/" + name).c_str(), 1);
+      tzset();
+
+      std::vector<int64_t> instants;
+      for (size_t i = 1; i < zone.starts.size(); ++i) {
+        for (int64_t delta : {-1, 0, 1}) instants.push_back(zone.starts[i] + delta);
+      }
+      for (int i = 0; i < 2000; ++i) instants.push_back(-2208988800ll + static_cast<int64_t>(rng() % 6311433600ull));
+
+      ZoneCursor cursor;
+      for (int64_t instant : instants) {
+        const time_t t = static_cast<time_t>(instant);
+        tm expected = { };
+        if (!localtime_r(&t, &expected)) continue;
+
+        const CivilTime civil = time_zone_civil(zone, cursor, instant * 1000);
+        const bool same = (time_zone_offset_search(zone, instant) == expected.tm_gmtoff) && (civil.year == expected.tm_year + 1900) && (civil.month == expected.tm_mon + 1) && (civil.day == expected.tm_mday) &&
+          (civil.hour == expected.tm_hour) && (civil.minute == expected.tm_min) && (civil.second == expected.tm_sec) && (civil.day_of_week == expected.tm_wday);
+        if (!same && (mismatches++ < 10)) fprintf(stderr, "time_zone: %s at %lld: %d vs %ld\n", name.c_str(), static_cast<long long>(instant), time_zone_offset_search(zone, instant), static_cast<long>(expected.tm_gmtoff));
+        samples++;
+      }
+      zones++;
+    }
+    unsetenv("TZ");
+    tzset();
+
+    report("time_zone_validate", "zones", static_cast<double>(zones));
+    report("time_zone_validate", "samples", static_cast<double>(samples));
+    report("time_zone_validate", "mismatches", static_cast<double>(mismatches));
+    check(mismatches == 0, "time zone conversions differ from the C library");
+  }
+  #endif
+
+  // Loads every zone of the system tzdata, then converts the same instant
+  // for thousands of (clock, zone) pairs per tick the way the render thread
+  // does, with and without the cached interval.
+  void bench_time_zone() {
+    if (!selected_group("time_zone")) return;
+
+    const std::string directory = zoneinfo_directory();
+    const std::vector<std::string> names = list_zones(directory);
+    if (names.empty()) {
+      fprintf(stderr, "time_zone: no zones in %s, set ZONEINFO\n", directory.c_str());
+      return;
+    }
+
+    if (selected("time_zone_load")) {
+      const uint64_t start = now_ns();
+      TimeZoneDatabase database = {.directory = directory};
+      size_t loaded = 0;
+      size_t entries = 0;
+      for (const std::string& name : names) {
+        if (std::shared_ptr<const TimeZone> zone = time_zone_database_get(database, name)) {
+          loaded++;
+          entries += zone->starts.size();
+        }
+      }
+      const double ms = static_cast<double>(now_ns() - start) / 1e6;
+      report("time_zone_load", "zones", static_cast<double>(loaded));
+      report("time_zone_load", "ms", ms);
+      report("time_zone_load", "bytes_per_zone", static_cast<double>(entries * (sizeof(int64_t) + 1)) / static_cast<double>(loaded));
+    }
+
+    #ifndef _WIN32
+    if (selected("time_zone_validate")) validate_time_zones(directory, names);
+    #endif
+
+    constexpr uint32_t kConversionsPerTick = 4096;
+    const char* picks[] = {"America/New_York", "Europe/London", "Asia/Tokyo", "Australia/Lord_Howe", "Asia/Kolkata", "America/Sao_Paulo", "Pacific/Chatham", "Europe/Berlin"};
+    std::vector<TimeZone> zones;
+    for (const char* name : picks) {
+      TimeZone zone;
+      if (time_zone_load(directory, name, zone)) zones.push_back(std::move(zone));
+    }
+    if (zones.empty()) return;
+
+    const int64_t base_ms = 1'772'000'000'000; // @NOTE: early March 2026, DST starts in the north during the run
+    std::vector<ZoneCursor> cursors(kConversionsPerTick);
+    ZoneStats stats;
+    char name[64];
+    snprintf(name, sizeof(name), "time_zone_tick_%u", kConversionsPerTick);
+    const double cached_ns = run(name, 0, 0, [&](uint64_t i) {
+      const int64_t utc_ms = base_ms + static_cast<int64_t>(i) * 1000;
+      uint64_t sum = 0;
+      for (uint32_t j = 0; j < kConversionsPerTick; ++j) sum += time_zone_civil(zones[j % zones.size()], cursors[j], utc_ms, &stats).minute;
+      consume(sum);
+    });
+    if (cached_ns > 0.0) {
+      report(name, "ns_per_conversion", cached_ns / kConversionsPerTick);
+      report(name, "miss_rate", static_cast<double>(stats.misses) / static_cast<double>(stats.conversions));
+    }
+
+    snprintf(name, sizeof(name), "time_zone_tick_%u_search", kConversionsPerTick);
+    const double search_ns = run(name, 0, 0, [&](uint64_t i) {
+      const int64_t utc_ms = base_ms + static_cast<int64_t>(i) * 1000;
+      uint64_t sum = 0;
+      for (uint32_t j = 0; j < kConversionsPerTick; ++j) {
+        const TimeZone& zone = zones[j % zones.size()];
+        sum += civil_from_unix_ms(utc_ms + static_cast<int64_t>(time_zone_offset_search(zone, utc_ms / 1000)) * 1000).minute;
+      }
+      consume(sum);
+    });
+    if (search_ns > 0.0) report(name, "ns_per_conversion", search_ns / kConversionsPerTick);
+
+    // @NOTE: A clock line with three zones, formatted every second.
+    const LocaleNames locale_names = make_locale_names();
+    const FormatProgram program = compile_format(L"H:mm");
+    std::vector<ZoneClock> clocks;
+    for (size_t i = 0; i < 3; ++i) clocks.push_back(ZoneClock{.zone = std::make_shared<TimeZone>(zones[i]), .label = L"ABC"});
+    ZoneLine line;
+    FormattedText text;
+    run("time_zone_line", 0, 0, [&](uint64_t i) {
+      consume(render_zone_line(clocks, program, locale_names, base_ms + static_cast<int64_t>(i) * 1000, line, text));
+    });
+  }
+
+  struct PacedRun {
+    uint64_t frames = 0;
+    uint64_t dropped = 0; // @NOTE: vsyncs that showed a stale frame
+    uint64_t missed = 0;
+    uint64_t wasted = 0; // @NOTE: frames replaced before any vsync showed them
+    std::vector<uint64_t> latency_us; // @NOTE: frame start to the vsync that shows it, shown frames only
+  };
+
+  // Synthetic frame cost for `monitors` clocks with a stall of 2-4
+  // intervals every 64 frames.
+  uint64_t simulated_frame_us(uint32_t monitors, uint64_t interval_us, uint64_t frame, std::mt19937& rng) {
+    if (frame % 64 == 63) return interval_us * (2 + rng() % 3);
+    return 400 + 60 * monitors + rng() % 300;
+  }
+
+  uint64_t next_vsync(uint64_t t, uint64_t interval_us) { return (t / interval_us + 1) * interval_us; }
+
+  PacedRun simulate_pacer(uint64_t interval_us, uint32_t monitors, uint64_t duration_us) {
+    std::mt19937 rng(5);
+    FramePacer pacer;
+    frame_pacer_retarget(pacer, interval_us, 0, 0);
+
+    PacedRun result;
+    uint64_t now = 0;
+    uint64_t shown_vsync = 0;
+    while (now < duration_us) {
+      const FrameTiming timing = frame_pacer_begin(pacer, now);
+      if (!timing.render) {
+        now += timing.wait_us + rng() % 300; // @NOTE: wakeup jitter
+        continue;
+      }
+
+      const uint64_t start = now;
+      now += simulated_frame_us(monitors, interval_us, result.frames, rng);
+      frame_pacer_end(pacer, now);
+      const uint64_t vsync = next_vsync(now, interval_us);
+      if (vsync == shown_vsync) {
+        result.wasted++;
+        result.latency_us.pop_back();
+      }
+      if (shown_vsync != 0 && vsync > shown_vsync + interval_us) result.dropped += (vsync - shown_vsync) / interval_us - 1;
+      shown_vsync = vsync;
+      result.frames++;
+      result.latency_us.push_back(vsync - start);
+      now += frame_pacer_wait_us(pacer, now) + rng() % 300;
+    }
+    result.missed = pacer.stats.missed;
+    return result;
+  }
+
+  // A periodic timer that queues its expirations, as SetTimer-style loops
+  // do: after a stall the backlog is rendered back to back.
+  PacedRun simulate_periodic_timer(uint64_t interval_us, uint32_t monitors, uint64_t duration_us) {
+    std::mt19937 rng(5);
+    PacedRun result;
+    uint64_t now = 0;
+    uint64_t due = 0;
+    uint64_t shown_vsync = 0;
+    while (now < duration_us) {
+      due += interval_us;
+      if (now < due) now = due + rng() % 300;
+
+      const uint64_t start = now;
+      now += simulated_frame_us(monitors, interval_us, result.frames, rng);
+      if (now > due + interval_us) result.missed++;
+      const uint64_t vsync = next_vsync(now, interval_us);
+      if (vsync == shown_vsync) {
+        result.wasted++;
+        result.latency_us.pop_back();
+      }
+      if (shown_vsync != 0 && vsync > shown_vsync + interval_us) result.dropped += (vsync - shown_vsync) / interval_us - 1;
+      shown_vsync = vsync;
+      result.frames++;
+      result.latency_us.push_back(vsync - start);
+    }
+    return result;
+  }
+
+  void report_paced_run(const char* name, PacedRun& run) {
+    report(name, "frames", static_cast<double>(run.frames));
+    report(name, "dropped", static_cast<double>(run.dropped));
+    report(name, "missed", static_cast<double>(run.missed));
+    report(name, "wasted", static_cast<double>(run.wasted));
+    report(name, "latency_p50_us", percentile(run.latency_us, 0.5));
+    report(name, "latency_p99_us", percentile(run.latency_us, 0.99));
+  }
+
+  void bench_frame_pacer() {
+    if (!selected_group("frame_pacer")) return;
+
+    constexpr uint32_t kMonitors = 6;
+    constexpr uint64_t kDurationUs = 60'000'000;
+    constexpr uint64_t kIntervals[] = {16667, 6944};
+    if (selected("frame_pacer_sim")) {
+      for (uint64_t interval_us : kIntervals) {
+        char name[64];
+        snprintf(name, sizeof(name), "frame_pacer_sim_%lluhz", static_cast<unsigned long long>((1'000'000 + interval_us / 2) / interval_us));
+        PacedRun paced = simulate_pacer(interval_us, kMonitors, kDurationUs);
+        report_paced_run(name, paced);
+
+        snprintf(name, sizeof(name), "frame_pacer_timer_%lluhz", static_cast<unsigned long long>((1'000'000 + interval_us / 2) / interval_us));
+        PacedRun timer = simulate_periodic_timer(interval_us, kMonitors, kDurationUs);
+        report_paced_run(name, timer);
+      }
+    }
+
+    // @NOTE: What one frame costs for real, a 205x48 clock at 100 % with a
+    // 15 px padding, so an 11 px ring.
+    constexpr int kWidth = 205;
+    constexpr int kHeight = 48;
+    constexpr int kArc = 11;
+    std::vector<uint32_t> pixels(static_cast<size_t>(kWidth) * kHeight * kMonitors);
+    const double arc_ns = run("frame_pacer_arc", kMonitors, 0, [&](uint64_t i) {
+      CivilTime time = time_at(i / 144);
+      time.milliseconds = static_cast<uint16_t>((i % 144) * 1000 / 144);
+      const float turns = seconds_turns(time);
+      for (uint32_t m = 0; m < kMonitors; ++m) {
+        const PixelView view = {.pixels = pixels.data() + static_cast<size_t>(m) * kWidth * kHeight, .width = kArc, .height = kArc, .stride = kWidth};
+        rasterize_seconds_arc(view, turns, 1.0f, 1.0f, 1.0f);
+      }
+      consume(pixels[kArc / 2]);
+    });
+    if (arc_ns > 0.0) {
+      report("frame_pacer_arc", "cpu_percent_at_144hz", arc_ns * 144.0 / 1e7);
+      report("frame_pacer_arc", "present_bytes_per_frame", static_cast<double>(kArc * kArc * 4 * kMonitors));
+      report("frame_pacer_arc", "full_present_bytes_per_frame", static_cast<double>(kWidth * kHeight * 4 * kMonitors));
+    }
+
+    const double face_ns = run("frame_pacer_face", kMonitors, 0, [&](uint64_t i) {
+      CivilTime time = time_at(i / 144);
+      time.milliseconds = static_cast<uint16_t>((i % 144) * 1000 / 144);
+      const ClockFace face = make_clock_face(time, true, true);
+      for (uint32_t m = 0; m < kMonitors; ++m) {
+        const PixelView view = {.pixels = pixels.data() + static_cast<size_t>(m) * kWidth * kHeight, .width = kHeight, .height = kHeight, .stride = kWidth};
+        rasterize_clock_face(view, face, best_clock_face_kernel());
+      }
+      consume(pixels[kHeight / 2]);
+    });
+    if (face_ns > 0.0) {
+      report("frame_pacer_face", "cpu_percent_at_144hz", face_ns * 144.0 / 1e7);
+      report("frame_pacer_face", "present_bytes_per_frame", static_cast<double>(kHeight * kHeight * 4 * kMonitors));
+    }
+  }
+
+  std::vector<BackdropKernel> supported_backdrop_kernels() {
+    std::vector<BackdropKernel> kernels = {BackdropKernel::Scalar};
+    if (static_cast<int>(best_backdrop_kernel()) >= static_cast<int>(BackdropKernel::Sse2)) kernels.push_back(BackdropKernel::Sse2);
+    if (best_backdrop_kernel() == BackdropKernel::Avx2) kernels.push_back(BackdropKernel::Avx2);
+    return kernels;
+  }
+
+  void validate_backdrop_kernels() {
+    std::mt19937 rng(7);
+    uint64_t checked = 0;
+    for (int i = 0; i < 2000; ++i) {
+      const int width = 1 + static_cast<int>(rng() % 300);
+      const int height = 1 + static_cast<int>(rng() % 40);
+      const int stride = width + static_cast<int>(rng() % 9);
+      std::vector<uint32_t> pixels(static_cast<size_t>(stride) * static_cast<size_t>(height));
+      const bool flat = (i % 4) == 0; // @NOTE: solid colors are the common case and easy to get wrong in a hash
+      const uint32_t color = rng();
+      for (uint32_t& pixel : pixels) pixel = flat ? color : rng();
+      const PixelView view = {.pixels = pixels.data(), .width = width, .height = height, .stride = stride};
+
+      const uint64_t hash = backdrop_hash(view, BackdropKernel::Scalar);
+      const LumaStats luma = backdrop_luma(view, BackdropKernel::Scalar);
+      check(luma.count == static_cast<uint64_t>(width) * static_cast<uint64_t>(height), "backdrop luma count");
+      for (BackdropKernel kernel : supported_backdrop_kernels()) {
+        check(backdrop_hash(view, kernel) == hash, "backdrop hash differs from scalar");
+        const LumaStats other = backdrop_luma(view, kernel);
+        check((other.sum == luma.sum) && (other.sum_squares == luma.sum_squares) && (other.count == luma.count), "backdrop luma differs from scalar");
+        checked++;
+      }
+
+      // @NOTE: Alpha is ignored, any change to a color is not.
+      pixels[0] ^= 0xff000000;
+      check(backdrop_hash(view, BackdropKernel::Scalar) == hash, "backdrop hash depends on alpha");
+      pixels[pixels.size() - static_cast<size_t>(stride - width) - 1] ^= 1u << (rng() % 24);
+      check(backdrop_hash(view, BackdropKernel::Scalar) != hash, "backdrop hash missed a change");
+    }
+
+    // @NOTE: White and black, the luma range ends exactly.
+    std::vector<uint32_t> pixels(64, 0xffffffff);
+    const PixelView view = {.pixels = pixels.data(), .width = 64, .height = 1, .stride = 64};
+    check(make_backdrop_sample(0, backdrop_luma(view, best_backdrop_kernel())).mean == 255, "white is not 255");
+    report("backdrop_validate", "images", static_cast<double>(checked));
+  }
+
+  // @NOTE: A backdrop whose mean luma drifts around mid gray with noise,
+  // like a video behind the clock. Counts text color flips with and
+  // without the hysteresis.
+  void simulate_backdrop_decisions() {
+    std::mt19937 rng(11);
+    BackdropContrast contrast;
+    uint64_t flips = 0;
+    uint64_t naive_flips = 0;
+    uint64_t shadowed = 0;
+    bool naive = false;
+    constexpr int kSamples = 3600 * 1000 / kBackdropSampleMs * 8; // @NOTE: 8 hours
+    for (int i = 0; i < kSamples; ++i) {
+      const double drift = 128.0 + 60.0 * sin(static_cast<double>(i) / 90.0);
+      const int mean = std::clamp(static_cast<int>(drift) + static_cast<int>(rng() % 41) - 20, 0, 255);
+      const BackdropSample sample = {.hash = static_cast<uint64_t>(i) + 1, .mean = static_cast<uint8_t>(mean), .deviation = static_cast<uint8_t>(rng() % 64)};
+
+      const bool dark_text = contrast.dark_text;
+      backdrop_update(contrast, sample);
+      if ((i > 0) && (contrast.dark_text != dark_text)) flips++;
+      if (contrast.shadow) shadowed++;
+
+      const bool naive_dark = mean >= 128;
+      if ((i > 0) && (naive_dark != naive)) naive_flips++;
+      naive = naive_dark;
+    }
+    report("backdrop_decisions", "samples", static_cast<double>(kSamples));
+    report("backdrop_decisions", "flips", static_cast<double>(flips));
+    report("backdrop_decisions", "flips_without_hysteresis", static_cast<double>(naive_flips));
+    report("backdrop_decisions", "shadowed_percent", 100.0 * static_cast<double>(shadowed) / static_cast<double>(kSamples));
+  }
+
+  void bench_backdrop() {
+    if (!selected_group("backdrop")) return;
+    if (selected("backdrop_validate")) validate_backdrop_kernels();
+    if (selected("backdrop_decisions")) simulate_backdrop_decisions();
+
+    // @NOTE: A clock at 100 % and 200 %, and a 1080p screen.
+    constexpr Int2 kSizes[] = {{205, 48}, {410, 96}, {1920, 1080}};
+    std::mt19937 rng(13);
+    for (Int2 size : kSizes) {
+      std::vector<uint32_t> pixels(static_cast<size_t>(size.x) * static_cast<size_t>(size.y));
+      for (uint32_t& pixel : pixels) pixel = rng();
+      const PixelView view = {.pixels = pixels.data(), .width = size.x, .height = size.y, .stride = size.x};
+      const double bytes = static_cast<double>(pixels.size() * sizeof(uint32_t));
+
+      for (BackdropKernel kernel : supported_backdrop_kernels()) {
+        char name[64];
+        snprintf(name, sizeof(name), "backdrop_hash_%s_%dx%d", backdrop_kernel_name(kernel), size.x, size.y);
+        double ns = run(name, 0, 0, [&](uint64_t) { consume(backdrop_hash(view, kernel)); });
+        if (ns > 0.0) report(name, "gb_per_s", bytes / ns);
+
+        snprintf(name, sizeof(name), "backdrop_luma_%s_%dx%d", backdrop_kernel_name(kernel), size.x, size.y);
+        ns = run(name, 0, 0, [&](uint64_t) { consume(backdrop_luma(view, kernel).sum); });
+        if (ns > 0.0) report(name, "gb_per_s", bytes / ns);
+      }
+    }
+  }
+
+  // @NOTE: Same nodes and dependencies as wWinMain, the costs are rough
+  // measurements of the Windows calls on a cold start. kStartupMonitors
+  // surfaces of kSurfaceCostUs each are fanned out like create_startup_surfaces.
+  void build_startup_graph(StartupGraph& graph, uint32_t surface_threads) {
+    static constexpr uint32_t kStartupMonitors = 4;
+    static constexpr uint32_t kSurfaceCostUs = 8000;
+    auto cost = [](uint32_t us) { return [us] { std::this_thread::sleep_for(std::chrono::microseconds(us)); }; };
+
+    const uint32_t settings = startup_graph_add(graph, "settings", StartupThread::Any, { }, cost(300));
+    const uint32_t factories = startup_graph_add(graph, "factories", StartupThread::Any, { }, cost(25000));
+    const uint32_t formats = startup_graph_add(graph, "formats", StartupThread::Any, { }, cost(6000));
+    const uint32_t theme = startup_graph_add(graph, "theme", StartupThread::Any, { }, cost(200));
+    const uint32_t monitors = startup_graph_add(graph, "monitors", StartupThread::Any, { }, cost(1000));
+    const uint32_t window_query = startup_graph_add(graph, "window_query", StartupThread::Any, { }, cost(10000));
+    const uint32_t message_window = startup_graph_add(graph, "message_window", StartupThread::Main, { }, cost(4000));
+    const uint32_t frame_format = startup_graph_add(graph, "frame_format", StartupThread::Any, {settings, formats}, cost(100));
+    const uint32_t clock_windows = startup_graph_add(graph, "clock_windows", StartupThread::Main, {settings, theme, monitors}, cost(kStartupMonitors * 1500));
+    const uint32_t surfaces = startup_graph_add(graph, "surfaces", StartupThread::Any, {factories, formats, clock_windows}, [surface_threads] {
+      startup_parallel_for(kStartupMonitors, surface_threads, [](uint32_t) { std::this_thread::sleep_for(std::chrono::microseconds(kSurfaceCostUs)); });
+    });
+    const uint32_t first_frame = startup_graph_add(graph, "first_frame", StartupThread::Main, {message_window, frame_format, surfaces}, cost(500));
+    const uint32_t window_index = startup_graph_add(graph, "window_index", StartupThread::Main, {clock_windows, window_query}, cost(300));
+    startup_graph_add(graph, "hooks", StartupThread::Main, {first_frame, window_index}, cost(800));
+  }
+
+  void bench_startup() {
+    if (!selected_group("startup")) return;
+
+    constexpr uint32_t kWorkers[] = {0, 3};
+    for (uint32_t workers : kWorkers) {
+      char name[64];
+      snprintf(name, sizeof(name), "startup_workers_%u", workers);
+      if (!selected(name)) continue;
+
+      StartupGraph graph;
+      build_startup_graph(graph, workers + 1);
+      startup_graph_run(graph, workers);
+      for (const StartupNode& node : graph.nodes) {
+        check(node.end_ns >= node.start_ns, "startup node finished before it started");
+        for (uint32_t dependency : node.after) check(graph.nodes[dependency].end_ns <= node.start_ns, "startup node ran before its dependency");
+        if (node.thread == StartupThread::Main) check(node.worker == 0, "startup main thread node ran on a worker");
+      }
+
+      const StartupReport startup = startup_graph_report(graph);
+      report(name, "wall_ms", static_cast<double>(startup.wall_ns) / 1e6);
+      report(name, "serial_ms", static_cast<double>(startup.serial_ns) / 1e6);
+      report(name, "critical_path_ms", static_cast<double>(startup.critical_path_ns) / 1e6);
+      report(name, "first_frame_ms", static_cast<double>(startup_graph_end_ns(graph, "first_frame")) / 1e6);
+    }
+  }
+
+  // An .ics export with `count` events between 2020 and 2030: mostly one-off
+  // meetings, a tenth recurring with every supported rule, some all-day and
+  // multi-week events, UTC and floating times, EXDATEs, moved occurrences,
+  // escaped and folded summaries and alarms.
+  std::string make_calendar(uint32_t count, std::mt19937& rng) {
+    constexpr const char* kDays[7] = {"MO", "TU", "WE", "TH", "FR", "SA", "SU"};
+    const int64_t base_day = 18262; // @NOTE: 2020-01-01
+    auto stamp = [](int64_t wall, bool date_only, bool utc) {
+      const CivilTime civil = calendar_civil(wall);
+      char text[48];
+      if (date_only) snprintf(text, sizeof(text), "%04u%02u%02u", civil.year, civil.month, civil.day);
+      else snprintf(text, sizeof(text), "%04u%02u%02uT%02u%02u%02u%s", civil.year, civil.month, civil.day, civil.hour, civil.minute, civil.second, utc ? "Z" : "");
+      return std::string(text);
+    };
+
+    std::string ics = "BEGIN:VCALENDAR\r\nVERSION:2.0\r\nPRODID:-//bench//EN\r\n";
+    char line[256];
+    for (uint32_t i = 0; i < count; ++i) {
+      const int64_t day = base_day + static_cast<int64_t>(rng() % 3650);
+      const bool utc = (rng() % 2) == 0;
+      const bool all_day = (rng() % 20) == 0;
+      const int64_t start = day * 86400 + (all_day ? 0 : (7 + rng() % 12) * 3600 + (rng() % 4) * 900);
+      const int64_t duration = all_day ? 86400 * (1 + rng() % 3) : ((rng() % 200) == 0 ? 86400 * (8 + rng() % 30) : 1800 * (1 + rng() % 4));
+
+      ics += "BEGIN:VEVENT\r\n";
+      snprintf(line, sizeof(line), "UID:event-%u@bench\r\n", i);
+      ics += line;
+      if (all_day) ics += "DTSTART;VALUE=DATE:" + stamp(start, true, false) + "\r\n";
+      else if (!utc && (rng() % 2)) ics += "DTSTART;TZID=\"Europe/Berlin\":" + stamp(start, false, false) + "\r\n";
+      else ics += "DTSTART:" + stamp(start, false, utc) + "\r\n";
+      if (all_day) ics += "DTEND;VALUE=DATE:" + stamp(start + duration, true, false) + "\r\n";
+      else if (rng() % 4 == 0) ics += "DURATION:PT" + std::to_string(duration / 60) + "M\r\n";
+      else ics += "DTEND:" + stamp(start + duration, false, utc) + "\r\n";
+
+      snprintf(line, sizeof(line), "SUMMARY:Meeting %u\\, room %u\\; agenda\\nitem", i, static_cast<uint32_t>(rng() % 100));
+      ics += line;
+      if (i % 7 == 0) ics += " with a summary long enough that the exporter folds it\r\n  onto a continuation line";
+      ics += "\r\n";
+
+      if (i % 10 == 0) {
+        std::string rule;
+        switch (rng() % 6) {
+        case 0: rule = "FREQ=DAILY;INTERVAL=" + std::to_string(1 + rng() % 3); break;
+        case 1: rule = "FREQ=WEEKLY;BYDAY=MO,WE,FR"; break;
+        case 2: rule = std::string("FREQ=WEEKLY;INTERVAL=2;BYDAY=") + kDays[rng() % 7] + "," + kDays[rng() % 7]; break;
+        case 3: rule = "FREQ=MONTHLY"; break;
+        case 4: rule = std::string("FREQ=MONTHLY;BYDAY=") + ((rng() % 2) ? "-1" : std::to_string(1 + rng() % 4)) + kDays[rng() % 7]; break;
+        default: rule = "FREQ=YEARLY"; break;
+        }
+        const uint32_t end = static_cast<uint32_t>(rng() % 3);
+        if (end == 0) rule += ";COUNT=" + std::to_string(1 + rng() % 60);
+        else if (end == 1) rule += ";UNTIL=" + stamp(start + static_cast<int64_t>(rng() % 1000) * 86400, false, true);
+        ics += "RRULE:" + rule + "\r\n";
+        if (rng() % 2) ics += "EXDATE:" + stamp(start + 7 * 86400, false, utc) + "," + stamp(start + 14 * 86400, false, utc) + "\r\n";
+      }
+      if (i % 13 == 0) ics += "BEGIN:VALARM\r\nTRIGGER:-PT15M\r\nDESCRIPTION:Reminder\r\nACTION:DISPLAY\r\nEND:VALARM\r\n";
+      ics += "END:VEVENT\r\n";
+
+      // @NOTE: Moves the second occurrence of every other series an hour later.
+      if ((i % 20 == 0) && !all_day) {
+        ics += "BEGIN:VEVENT\r\n";
+        snprintf(line, sizeof(line), "UID:event-%u@bench\r\n", i);
+        ics += line;
+        ics += "RECURRENCE-ID:" + stamp(start + 86400, false, utc) + "\r\n";
+        ics += "DTSTART:" + stamp(start + 86400 + 3600, false, utc) + "\r\n";
+        ics += "DTEND:" + stamp(start + 86400 + 3600 + duration, false, utc) + "\r\n";
+        ics += "SUMMARY:Moved\r\nEND:VEVENT\r\n";
+      }
+    }
+    ics += "END:VCALENDAR\r\n";
+    return ics;
+  }
+
+  bool same_occurrences(const std::vector<CalendarOccurrence>& lhs, const std::vector<CalendarOccurrence>& rhs) {
+    if (lhs.size() != rhs.size()) return false;
+    for (size_t i = 0; i < lhs.size(); ++i) {
+      if ((lhs[i].start != rhs[i].start) || (lhs[i].end != rhs[i].end) || (lhs[i].event != rhs[i].event)) return false;
+    }
+    return true;
+  }
+
+  // Builds the index of a generated 100k event export from a mapped file,
+  // checks range queries against walking every series from its start, and
+  // times the cold build, month and two-week queries and reindexing after
+  // an edit and after new events were appended.
+  void bench_calendar() {
+    if (!selected_group("calendar")) return;
+
+    constexpr uint32_t kEvents = 100'000;
+    std::mt19937 rng(19);
+    std::string ics = make_calendar(kEvents, rng);
+    const CalendarParseOptions options = {.utc_to_local = [](int64_t utc) { return utc + 3600; }};
+
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "bench_calendar.ics";
+    FILE* file = fopen(path.string().c_str(), "wb");
+    check(file != nullptr, "cannot write the calendar");
+    fwrite(ics.data(), 1, ics.size(), file);
+    fclose(file);
+
+    #ifndef _WIN32
+    const int fd = open(path.string().c_str(), O_RDONLY);
+    check(fd >= 0, "cannot open the calendar");
+    void* mapped = mmap(nullptr, ics.size(), PROT_READ, MAP_PRIVATE, fd, 0);
+    check(mapped != MAP_FAILED, "cannot map the calendar");
+    const char* data = static_cast<const char*>(mapped);
+    #else
+    const char* data = ics.data(); // @NOTE: main.cpp maps it with map_file
+    #endif
+
+    CalendarIndex index;
+    uint64_t start = now_ns();
+    calendar_index_build(index, data, ics.size(), options);
+    const double cold_ms = static_cast<double>(now_ns() - start) / 1e6;
+    #ifndef _WIN32
+    munmap(mapped, ics.size());
+    close(fd);
+    #endif
+    std::filesystem::remove(path);
+
+    check(index.stats.blocks == index.events.size(), "calendar lost events");
+    check(index.events.size() > kEvents, "calendar overrides missing");
+    if (selected("calendar_index")) {
+      report("calendar_index", "events", static_cast<double>(index.events.size()));
+      report("calendar_index", "series", static_cast<double>(index.series.size()));
+      report("calendar_index", "cold_ms", cold_ms);
+      report("calendar_index", "mb_per_s", static_cast<double>(ics.size()) / 1e6 / (cold_ms / 1e3));
+    }
+
+    const int64_t first_day = 18262 - 30;
+    std::vector<CalendarOccurrence> fast;
+    std::vector<CalendarOccurrence> naive;
+    uint64_t occurrences = 0;
+    for (uint32_t i = 0; i < 300; ++i) {
+      const int64_t from = (first_day + static_cast<int64_t>(rng() % 3800)) * 86400 + static_cast<int64_t>(rng() % 86400);
+      const int64_t to = from + 3600 + static_cast<int64_t>(rng() % (62 * 86400));
+      fast.clear();
+      naive.clear();
+      calendar_query(index, from, to, fast);
+      calendar_query_naive(index, from, to, naive);
+      check(same_occurrences(fast, naive), "calendar query differs from the naive expansion");
+      occurrences += fast.size();
+    }
+    report("calendar_validate", "occurrences", static_cast<double>(occurrences));
+
+    // @NOTE: The flyout shows a month grid with the events of the next two
+    // weeks, on random months of the decade.
+    run("calendar_query_month", 0, 0, [&](uint64_t i) {
+      const uint32_t month = static_cast<uint32_t>(i % 120);
+      CivilTime civil = { };
+      civil.year = static_cast<uint16_t>(2020 + month / 12);
+      civil.month = static_cast<uint16_t>(1 + month % 12);
+      civil.day = 1;
+      const int64_t from = calendar_wall_seconds(civil);
+      fast.clear();
+      calendar_query(index, from, from + 31 * 86400, fast);
+      consume(fast.size());
+    });
+    run("calendar_query_two_weeks", 0, 0, [&](uint64_t i) {
+      const int64_t from = (18262 + static_cast<int64_t>(i % 3650)) * 86400 + 9 * 3600;
+      fast.clear();
+      calendar_query(index, from, from + 14 * 86400, fast);
+      consume(fast.size());
+    });
+    run("calendar_query_two_weeks_naive", 0, 0, [&](uint64_t i) {
+      const int64_t from = (18262 + static_cast<int64_t>(i % 3650)) * 86400 + 9 * 3600;
+      fast.clear();
+      calendar_query_naive(index, from, from + 14 * 86400, fast);
+      consume(fast.size());
+    });
+
+    if (selected("calendar_reindex")) {
+      start = now_ns();
+      calendar_index_build(index, ics.data(), ics.size(), options);
+      report("calendar_reindex", "unchanged_ms", static_cast<double>(now_ns() - start) / 1e6);
+      check(index.stats.parsed == 0, "calendar reindex parsed an unchanged file");
+
+      const size_t summary = ics.find("SUMMARY:Meeting 5000\\");
+      check(summary != std::string::npos, "calendar edit target missing");
+      ics[summary + 8] = 'm';
+      start = now_ns();
+      calendar_index_build(index, ics.data(), ics.size(), options);
+      report("calendar_reindex", "edit_ms", static_cast<double>(now_ns() - start) / 1e6);
+      report("calendar_reindex", "edit_parsed", static_cast<double>(index.stats.parsed));
+      check(index.stats.parsed == 1, "calendar reindex parsed unchanged events");
+
+      std::mt19937 more(23);
+      std::string appended = make_calendar(1000, more);
+      ics.insert(ics.size() - strlen("END:VCALENDAR\r\n"), appended.substr(appended.find("BEGIN:VEVENT")));
+      start = now_ns();
+      calendar_index_build(index, ics.data(), ics.size(), options);
+      report("calendar_reindex", "append_ms", static_cast<double>(now_ns() - start) / 1e6);
+      report("calendar_reindex", "append_parsed", static_cast<double>(index.stats.parsed));
+
+      CalendarIndex cold;
+      calendar_index_build(cold, ics.data(), ics.size(), options);
+      fast.clear();
+      naive.clear();
+      calendar_query(index, 18262 * 86400, (18262 + 400) * 86400, fast);
+      calendar_query(cold, 18262 * 86400, (18262 + 400) * 86400, naive);
+      check(same_occurrences(fast, naive), "calendar reindex differs from a cold build");
+    }
+  }
+
+  // @NOTE: The reference, a min-heap that cancels by forgetting the id and
+  // skips forgotten ones when they come up.
+  struct ReferenceTimers {
+    using Entry = std::pair<uint64_t, TimerId>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    std::unordered_map<TimerId, uint64_t> pending;
+
+    void drop_cancelled() {
+      while (!heap.empty() && !pending.count(heap.top().second)) heap.pop();
+    }
+  };
+
+  // Deadlines from a millisecond to far past the wheel's range, some of
+  // them already due.
+  uint64_t random_deadline(std::mt19937_64& rng, uint64_t now) {
+    switch (rng() % 8) {
+      case 0: return now - std::min<uint64_t>(now, rng() % 5000);
+      case 1: return now + rng() % 64;
+      case 2: return now + rng() % 5000;
+      case 3: return now + rng() % 400'000;
+      case 4: return now + rng() % 30'000'000;
+      case 5: return now + rng() % 3'000'000'000;
+      case 6: return now + rng() % (kTimerWheelRangeMs * 3);
+      default: return now + 1000 * (rng() % 100);
+    }
+  }
+
+  void fuzz_timer_wheel(uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    uint64_t now = 1'700'000'000'000 + rng() % 1'000'000;
+    TimerWheel wheel;
+    timer_wheel_init(wheel, now);
+    ReferenceTimers reference;
+    std::vector<TimerId> ids;
+    std::vector<TimerExpiry> expired;
+    std::vector<std::pair<uint64_t, TimerId>> wheel_batch;
+    std::vector<std::pair<uint64_t, TimerId>> reference_batch;
+
+    for (uint32_t step = 0; step < 200'000; ++step) {
+      const uint64_t op = rng() % 16;
+      if (op < 7) {
+        const uint64_t deadline = random_deadline(rng, now);
+        const TimerId id = timer_wheel_schedule(wheel, deadline, step);
+        check(!reference.pending.count(id), "timer wheel reused a pending id");
+        reference.pending[id] = deadline;
+        reference.heap.push({deadline, id});
+        ids.push_back(id);
+      } else if ((op < 10) && !ids.empty()) {
+        const size_t pick = rng() % ids.size();
+        const TimerId id = ids[pick];
+        ids[pick] = ids.back();
+        ids.pop_back();
+        auto it = reference.pending.find(id);
+        const bool was_pending = it != reference.pending.end();
+        check(timer_wheel_deadline(wheel, id) == (was_pending ? it->second : UINT64_MAX), "timer wheel deadline differs");
+        if (was_pending) reference.pending.erase(it);
+        check(timer_wheel_cancel(wheel, id) == was_pending, "timer wheel cancel differs");
+        check(!timer_wheel_cancel(wheel, id), "timer wheel cancelled twice");
+      } else {
+        // @NOTE: Mostly what the app does, jump to the next deadline.
+        reference.drop_cancelled();
+        const uint64_t next = timer_wheel_next_deadline(wheel);
+        check(reference.heap.empty() ? (next == UINT64_MAX) : (next <= std::max(reference.heap.top().first, wheel.now_ms)), "timer wheel next deadline is late");
+        if ((op < 13) && (next != UINT64_MAX)) now = std::max(now, next);
+        else now += (op == 15) ? rng() % 100'000'000 : rng() % 3000;
+
+        expired.clear();
+        timer_wheel_advance(wheel, now, expired);
+        wheel_batch.clear();
+        for (size_t i = 0; i < expired.size(); ++i) {
+          check((i == 0) || (expired[i - 1].deadline_ms <= expired[i].deadline_ms), "timer wheel expired out of order");
+          wheel_batch.push_back({expired[i].deadline_ms, expired[i].id});
+        }
+        reference_batch.clear();
+        for (reference.drop_cancelled(); !reference.heap.empty() && (reference.heap.top().first <= now); reference.drop_cancelled()) {
+          reference_batch.push_back(reference.heap.top());
+          reference.pending.erase(reference.heap.top().second);
+          reference.heap.pop();
+        }
+        std::sort(wheel_batch.begin(), wheel_batch.end());
+        std::sort(reference_batch.begin(), reference_batch.end());
+        check(wheel_batch == reference_batch, "timer wheel expired other timers than the reference");
+      }
+      check(wheel.count == reference.pending.size(), "timer wheel count differs");
+    }
+  }
+
+  // Counts the wakeups of a simulated day with a few alarms, each at the
+  // wheel's next deadline like the app's kAlarmTimer, against a 1 Hz tick.
+  void simulate_alarm_day() {
+    const char* config =
+      "# a day\n"
+      "at 07:30 Stand-up\n"
+      "in 25m Tea\n"
+      "every 45m Stretch\n"
+      "at 12:00:30 @2 Lunch\n"
+      "at 25:00 ignored\n"
+      "soon ignored\n";
+    CivilTime midnight = { };
+    midnight.year = 2024;
+    midnight.month = 3;
+    midnight.day = 10;
+    const uint64_t start = 5'000'000;
+    Alarms alarms;
+    alarms_init(alarms, start);
+    alarms_configure(alarms, parse_alarm_config(config, strlen(config)), start, midnight);
+    check(alarms.entries.size() == 4, "alarm config parsed wrong");
+    check((alarms.entries[3].monitor == 2) && (alarms.entries[3].label == "Lunch"), "alarm monitor parsed wrong");
+
+    std::vector<uint32_t> fired;
+    std::vector<uint64_t> fired_at(alarms.entries.size(), 0);
+    std::vector<uint32_t> fired_count(alarms.entries.size(), 0);
+    uint64_t wakeups = 0;
+    bool reconfigured = false;
+    for (uint64_t now = start; now < start + 86'400'000;) {
+      now = std::min(alarms_next_deadline(alarms), start + 86'400'000);
+      if (!reconfigured && (now >= start + 10 * 60'000)) {
+        // @NOTE: Saving the file again with a new line keeps the running
+        // countdowns.
+        const std::string edited = std::string(config) + "at 23:00 Sleep\n";
+        alarms_configure(alarms, parse_alarm_config(edited.data(), edited.size()), now, civil_time_add_ms(midnight, now - start));
+        fired_at.push_back(0);
+        fired_count.push_back(0);
+        reconfigured = true;
+      }
+      fired.clear();
+      alarms_advance(alarms, now, civil_time_add_ms(midnight, now - start), fired);
+      wakeups++;
+      for (uint32_t index : fired) {
+        fired_at[index] = now - start;
+        fired_count[index]++;
+        check(alarms_alerting(alarms, alarms.entries[index].monitor), "alarm is not alerting");
+      }
+      if ((now - start > 12 * 3600'000 + 40'000) && (now - start < 12 * 3600'000 + 60'000)) {
+        check(alarms_alerting(alarms, 2) && !alarms_alerting(alarms, 1), "alarm alerts the wrong monitor");
+      }
+    }
+    check(reconfigured && (fired_count.size() == 5), "alarm reconfiguration missing");
+    check((fired_count[0] == 1) && (fired_at[0] == (7 * 60 + 30) * 60'000), "daily alarm fired wrong");
+    check((fired_count[1] == 1) && (fired_at[1] == 25 * 60'000), "countdown restarted or fired wrong");
+    check(fired_count[2] == 86'400 / (45 * 60), "repeating alarm drifted");
+    check((fired_count[3] == 1) && (fired_at[3] == 12 * 3600'000 + 30'000), "monitor alarm fired wrong");
+    check(fired_count[4] == 1, "added alarm did not fire");
+    report("timer_wheel_alarm_day", "wakeups", static_cast<double>(wakeups));
+    report("timer_wheel_alarm_day", "ticks_1hz", 86'400.0);
+  }
+
+  // Fuzzes the wheel against the reference and times both with a million
+  // pending timers.
+  void bench_timer_wheel() {
+    if (!selected_group("timer_wheel")) return;
+
+    if (selected("timer_wheel_validate")) {
+      for (uint64_t seed = 1; seed <= 8; ++seed) fuzz_timer_wheel(seed);
+      report("timer_wheel_validate", "seeds", 8.0);
+    }
+    if (selected("timer_wheel_alarm_day")) simulate_alarm_day();
+
+    constexpr uint32_t kTimers = 1'000'000;
+    constexpr uint64_t kStart = 1'000'000'000;
+    std::mt19937_64 rng(20);
+    std::vector<uint64_t> deadlines(kTimers);
+    for (uint64_t& deadline : deadlines) deadline = kStart + 1 + rng() % 3'600'000;
+
+    if (selected("timer_wheel_million")) {
+      TimerWheel wheel;
+      timer_wheel_init(wheel, kStart);
+      std::vector<TimerId> ids(kTimers);
+      uint64_t start = now_ns();
+      for (uint32_t i = 0; i < kTimers; ++i) ids[i] = timer_wheel_schedule(wheel, deadlines[i], i);
+      report("timer_wheel_million", "wheel_schedule_ns", static_cast<double>(now_ns() - start) / kTimers);
+
+      ReferenceTimers reference;
+      start = now_ns();
+      for (uint32_t i = 0; i < kTimers; ++i) {
+        reference.heap.push({deadlines[i], i + 1});
+        reference.pending[i + 1] = deadlines[i];
+      }
+      report("timer_wheel_million", "heap_schedule_ns", static_cast<double>(now_ns() - start) / kTimers);
+
+      start = now_ns();
+      for (uint32_t i = 0; i < kTimers; i += 2) timer_wheel_cancel(wheel, ids[i]);
+      report("timer_wheel_million", "wheel_cancel_ns", static_cast<double>(now_ns() - start) / (kTimers / 2));
+      start = now_ns();
+      for (uint32_t i = 0; i < kTimers; i += 2) reference.pending.erase(i + 1);
+      report("timer_wheel_million", "heap_cancel_ns", static_cast<double>(now_ns() - start) / (kTimers / 2));
+
+      // @NOTE: Expires everything by jumping from deadline to deadline.
+      std::vector<TimerExpiry> expired;
+      uint64_t wakeups = 0;
+      start = now_ns();
+      for (uint64_t next = timer_wheel_next_deadline(wheel); next != UINT64_MAX; next = timer_wheel_next_deadline(wheel)) {
+        timer_wheel_advance(wheel, next, expired);
+        wakeups++;
+      }
+      report("timer_wheel_million", "wheel_expire_ns", static_cast<double>(now_ns() - start) / (kTimers / 2));
+      report("timer_wheel_million", "wheel_wakeups", static_cast<double>(wakeups));
+      check(expired.size() == kTimers / 2, "timer wheel lost timers");
+
+      uint64_t expired_count = 0;
+      start = now_ns();
+      for (reference.drop_cancelled(); !reference.heap.empty(); reference.drop_cancelled()) {
+        reference.pending.erase(reference.heap.top().second);
+        reference.heap.pop();
+        expired_count++;
+      }
+      report("timer_wheel_million", "heap_expire_ns", static_cast<double>(now_ns() - start) / (kTimers / 2));
+      check(expired_count == kTimers / 2, "reference lost timers");
+    }
+
+    // @NOTE: Steady state with a million pending: one timer is cancelled
+    // and another scheduled per operation, the next deadline is asked for.
+    TimerWheel wheel;
+    timer_wheel_init(wheel, kStart);
+    std::vector<TimerId> ids(kTimers);
+    for (uint32_t i = 0; i < kTimers; ++i) ids[i] = timer_wheel_schedule(wheel, deadlines[i], i);
+    run("timer_wheel_churn", 0, kTimers, [&](uint64_t i) {
+      const uint32_t pick = static_cast<uint32_t>(i * 2654435761u % kTimers);
+      timer_wheel_cancel(wheel, ids[pick]);
+      ids[pick] = timer_wheel_schedule(wheel, deadlines[(pick + i) % kTimers], pick);
+    });
+    run("timer_wheel_next_deadline", 0, kTimers, [&](uint64_t) {
+      consume(timer_wheel_next_deadline(wheel));
+    });
+
+    ReferenceTimers reference;
+    std::vector<TimerId> reference_ids(kTimers);
+    TimerId next_id = 1;
+    for (uint32_t i = 0; i < kTimers; ++i) {
+      reference_ids[i] = next_id++;
+      reference.heap.push({deadlines[i], reference_ids[i]});
+      reference.pending[reference_ids[i]] = deadlines[i];
+    }
+    run("timer_wheel_churn_heap", 0, kTimers, [&](uint64_t i) {
+      const uint32_t pick = static_cast<uint32_t>(i * 2654435761u % kTimers);
+      reference.pending.erase(reference_ids[pick]);
+      reference_ids[pick] = next_id++;
+      reference.heap.push({deadlines[(pick + i) % kTimers], reference_ids[pick]});
+      reference.pending[reference_ids[pick]] = deadlines[(pick + i) % kTimers];
+    });
+  }
+
+  // Parses canned /proc files, checks the rates and the line from a
+  // provider with known counters, then times the live /proc provider and the
+  // formatting and checks a pass against kMetricsSampleBudgetNs.
+  void bench_system_metrics() {
+    if (!selected_group("system_metrics")) return;
+
+    const char stat[] = "cpu  100 20 30 800 50 0 0 0 0 0\ncpu0 50 10 15 400 25 0 0 0 0 0\nintr 12 3 4\n";
+    const char meminfo[] = "MemTotal:       16000000 kB\nMemFree:         1000000 kB\nMemAvailable:    8000000 kB\nBuffers:          200000 kB\n";
+    const char net_dev[] =
+      "Inter-|   Receive                                                |  Transmit\n"
+      " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+      "    lo:  999999      10    0    0    0     0          0         0   999999      10    0    0    0     0       0          0\n"
+      "  eth0:    1000      10    0    0    0     0          0         0     2000      20    0    0    0     0       0          0\n"
+      " wlan0:     500       5    0    0    0     0          0         0      300       3    0    0    0     0       0          0\n";
+
+    MetricsCounters parsed;
+    check(parse_proc_stat(stat, strlen(stat), parsed) && (parsed.cpu_total == 1000) && (parsed.cpu_busy == 150), "parse_proc_stat");
+    check(parse_proc_meminfo(meminfo, strlen(meminfo), parsed) && (parsed.memory_total == 16000000ull * 1024) && (parsed.memory_used == 8000000ull * 1024), "parse_proc_meminfo");
+    check(parse_proc_net_dev(net_dev, strlen(net_dev), parsed) && (parsed.net_received == 1500) && (parsed.net_sent == 2300), "parse_proc_net_dev");
+    check(!parse_proc_stat(meminfo, strlen(meminfo), parsed), "parse_proc_stat accepts another file");
+    const char short_net_dev[] = "header\nheader\n  eth0: 1 2 3\n";
+    check(!parse_proc_net_dev(short_net_dev, strlen(short_net_dev), parsed), "parse_proc_net_dev accepts a short line");
+
+    // @NOTE: A /proc/net/dev of 600 interfaces, several times the initial
+    // buffer, read through the provider from a fake root. Cut anywhere in
+    // its last line it has to be rejected rather than summed short.
+    {
+      std::string big_net_dev(net_dev, net_dev + strlen(net_dev));
+      uint64_t received = 1500;
+      uint64_t sent = 2300;
+      for (uint32_t i = 0; i < 600; ++i) {
+        char line[160];
+        snprintf(line, sizeof(line), " veth%u:  %u  1  0  0  0  0  0  0  %u  1  0  0  0  0  0  0\n", i, 1000 + i, 2000 + 2 * i);
+        big_net_dev += line;
+        received += 1000 + i;
+        sent += 2000 + 2 * i;
+      }
+      check(big_net_dev.size() > 2 * kProcMetricsBuffer, "the oversized /proc/net/dev fits the buffer");
+      check(parse_proc_net_dev(big_net_dev.data(), big_net_dev.size(), parsed) && (parsed.net_received == received) && (parsed.net_sent == sent), "parse_proc_net_dev with many interfaces");
+      const size_t last_line = big_net_dev.rfind('\n', big_net_dev.size() - 2) + 1;
+      for (size_t cut = last_line + 8; cut < big_net_dev.size() - 8; cut += 7) {
+        check(!parse_proc_net_dev(big_net_dev.data(), cut, parsed), "parse_proc_net_dev accepts a partially read line");
+      }
+
+      const std::filesystem::path root = std::filesystem::temp_directory_path() / ("bench_proc_" + std::to_string(now_ns()));
+      std::filesystem::create_directories(root / "net");
+      const std::pair<const char*, std::string> files[] = {{"stat", stat}, {"meminfo", meminfo}, {"net/dev", big_net_dev}};
+      for (const auto& [name, text] : files) {
+        FILE* f = fopen((root / name).string().c_str(), "wb");
+        if (f) {
+          fwrite(text.data(), 1, text.size(), f);
+          fclose(f);
+        }
+      }
+      ProcMetricsSource source;
+      MetricsCounters counters;
+      check(proc_metrics_open(source, root.string().c_str()) && proc_metrics_sample(source, counters), "the provider fails on a long /proc/net/dev");
+      check((counters.net_received == received) && (counters.net_sent == sent) && (counters.cpu_total == 1000), "the provider read /proc/net/dev short");
+      check(proc_metrics_sample(source, counters) && (counters.net_received == received), "a second pass after the buffer grew");
+      proc_metrics_close(source);
+      std::filesystem::remove_all(root);
+    }
+
+    // @NOTE: A quarter of the CPU busy, 1 MiB in and 512 B out per second,
+    // half of the memory used.
+    MetricsCounters fake = {.memory_used = 8ull << 30, .memory_total = 16ull << 30};
+    MetricsSampler sampler;
+    sampler.provider.sample = [&](MetricsCounters& counters) {
+      counters = fake;
+      fake.cpu_total += 1000;
+      fake.cpu_busy += 250;
+      fake.net_received += 1 << 20;
+      fake.net_sent += 512;
+      return true;
+    };
+    FormattedText line;
+    check(!metrics_sampler_tick(sampler, 10'000) && render_metrics_line(sampler, line) && (std::wstring(line.text, line.length) == L"CPU MEM"), "the first pass has rates");
+    check(!metrics_sampler_tick(sampler, 10'500), "a pass before the interval");
+    check(metrics_sampler_tick(sampler, 11'000) && (sampler.latest.cpu_permille == 250) && (sampler.latest.memory_permille == 500), "wrong CPU or memory rate");
+    check((sampler.latest.received_per_s == (1 << 20)) && (sampler.latest.sent_per_s == 512), "wrong network rate");
+    check(render_metrics_line(sampler, line) && (std::wstring(line.text, line.length) == L"CPU 25% \u2583 MEM 50% \u21931.0M \u2191" L"512B"), "wrong metrics line");
+    check(!render_metrics_line(sampler, line), "an unchanged line is reported as changed");
+    check(metrics_sampler_tick(sampler, 11'760) && (sampler.cpu.count == 2), "a tick a little early skips the pass");
+    for (uint64_t now = 12'000; now < 60'000; now += 1000) metrics_sampler_tick(sampler, now);
+    check((sampler.cpu.count == kMetricsHistory) && (metrics_ring_at(sampler.cpu, 0) == 250), "the ring does not keep the newest rates");
+    render_metrics_line(sampler, line);
+    check(std::wstring(line.text, line.length) == L"CPU 25% \u2583\u2583\u2583\u2583\u2583\u2583\u2583\u2583 MEM 50% \u21931.0M \u2191" L"512B", "wrong sparkline");
+
+    run("system_metrics_format", 0, 0, [&](uint64_t i) {
+      sampler.latest.received_per_s = i;
+      consume(render_metrics_line(sampler, line));
+    });
+
+    #ifndef _WIN32
+    ProcMetricsSource source;
+    if (!proc_metrics_open(source, "/proc")) return;
+
+    run("system_metrics_sample", 0, 0, [&](uint64_t) {
+      MetricsCounters counters;
+      consume(proc_metrics_sample(source, counters));
+    });
+
+    // @NOTE: An hour of ticks, one pass per tick.
+    MetricsSampler live;
+    live.provider.sample = [&](MetricsCounters& counters) { return proc_metrics_sample(source, counters); };
+    for (uint64_t now = 1000; now <= 3600 * 1000; now += 1000) metrics_sampler_tick(live, now);
+    proc_metrics_close(source);
+
+    check((live.stats.samples == 3600) && (live.stats.failures == 0), "the /proc provider fails");
+    const double mean_ns = static_cast<double>(live.stats.sample_ns) / static_cast<double>(live.stats.samples);
+    check(mean_ns < static_cast<double>(kMetricsSampleBudgetNs), "a /proc pass is over budget");
+    report("system_metrics_sample", "mean_ns_per_tick", mean_ns);
+    report("system_metrics_sample", "max_ns_per_tick", static_cast<double>(live.stats.max_sample_ns));
+    #endif
+  }
+
+  // @NOTE: Tabular digits and figure spaces, block elements as wide as a
+  // digit, everything else from the character code. 16 px lines at 96 dpi.
+  TextExtent measure_synthetic(TextFont font, const wchar_t* text, uint32_t length) {
+    int width = 0;
+    for (uint32_t i = 0; i < length; ++i) {
+      const wchar_t ch = text[i];
+      const bool digit_wide = ((ch >= L'0') && (ch <= L'9')) || (ch == 0x2007) || ((ch >= 0x2581) && (ch <= 0x2588));
+      width += digit_wide ? 7 : 3 + static_cast<int>(ch % 6);
+    }
+    const int scale = static_cast<int>(font.dpi);
+    return TextExtent{.width = width * scale / 96, .height = 16 * scale / 96};
+  }
+
+  // A week at one frame per second: "H:mm:ss", the long date and the
+  // metrics line from random counters, at 100 % and 150 %, through the text
+  // metrics cache. Every extent is checked against measuring directly, a
+  // resize is counted whenever the settled window size changes.
+  void bench_text_metrics() {
+    if (!selected_group("text_metrics")) return;
+
+    const LocaleNames names = make_locale_names();
+    const FormatProgram time_program = compile_format(L"H:mm:ss");
+    const FormatProgram date_program = compile_format(L"dddd, MMMM d, yyyy");
+
+    std::mt19937 rng(23);
+    MetricsCounters counters = {.memory_total = 16ull << 30};
+    MetricsSampler sampler;
+    sampler.provider.sample = [&](MetricsCounters& out) {
+      counters.cpu_total += 1000;
+      counters.cpu_busy += 150 + rng() % 500; // @NOTE: a busy desktop, below 100 %
+      counters.memory_used = (4ull << 30) + (rng() % (8ull << 30));
+      counters.net_received += (rng() % 4 == 0) ? rng() % (8u << 20) : rng() % 4096;
+      counters.net_sent += rng() % 65536;
+      out = counters;
+      return true;
+    };
+
+    const TextFont fonts[2] = {{.size = 12.0f, .dpi = 96}, {.size = 18.0f, .dpi = 144}};
+    TextMetricsCache cache;
+    uint64_t measured = 0;
+    uint64_t lines = 0;
+    uint32_t resizes = 0;
+    uint32_t unsettled = 0;
+    ClockFit fits[2];
+    FormattedText time, date, metrics;
+    constexpr uint64_t kDays = 7;
+    for (uint64_t second = 0; second < kDays * 86400; ++second) {
+      const CivilTime civil = time_at(second);
+      render_format(time_program, names, civil, time);
+      render_format(date_program, names, civil, date);
+      metrics_sampler_tick(sampler, second * 1000);
+      render_metrics_line(sampler, metrics);
+
+      const FormattedText* texts[3] = {&time, &date, &metrics};
+      for (uint32_t f = 0; f < 2; ++f) {
+        Int2 content = { };
+        for (const FormattedText* text : texts) {
+          auto measure = [&](const wchar_t* chars, uint32_t length) {
+            measured++;
+            return measure_synthetic(fonts[f], chars, length);
+          };
+          const TextExtent extent = text_metrics_measure(cache, fonts[f], text->text, text->length, measure);
+          check(extent == measure_synthetic(fonts[f], text->text, text->length), "a cached extent is wrong");
+          content.x = std::max(content.x, extent.width);
+          content.y += extent.height;
+          lines++;
+        }
+
+        const float scale = static_cast<float>(fonts[f].dpi) / 96.0f;
+        const Int2 fitted = fit_clock_window_size({scale, scale}, content);
+        if ((fitted.x != fits[f].size.x) || (fitted.y != fits[f].size.y)) unsettled++;
+        if (settle_clock_fit(fits[f], fitted, second * 1000 + 1) && (second > 0)) resizes++;
+        check((fits[f].size.x >= fitted.x) && (fits[f].size.y >= fitted.y), "a window is smaller than its text");
+      }
+    }
+
+    const TextMetricsStats& stats = cache.stats;
+    check(stats.lookups == lines, "a line was not looked up");
+    check(stats.misses == measured, "a miss was not measured");
+    check(static_cast<double>(stats.hits) / static_cast<double>(stats.lookups) > 0.99, "the text metrics cache misses too often");
+    report("text_metrics", "hit_rate", static_cast<double>(stats.hits) / static_cast<double>(stats.lookups));
+    report("text_metrics", "measures_per_day", static_cast<double>(measured) / kDays);
+    report("text_metrics", "fit_changes_per_day", static_cast<double>(unsettled) / kDays);
+    report("text_metrics", "resizes_per_day", static_cast<double>(resizes) / kDays);
+    report("text_metrics", "entries", static_cast<double>(cache.entries.size()));
+    report("text_metrics", "collisions", static_cast<double>(stats.collisions));
+
+    run("text_metrics_lookup", 0, 0, [&](uint64_t i) {
+      render_format(time_program, names, time_at(i), time);
+      consume(static_cast<uint64_t>(text_metrics_measure(cache, fonts[0], time.text, time.length, [&](const wchar_t* chars, uint32_t length) { return measure_synthetic(fonts[0], chars, length); }).width));
+    });
+    run("text_metrics_format_only", 0, 0, [&](uint64_t i) {
+      render_format(time_program, names, time_at(i), time);
+      consume(time.length);
+    });
+  }
+
+  struct PowerStep {
+    PowerEvent event;
+    PowerMode mode; // @NOTE: expected afterwards
+    bool changed;
+  };
+
+  struct PowerScriptEvent {
+    uint32_t second; // @NOTE: of the day
+    PowerEvent event;
+  };
+
+  // A day from midnight with 60 windows moving now and then and the
+  // foreground changing every 10 s, the long time with seconds on every
+  // clock. Power events are only fed if `power` is set, the hooks drop
+  // what the app would have dropped while suspended. Every event goes
+  // through the event log and the replay has to match the model fed
+  // directly.
+  ReplayStats simulate_power_day(const std::vector<PowerScriptEvent>& script, uint32_t monitor_count, bool power, PowerStats* power_stats) {
+    std::mt19937 rng(24);
+    const std::vector<Monitor> monitors = make_monitors(monitor_count);
+    std::vector<WindowEntry> windows;
+    for (const WindowState& state : make_windows(60, monitors, rng)) windows.push_back(WindowEntry{.id = windows.size() + 1, .state = state});
+
+    const FormatPictures pictures = {.short_date = L"d.M.yyyy", .long_date = L"dddd, MMMM d, yyyy", .short_time = L"H:mm", .long_time = L"H:mm:ss"};
+    Settings settings;
+    settings.long_time = true;
+    settings.on_primary_display = true;
+    settings.on_fullscreen = true;
+
+    FILE* file = tmpfile();
+    check(file != nullptr, "tmpfile failed");
+    EventLogWriter writer;
+    check(event_log_begin(writer, file), "event_log_begin failed");
+
+    auto shadow = std::make_unique<ReplayModel>();
+    const uint64_t base_ms = 1'000'000;
+    uint64_t now_ms = base_ms;
+    const CivilTime midnight = time_at(0);
+    auto emit = [&](Event& event) {
+      event.time_ms = now_ms;
+      check(event_log_write(writer, event), "event_log_write failed");
+      check(replay_event(*shadow, event), "shadow rejected an event");
+    };
+    auto tick = [&] {
+      const TickActions actions = plan_tick(shadow->transient_flags);
+      Event event = {.kind = EventKind::Tick, .flags = shadow->transient_flags, .civil = civil_time_add_ms(midnight, now_ms - base_ms)};
+      if (actions.rebuild_window_index) {
+        event.sections |= kEventSectionWindows;
+        event.windows = windows;
+      }
+      emit(event);
+    };
+    auto suspended = [&] { return shadow->power.mode == PowerMode::Suspended; };
+
+    Event start = {.kind = EventKind::Start, .sections = kEventSectionTheme | kEventSectionLocale | kEventSectionMonitors | kEventSectionWindows, .civil = midnight, .settings = settings, .pictures = pictures, .names = make_locale_names(), .monitors = monitors, .windows = windows};
+    emit(start);
+
+    size_t next = 0;
+    for (uint32_t second = 0; second < 86400; ++second) {
+      now_ms = base_ms + second * 1000ull;
+      for (; (next < script.size()) && (script[next].second == second); ++next) {
+        if (!power) continue;
+        Event event = {.kind = EventKind::Power, .flags = static_cast<uint32_t>(script[next].event)};
+        emit(event);
+      }
+      if (shadow->transient_flags && !suspended()) {
+        now_ms += kTickExpediteDelayMs;
+        tick();
+      }
+      if (suspended()) continue;
+
+      // @NOTE: The UI tick at its longest delay, a window move every few
+      // seconds and a foreground change every 10 s.
+      if (second % (kTickMaxDelayMs / 1000) == 0) tick();
+      if (rng() % 4 == 0) {
+        WindowEntry& window = windows[rng() % windows.size()];
+        window.state.frame = {window.state.frame.left + 1, window.state.frame.top, window.state.frame.right + 1, window.state.frame.bottom};
+        Event event = {.kind = EventKind::WindowUpdate, .windows = {window}};
+        emit(event);
+      }
+      if (second % 10 == 5) {
+        Event event = {.kind = EventKind::Foreground, .has_frame = false};
+        emit(event);
+      }
+    }
+    now_ms = base_ms + 86400'000ull;
+    replay_advance(*shadow, now_ms);
+
+    rewind(file);
+    EventLogReader reader;
+    check(event_log_open(reader, file), "event_log_open failed");
+    auto model = std::make_unique<ReplayModel>();
+    Event event;
+    while (event_log_read(reader, event)) check(replay_event(*model, event), "replay rejected an event");
+    replay_advance(*model, now_ms);
+    fclose(file);
+
+    check(!reader.failed, "event log did not read back");
+    check(model->stats.divergences == 0, "the power day diverged");
+    check(memcmp(&model->stats, &shadow->stats, sizeof(ReplayStats)) == 0, "the power day is not deterministic");
+    if (power_stats) *power_stats = model->power.stats;
+    return model->stats;
+  }
+
+  void bench_power() {
+    if (!selected_group("power")) return;
+
+    // @NOTE: Suspended wins over Reduced, every condition is tracked on its
+    // own, repeats change nothing.
+    const PowerStep steps[] = {
+      {PowerEvent::DisplayOn, PowerMode::Full, false},
+      {PowerEvent::BatteryPower, PowerMode::Reduced, true},
+      {PowerEvent::SaverOn, PowerMode::Reduced, false},
+      {PowerEvent::AcPower, PowerMode::Reduced, false},
+      {PowerEvent::DisplayOff, PowerMode::Suspended, true},
+      {PowerEvent::Lock, PowerMode::Suspended, false},
+      {PowerEvent::DisplayOn, PowerMode::Suspended, false},
+      {PowerEvent::SessionDisconnect, PowerMode::Suspended, false},
+      {PowerEvent::Unlock, PowerMode::Suspended, false},
+      {PowerEvent::SessionConnect, PowerMode::Reduced, true},
+      {PowerEvent::SaverOff, PowerMode::Full, true},
+      {PowerEvent::Lock, PowerMode::Suspended, true},
+      {PowerEvent::Lock, PowerMode::Suspended, false},
+      {PowerEvent::Unlock, PowerMode::Full, true},
+    };
+    PowerState state;
+    power_state_init(state, 0);
+    for (uint64_t i = 0; i < std::size(steps); ++i) {
+      const bool changed = power_state_apply(state, steps[i].event, (i + 1) * 1000);
+      check((changed == steps[i].changed) && (state.mode == steps[i].mode), "a power event led to the wrong mode");
+    }
+    power_state_account(state, 15'000);
+    check((state.stats.resumes == 2) && (state.stats.changes == 6), "the power transitions were miscounted");
+    check(state.stats.mode_ms[0] + state.stats.mode_ms[1] + state.stats.mode_ms[2] == 15'000, "the time per power mode does not add up");
+    check(power_tick_granularity(PowerMode::Reduced, TickGranularity::Second) == TickGranularity::Minute, "on battery the seconds are still drawn");
+    check(power_tick_granularity(PowerMode::Reduced, TickGranularity::Day) == TickGranularity::Day, "on battery the ticks got finer");
+
+    // @NOTE: Asleep until 8:30, a locked lunch, the afternoon on battery
+    // with the saver on for a while, locked and dark from 18:00.
+    const std::vector<PowerScriptEvent> laptop = {
+      {1, PowerEvent::Lock}, {2, PowerEvent::DisplayOff},
+      {8 * 3600 + 1800, PowerEvent::DisplayOn}, {8 * 3600 + 1830, PowerEvent::Unlock},
+      {12 * 3600, PowerEvent::Lock}, {12 * 3600 + 300, PowerEvent::DisplayOff},
+      {12 * 3600 + 3300, PowerEvent::DisplayOn}, {13 * 3600, PowerEvent::Unlock},
+      {14 * 3600, PowerEvent::BatteryPower}, {15 * 3600 + 1800, PowerEvent::SaverOn},
+      {16 * 3600, PowerEvent::AcPower}, {16 * 3600 + 1, PowerEvent::SaverOff},
+      {18 * 3600, PowerEvent::Lock}, {18 * 3600 + 60, PowerEvent::DisplayOff},
+    };
+    // @NOTE: A pooled desktop, connected for the working hours but lunch.
+    const std::vector<PowerScriptEvent> vdi = {
+      {1, PowerEvent::SessionDisconnect},
+      {9 * 3600, PowerEvent::SessionConnect}, {12 * 3600 + 1800, PowerEvent::SessionDisconnect},
+      {13 * 3600 + 900, PowerEvent::SessionConnect}, {17 * 3600 + 1800, PowerEvent::SessionDisconnect},
+    };
+
+    struct Profile {
+      const char* name;
+      const std::vector<PowerScriptEvent>* script;
+      uint32_t monitors;
+      uint64_t resumes;
+    };
+    const Profile profiles[] = {{"power_laptop", &laptop, 1, 2}, {"power_vdi", &vdi, 2, 2}};
+    for (const Profile& profile : profiles) {
+      PowerStats stats;
+      const ReplayStats always = simulate_power_day(*profile.script, profile.monitors, false, nullptr);
+      const ReplayStats aware = simulate_power_day(*profile.script, profile.monitors, true, &stats);
+      check(stats.resumes == profile.resumes, "a resume was missed");
+      check(aware.frames < always.frames, "suspending did not save any frames");
+
+      auto avoided = [](uint64_t before, uint64_t after) { return static_cast<double>(before) - static_cast<double>(after); };
+      report(profile.name, "frames", static_cast<double>(aware.frames));
+      report(profile.name, "frames_avoided", avoided(always.frames, aware.frames));
+      report(profile.name, "formats_avoided", avoided(always.formats, aware.formats));
+      report(profile.name, "presents_avoided", avoided(always.presents, aware.presents));
+      report(profile.name, "window_events_avoided", avoided(always.window_events, aware.window_events));
+      report(profile.name, "ticks_avoided", avoided(always.ticks, aware.ticks));
+      report(profile.name, "index_rebuilds", static_cast<double>(aware.window_index_rebuilds));
+      report(profile.name, "suspended_hours", static_cast<double>(stats.mode_ms[static_cast<size_t>(PowerMode::Suspended)]) / 3.6e6);
+      report(profile.name, "reduced_hours", static_cast<double>(stats.mode_ms[static_cast<size_t>(PowerMode::Reduced)]) / 3.6e6);
+    }
+  }
+
+  // @NOTE: Everything the client has queued, as one transport write would
+  // take it.
+  std::vector<uint8_t> api_take(ApiServer& server, uint64_t client) {
+    std::vector<uint8_t> bytes;
+    ApiClient& state = server.clients.at(client);
+    size_t skip = state.sent;
+    for (const ApiQueued& queued : state.output) {
+      bytes.insert(bytes.end(), queued.frame->begin() + static_cast<ptrdiff_t>(skip), queued.frame->end());
+      skip = 0;
+    }
+    api_client_sent(server, state, bytes.size());
+    return bytes;
+  }
+
+  std::vector<ApiMessage> api_frame_types(const std::vector<uint8_t>& bytes) {
+    std::vector<ApiMessage> types;
+    ApiFrame frame;
+    for (size_t at = 0; api_parse_frame(bytes.data() + at, bytes.size() - at, frame) == ApiParse::Complete; at += kApiFrameHeader + frame.size) types.push_back(frame.type);
+    return types;
+  }
+
+  #ifndef _WIN32
+  // @NOTE: Hundreds of subscribers on a Unix domain socket, the server on
+  // its own thread pushing a new text every few milliseconds, far more often
+  // than once a second. The latency is from the flush to a client having
+  // parsed the whole frame.
+  void bench_clock_api_sockets() {
+    if (!selected("clock_api_sockets")) return;
+
+    rlimit limit = { };
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    const uint32_t client_count = static_cast<uint32_t>(std::min<rlim_t>(500, (limit.rlim_cur - 64) / 2));
+    constexpr uint32_t kTicks = 400;
+    constexpr uint64_t kTickIntervalNs = 2'000'000;
+
+    const std::string path = (std::filesystem::temp_directory_path() / ("bench_clock_api_" + std::to_string(getpid()) + ".sock")).string();
+    ApiServer server;
+    ApiSocketServer transport;
+    check(api_socket_listen(transport, path.c_str()), "cannot listen on the API socket");
+
+    std::unique_ptr<std::atomic<uint64_t>[]> flushed(new std::atomic<uint64_t>[kTicks]);
+    for (uint32_t i = 0; i < kTicks; ++i) flushed[i].store(0);
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> subscribed{0};
+    uint64_t flush_ns = 0;
+
+    std::thread server_thread([&] {
+      const uint64_t deadline = now_ns() + 10'000'000'000ull;
+      while ((server.subscribers[1] < client_count) && (now_ns() < deadline)) api_socket_poll(transport, server, 1);
+      subscribed.store(server.subscribers[1], std::memory_order_release);
+
+      char time[32];
+      for (uint32_t tick = 0; tick < kTicks; ++tick) {
+        snprintf(time, sizeof(time), "%u", tick);
+        const uint64_t start = now_ns();
+        api_server_set_text(server, time, "Wednesday, 14 October 2026");
+        flushed[tick].store(start, std::memory_order_release);
+        api_server_flush(server);
+        api_socket_send(transport, server);
+        flush_ns += now_ns() - start;
+        while (now_ns() - start < kTickIntervalNs) api_socket_poll(transport, server, 0);
+      }
+      while (!done.load(std::memory_order_acquire) && (now_ns() < deadline + 10'000'000'000ull)) api_socket_poll(transport, server, 1);
+    });
+
+    struct SocketClient {
+      int socket = -1;
+      std::vector<uint8_t> input;
+      uint32_t next_tick = 0; // @NOTE: the ticks before it were received or skipped
+      uint32_t received = 0;
+    };
+    std::vector<SocketClient> clients(client_count);
+    std::vector<pollfd> polled(client_count);
+    sockaddr_un address = { };
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+    std::vector<uint8_t> subscribe;
+    api_encode_subscribe(subscribe, kApiTopicText);
+    for (uint32_t i = 0; i < client_count; ++i) {
+      SocketClient& client = clients[i];
+      client.socket = socket(AF_UNIX, SOCK_STREAM, 0);
+      check((client.socket >= 0) && (connect(client.socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0), "cannot connect to the API socket");
+      check(send(client.socket, subscribe.data(), subscribe.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(subscribe.size()), "cannot subscribe");
+      fcntl(client.socket, F_SETFL, fcntl(client.socket, F_GETFL, 0) | O_NONBLOCK);
+      polled[i] = pollfd{.fd = client.socket, .events = POLLIN, .revents = 0};
+    }
+
+    std::vector<uint64_t> latencies;
+    latencies.reserve(static_cast<size_t>(client_count) * kTicks);
+    uint32_t finished = 0;
+    uint64_t skipped = 0;
+    const uint64_t deadline = now_ns() + 30'000'000'000ull;
+    uint8_t buffer[65536];
+    while ((finished < client_count) && (now_ns() < deadline)) {
+      if (poll(polled.data(), polled.size(), 10) <= 0) continue;
+      for (uint32_t i = 0; i < client_count; ++i) {
+        if (!(polled[i].revents & POLLIN)) continue;
+        SocketClient& client = clients[i];
+        for (ssize_t received; (received = recv(client.socket, buffer, sizeof(buffer), 0)) > 0;) client.input.insert(client.input.end(), buffer, buffer + received);
+
+        size_t at = 0;
+        ApiFrame frame;
+        while (api_parse_frame(client.input.data() + at, client.input.size() - at, frame) == ApiParse::Complete) {
+          at += kApiFrameHeader + frame.size;
+          std::string time, date;
+          if (!api_decode_text(frame, time, date)) continue;
+
+          const uint32_t tick = static_cast<uint32_t>(strtoul(time.c_str(), nullptr, 10));
+          check((tick >= client.next_tick) && (tick < kTicks), "a client got the ticks out of order");
+          latencies.push_back(now_ns() - flushed[tick].load(std::memory_order_acquire));
+          skipped += tick - client.next_tick;
+          client.next_tick = tick + 1;
+          client.received++;
+          if (tick == kTicks - 1) finished++;
+        }
+        client.input.erase(client.input.begin(), client.input.begin() + static_cast<ptrdiff_t>(at));
+      }
+    }
+    done.store(true, std::memory_order_release);
+    server_thread.join();
+    for (SocketClient& client : clients) close(client.socket);
+    api_socket_close(transport, server);
+
+    check(subscribed.load() == client_count, "not every client subscribed");
+    check(finished == client_count, "not every client got the last tick");
+    check((server.stats.malformed == 0) && (server.stats.encoded == kTicks), "the text was not encoded once per tick");
+
+    const double deliveries = static_cast<double>(latencies.size());
+    report("clock_api_sockets", "clients", client_count);
+    report("clock_api_sockets", "ticks", kTicks);
+    report("clock_api_sockets", "fanout_p50_us", percentile(latencies, 0.50) / 1000.0);
+    report("clock_api_sockets", "fanout_p99_us", percentile(latencies, 0.99) / 1000.0);
+    report("clock_api_sockets", "fanout_max_us", percentile(latencies, 1.0) / 1000.0);
+    report("clock_api_sockets", "flush_us_per_tick", static_cast<double>(flush_ns) / kTicks / 1000.0);
+    report("clock_api_sockets", "delivered_ratio", deliveries / (static_cast<double>(client_count) * kTicks));
+    report("clock_api_sockets", "skipped_updates", static_cast<double>(skipped));
+    report("clock_api_sockets", "coalesced", static_cast<double>(server.stats.coalesced));
+    report("clock_api_sockets", "bytes_encoded_per_tick", static_cast<double>(server.stats.encoded_bytes) / kTicks);
+    report("clock_api_sockets", "bytes_sent_per_tick", static_cast<double>(server.stats.sent_bytes) / kTicks);
+  }
+  #endif
+
+  void bench_clock_api() {
+    if (!selected_group("clock_api")) return;
+
+    // @NOTE: Framing, fed whole and a byte at a time.
+    std::vector<uint8_t> bytes;
+    api_encode_subscribe(bytes, kApiTopicLayout | kApiTopicText);
+    ApiFrame frame;
+    check((api_parse_frame(bytes.data(), bytes.size(), frame) == ApiParse::Complete) && (frame.type == ApiMessage::Subscribe) && (frame.size == 4), "subscribe frame");
+    check(api_parse_frame(bytes.data(), bytes.size() - 1, frame) == ApiParse::Incomplete, "a partial frame parses");
+    const uint8_t huge[kApiFrameHeader] = {0xff, 0xff, 0x00, 0x00, 1};
+    check(api_parse_frame(huge, sizeof(huge), frame) == ApiParse::Malformed, "an oversized frame is accepted");
+
+    ApiServer server;
+    const uint64_t a = api_server_connect(server);
+    const uint64_t b = api_server_connect(server);
+    std::vector<uint8_t> hello = api_take(server, a);
+    uint16_t version = 0;
+    check((api_parse_frame(hello.data(), hello.size(), frame) == ApiParse::Complete) && api_decode_hello(frame, version) && (version == kApiProtocolVersion), "hello");
+    api_take(server, b);
+
+    for (uint8_t byte : bytes) check(api_server_receive(server, a, &byte, 1), "a subscribe sent byte by byte is rejected");
+    check((server.subscribers[0] == 1) && (server.subscribers[1] == 1), "subscribe");
+    check(api_take(server, a).empty(), "state was pushed before there was any");
+
+    const std::vector<ApiClock> layout = {
+      {.identity = 0x5000, .monitor = {0, 0, 1920, 1080}, .corner = Corner::BottomRight, .visible = true},
+      {.identity = 0x5001, .monitor = {1920, -200, 4480, 1240}, .corner = Corner::TopLeft, .visible = false},
+    };
+    api_server_set_layout(server, layout);
+    api_server_set_text(server, "12:34:56", "Mittwoch, 14. Oktober 2026");
+    check(api_server_flush(server) == 2, "flush encodes each changed topic once");
+    bytes = api_take(server, a);
+    check(api_frame_types(bytes) == std::vector<ApiMessage>{ApiMessage::Layout, ApiMessage::Text}, "the subscriber did not get both topics");
+    std::vector<ApiClock> decoded;
+    std::string time, date;
+    check((api_parse_frame(bytes.data(), bytes.size(), frame) == ApiParse::Complete) && api_decode_layout(frame, decoded) && (decoded == layout), "layout round trip");
+    const size_t second = kApiFrameHeader + frame.size;
+    check((api_parse_frame(bytes.data() + second, bytes.size() - second, frame) == ApiParse::Complete) && api_decode_text(frame, time, date) && (time == "12:34:56") && (date == "Mittwoch, 14. Oktober 2026"), "text round trip");
+    check(api_take(server, b).empty(), "an unsubscribed client got state");
+
+    api_server_set_text(server, "12:34:56", "Mittwoch, 14. Oktober 2026");
+    check(api_server_flush(server) == 0, "an unchanged text was pushed again");
+
+    // @NOTE: A late subscriber gets the current state at once, a text-only
+    // one no layout.
+    bytes.clear();
+    api_encode_subscribe(bytes, kApiTopicText);
+    check(api_server_receive(server, b, bytes.data(), bytes.size()), "subscribe");
+    check(api_frame_types(api_take(server, b)) == std::vector<ApiMessage>{ApiMessage::Text}, "a late subscriber did not get the current text");
+
+    // @NOTE: A client that does not take its updates keeps the one that may
+    // be being written and the latest of each topic.
+    const uint64_t encoded = server.stats.encoded;
+    for (int i = 0; i < 10; ++i) {
+      api_server_set_text(server, std::to_string(i), "date");
+      api_server_flush(server);
+    }
+    api_server_set_layout(server, { });
+    api_server_flush(server);
+    check(server.stats.encoded - encoded == 11, "a topic was encoded more than once per flush");
+    check((server.clients.at(a).output.size() == 3) && (server.clients.at(b).output.size() == 2), "a slow client piles up updates");
+    check(server.clients.at(a).output[1].frame == server.clients.at(b).output[1].frame, "subscribers got copies of the frame");
+    bytes = api_take(server, b);
+    const size_t latest = bytes.size() - server.clients.at(a).output[1].frame->size();
+    check((api_parse_frame(bytes.data() + latest, bytes.size() - latest, frame) == ApiParse::Complete) && api_decode_text(frame, time, date) && (time == "9"), "a slow client did not get the latest text");
+
+    // @NOTE: The texts publish_api sends, across a format change between
+    // two publishes and with a format showing zones. The offsets patched
+    // in place belong to the old programs and must not carry over.
+    {
+      const auto ascii = [](const FormattedText& text) { return std::string(text.text, text.text + text.length); };
+      const auto format_of = [](const wchar_t* time, const wchar_t* date) {
+        FrameFormat format;
+        format.names = make_locale_names();
+        format.time = compile_format(time);
+        format.date = compile_format(date);
+        return std::make_shared<const FrameFormat>(std::move(format));
+      };
+      const CivilTime noon = {.year = 2026, .month = 10, .day_of_week = 3, .day = 14, .hour = 12, .minute = 34, .second = 56, .milliseconds = 0};
+      const CivilTime later = {.year = 2026, .month = 10, .day_of_week = 3, .day = 14, .hour = 12, .minute = 34, .second = 57, .milliseconds = 0};
+      const std::shared_ptr<const FrameFormat> first = format_of(L"H:mm:ss", L"d.M.yyyy");
+      const std::shared_ptr<const FrameFormat> second = format_of(L"h:mm tt", L"dddd, MMMM d, yyyy");
+      ApiServer texts_server;
+      const uint64_t client = api_server_connect(texts_server);
+      api_take(texts_server, client);
+      bytes.clear();
+      api_encode_subscribe(bytes, kApiTopicText);
+      api_server_receive(texts_server, client, bytes.data(), bytes.size());
+      FrameTexts texts;
+      frame_texts_render(texts, first, noon, 0);
+      api_server_set_text(texts_server, ascii(texts.time), ascii(texts.date));
+      api_server_flush(texts_server);
+      api_take(texts_server, client);
+      check(frame_texts_render(texts, second, later, 0), "a format change did not change the texts");
+      api_server_set_text(texts_server, ascii(texts.time), ascii(texts.date));
+      api_server_flush(texts_server);
+      bytes = api_take(texts_server, client);
+      const std::wstring time_text = format_picture(L"h:mm tt", second->names, later);
+      const std::wstring date_text = format_picture(L"dddd, MMMM d, yyyy", second->names, later);
+      check((api_parse_frame(bytes.data(), bytes.size(), frame) == ApiParse::Complete) && api_decode_text(frame, time, date) && (time == std::string(time_text.begin(), time_text.end())) && (date == std::string(date_text.begin(), date_text.end())), "the texts after a format change");
+
+      auto tokyo = std::make_shared<TimeZone>(TimeZone{.name = "Asia/Tokyo", .starts = {INT64_MIN}, .types = {0}, .zone_types = {ZoneType{.offset = 9 * 3600}}, .abbreviations = std::string("JST", 4)});
+      FrameFormat zoned = *format_of(L"H:mm", L"d.M.yyyy");
+      zoned.zones = {ZoneClock{.zone = tokyo, .label = L"TYO"}, ZoneClock{.zone = tokyo, .label = L"KIX"}};
+      const std::shared_ptr<const FrameFormat> third = std::make_shared<const FrameFormat>(std::move(zoned));
+      const int64_t utc_ms = unix_seconds_from_civil(later) * 1000;
+      frame_texts_render(texts, third, later, utc_ms);
+      ZoneLine line;
+      FormattedText expected;
+      render_zone_line(third->zones, third->time, third->names, utc_ms, line, expected);
+      check((ascii(texts.date) == ascii(expected)) && (ascii(texts.time) == "12:34"), "a format with zones publishes the zone line");
+    }
+
+    // @NOTE: Overlays, and what gets a client dropped.
+    bytes.clear();
+    api_encode_overlay(bytes, ApiOverlayRequest{.identity = 0x5001, .duration_ms = 5000, .text = "Build failed"});
+    check(api_server_receive(server, b, bytes.data(), bytes.size()) && (server.overlays.size() == 1) && (server.overlays[0].text == "Build failed"), "overlay request");
+    bytes.clear();
+    api_encode_overlay(bytes, ApiOverlayRequest{.text = std::string(kApiMaxOverlayText + 1, 'x')});
+    check(!api_server_receive(server, b, bytes.data(), bytes.size()), "an overlong overlay text is accepted");
+    const uint8_t echo[] = {2, 0, 0, 0, static_cast<uint8_t>(ApiMessage::Hello), 1, 0};
+    check(!api_server_receive(server, a, echo, sizeof(echo)), "a server message from a client is accepted");
+    api_server_disconnect(server, a);
+    api_server_disconnect(server, b);
+    check((server.subscribers[0] == 0) && (server.subscribers[1] == 0) && (server.stats.malformed == 2), "disconnect");
+
+    ApiOverlays overlays;
+    check(api_overlays_apply(overlays, server.overlays[0], 1000) && (api_overlay_for(overlays, 0x5001) != 0) && (api_overlay_for(overlays, 0x5000) == 0), "overlay for one monitor");
+    check(api_overlays_apply(overlays, ApiOverlayRequest{.identity = 0, .duration_ms = 1000, .text = "Stand-up"}, 2000), "overlay for every monitor");
+    const uint16_t everywhere = api_overlay_for(overlays, 0x5000);
+    check((everywhere != 0) && (api_overlay_for(overlays, 0x5001) == everywhere), "the newest overlay does not win");
+    check(api_overlays_next_expiry(overlays) == 3000, "overlay expiry");
+    check(api_overlays_expire(overlays, 3000) && (api_overlay_for(overlays, 0x5000) == 0) && (api_overlay_for(overlays, 0x5001) != 0), "an expired overlay is still shown");
+    check(api_overlays_apply(overlays, ApiOverlayRequest{.identity = 0x5001, .duration_ms = 0, .text = ""}, 3000) && overlays.entries.empty(), "an empty overlay does not clear");
+    for (uint32_t i = 0; i < 70'000; ++i) api_overlays_apply(overlays, ApiOverlayRequest{.duration_ms = 1000, .text = "x"}, 4000);
+    check(overlays.entries.size() == kApiMaxOverlays, "too many overlays are kept");
+    for (const ApiOverlay& overlay : overlays.entries) check(overlay.id != 0, "an overlay got id 0");
+
+    // @NOTE: One new text per flush to every client, everything taken as
+    // a transport would. The encoded bytes do not grow with the clients.
+    for (uint32_t client_count : {1u, 100u, 1000u}) {
+      ApiServer fanout;
+      std::vector<uint64_t> ids;
+      for (uint32_t i = 0; i < client_count; ++i) {
+        ids.push_back(api_server_connect(fanout));
+        bytes.clear();
+        api_encode_subscribe(bytes, kApiTopicLayout | kApiTopicText);
+        api_server_receive(fanout, ids.back(), bytes.data(), bytes.size());
+      }
+      char name[64];
+      snprintf(name, sizeof(name), "clock_api_fanout_%u", client_count);
+      char text[32];
+      run(name, 0, client_count, [&](uint64_t i) {
+        snprintf(text, sizeof(text), "%llu", static_cast<unsigned long long>(i));
+        api_server_set_text(fanout, text, "Wednesday, 14 October 2026");
+        api_server_flush(fanout);
+        for (uint64_t id : ids) {
+          ApiClient& client = fanout.clients.at(id);
+          size_t pending = 0;
+          for (const ApiQueued& queued : client.output) pending += queued.frame->size();
+          api_client_sent(fanout, client, pending - client.sent);
+        }
+      });
+      if (selected(name)) {
+        report(name, "bytes_encoded_per_flush", static_cast<double>(fanout.stats.encoded_bytes) / static_cast<double>(fanout.stats.flushes));
+        report(name, "bytes_sent_per_flush", static_cast<double>(fanout.stats.sent_bytes) / static_cast<double>(fanout.stats.flushes));
+      }
+    }
+
+    #ifndef _WIN32
+    bench_clock_api_sockets();
+    #endif
+  }
+
+  // @NOTE: Every field of a test event follows from its value, so a torn
+  // event shows up as a mismatch. The value is the producer in the high
+  // half and its event number in the low one.
+  TraceName trace_test_name(int64_t value) {
+    return static_cast<TraceName>(static_cast<uint64_t>(value) % static_cast<uint64_t>(TraceName::Count));
+  }
+
+  uint64_t trace_test_timestamp(int64_t value) {
+    return static_cast<uint64_t>(value) * 7 + 11;
+  }
+
+  // Reads a file written by trace_dump.
+  bool read_trace_dump(FILE* file, std::vector<TraceEvent>& events) {
+    events.clear();
+    TraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1) return false;
+    if ((memcmp(header.magic, kTraceMagic, sizeof(kTraceMagic)) != 0) || (header.event_size != sizeof(TraceEvent))) return false;
+    events.resize(header.count);
+    return fread(events.data(), sizeof(TraceEvent), events.size(), file) == events.size();
+  }
+
+  // Checks the events of a dump taken while the producers ran and returns
+  // their number.
+  size_t check_trace_dump(FILE* file, std::vector<TraceEvent>& events, std::vector<int64_t>& last) {
+    rewind(file);
+    check(read_trace_dump(file, events), "trace dump unreadable");
+    std::fill(last.begin(), last.end(), -1);
+    for (const TraceEvent& e : events) {
+      const uint64_t producer = static_cast<uint64_t>(e.value) >> 32;
+      const int64_t number = e.value & 0xffffffff;
+      check((e.kind == TraceEventKind::Counter) && (e.name == trace_test_name(e.value)) && (e.timestamp_ns == trace_test_timestamp(e.value)) && (producer < last.size()), "torn trace event");
+      check(number > last[producer], "trace events out of order");
+      last[producer] = number;
+    }
+    return events.size();
+  }
+
+  void bench_trace() {
+    if (!selected_group("trace")) return;
+
+    {
+      auto buffer = std::make_unique<TraceBuffer>();
+      run("trace_emit", 0, 0, [&](uint64_t i) {
+        trace_emit(*buffer, TraceName::Tick, TraceEventKind::Counter, i, static_cast<int64_t>(i));
+      });
+    }
+
+    // @NOTE: Like TRACE_COUNTER on 8 threads, the buffer wraps about 50
+    // times while it is dumped over and over.
+    if (selected("trace_producers")) {
+      constexpr uint32_t kProducers = 8;
+      constexpr int64_t kEvents = 100'000;
+      auto buffer = std::make_unique<TraceBuffer>();
+      std::atomic<uint32_t> running{kProducers};
+
+      std::vector<std::thread> producers;
+      for (uint32_t p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p] {
+          for (int64_t n = 0; n < kEvents; ++n) {
+            const int64_t value = (static_cast<int64_t>(p) << 32) | n;
+            trace_emit(*buffer, trace_test_name(value), TraceEventKind::Counter, trace_test_timestamp(value), value);
+          }
+          running.fetch_sub(1, std::memory_order_release);
+        });
+      }
+
+      FILE* file = tmpfile();
+      check(file != nullptr, "tmpfile failed");
+      std::vector<TraceEvent> events;
+      std::vector<int64_t> last(kProducers);
+      uint64_t dumps = 0;
+      uint64_t dumped = 0;
+      while (running.load(std::memory_order_acquire) != 0) {
+        rewind(file);
+        check(trace_dump(*buffer, file), "trace_dump failed");
+        dumped += check_trace_dump(file, events, last);
+        dumps++;
+      }
+      for (std::thread& producer : producers) producer.join();
+
+      // @NOTE: With the producers done every slot holds one of the last
+      // kTraceCapacity events, unless a producer that fell a buffer behind
+      // wrote an older one over it.
+      rewind(file);
+      check(trace_dump(*buffer, file), "trace_dump failed");
+      const size_t final_count = check_trace_dump(file, events, last);
+      check(buffer->write_index.load() == kProducers * kEvents, "trace write index");
+      check((final_count > 0) && (final_count <= kTraceCapacity), "trace dump after the producers");
+      fclose(file);
+
+      report("trace_producers", "dumps", static_cast<double>(dumps));
+      report("trace_producers", "events_per_dump", (dumps > 0) ? static_cast<double>(dumped) / static_cast<double>(dumps) : 0.0);
+      report("trace_producers", "final_events", static_cast<double>(final_count));
+      report("trace_producers", "dropped", static_cast<double>(buffer->dropped.load()));
+    }
+
+    // @NOTE: What trace2json does: a dump converted to Chrome trace JSON has
+    // every event with its name, thread, time and duration or value.
+    if (selected("trace_json")) {
+      auto buffer = std::make_unique<TraceBuffer>();
+      constexpr uint64_t kEvents = kTraceCapacity + 100; // @NOTE: wraps, the oldest 100 are gone
+      for (uint64_t i = 0; i < kEvents; ++i) {
+        const TraceEventKind kind = (i % 3 == 0) ? TraceEventKind::Counter : TraceEventKind::Scope;
+        const int64_t value = (kind == TraceEventKind::Counter) ? -static_cast<int64_t>(i) : static_cast<int64_t>(i * 1000 + 7);
+        trace_emit(*buffer, static_cast<TraceName>(i % static_cast<uint64_t>(TraceName::Count)), kind, 1'000'000'000 + i * 1500, value);
+      }
+
+      FILE* dump = tmpfile();
+      FILE* json = tmpfile();
+      check(dump && json, "tmpfile failed");
+      check(trace_dump(*buffer, dump), "trace_dump failed");
+      rewind(dump);
+      check(trace_convert_to_chrome_json(dump, json), "trace conversion failed");
+      rewind(json);
+
+      char line[512];
+      check(fgets(line, sizeof(line), json) && (strcmp(line, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n") == 0), "trace json prologue");
+      const uint32_t thread = trace_thread_id();
+      uint64_t converted = 0;
+      for (uint64_t i = kEvents - kTraceCapacity; i < kEvents; ++i) {
+        check(fgets(line, sizeof(line), json) != nullptr, "trace json ends early");
+        char name[64] = { };
+        char phase = 0;
+        unsigned tid = 0;
+        double ts = 0.0;
+        int consumed = 0;
+        check(sscanf(line, "{\"name\":\"%63[^\"]\",\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%lf,%n", name, &phase, &tid, &ts, &consumed) == 4, "trace json event");
+        const bool counter = (i % 3 == 0);
+        check(strcmp(name, trace_name_string(static_cast<TraceName>(i % static_cast<uint64_t>(TraceName::Count)))) == 0, "trace json name");
+        check((phase == (counter ? 'C' : 'X')) && (tid == thread), "trace json phase or thread");
+        check(std::abs(ts - static_cast<double>(1'000'000'000 + i * 1500) / 1000.0) < 0.001, "trace json timestamp");
+        if (counter) {
+          long long value = 0;
+          check((sscanf(line + consumed, "\"args\":{\"value\":%lld}}", &value) == 1) && (value == -static_cast<long long>(i)), "trace json counter value");
+        } else {
+          double dur = 0.0;
+          check((sscanf(line + consumed, "\"dur\":%lf}", &dur) == 1) && (std::abs(dur - static_cast<double>(i * 1000 + 7) / 1000.0) < 0.001), "trace json duration");
+        }
+        converted++;
+      }
+      check(fgets(line, sizeof(line), json) && (strcmp(line, "]}\n") == 0), "trace json epilogue");
+
+      // @NOTE: Anything but a dump of this version is refused.
+      rewind(dump);
+      check(fputc('X', dump) != EOF, "trace dump write");
+      rewind(dump);
+      rewind(json);
+      check(!trace_convert_to_chrome_json(dump, json), "trace conversion accepted a bad magic");
+      fclose(json);
+      fclose(dump);
+
+      report("trace_json", "events", static_cast<double>(converted));
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) filter = argv[1];
+
+  bench_layout();
+  bench_visibility();
+  bench_window_index();
+  bench_clock_table();
+  bench_surface_cache();
+  bench_monitor_diff();
+  bench_settings();
+  bench_compose();
+  bench_datetime_format();
+  bench_framebuffer();
+  bench_render_queue();
+  bench_clock_face();
+  bench_frame_pacer();
+  bench_backdrop();
+  bench_startup();
+  bench_tick();
+  bench_tick_scheduler();
+  bench_topmost();
+  bench_replay();
+  bench_time_zone();
+  bench_calendar();
+  bench_timer_wheel();
+  bench_system_metrics();
+  bench_text_metrics();
+  bench_power();
+  bench_clock_api();
+  bench_trace();
+  return 0;
+}
@@ -2,6 +2,9 @@
 // This is a pixel/fragment shader. Easiest way to edit is to
 // copy&paste this code to [shadertoy](https://www.shadertoy.com/new)
 // or with vscode shadertoy extension.
+//
+// src/clock_face.cpp evaluates the same functions on the CPU for the
+// analog mode and the tray icon, keep the two in sync.
 
 float sdcircle(vec2 point, float radius) {
   return length(point) - radius;
@@ -0,0 +1,70 @@
+// Replays an event log recorded with `clock.exe --record` (events.bin in
+// the app's temp directory) against the platform-neutral core and prints
+// what the app did, as one JSON object.
+//
+//   replay events.bin
+
+#include "../src/backdrop.cpp"
+#include "../src/clock_core.cpp"
+#include "../src/clock_table.cpp"
+#include "../src/cpu.cpp"
+#include "../src/datetime_format.cpp"
+#include "../src/event_log.cpp"
+#include "../src/monitor_diff.cpp"
+#include "../src/power_state.cpp"
+#include "../src/render_queue.cpp"
+#include "../src/replay.cpp"
+#include "../src/settings.cpp"
+#include "../src/surface_cache.cpp"
+#include "../src/tick_scheduler.cpp"
+#include "../src/time_zone.cpp"
+#include "../src/topmost_guard.cpp"
+#include "../src/window_index.cpp"
+#include <chrono>
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <events.bin>\n", argv[0]);
+    return 1;
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (!in) {
+    fprintf(stderr, "cannot open %s\n", argv[1]);
+    return 1;
+  }
+
+  EventLogReader reader;
+  if (!event_log_open(reader, in)) {
+    fprintf(stderr, "%s is not an event log\n", argv[1]);
+    fclose(in);
+    return 1;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+
+  auto model = std::make_unique<ReplayModel>();
+  Event event;
+  uint64_t rejected = 0;
+  uint64_t last_ms = 0;
+  while (event_log_read(reader, event)) {
+    if (!replay_event(*model, event)) rejected++;
+    last_ms = event.time_ms;
+  }
+  replay_advance(*model, last_ms);
+
+  const double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  fclose(in);
+
+  if (reader.failed) fprintf(stderr, "%s is truncated, replayed what was readable\n", argv[1]);
+
+  const ReplayStats& s = model->stats;
+  printf("{\"events\":%llu,\"rejected\":%llu,\"divergences\":%llu,\"simulated_ms\":%llu,\"wall_ms\":%.3f,\"speedup\":%.1f,", static_cast<unsigned long long>(s.events), static_cast<unsigned long long>(rejected), static_cast<unsigned long long>(s.divergences), static_cast<unsigned long long>(s.simulated_ms), wall_ms, (wall_ms > 0.0) ? static_cast<double>(s.simulated_ms) / wall_ms : 0.0);
+  printf("\"ticks\":%llu,\"expedites\":%llu,\"reconciles\":%llu,", static_cast<unsigned long long>(s.ticks), static_cast<unsigned long long>(s.expedites), static_cast<unsigned long long>(s.reconciles));
+  printf("\"clocks_created\":%llu,\"clocks_updated\":%llu,\"clocks_destroyed\":%llu,", static_cast<unsigned long long>(s.clocks_created), static_cast<unsigned long long>(s.clocks_updated), static_cast<unsigned long long>(s.clocks_destroyed));
+  printf("\"theme_reloads\":%llu,\"locale_reloads\":%llu,\"settings_saves\":%llu,", static_cast<unsigned long long>(s.theme_reloads), static_cast<unsigned long long>(s.locale_reloads), static_cast<unsigned long long>(s.settings_saves));
+  printf("\"window_index_rebuilds\":%llu,\"window_events\":%llu,\"zorder_calls\":%llu,", static_cast<unsigned long long>(s.window_index_rebuilds), static_cast<unsigned long long>(s.window_events), static_cast<unsigned long long>(s.zorder_calls));
+  printf("\"backdrop_samples\":%llu,\"contrast_changes\":%llu,", static_cast<unsigned long long>(s.backdrop_samples), static_cast<unsigned long long>(s.contrast_changes));
+  printf("\"snapshots\":%llu,\"frames\":%llu,\"formats\":%llu,\"text_changes\":%llu,\"rasterizations\":%llu,\"presents\":%llu}\n", static_cast<unsigned long long>(s.snapshots), static_cast<unsigned long long>(s.frames), static_cast<unsigned long long>(s.formats), static_cast<unsigned long long>(s.text_changes), static_cast<unsigned long long>(s.rasterizations), static_cast<unsigned long long>(s.presents));
+  return reader.failed ? 1 : 0;
+}
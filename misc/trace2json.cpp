@@ -0,0 +1,34 @@
+// Converts a trace dump written by a CLOCK_TRACE build (trace.bin in the
+// app's temp directory) to Chrome trace JSON.
+//
+//   trace2json trace.bin trace.json
+
+#define CLOCK_TRACE
+#include "../src/trace.cpp"
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s <trace.bin> <trace.json>\n", argv[0]);
+    return 1;
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (!in) {
+    fprintf(stderr, "cannot open %s\n", argv[1]);
+    return 1;
+  }
+
+  FILE* out = fopen(argv[2], "wb");
+  if (!out) {
+    fprintf(stderr, "cannot open %s\n", argv[2]);
+    fclose(in);
+    return 1;
+  }
+
+  const bool ok = trace_convert_to_chrome_json(in, out);
+  fclose(out);
+  fclose(in);
+
+  if (!ok) fprintf(stderr, "%s is not a valid trace\n", argv[1]);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+#include "alarms.h"
+#include <string.h>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+  constexpr uint32_t kAlarmDayMs = 24 * 60 * 60 * 1000;
+
+  bool alarm_is_space(char ch) {
+    return (ch == ' ') || (ch == '\t') || (ch == '\r');
+  }
+
+  std::string_view alarm_next_word(std::string_view& text) {
+    size_t begin = 0;
+    while ((begin < text.size()) && alarm_is_space(text[begin])) ++begin;
+    size_t end = begin;
+    while ((end < text.size()) && !alarm_is_space(text[end])) ++end;
+    const std::string_view word = text.substr(begin, end - begin);
+    text.remove_prefix(end);
+    return word;
+  }
+
+  // "07:30" or "07:30:15".
+  bool alarm_parse_time_of_day(std::string_view word, uint32_t& seconds) {
+    uint32_t parts[3] = { };
+    uint32_t count = 0;
+    uint32_t digits = 0;
+    for (char ch : word) {
+      if ((ch >= '0') && (ch <= '9') && (digits < 2)) {
+        parts[count] = parts[count] * 10 + static_cast<uint32_t>(ch - '0');
+        digits++;
+      } else if ((ch == ':') && (digits > 0) && (count < 2)) {
+        count++;
+        digits = 0;
+      } else {
+        return false;
+      }
+    }
+    if ((digits == 0) || (count == 0) || (parts[0] > 23) || (parts[1] > 59) || (parts[2] > 59)) return false;
+    seconds = (parts[0] * 60 + parts[1]) * 60 + parts[2];
+    return true;
+  }
+
+  // "90s", "25m", "1h30m".
+  bool alarm_parse_duration(std::string_view word, uint32_t& seconds) {
+    uint64_t total = 0;
+    uint64_t number = 0;
+    bool digits = false;
+    for (char ch : word) {
+      if ((ch >= '0') && (ch <= '9')) {
+        number = number * 10 + static_cast<uint64_t>(ch - '0');
+        digits = true;
+        if (number > kAlarmDayMs) return false;
+        continue;
+      }
+      if (!digits) return false;
+      if (ch == 's') total += number;
+      else if (ch == 'm') total += number * 60;
+      else if (ch == 'h') total += number * 3600;
+      else return false;
+      number = 0;
+      digits = false;
+    }
+    if (digits || (total == 0) || (total > UINT32_MAX / 1000)) return false;
+    seconds = static_cast<uint32_t>(total);
+    return true;
+  }
+
+  uint64_t alarm_first_deadline(const AlarmEntry& entry, uint64_t now_ms, CivilTime now) {
+    if (entry.kind == AlarmKind::At) return now_ms + ms_until_time_of_day(now, entry.seconds);
+    return now_ms + static_cast<uint64_t>(entry.seconds) * 1000;
+  }
+
+  std::string alarm_key(const AlarmEntry& entry) {
+    return std::to_string(static_cast<uint32_t>(entry.kind)) + ' ' + std::to_string(entry.seconds) + ' ' + std::to_string(entry.monitor) + ' ' + entry.label;
+  }
+}
+
+std::vector<AlarmEntry> parse_alarm_config(const char* text, size_t length) {
+  std::vector<AlarmEntry> entries;
+  const char* end = text + length;
+  for (const char* p = text; p < end;) {
+    const char* line_end = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+    if (!line_end) line_end = end;
+    const char* comment = static_cast<const char*>(memchr(p, '#', static_cast<size_t>(line_end - p)));
+    std::string_view line(p, static_cast<size_t>((comment ? comment : line_end) - p));
+    p = line_end + 1;
+
+    AlarmEntry entry;
+    const std::string_view kind = alarm_next_word(line);
+    const std::string_view when = alarm_next_word(line);
+    bool ok = false;
+    if (kind == "at") {
+      entry.kind = AlarmKind::At;
+      ok = alarm_parse_time_of_day(when, entry.seconds);
+    } else if ((kind == "in") || (kind == "every")) {
+      entry.kind = (kind == "in") ? AlarmKind::In : AlarmKind::Every;
+      ok = alarm_parse_duration(when, entry.seconds);
+    }
+    if (!ok) continue;
+
+    std::string_view rest = line;
+    if (const std::string_view word = alarm_next_word(rest); (word.size() > 1) && (word.size() <= 4) && (word[0] == '@')) {
+      uint32_t monitor = 0;
+      for (char ch : word.substr(1)) monitor = ((ch >= '0') && (ch <= '9')) ? monitor * 10 + static_cast<uint32_t>(ch - '0') : UINT32_MAX;
+      if ((monitor > 0) && (monitor < 1000)) {
+        entry.monitor = monitor;
+        line = rest;
+      }
+    }
+    while (!line.empty() && alarm_is_space(line.front())) line.remove_prefix(1);
+    while (!line.empty() && alarm_is_space(line.back())) line.remove_suffix(1);
+    entry.label = line.empty() ? std::string(when) : std::string(line);
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+uint32_t ms_until_time_of_day(CivilTime now, uint32_t seconds) {
+  const int64_t now_ms = ((static_cast<int64_t>(now.hour) * 60 + now.minute) * 60 + now.second) * 1000 + now.milliseconds;
+  int64_t delta = static_cast<int64_t>(seconds) * 1000 - now_ms;
+  if (delta <= 0) delta += kAlarmDayMs;
+  return static_cast<uint32_t>(delta);
+}
+
+void alarms_init(Alarms& alarms, uint64_t now_ms) {
+  alarms = { };
+  timer_wheel_init(alarms.wheel, now_ms);
+}
+
+void alarms_configure(Alarms& alarms, std::vector<AlarmEntry> entries, uint64_t now_ms, CivilTime now) {
+  std::unordered_map<std::string, std::vector<uint32_t>> previous;
+  for (uint32_t i = 0; i < alarms.entries.size(); ++i) previous[alarm_key(alarms.entries[i])].push_back(i);
+
+  // @NOTE: The payload is the index, so kept timers are moved to their new
+  // index; cancelling and scheduling again are both O(1).
+  std::vector<TimerId> timers(entries.size(), 0);
+  std::vector<uint8_t> kept(alarms.entries.size(), 0);
+  for (uint32_t i = 0; i < entries.size(); ++i) {
+    auto it = previous.find(alarm_key(entries[i]));
+    if ((it != previous.end()) && !it->second.empty()) {
+      const uint32_t old = it->second.back();
+      it->second.pop_back();
+      kept[old] = 1;
+      const uint64_t deadline = timer_wheel_deadline(alarms.wheel, alarms.timers[old]);
+      timer_wheel_cancel(alarms.wheel, alarms.timers[old]);
+      if (deadline != UINT64_MAX) timers[i] = timer_wheel_schedule(alarms.wheel, deadline, i);
+      continue;
+    }
+    timers[i] = timer_wheel_schedule(alarms.wheel, alarm_first_deadline(entries[i], now_ms, now), i);
+  }
+  for (uint32_t i = 0; i < alarms.entries.size(); ++i) {
+    if (!kept[i]) timer_wheel_cancel(alarms.wheel, alarms.timers[i]);
+  }
+
+  alarms.entries = std::move(entries);
+  alarms.timers = std::move(timers);
+}
+
+void alarms_retime(Alarms& alarms, uint64_t now_ms, CivilTime now) {
+  for (uint32_t i = 0; i < alarms.entries.size(); ++i) {
+    if (alarms.entries[i].kind != AlarmKind::At) continue;
+
+    timer_wheel_cancel(alarms.wheel, alarms.timers[i]);
+    alarms.timers[i] = timer_wheel_schedule(alarms.wheel, alarm_first_deadline(alarms.entries[i], now_ms, now), i);
+  }
+}
+
+bool alarms_advance(Alarms& alarms, uint64_t now_ms, CivilTime now, std::vector<uint32_t>& fired) {
+  bool changed = false;
+  alarms.expired.clear();
+  timer_wheel_advance(alarms.wheel, now_ms, alarms.expired);
+  for (const TimerExpiry& expiry : alarms.expired) {
+    if (expiry.payload & kAlarmAlertEnd) {
+      std::erase_if(alarms.alerts, [&](const AlarmAlert& alert) { return alert.end == expiry.id; });
+      changed = true;
+      continue;
+    }
+
+    const uint32_t index = static_cast<uint32_t>(expiry.payload);
+    const AlarmEntry& entry = alarms.entries[index];
+    alarms.timers[index] = 0;
+    bool fire = true;
+    if (entry.kind == AlarmKind::At) {
+      // @NOTE: The deadline is monotonic, the wall clock decides. Woken
+      // early, e.g. by a DST change, it only reschedules; far too late it
+      // skips this day.
+      const uint32_t until = ms_until_time_of_day(now, entry.seconds);
+      fire = until >= kAlarmDayMs - kAlarmLateMs;
+      alarms.timers[index] = timer_wheel_schedule(alarms.wheel, now_ms + until, index);
+    } else if (entry.kind == AlarmKind::Every) {
+      // @NOTE: Stays on its own grid, periods missed while asleep fire once.
+      const uint64_t period = static_cast<uint64_t>(entry.seconds) * 1000;
+      const uint64_t next = expiry.deadline_ms + period;
+      alarms.timers[index] = timer_wheel_schedule(alarms.wheel, (next > now_ms) ? next : now_ms + period - (now_ms - expiry.deadline_ms) % period, index);
+    }
+    if (!fire) continue;
+
+    fired.push_back(index);
+    alarms.alerts.push_back(AlarmAlert{.monitor = entry.monitor, .end = timer_wheel_schedule(alarms.wheel, now_ms + kAlarmAlertMs, kAlarmAlertEnd | index)});
+    changed = true;
+  }
+  return changed;
+}
+
+bool alarms_dismiss(Alarms& alarms) {
+  for (const AlarmAlert& alert : alarms.alerts) timer_wheel_cancel(alarms.wheel, alert.end);
+  const bool had = !alarms.alerts.empty();
+  alarms.alerts.clear();
+  return had;
+}
+
+bool alarms_alerting(const Alarms& alarms, uint32_t monitor) {
+  for (const AlarmAlert& alert : alarms.alerts) {
+    if ((alert.monitor == 0) || (alert.monitor == monitor)) return true;
+  }
+  return false;
+}
+
+uint64_t alarms_next_deadline(const Alarms& alarms) {
+  return timer_wheel_next_deadline(alarms.wheel);
+}
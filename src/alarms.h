@@ -0,0 +1,82 @@
+#pragma once
+
+#include "base.h"
+#include "timer_wheel.h"
+#include <string>
+#include <vector>
+
+// Alarms, countdowns and reminders from alarms.txt. One per line, '#'
+// starts a comment, durations are a number with s, m or h:
+//
+//   at 07:30 Stand-up       every day at 07:30 local time
+//   in 25m Tea              once, 25 minutes after the line showed up
+//   every 45m Stretch       every 45 minutes after the line showed up
+//   at 12:00 @2 Lunch       only on the second monitor
+//
+// When one goes off the clocks it applies to are recolored for
+// kAlarmAlertMs. Every pending alarm and the end of every alert is a timer
+// in one TimerWheel, the app only wakes up for the wheel's next deadline,
+// so however many alarms are set, none costs anything until it is due.
+
+constexpr uint32_t kAlarmAlertMs = 30'000;
+constexpr uint32_t kAlarmLateMs = 60 * 60 * 1000; // @NOTE: a daily alarm missed by more, e.g. while asleep, is skipped
+constexpr uint64_t kAlarmAlertEnd = 1ull << 63; // @NOTE: timer payload flag, the rest is the alarm
+
+enum class AlarmKind : uint8_t {
+  At,
+  In,
+  Every,
+};
+
+struct AlarmEntry {
+  AlarmKind kind = AlarmKind::At;
+  uint32_t seconds = 0; // @NOTE: At: since midnight, In and Every: the duration
+  uint32_t monitor = 0; // @NOTE: 1-based in monitor order, 0 = every monitor
+  std::string label; // @NOTE: UTF-8
+};
+
+inline bool operator ==(const AlarmEntry& lhs, const AlarmEntry& rhs) {
+  return (lhs.kind == rhs.kind) && (lhs.seconds == rhs.seconds) && (lhs.monitor == rhs.monitor) && (lhs.label == rhs.label);
+}
+
+std::vector<AlarmEntry> parse_alarm_config(const char* text, size_t length);
+
+struct AlarmAlert {
+  uint32_t monitor = 0; // @NOTE: see AlarmEntry::monitor
+  TimerId end = 0;
+};
+
+struct Alarms {
+  TimerWheel wheel;
+  std::vector<AlarmEntry> entries;
+  std::vector<TimerId> timers; // @NOTE: parallel to `entries`, 0 once a countdown went off
+  std::vector<AlarmAlert> alerts;
+  std::vector<TimerExpiry> expired; // @NOTE: scratch
+};
+
+void alarms_init(Alarms& alarms, uint64_t now_ms);
+
+// Replaces the alarms with `entries`. Lines that did not change keep their
+// timer, so editing the file does not restart the countdowns in it.
+void alarms_configure(Alarms& alarms, std::vector<AlarmEntry> entries, uint64_t now_ms, CivilTime now);
+
+// Reschedules the daily alarms after the wall clock or the time zone
+// changed.
+void alarms_retime(Alarms& alarms, uint64_t now_ms, CivilTime now);
+
+// Runs everything due at `now_ms`. Appends the alarms that went off to
+// `fired`, returns true if the set of alerts changed.
+bool alarms_advance(Alarms& alarms, uint64_t now_ms, CivilTime now, std::vector<uint32_t>& fired);
+
+// Ends every alert, returns true if there was one.
+bool alarms_dismiss(Alarms& alarms);
+
+// True if monitor `monitor` (1-based) is alerting.
+bool alarms_alerting(const Alarms& alarms, uint32_t monitor);
+
+// Monotonic time of the next wakeup, UINT64_MAX with nothing pending.
+uint64_t alarms_next_deadline(const Alarms& alarms);
+
+// Milliseconds from `now` until the next `seconds` past midnight, in
+// (0, 24 h].
+uint32_t ms_until_time_of_day(CivilTime now, uint32_t seconds);
@@ -0,0 +1,276 @@
+#include "backdrop.h"
+#include "cpu.h"
+#include <math.h>
+
+namespace {
+  constexpr uint32_t kColorMask = 0x00ffffff;
+  constexpr uint32_t kHashSeed = 0x9e3779b9;
+  constexpr int kHashLanes = 8; // @NOTE: pixel x goes to lane x % 8, whatever the kernel
+
+  // @NOTE: Rec. 709 in 8.8 fixed point, the weights add up to 256 so that
+  // white stays 255.
+  constexpr uint32_t kLumaB = 19;
+  constexpr uint32_t kLumaG = 183;
+  constexpr uint32_t kLumaR = 54;
+
+  // @NOTE: Pixels summed in 32-bit lanes before they are flushed, small
+  // enough that a lane of squares cannot overflow.
+  constexpr int kLumaChunk = 8192;
+
+  // @NOTE: Hysteresis, in luma. Between the two the text keeps its color.
+  constexpr int kDarkTextAbove = 160;
+  constexpr int kLightTextBelow = 96;
+  constexpr int kFirstDarkText = 128;
+
+  // @NOTE: A shadow when the text is this close to the mean luma or the
+  // backdrop is this busy, removed again only well past both.
+  constexpr int kShadowDistanceOn = 112;
+  constexpr int kShadowDistanceOff = 128;
+  constexpr int kShadowDeviationOn = 56;
+  constexpr int kShadowDeviationOff = 40;
+
+  uint32_t rotl(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+  }
+
+  // @NOTE: Add, rotate, xor: invertible for a fixed pixel and not linear, so
+  // recolouring a region does not cancel out.
+  uint32_t hash_step(uint32_t lane, uint32_t pixel) {
+    return rotl(lane + pixel, 13) ^ pixel;
+  }
+
+  uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  void init_lanes(uint32_t* lanes) {
+    for (int i = 0; i < kHashLanes; ++i) lanes[i] = kHashSeed * static_cast<uint32_t>(i + 1);
+  }
+
+  uint64_t finish_hash(const uint32_t* lanes, PixelView view) {
+    uint64_t h = mix64((static_cast<uint64_t>(static_cast<uint32_t>(view.width)) << 32) | static_cast<uint32_t>(view.height));
+    for (int i = 0; i < kHashLanes; ++i) h = mix64(h ^ lanes[i]);
+    return h;
+  }
+
+  void hash_tail(uint32_t* lanes, const uint32_t* row, int begin, int end) {
+    for (int x = begin; x < end; ++x) lanes[x % kHashLanes] = hash_step(lanes[x % kHashLanes], row[x] & kColorMask);
+  }
+
+  uint32_t luma(uint32_t pixel) {
+    const uint32_t b = pixel & 0xff;
+    const uint32_t g = (pixel >> 8) & 0xff;
+    const uint32_t r = (pixel >> 16) & 0xff;
+    return (kLumaB * b + kLumaG * g + kLumaR * r + 128) >> 8;
+  }
+
+  void luma_tail(LumaStats& stats, const uint32_t* row, int begin, int end) {
+    for (int x = begin; x < end; ++x) {
+      const uint64_t y = luma(row[x]);
+      stats.sum += y;
+      stats.sum_squares += y * y;
+    }
+  }
+
+  #if CPU_X86
+  __m128i rotl13_sse2(__m128i x) {
+    return _mm_or_si128(_mm_slli_epi32(x, 13), _mm_srli_epi32(x, 19));
+  }
+
+  // @NOTE: Two vectors, lanes 0-3 and 4-7.
+  int hash_row_sse2(uint32_t* lanes, const uint32_t* row, int width) {
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(kColorMask));
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes + 4));
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+      const __m128i a = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x)), mask);
+      const __m128i b = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x + 4)), mask);
+      lo = _mm_xor_si128(rotl13_sse2(_mm_add_epi32(lo, a)), a);
+      hi = _mm_xor_si128(rotl13_sse2(_mm_add_epi32(hi, b)), b);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes + 4), hi);
+    return x;
+  }
+
+  CPU_TARGET_AVX2 int hash_row_avx2(uint32_t* lanes, const uint32_t* row, int width) {
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>(kColorMask));
+    __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes));
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+      const __m256i p = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x)), mask);
+      const __m256i t = _mm256_add_epi32(h, p);
+      h = _mm256_xor_si256(_mm256_or_si256(_mm256_slli_epi32(t, 13), _mm256_srli_epi32(t, 19)), p);
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), h);
+    return x;
+  }
+
+  uint64_t horizontal_sum_sse2(__m128i v) {
+    uint32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), v);
+    return static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+  }
+
+  // @NOTE: 4 pixels widened to 16 bits, multiplied with the weights in
+  // pairs (b*wb + g*wg, r*wr + 0) and the pairs added back per pixel.
+  int luma_row_sse2(LumaStats& stats, const uint32_t* row, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    const short b = static_cast<short>(kLumaB), g = static_cast<short>(kLumaG), r = static_cast<short>(kLumaR);
+    const __m128i weights = _mm_setr_epi16(b, g, r, 0, b, g, r, 0);
+    const __m128i round = _mm_set1_epi32(128);
+
+    int x = 0;
+    while (x + 4 <= width) {
+      const int end = (width - x > kLumaChunk) ? x + kLumaChunk : width;
+      __m128i sum = zero;
+      __m128i squares = zero;
+      for (; x + 4 <= end; x += 4) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        const __m128 lo = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(p, zero), weights));
+        const __m128 hi = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(p, zero), weights));
+        const __m128i bg = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128i red = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+        const __m128i y = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bg, red), round), 8);
+        sum = _mm_add_epi32(sum, y);
+        squares = _mm_add_epi32(squares, _mm_madd_epi16(y, y)); // @NOTE: the high halves are 0
+      }
+      stats.sum += horizontal_sum_sse2(sum);
+      stats.sum_squares += horizontal_sum_sse2(squares);
+    }
+    return x;
+  }
+
+  CPU_TARGET_AVX2 uint64_t horizontal_sum_avx2(__m256i v) {
+    return horizontal_sum_sse2(_mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+  }
+
+  // @NOTE: Same as SSE2, the unpacks and shuffles stay within 128-bit
+  // halves which is fine as only the sums are kept.
+  CPU_TARGET_AVX2 int luma_row_avx2(LumaStats& stats, const uint32_t* row, int width) {
+    const __m256i zero = _mm256_setzero_si256();
+    const short b = static_cast<short>(kLumaB), g = static_cast<short>(kLumaG), r = static_cast<short>(kLumaR);
+    const __m256i weights = _mm256_setr_epi16(b, g, r, 0, b, g, r, 0, b, g, r, 0, b, g, r, 0);
+    const __m256i round = _mm256_set1_epi32(128);
+
+    int x = 0;
+    while (x + 8 <= width) {
+      const int end = (width - x > kLumaChunk) ? x + kLumaChunk : width;
+      __m256i sum = zero;
+      __m256i squares = zero;
+      for (; x + 8 <= end; x += 8) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+        const __m256 lo = _mm256_castsi256_ps(_mm256_madd_epi16(_mm256_unpacklo_epi8(p, zero), weights));
+        const __m256 hi = _mm256_castsi256_ps(_mm256_madd_epi16(_mm256_unpackhi_epi8(p, zero), weights));
+        const __m256i bg = _mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m256i red = _mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+        const __m256i y = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(bg, red), round), 8);
+        sum = _mm256_add_epi32(sum, y);
+        squares = _mm256_add_epi32(squares, _mm256_madd_epi16(y, y));
+      }
+      stats.sum += horizontal_sum_avx2(sum);
+      stats.sum_squares += horizontal_sum_avx2(squares);
+    }
+    return x;
+  }
+  #endif
+
+  bool wants_shadow(bool shadow, bool dark_text, int mean, int deviation) {
+    const int distance = dark_text ? mean : 255 - mean;
+    if ((distance < kShadowDistanceOn) || (deviation > kShadowDeviationOn)) return true;
+    if ((distance >= kShadowDistanceOff) && (deviation <= kShadowDeviationOff)) return false;
+    return shadow;
+  }
+}
+
+BackdropKernel best_backdrop_kernel() {
+  #if CPU_X86
+  static const BackdropKernel kernel = cpu_has_avx2() ? BackdropKernel::Avx2 : BackdropKernel::Sse2;
+  return kernel;
+  #else
+  return BackdropKernel::Scalar;
+  #endif
+}
+
+const char* backdrop_kernel_name(BackdropKernel kernel) {
+  switch (kernel) {
+    case BackdropKernel::Scalar: return "scalar";
+    case BackdropKernel::Sse2: return "sse2";
+    case BackdropKernel::Avx2: return "avx2";
+  }
+  return "unknown";
+}
+
+uint64_t backdrop_hash(PixelView view, BackdropKernel kernel) {
+  uint32_t lanes[kHashLanes];
+  init_lanes(lanes);
+
+  for (int y = 0; y < view.height; ++y) {
+    const uint32_t* row = view.pixels + static_cast<ptrdiff_t>(y) * view.stride;
+    int done = 0;
+    #if CPU_X86
+    if (kernel == BackdropKernel::Avx2) done = hash_row_avx2(lanes, row, view.width);
+    else if (kernel == BackdropKernel::Sse2) done = hash_row_sse2(lanes, row, view.width);
+    #endif
+    hash_tail(lanes, row, done, view.width);
+  }
+  return finish_hash(lanes, view);
+}
+
+LumaStats backdrop_luma(PixelView view, BackdropKernel kernel) {
+  LumaStats stats = {.count = static_cast<uint64_t>(view.width > 0 ? view.width : 0) * static_cast<uint64_t>(view.height > 0 ? view.height : 0)};
+
+  for (int y = 0; y < view.height; ++y) {
+    const uint32_t* row = view.pixels + static_cast<ptrdiff_t>(y) * view.stride;
+    int done = 0;
+    #if CPU_X86
+    if (kernel == BackdropKernel::Avx2) done = luma_row_avx2(stats, row, view.width);
+    else if (kernel == BackdropKernel::Sse2) done = luma_row_sse2(stats, row, view.width);
+    #endif
+    luma_tail(stats, row, done, view.width);
+  }
+  return stats;
+}
+
+BackdropSample make_backdrop_sample(uint64_t hash, LumaStats stats) {
+  if (stats.count == 0) return BackdropSample{.hash = hash};
+
+  const double mean = static_cast<double>(stats.sum) / static_cast<double>(stats.count);
+  const double variance = static_cast<double>(stats.sum_squares) / static_cast<double>(stats.count) - mean * mean;
+  const double deviation = (variance > 0.0) ? sqrt(variance) : 0.0;
+  return BackdropSample{
+    .hash = hash,
+    .mean = static_cast<uint8_t>(mean + 0.5),
+    .deviation = static_cast<uint8_t>((deviation < 255.0) ? deviation + 0.5 : 255.0),
+  };
+}
+
+bool backdrop_changed(const BackdropContrast& contrast, uint64_t hash) {
+  return !contrast.sampled || (contrast.hash != hash);
+}
+
+bool backdrop_update(BackdropContrast& contrast, BackdropSample sample) {
+  const BackdropContrast previous = contrast;
+  const int mean = sample.mean;
+
+  if (!contrast.sampled) contrast.dark_text = mean >= kFirstDarkText;
+  else if (contrast.dark_text && (mean < kLightTextBelow)) contrast.dark_text = false;
+  else if (!contrast.dark_text && (mean > kDarkTextAbove)) contrast.dark_text = true;
+
+  contrast.shadow = wants_shadow(contrast.sampled && contrast.shadow, contrast.dark_text, mean, sample.deviation);
+  contrast.hash = sample.hash;
+  contrast.sampled = true;
+  return !previous.sampled || (previous.dark_text != contrast.dark_text) || (previous.shadow != contrast.shadow);
+}
+
+TextContrast text_contrast_for(const BackdropContrast& contrast, bool adaptive, bool light_theme) {
+  if (!adaptive || !contrast.sampled) return TextContrast{.dark_text = light_theme, .shadow = false};
+  return TextContrast{.dark_text = contrast.dark_text, .shadow = contrast.shadow};
+}
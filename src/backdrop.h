@@ -0,0 +1,72 @@
+#pragma once
+
+#include "base.h"
+
+// Picks the text color of each clock from the desktop pixels behind it
+// instead of only from the theme. The pixels under a clock are captured at
+// a low rate (kBackdropSampleMs); a cheap hash tells whether they changed
+// since the previous capture, and only then are their luminance statistics
+// measured and the decision revisited.
+//
+// The decision has hysteresis: the text flips to dark only well above mid
+// gray and back to light only well below it, so a backdrop that hovers
+// around the middle, e.g. a video or a slideshow, does not make the clock
+// flicker. Busy or mid-gray backdrops also get a shadow under the text.
+//
+// The hash and luminance kernels have a scalar reference and SSE2/AVX2
+// versions that process 4/8 pixels at a time and return the same results.
+
+constexpr uint32_t kBackdropSampleMs = 2000;
+
+enum class BackdropKernel : uint8_t {
+  Scalar,
+  Sse2,
+  Avx2,
+};
+
+BackdropKernel best_backdrop_kernel();
+const char* backdrop_kernel_name(BackdropKernel kernel);
+
+// Hash of the BGR bytes of the view, the X/alpha byte is ignored.
+uint64_t backdrop_hash(PixelView view, BackdropKernel kernel);
+
+// Luma is Rec. 709, 0-255 per pixel, rounded the same way by every kernel.
+struct LumaStats {
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t sum_squares = 0;
+};
+
+LumaStats backdrop_luma(PixelView view, BackdropKernel kernel);
+
+struct BackdropSample {
+  uint64_t hash = 0;
+  uint8_t mean = 0; // @NOTE: luma
+  uint8_t deviation = 0; // @NOTE: standard deviation of the luma
+};
+
+BackdropSample make_backdrop_sample(uint64_t hash, LumaStats stats);
+
+// Per clock decision state.
+struct BackdropContrast {
+  uint64_t hash = 0; // @NOTE: of the latest sample
+  bool sampled = false;
+  bool dark_text = false;
+  bool shadow = false;
+};
+
+// True if `hash` differs from the latest sample, i.e. the luma is worth
+// measuring.
+bool backdrop_changed(const BackdropContrast& contrast, uint64_t hash);
+
+// Applies a sample. Returns true if the text color or the shadow changed.
+bool backdrop_update(BackdropContrast& contrast, BackdropSample sample);
+
+struct TextContrast {
+  bool dark_text = false;
+  bool shadow = false;
+};
+
+// What a clock draws with. Without `adaptive`, or before the first sample,
+// dark text on the light theme and no shadow.
+TextContrast text_contrast_for(const BackdropContrast& contrast, bool adaptive, bool light_theme);
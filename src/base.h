@@ -0,0 +1,83 @@
+#pragma once
+
+// Platform-neutral basic types. Nothing in here may depend on windows.h so
+// that the pure parts of the app can be built and profiled elsewhere.
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Int2 { int x, y; };
+
+struct Float2 { float x, y; };
+
+struct Rect { int left, top, right, bottom; };
+
+inline bool operator ==(Rect lhs, Rect rhs) { return (lhs.left == rhs.left) && (lhs.top == rhs.top) && (lhs.right == rhs.right) && (lhs.bottom == rhs.bottom); }
+inline bool operator !=(Rect lhs, Rect rhs) { return !(lhs == rhs); }
+
+inline Rect make_rect(Int2 position, Int2 size) { return {position.x, position.y, position.x + size.x, position.y + size.y}; }
+inline bool is_empty(Rect r) { return (r.left >= r.right) || (r.top >= r.bottom); }
+
+// @NOTE: Union of two rectangles, empty ones are ignored.
+inline Rect union_rect(Rect a, Rect b) {
+  if (is_empty(a)) return b;
+  if (is_empty(b)) return a;
+  return {a.left < b.left ? a.left : b.left, a.top < b.top ? a.top : b.top, a.right > b.right ? a.right : b.right, a.bottom > b.bottom ? a.bottom : b.bottom};
+}
+
+inline Rect intersect_rect(Rect a, Rect b) {
+  Rect r = {a.left > b.left ? a.left : b.left, a.top > b.top ? a.top : b.top, a.right < b.right ? a.right : b.right, a.bottom < b.bottom ? a.bottom : b.bottom};
+  return is_empty(r) ? Rect{0, 0, 0, 0} : r;
+}
+
+// Premultiplied BGRA pixels, `stride` is in pixels.
+struct PixelView {
+  uint32_t* pixels = nullptr;
+  int width = 0;
+  int height = 0;
+  int stride = 0;
+};
+
+enum Corner : uint8_t {
+  BottomLeft = 0,
+  BottomRight = 1,
+  TopLeft = 2,
+  TopRight = 3,
+};
+
+inline bool is_left(Corner corner) { return (corner == Corner::BottomLeft) || (corner == Corner::TopLeft); }
+inline bool is_right(Corner corner) { return !is_left(corner); }
+
+struct Monitor {
+  uintptr_t handle = 0; // @NOTE: HMONITOR on Windows
+  Int2 position = { };
+  Int2 size = { };
+  Float2 dpi = {1.0f, 1.0f};
+  uint64_t identity = 0; // @NOTE: stable across reconnects and reboots, see monitor_identity
+};
+
+// https://devblogs.microsoft.com/oldnewthing/20070809-00/?p=25643
+inline bool is_primary_monitor(const Monitor& monitor) { return (monitor.position.x == 0) && (monitor.position.y == 0); }
+
+struct RectHash {
+  size_t operator()(Rect r) const {
+    uint64_t h = (static_cast<uint64_t>(static_cast<uint32_t>(r.left)) << 32) | static_cast<uint32_t>(r.top);
+    h ^= ((static_cast<uint64_t>(static_cast<uint32_t>(r.right)) << 32) | static_cast<uint32_t>(r.bottom)) * 0x9e3779b97f4a7c15ull;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 32;
+    return static_cast<size_t>(h);
+  }
+};
+
+// @NOTE: Same field order as SYSTEMTIME.
+struct CivilTime {
+  uint16_t year;
+  uint16_t month; // 1-12
+  uint16_t day_of_week; // 0 = Sunday
+  uint16_t day; // 1-31
+  uint16_t hour;
+  uint16_t minute;
+  uint16_t second;
+  uint16_t milliseconds;
+};
@@ -0,0 +1,621 @@
+#include "calendar.h"
+#include "time_zone.h"
+#include <algorithm>
+#include <bit>
+#include <string.h>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+  constexpr int64_t kDaySeconds = 86400;
+  constexpr uint32_t kCountedWalkLimit = 10000; // @NOTE: longer COUNTs keep no last start
+
+  int64_t ics_floor_div(int64_t a, int64_t b) {
+    return (a / b) - (((a % b) != 0) && ((a < 0) != (b < 0)) ? 1 : 0);
+  }
+
+  // @NOTE: 0 = Monday, like BYDAY counts from MO.
+  uint32_t ics_weekday(int64_t day) {
+    return static_cast<uint32_t>(((day + 3) % 7 + 7) % 7);
+  }
+
+  int64_t ics_days_from_civil(int64_t year, uint32_t month, uint32_t day) {
+    year -= (month <= 2) ? 1 : 0;
+    const int64_t era = ics_floor_div(year, 400);
+    const int64_t year_of_era = year - era * 400;
+    const int64_t day_of_year = (153 * ((month > 2) ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+  }
+
+  uint32_t ics_days_in_month(int64_t year, uint32_t month) {
+    constexpr uint8_t kDays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    const bool leap = ((year % 4 == 0) && (year % 100 != 0)) || (year % 400 == 0);
+    return ((month == 2) && leap) ? 29u : kDays[(month - 1) % 12];
+  }
+
+  // @NOTE: Eight bytes at a time, only has to tell blocks apart.
+  uint64_t ics_hash(const char* data, size_t size) {
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+      uint64_t word;
+      memcpy(&word, data + i, 8);
+      h = std::rotl((h ^ word) * 0xbf58476d1ce4e5b9ull, 31);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, size - i);
+    h = (h ^ tail) * 0x94d049bb133111ebull;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    return h ^ (h >> 32);
+  }
+
+  bool ics_name_is(std::string_view name, std::string_view upper) {
+    if (name.size() != upper.size()) return false;
+    for (size_t i = 0; i < name.size(); ++i) {
+      const char ch = ((name[i] >= 'a') && (name[i] <= 'z')) ? static_cast<char>(name[i] - 'a' + 'A') : name[i];
+      if (ch != upper[i]) return false;
+    }
+    return true;
+  }
+
+  // Next physical line without its line break, advances `p` past it.
+  std::string_view ics_physical_line(const char*& p, const char* end) {
+    const char* begin = p;
+    const char* newline = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+    const char* line_end = newline ? newline : end;
+    p = newline ? newline + 1 : end;
+    if ((line_end > begin) && (line_end[-1] == '\r')) line_end--;
+    return std::string_view(begin, static_cast<size_t>(line_end - begin));
+  }
+
+  // Next content line with folded continuation lines joined. Only copies
+  // into `scratch` when the line actually is folded.
+  std::string_view ics_content_line(const char*& p, const char* end, std::string& scratch) {
+    std::string_view line = ics_physical_line(p, end);
+    if ((p >= end) || ((*p != ' ') && (*p != '\t'))) return line;
+
+    scratch.assign(line);
+    while ((p < end) && ((*p == ' ') || (*p == '\t'))) {
+      const std::string_view continuation = ics_physical_line(p, end);
+      scratch.append(continuation.substr(1));
+    }
+    return scratch;
+  }
+
+  struct IcsProperty {
+    std::string_view name;
+    std::string_view params; // @NOTE: ";VALUE=DATE;TZID=..." or empty
+    std::string_view value;
+  };
+
+  bool ics_split(std::string_view line, IcsProperty& property) {
+    const size_t name_end = line.find_first_of(";:");
+    if (name_end == std::string_view::npos) return false;
+
+    // @NOTE: The value starts at the first colon outside a quoted parameter.
+    bool quoted = false;
+    size_t colon = name_end;
+    for (; colon < line.size(); ++colon) {
+      if (line[colon] == '"') quoted = !quoted;
+      else if ((line[colon] == ':') && !quoted) break;
+    }
+    if (colon == line.size()) return false;
+
+    property.name = line.substr(0, name_end);
+    property.params = line.substr(name_end, colon - name_end);
+    property.value = line.substr(colon + 1);
+    return true;
+  }
+
+  bool ics_digits(std::string_view text, size_t offset, size_t count, uint32_t& value) {
+    if (offset + count > text.size()) return false;
+    value = 0;
+    for (size_t i = offset; i < offset + count; ++i) {
+      if ((text[i] < '0') || (text[i] > '9')) return false;
+      value = value * 10 + static_cast<uint32_t>(text[i] - '0');
+    }
+    return true;
+  }
+
+  // "20240105", "20240105T090000" or "20240105T090000Z".
+  bool ics_parse_time(std::string_view value, const CalendarParseOptions& options, int64_t& wall, bool& date_only) {
+    uint32_t year, month, day;
+    if (!ics_digits(value, 0, 4, year) || !ics_digits(value, 4, 2, month) || !ics_digits(value, 6, 2, day)) return false;
+    if ((month < 1) || (month > 12) || (day < 1) || (day > 31)) return false;
+
+    const int64_t days = ics_days_from_civil(year, month, day);
+    date_only = (value.size() < 15) || (value[8] != 'T');
+    if (date_only) {
+      wall = days * kDaySeconds;
+      return true;
+    }
+
+    uint32_t hour, minute, second;
+    if (!ics_digits(value, 9, 2, hour) || !ics_digits(value, 11, 2, minute) || !ics_digits(value, 13, 2, second)) return false;
+    wall = days * kDaySeconds + hour * 3600 + minute * 60 + second;
+    if ((value.size() > 15) && (value[15] == 'Z') && options.utc_to_local) wall = options.utc_to_local(wall);
+    return true;
+  }
+
+  // "PT1H30M", "P1D", "P2W", "-PT15M".
+  bool ics_parse_duration(std::string_view value, int64_t& seconds) {
+    size_t i = 0;
+    int64_t sign = 1;
+    if ((i < value.size()) && ((value[i] == '+') || (value[i] == '-'))) sign = (value[i++] == '-') ? -1 : 1;
+    if ((i >= value.size()) || (value[i++] != 'P')) return false;
+
+    seconds = 0;
+    int64_t number = 0;
+    bool digits = false;
+    for (; i < value.size(); ++i) {
+      const char ch = value[i];
+      if ((ch >= '0') && (ch <= '9')) {
+        number = number * 10 + (ch - '0');
+        digits = true;
+        continue;
+      }
+      if (ch == 'T') continue;
+      if (!digits) return false;
+      if (ch == 'W') seconds += number * 7 * kDaySeconds;
+      else if (ch == 'D') seconds += number * kDaySeconds;
+      else if (ch == 'H') seconds += number * 3600;
+      else if (ch == 'M') seconds += number * 60;
+      else if (ch == 'S') seconds += number;
+      else return false;
+      number = 0;
+      digits = false;
+    }
+    seconds *= sign;
+    return true;
+  }
+
+  bool ics_has_param(std::string_view params, std::string_view param) {
+    for (size_t at = params.find(param); at != std::string_view::npos; at = params.find(param, at + 1)) {
+      const size_t after = at + param.size();
+      if ((params[at - 1] == ';') && ((after == params.size()) || (params[after] == ';'))) return true;
+    }
+    return false;
+  }
+
+  uint8_t ics_weekday_of(std::string_view code) {
+    constexpr const char* kCodes[7] = {"MO", "TU", "WE", "TH", "FR", "SA", "SU"};
+    for (uint8_t i = 0; i < 7; ++i) {
+      if (ics_name_is(code, kCodes[i])) return i;
+    }
+    return 0xff;
+  }
+
+  void ics_parse_rule(std::string_view value, const CalendarParseOptions& options, CalendarRule& rule) {
+    rule = { };
+    while (!value.empty()) {
+      const size_t part_end = value.find(';');
+      const std::string_view part = value.substr(0, part_end);
+      value = (part_end == std::string_view::npos) ? std::string_view() : value.substr(part_end + 1);
+
+      const size_t equals = part.find('=');
+      if (equals == std::string_view::npos) continue;
+      const std::string_view key = part.substr(0, equals);
+      const std::string_view argument = part.substr(equals + 1);
+
+      uint32_t number = 0;
+      if (ics_name_is(key, "FREQ")) {
+        if (ics_name_is(argument, "DAILY")) rule.frequency = CalendarFrequency::Daily;
+        else if (ics_name_is(argument, "WEEKLY")) rule.frequency = CalendarFrequency::Weekly;
+        else if (ics_name_is(argument, "MONTHLY")) rule.frequency = CalendarFrequency::Monthly;
+        else if (ics_name_is(argument, "YEARLY")) rule.frequency = CalendarFrequency::Yearly;
+      } else if (ics_name_is(key, "INTERVAL")) {
+        if (ics_digits(argument, 0, argument.size(), number) && (number > 0)) rule.interval = number;
+      } else if (ics_name_is(key, "COUNT")) {
+        if (ics_digits(argument, 0, argument.size(), number)) rule.count = number;
+      } else if (ics_name_is(key, "UNTIL")) {
+        bool date_only = false;
+        if (ics_parse_time(argument, options, rule.until, date_only) && date_only) rule.until += kDaySeconds - 1;
+      } else if (ics_name_is(key, "BYDAY")) {
+        for (std::string_view days = argument; !days.empty();) {
+          const size_t comma = days.find(',');
+          std::string_view day = days.substr(0, comma);
+          days = (comma == std::string_view::npos) ? std::string_view() : days.substr(comma + 1);
+          if (day.size() < 2) continue;
+
+          const uint8_t weekday = ics_weekday_of(day.substr(day.size() - 2));
+          if (weekday == 0xff) continue;
+          day.remove_suffix(2);
+          const bool negative = !day.empty() && (day[0] == '-');
+          if (!day.empty() && ((day[0] == '-') || (day[0] == '+'))) day.remove_prefix(1);
+
+          rule.weekdays |= static_cast<uint8_t>(1u << weekday);
+          if (day.empty() || (rule.ordinal != 0) || !ics_digits(day, 0, day.size(), number) || (number == 0) || (number > 5)) continue;
+          rule.ordinal = static_cast<int8_t>(negative ? -static_cast<int32_t>(number) : static_cast<int32_t>(number));
+          rule.weekday = weekday;
+        }
+      }
+    }
+  }
+
+  void ics_unescape(std::string_view value, std::string& text) {
+    text.clear();
+    text.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+      if ((value[i] != '\\') || (i + 1 == value.size())) {
+        text.push_back(value[i]);
+        continue;
+      }
+      const char next = value[++i];
+      text.push_back(((next == 'n') || (next == 'N')) ? ' ' : next);
+    }
+  }
+
+  // Parses the lines of one VEVENT block. Properties of nested components,
+  // e.g. a VALARM, are skipped.
+  void ics_parse_event(const char* p, const char* end, const CalendarParseOptions& options, CalendarEvent& event, std::string& scratch) {
+    bool has_end = false;
+    int64_t duration = 0;
+    bool has_duration = false;
+    uint32_t depth = 0;
+    while (p < end) {
+      const std::string_view line = ics_content_line(p, end, scratch);
+      IcsProperty property;
+      if (!ics_split(line, property)) continue;
+
+      if (ics_name_is(property.name, "BEGIN")) {
+        depth++;
+        continue;
+      }
+      if (ics_name_is(property.name, "END")) {
+        depth--;
+        continue;
+      }
+      if (depth != 1) continue;
+
+      bool date_only = false;
+      if (ics_name_is(property.name, "DTSTART")) {
+        if (ics_parse_time(property.value, options, event.start, date_only)) event.all_day = date_only || ics_has_param(property.params, "VALUE=DATE");
+      } else if (ics_name_is(property.name, "DTEND")) {
+        has_end = ics_parse_time(property.value, options, event.end, date_only);
+      } else if (ics_name_is(property.name, "DURATION")) {
+        has_duration = ics_parse_duration(property.value, duration);
+      } else if (ics_name_is(property.name, "SUMMARY")) {
+        ics_unescape(property.value, event.summary);
+      } else if (ics_name_is(property.name, "RRULE")) {
+        ics_parse_rule(property.value, options, event.rule);
+      } else if (ics_name_is(property.name, "EXDATE")) {
+        for (std::string_view dates = property.value; !dates.empty();) {
+          const size_t comma = dates.find(',');
+          int64_t exdate = 0;
+          if (ics_parse_time(dates.substr(0, comma), options, exdate, date_only)) event.exdates.push_back(exdate);
+          dates = (comma == std::string_view::npos) ? std::string_view() : dates.substr(comma + 1);
+        }
+      } else if (ics_name_is(property.name, "UID")) {
+        event.uid = ics_hash(property.value.data(), property.value.size());
+      } else if (ics_name_is(property.name, "RECURRENCE-ID")) {
+        ics_parse_time(property.value, options, event.recurrence_id, date_only);
+      }
+    }
+
+    if (has_duration) event.end = event.start + duration;
+    else if (!has_end) event.end = event.start + (event.all_day ? kDaySeconds : 0);
+    if (event.end < event.start) event.end = event.start;
+    if (event.recurrence_id != INT64_MIN) event.rule = { };
+  }
+
+  // True if [start, end) overlaps [from, to). An event without duration
+  // overlaps the range it starts in.
+  bool overlaps(int64_t start, int64_t end, int64_t from, int64_t to) {
+    return (start < to) && ((end > from) || ((end == start) && (start >= from)));
+  }
+
+  uint32_t popcount_below(uint8_t weekdays, uint32_t weekday) {
+    return static_cast<uint32_t>(std::popcount(static_cast<uint32_t>(weekdays) & ((1u << weekday) - 1)));
+  }
+
+  uint8_t series_weekdays(const CalendarEvent& event) {
+    return event.rule.weekdays ? event.rule.weekdays : static_cast<uint8_t>(1u << ics_weekday(ics_floor_div(event.start, kDaySeconds)));
+  }
+
+  // Latest start of any occurrence, from COUNT and UNTIL. Monthly and
+  // yearly counts skip months without the day, finish_index walks those.
+  int64_t series_last_start(const CalendarEvent& event) {
+    const CalendarRule& rule = event.rule;
+    if (rule.count == 0) return rule.until;
+
+    const int64_t n = static_cast<int64_t>(rule.count) - 1;
+    const int64_t interval = rule.interval;
+    int64_t bound = INT64_MAX;
+    if (rule.frequency == CalendarFrequency::Daily) {
+      bound = event.start + n * interval * kDaySeconds;
+    } else if (rule.frequency == CalendarFrequency::Weekly) {
+      const uint8_t weekdays = series_weekdays(event);
+      const int64_t per_week = std::popcount(static_cast<uint32_t>(weekdays));
+      const int64_t first_week = per_week - popcount_below(weekdays, ics_weekday(ics_floor_div(event.start, kDaySeconds)));
+      const int64_t week = (n < first_week) ? 0 : 1 + (n - first_week) / per_week;
+      bound = event.start + (week * 7 * interval + 6) * kDaySeconds;
+    }
+    return std::min(rule.until, bound);
+  }
+
+  // Emits the occurrences of `series` overlapping [from, to). With `jump`
+  // the walk starts at the first period that can overlap the range, which
+  // is only possible when the occurrences before it do not have to be
+  // counted.
+  void expand_series(const CalendarIndex& index, const CalendarSeries& series, int64_t from, int64_t to, bool jump, std::vector<CalendarOccurrence>& occurrences) {
+    const CalendarEvent& event = index.events[series.event];
+    const CalendarRule& rule = event.rule;
+    const int64_t duration = event.end - event.start;
+    const int64_t* exclusions = index.exclusions.data() + series.exclusions;
+    const int64_t* exclusions_end = exclusions + series.exclusion_count;
+    const uint64_t count = rule.count ? rule.count : UINT64_MAX;
+
+    // @NOTE: false once the walk is past the range, COUNT or UNTIL.
+    auto emit = [&](int64_t start, uint64_t ordinal) {
+      if ((start >= to) || (ordinal >= count) || (start > rule.until)) return false;
+      if (overlaps(start, start + duration, from, to) && !std::binary_search(exclusions, exclusions_end, start)) {
+        occurrences.push_back(CalendarOccurrence{.start = start, .end = start + duration, .event = series.event});
+      }
+      return true;
+    };
+
+    const int64_t start_day = ics_floor_div(event.start, kDaySeconds);
+    const int64_t time_of_day = event.start - start_day * kDaySeconds;
+    const int64_t earliest = from - duration - 1; // @NOTE: no occurrence starting before it can overlap
+    const int64_t interval = rule.interval;
+
+    if (rule.frequency == CalendarFrequency::Daily) {
+      const int64_t step = interval * kDaySeconds;
+      const int64_t first = (jump && (rule.count == 0)) ? std::max<int64_t>(0, ics_floor_div(earliest - event.start, step)) : 0;
+      for (int64_t k = first; emit(event.start + k * step, static_cast<uint64_t>(k)); ++k) {}
+      return;
+    }
+
+    if (rule.frequency == CalendarFrequency::Weekly) {
+      const uint8_t weekdays = series_weekdays(event);
+      const uint32_t start_weekday = ics_weekday(start_day);
+      const int64_t week0 = start_day - start_weekday;
+      const uint64_t per_week = static_cast<uint64_t>(std::popcount(static_cast<uint32_t>(weekdays)));
+      const uint64_t first_week = per_week - popcount_below(weekdays, start_weekday);
+      const int64_t first = jump ? std::max<int64_t>(0, ics_floor_div(ics_floor_div(earliest, kDaySeconds) - week0, 7 * interval)) : 0;
+      for (int64_t w = first;; ++w) {
+        for (uint32_t weekday = (w == 0) ? start_weekday : 0; weekday < 7; ++weekday) {
+          if (!(weekdays & (1u << weekday))) continue;
+
+          const uint64_t ordinal = (w == 0) ? popcount_below(weekdays, weekday) - popcount_below(weekdays, start_weekday) : first_week + static_cast<uint64_t>(w - 1) * per_week + popcount_below(weekdays, weekday);
+          if (!emit((week0 + w * 7 * interval + weekday) * kDaySeconds + time_of_day, ordinal)) return;
+        }
+      }
+    }
+
+    const CivilTime civil = calendar_civil(event.start);
+    if (rule.frequency == CalendarFrequency::Monthly) {
+      const int64_t start_month = static_cast<int64_t>(civil.year) * 12 + (civil.month - 1);
+      int64_t first = 0;
+      if (jump && (rule.count == 0)) {
+        const CivilTime from_civil = calendar_civil(earliest);
+        first = std::max<int64_t>(0, ics_floor_div(static_cast<int64_t>(from_civil.year) * 12 + (from_civil.month - 1) - start_month, interval));
+      }
+
+      uint64_t ordinal = 0;
+      for (int64_t k = first;; ++k) {
+        const int64_t month_index = start_month + k * interval;
+        const int64_t year = ics_floor_div(month_index, 12);
+        const uint32_t month = static_cast<uint32_t>(month_index - year * 12) + 1;
+        const int64_t month_first = ics_days_from_civil(year, month, 1);
+        const uint32_t days = ics_days_in_month(year, month);
+        if (month_first * kDaySeconds >= to) return;
+
+        int64_t day;
+        if (rule.ordinal > 0) {
+          day = month_first + (rule.weekday + 7 - ics_weekday(month_first)) % 7 + (rule.ordinal - 1) * 7;
+        } else if (rule.ordinal < 0) {
+          const int64_t month_last = month_first + days - 1;
+          day = month_last - (ics_weekday(month_last) + 7 - rule.weekday) % 7 + (rule.ordinal + 1) * 7;
+        } else {
+          day = (civil.day <= days) ? month_first + civil.day - 1 : INT64_MIN;
+        }
+        if ((day < month_first) || (day >= month_first + days)) continue;
+
+        const int64_t start = day * kDaySeconds + time_of_day;
+        if (start < event.start) continue;
+        if (!emit(start, ordinal++)) return;
+      }
+    }
+
+    if (rule.frequency == CalendarFrequency::Yearly) {
+      int64_t first = 0;
+      if (jump && (rule.count == 0)) first = std::max<int64_t>(0, ics_floor_div(calendar_civil(earliest).year - static_cast<int64_t>(civil.year), interval));
+
+      uint64_t ordinal = 0;
+      for (int64_t k = first;; ++k) {
+        const int64_t year = civil.year + k * interval;
+        if (ics_days_from_civil(year, 1, 1) * kDaySeconds >= to) return;
+        if (civil.day > ics_days_in_month(year, civil.month)) continue;
+        if (!emit(ics_days_from_civil(year, civil.month, civil.day) * kDaySeconds + time_of_day, ordinal++)) return;
+      }
+    }
+  }
+
+  void sort_occurrences(std::vector<CalendarOccurrence>& occurrences, size_t begin) {
+    std::sort(occurrences.begin() + static_cast<ptrdiff_t>(begin), occurrences.end(), [](const CalendarOccurrence& lhs, const CalendarOccurrence& rhs) {
+      return (lhs.start != rhs.start) ? (lhs.start < rhs.start) : (lhs.event < rhs.event);
+    });
+  }
+
+  void finish_index(CalendarIndex& index) {
+    std::vector<uint32_t> singles;
+    std::unordered_map<uint64_t, uint32_t> series_by_uid;
+    for (uint32_t i = 0; i < index.events.size(); ++i) {
+      const CalendarEvent& event = index.events[i];
+      if (event.rule.frequency == CalendarFrequency::None) {
+        if (event.end - event.start > kCalendarLongEventSeconds) index.long_singles.push_back(i);
+        else singles.push_back(i);
+        continue;
+      }
+      if (event.uid) series_by_uid.emplace(event.uid, static_cast<uint32_t>(index.series.size()));
+      index.series.push_back(CalendarSeries{.event = i, .last_start = series_last_start(event)});
+    }
+
+    std::vector<CalendarOccurrence> walked;
+    for (CalendarSeries& series : index.series) {
+      const CalendarRule& rule = index.events[series.event].rule;
+      const bool counted = (rule.count != 0) && (rule.count <= kCountedWalkLimit);
+      if (!counted || (rule.frequency == CalendarFrequency::Daily) || (rule.frequency == CalendarFrequency::Weekly)) continue;
+
+      walked.clear();
+      expand_series(index, series, index.events[series.event].start, INT64_MAX, false, walked);
+      series.last_start = walked.empty() ? index.events[series.event].start : walked.back().start;
+    }
+
+    // @NOTE: Sorted as (start, event) pairs, comparing through the events
+    // misses the cache on every comparison.
+    std::vector<std::pair<int64_t, uint32_t>> sorted;
+    sorted.reserve(singles.size());
+    for (uint32_t i : singles) {
+      sorted.emplace_back(index.events[i].start, i);
+      index.max_duration = std::max(index.max_duration, index.events[i].end - index.events[i].start);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    index.starts.reserve(sorted.size());
+    index.singles.reserve(sorted.size());
+    for (const auto& [start, i] : sorted) {
+      index.starts.push_back(start);
+      index.singles.push_back(i);
+    }
+
+    // @NOTE: An override replaces one occurrence of its series, which then
+    // excludes it like an EXDATE.
+    std::vector<std::vector<int64_t>> exclusions(index.series.size());
+    for (uint32_t s = 0; s < index.series.size(); ++s) exclusions[s] = index.events[index.series[s].event].exdates;
+    for (const CalendarEvent& event : index.events) {
+      if (event.recurrence_id == INT64_MIN) continue;
+      if (auto it = series_by_uid.find(event.uid); it != series_by_uid.end()) exclusions[it->second].push_back(event.recurrence_id);
+    }
+
+    std::vector<uint32_t> order(index.series.size());
+    for (uint32_t s = 0; s < order.size(); ++s) order[s] = s;
+    std::sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) { return index.events[index.series[lhs].event].start < index.events[index.series[rhs].event].start; });
+
+    std::vector<CalendarSeries> series;
+    series.reserve(order.size());
+    for (uint32_t s : order) {
+      std::vector<int64_t>& excluded = exclusions[s];
+      std::sort(excluded.begin(), excluded.end());
+      CalendarSeries entry = index.series[s];
+      entry.exclusions = static_cast<uint32_t>(index.exclusions.size());
+      entry.exclusion_count = static_cast<uint32_t>(excluded.size());
+      index.exclusions.insert(index.exclusions.end(), excluded.begin(), excluded.end());
+      series.push_back(entry);
+    }
+    index.series = std::move(series);
+  }
+}
+
+void calendar_index_build(CalendarIndex& index, const char* data, size_t size, const CalendarParseOptions& options) {
+  // @NOTE: Exports keep their order, so the block at the cursor is tried
+  // first. A changed block is taken as edited in place; only when the next
+  // block misses too did blocks move, and the map by hash gets built.
+  std::vector<CalendarEvent>& previous = index.events;
+  std::vector<uint8_t> reused(previous.size(), 0);
+  std::unordered_map<uint64_t, uint32_t> moved;
+  size_t cursor = 0;
+  bool missed = false;
+  bool in_order = true;
+
+  CalendarIndex next;
+  next.events.reserve(previous.size());
+  next.stats.bytes = size;
+  std::string scratch;
+  const std::string_view text(data, size);
+  // @NOTE: With the line break in front the search only stops at line
+  // starts instead of at every 'E'.
+  constexpr std::string_view kBegin = "\nBEGIN:VEVENT";
+  constexpr std::string_view kEnd = "\nEND:VEVENT";
+  for (size_t found = text.find(kBegin); found != std::string_view::npos; found = text.find(kBegin, found)) {
+    const size_t at = found + 1;
+    const size_t end = text.find(kEnd, at);
+    if (end == std::string_view::npos) break;
+
+    const size_t block_end = end + kEnd.size();
+    const uint64_t hash = ics_hash(data + at, block_end - at);
+    next.stats.blocks++;
+    found = block_end;
+
+    const bool hit = (cursor < previous.size()) && !reused[cursor] && (previous[cursor].block_hash == hash);
+    if (!hit && missed && !previous.empty()) {
+      if (moved.empty()) {
+        moved.reserve(previous.size());
+        for (uint32_t i = 0; i < previous.size(); ++i) moved.emplace(previous[i].block_hash, i);
+      }
+      if (auto it = moved.find(hash); (it != moved.end()) && !reused[it->second]) {
+        cursor = it->second;
+        in_order = false;
+      }
+    }
+
+    if ((cursor < previous.size()) && !reused[cursor] && (previous[cursor].block_hash == hash)) {
+      reused[cursor] = 1; // @NOTE: a duplicate block is parsed again
+      next.events.push_back(std::move(previous[cursor++]));
+      missed = false;
+      continue;
+    }
+
+    CalendarEvent event;
+    event.block_hash = hash;
+    ics_parse_event(data + at, data + block_end, options, event, scratch);
+    next.events.push_back(std::move(event));
+    next.stats.parsed++;
+    cursor++;
+    missed = true;
+    in_order = false;
+  }
+
+  // @NOTE: The file was saved without changes, the rest of the index holds.
+  if (in_order && (next.events.size() == previous.size())) {
+    index.events = std::move(next.events);
+    index.stats = next.stats;
+    return;
+  }
+
+  finish_index(next);
+  index = std::move(next);
+}
+
+void calendar_query(const CalendarIndex& index, int64_t from, int64_t to, std::vector<CalendarOccurrence>& occurrences) {
+  const size_t begin = occurrences.size();
+
+  // @NOTE: Nothing starting before `from - max_duration` can reach `from`.
+  auto it = std::lower_bound(index.starts.begin(), index.starts.end(), from - index.max_duration);
+  for (; (it != index.starts.end()) && (*it < to); ++it) {
+    const CalendarEvent& event = index.events[index.singles[static_cast<size_t>(it - index.starts.begin())]];
+    if (overlaps(event.start, event.end, from, to)) occurrences.push_back(CalendarOccurrence{.start = event.start, .end = event.end, .event = index.singles[static_cast<size_t>(it - index.starts.begin())]});
+  }
+  for (uint32_t i : index.long_singles) {
+    const CalendarEvent& event = index.events[i];
+    if (overlaps(event.start, event.end, from, to)) occurrences.push_back(CalendarOccurrence{.start = event.start, .end = event.end, .event = i});
+  }
+
+  for (const CalendarSeries& series : index.series) {
+    const CalendarEvent& event = index.events[series.event];
+    if (event.start >= to) break;
+    if ((series.last_start != INT64_MAX) && (series.last_start + (event.end - event.start) < from)) continue;
+    expand_series(index, series, from, to, true, occurrences);
+  }
+  sort_occurrences(occurrences, begin);
+}
+
+void calendar_query_naive(const CalendarIndex& index, int64_t from, int64_t to, std::vector<CalendarOccurrence>& occurrences) {
+  const size_t begin = occurrences.size();
+  for (uint32_t i = 0; i < index.events.size(); ++i) {
+    const CalendarEvent& event = index.events[i];
+    if ((event.rule.frequency == CalendarFrequency::None) && overlaps(event.start, event.end, from, to)) occurrences.push_back(CalendarOccurrence{.start = event.start, .end = event.end, .event = i});
+  }
+  for (const CalendarSeries& series : index.series) expand_series(index, series, from, to, false, occurrences);
+  sort_occurrences(occurrences, begin);
+}
+
+int64_t calendar_wall_seconds(CivilTime time) {
+  return unix_seconds_from_civil(time);
+}
+
+CivilTime calendar_civil(int64_t wall_seconds) {
+  return civil_from_unix_ms(wall_seconds * 1000);
+}
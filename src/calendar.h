@@ -0,0 +1,116 @@
+#pragma once
+
+#include "base.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// Index of the events in an iCalendar (.ics) export, for the calendar
+// flyout. The file is parsed in one streaming pass straight out of the
+// mapped bytes: only DTSTART, DTEND/DURATION, SUMMARY, RRULE, EXDATE, UID
+// and RECURRENCE-ID are looked at, everything else is skipped a line at a
+// time.
+//
+// Times are wall clock seconds: the local date and time counted like unix
+// seconds, so a month of the flyout is one range query. UTC times (the
+// trailing Z) are converted with `CalendarParseOptions::utc_to_local`,
+// floating times and times with a TZID are taken as local.
+//
+// One-off events are kept sorted by start. A range query binary searches
+// for the first start that can still overlap and scans to the end of the
+// range; the few events longer than kCalendarLongEventSeconds are checked
+// separately so they do not widen that search for everything else.
+// Recurring events are kept as rules and expanded lazily, only inside the
+// queried range, by jumping straight to the first period that can overlap
+// it instead of walking from the first occurrence.
+//
+// Reindexing after the file changed hashes every VEVENT block and reuses
+// the parsed event of any block that is byte for byte the same as before,
+// so an export that changed a few events only parses those. Reused events
+// keep their converted times, so the index has to be cleared when
+// `utc_to_local` changes, e.g. with the time zone.
+//
+// Supported recurrence: FREQ=DAILY/WEEKLY/MONTHLY/YEARLY with INTERVAL,
+// COUNT, UNTIL, BYDAY (weekdays for WEEKLY, one "2TU" or "-1FR" for
+// MONTHLY), EXDATE and RECURRENCE-ID overrides. Other BY* parts are
+// ignored, the series then repeats on the start's own day.
+
+constexpr int64_t kCalendarLongEventSeconds = 7 * 86400;
+
+enum class CalendarFrequency : uint8_t {
+  None,
+  Daily,
+  Weekly,
+  Monthly,
+  Yearly,
+};
+
+struct CalendarRule {
+  CalendarFrequency frequency = CalendarFrequency::None;
+  uint8_t weekdays = 0; // @NOTE: WEEKLY BYDAY, bit 0 = Monday, 0 = the start's weekday
+  int8_t ordinal = 0; // @NOTE: MONTHLY BYDAY, the nth (negative: from the end) `weekday` of the month, 0 = the start's day of the month
+  uint8_t weekday = 0; // @NOTE: 0 = Monday
+  uint32_t interval = 1;
+  uint32_t count = 0; // @NOTE: 0 = no COUNT
+  int64_t until = INT64_MAX; // @NOTE: wall clock, inclusive
+};
+
+struct CalendarEvent {
+  int64_t start = 0; // @NOTE: wall clock seconds
+  int64_t end = 0; // @NOTE: exclusive
+  bool all_day = false;
+  CalendarRule rule;
+  uint64_t uid = 0; // @NOTE: hash of the UID
+  int64_t recurrence_id = INT64_MIN; // @NOTE: the occurrence of the `uid` series this overrides
+  std::vector<int64_t> exdates;
+  std::string summary; // @NOTE: UTF-8, unescaped
+  uint64_t block_hash = 0; // @NOTE: of the VEVENT's bytes
+};
+
+struct CalendarSeries {
+  uint32_t event = 0;
+  int64_t last_start = INT64_MAX; // @NOTE: no occurrence starts later
+  uint32_t exclusions = 0; // @NOTE: offset into CalendarIndex::exclusions, sorted
+  uint32_t exclusion_count = 0;
+};
+
+struct CalendarIndexStats {
+  uint64_t blocks = 0; // @NOTE: VEVENTs in the latest build
+  uint64_t parsed = 0; // @NOTE: VEVENTs parsed in the latest build, the rest were reused
+  uint64_t bytes = 0;
+};
+
+struct CalendarIndex {
+  std::vector<CalendarEvent> events; // @NOTE: file order
+  std::vector<int64_t> starts; // @NOTE: of the one-off events, sorted
+  std::vector<uint32_t> singles; // @NOTE: parallel to `starts`
+  int64_t max_duration = 0; // @NOTE: of `singles`
+  std::vector<uint32_t> long_singles;
+  std::vector<CalendarSeries> series; // @NOTE: sorted by the start of the event
+  std::vector<int64_t> exclusions;
+  CalendarIndexStats stats;
+};
+
+struct CalendarParseOptions {
+  std::function<int64_t(int64_t utc_seconds)> utc_to_local; // @NOTE: missing = UTC is local
+};
+
+// Builds the index from the bytes of an .ics file. Events of `index` whose
+// block did not change are reused.
+void calendar_index_build(CalendarIndex& index, const char* data, size_t size, const CalendarParseOptions& options);
+
+struct CalendarOccurrence {
+  int64_t start = 0;
+  int64_t end = 0;
+  uint32_t event = 0; // @NOTE: CalendarIndex::events
+};
+
+// Appends every occurrence overlapping [from, to), sorted by start.
+void calendar_query(const CalendarIndex& index, int64_t from, int64_t to, std::vector<CalendarOccurrence>& occurrences);
+
+// Reference for calendar_query: walks every series from its first
+// occurrence.
+void calendar_query_naive(const CalendarIndex& index, int64_t from, int64_t to, std::vector<CalendarOccurrence>& occurrences);
+
+int64_t calendar_wall_seconds(CivilTime time);
+CivilTime calendar_civil(int64_t wall_seconds);
@@ -0,0 +1,532 @@
+#include "clock_api.h"
+#include <string.h>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  constexpr uint32_t kApiTopics[kApiTopicCount] = {kApiTopicLayout, kApiTopicText};
+
+  void api_put(std::vector<uint8_t>& out, uint64_t value, uint32_t bytes) {
+    for (uint32_t i = 0; i < bytes; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+
+  void api_put_string(std::vector<uint8_t>& out, std::string_view text) {
+    const size_t length = std::min<size_t>(text.size(), 0xffff);
+    api_put(out, length, 2);
+    out.insert(out.end(), text.begin(), text.begin() + static_cast<ptrdiff_t>(length));
+  }
+
+  // @NOTE: Starts a frame, api_end_frame fills in its size.
+  size_t api_begin_frame(std::vector<uint8_t>& out, ApiMessage type) {
+    const size_t start = out.size();
+    out.resize(start + 4);
+    out.push_back(static_cast<uint8_t>(type));
+    return start;
+  }
+
+  void api_end_frame(std::vector<uint8_t>& out, size_t start) {
+    const uint64_t size = out.size() - start - kApiFrameHeader;
+    for (uint32_t i = 0; i < 4; ++i) out[start + i] = static_cast<uint8_t>(size >> (8 * i));
+  }
+
+  struct ApiReader {
+    const uint8_t* data = nullptr;
+    uint32_t size = 0;
+    uint32_t at = 0;
+    bool ok = true;
+  };
+
+  uint64_t api_get(ApiReader& in, uint32_t bytes) {
+    if (in.size - in.at < bytes) {
+      in.ok = false;
+      return 0;
+    }
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(in.data[in.at + i]) << (8 * i);
+    in.at += bytes;
+    return value;
+  }
+
+  std::string api_get_string(ApiReader& in) {
+    const uint32_t length = static_cast<uint32_t>(api_get(in, 2));
+    if (!in.ok || (in.size - in.at < length)) {
+      in.ok = false;
+      return { };
+    }
+    std::string text(reinterpret_cast<const char*>(in.data + in.at), length);
+    in.at += length;
+    return text;
+  }
+
+  ApiReader api_reader(const ApiFrame& frame) {
+    return ApiReader{.data = frame.payload, .size = frame.size};
+  }
+
+  ApiBuffer api_encode_state(const ApiServer& server, uint32_t topic) {
+    auto frame = std::make_shared<std::vector<uint8_t>>();
+    if (topic == kApiTopicLayout) {
+      const size_t start = api_begin_frame(*frame, ApiMessage::Layout);
+      const size_t count = std::min<size_t>(server.layout.size(), 0xffff);
+      api_put(*frame, count, 2);
+      for (size_t i = 0; i < count; ++i) {
+        const ApiClock& clock = server.layout[i];
+        api_put(*frame, clock.identity, 8);
+        api_put(*frame, static_cast<uint32_t>(clock.monitor.left), 4);
+        api_put(*frame, static_cast<uint32_t>(clock.monitor.top), 4);
+        api_put(*frame, static_cast<uint32_t>(clock.monitor.right), 4);
+        api_put(*frame, static_cast<uint32_t>(clock.monitor.bottom), 4);
+        api_put(*frame, clock.corner, 1);
+        api_put(*frame, clock.visible ? 1 : 0, 1);
+      }
+      api_end_frame(*frame, start);
+    } else {
+      const size_t start = api_begin_frame(*frame, ApiMessage::Text);
+      api_put_string(*frame, server.time);
+      api_put_string(*frame, server.date);
+      api_end_frame(*frame, start);
+    }
+    return frame;
+  }
+
+  // @NOTE: The state of topic `index`, encoded once per change.
+  const ApiBuffer& api_current(ApiServer& server, uint32_t index) {
+    ApiBuffer& current = server.current[index];
+    if (!current) {
+      current = api_encode_state(server, kApiTopics[index]);
+      server.stats.encoded++;
+      server.stats.encoded_bytes += current->size();
+    }
+    return current;
+  }
+
+  // @NOTE: The front entry may be being written, only the ones behind it
+  // are replaced.
+  void api_queue(ApiServer& server, ApiClient& client, const ApiBuffer& frame, uint32_t topic) {
+    for (size_t i = 1; i < client.output.size(); ++i) {
+      if (client.output[i].topic != topic) continue;
+      client.output[i].frame = frame;
+      server.stats.coalesced++;
+      return;
+    }
+    client.output.push_back(ApiQueued{.frame = frame, .topic = topic});
+    server.stats.queued++;
+  }
+
+  void api_subscribe(ApiServer& server, ApiClient& client, uint32_t topics) {
+    server.stats.subscribes++;
+    for (uint32_t i = 0; i < kApiTopicCount; ++i) {
+      const uint32_t topic = kApiTopics[i];
+      const bool had = (client.topics & topic) != 0;
+      const bool has = (topics & topic) != 0;
+      if (had == has) continue;
+
+      if (had) {
+        server.subscribers[i]--;
+        client.topics &= ~topic;
+        continue;
+      }
+      server.subscribers[i]++;
+      client.topics |= topic;
+      if (server.known & topic) api_queue(server, client, api_current(server, i), topic);
+    }
+  }
+
+  bool api_handle_frame(ApiServer& server, ApiClient& client, const ApiFrame& frame) {
+    switch (frame.type) {
+      case ApiMessage::Subscribe: {
+        ApiReader in = api_reader(frame);
+        const uint32_t topics = static_cast<uint32_t>(api_get(in, 4));
+        if (!in.ok) return false;
+        api_subscribe(server, client, topics);
+        return true;
+      }
+      case ApiMessage::Overlay: {
+        ApiOverlayRequest request;
+        if (!api_decode_overlay(frame, request) || (request.text.size() > kApiMaxOverlayText)) return false;
+        server.overlays.push_back(std::move(request));
+        server.stats.overlays++;
+        return true;
+      }
+      case ApiMessage::Hello:
+      case ApiMessage::Layout:
+      case ApiMessage::Text: {
+        return false;
+      }
+    }
+    return false;
+  }
+
+  uint32_t api_topic_index(uint32_t topic) {
+    return (topic == kApiTopicLayout) ? 0 : 1;
+  }
+
+  void api_set_topic(ApiServer& server, uint32_t topic) {
+    server.current[api_topic_index(topic)].reset();
+    server.dirty |= topic;
+    server.known |= topic;
+  }
+}
+
+ApiParse api_parse_frame(const uint8_t* data, size_t size, ApiFrame& frame) {
+  if (size < kApiFrameHeader) return ApiParse::Incomplete;
+
+  const uint32_t payload = static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+  if (payload > kApiMaxFrame) return ApiParse::Malformed;
+  if (size - kApiFrameHeader < payload) return ApiParse::Incomplete;
+
+  frame.type = static_cast<ApiMessage>(data[4]);
+  frame.payload = data + kApiFrameHeader;
+  frame.size = payload;
+  return ApiParse::Complete;
+}
+
+void api_encode_subscribe(std::vector<uint8_t>& out, uint32_t topics) {
+  const size_t start = api_begin_frame(out, ApiMessage::Subscribe);
+  api_put(out, topics, 4);
+  api_end_frame(out, start);
+}
+
+void api_encode_overlay(std::vector<uint8_t>& out, const ApiOverlayRequest& request) {
+  const size_t start = api_begin_frame(out, ApiMessage::Overlay);
+  api_put(out, request.identity, 8);
+  api_put(out, request.duration_ms, 4);
+  api_put_string(out, request.text);
+  api_end_frame(out, start);
+}
+
+bool api_decode_hello(const ApiFrame& frame, uint16_t& version) {
+  if (frame.type != ApiMessage::Hello) return false;
+  ApiReader in = api_reader(frame);
+  version = static_cast<uint16_t>(api_get(in, 2));
+  return in.ok;
+}
+
+bool api_decode_layout(const ApiFrame& frame, std::vector<ApiClock>& clocks) {
+  if (frame.type != ApiMessage::Layout) return false;
+  ApiReader in = api_reader(frame);
+  const uint64_t count = api_get(in, 2);
+  clocks.clear();
+  for (uint64_t i = 0; (i < count) && in.ok; ++i) {
+    ApiClock clock;
+    clock.identity = api_get(in, 8);
+    clock.monitor.left = static_cast<int32_t>(api_get(in, 4));
+    clock.monitor.top = static_cast<int32_t>(api_get(in, 4));
+    clock.monitor.right = static_cast<int32_t>(api_get(in, 4));
+    clock.monitor.bottom = static_cast<int32_t>(api_get(in, 4));
+    clock.corner = static_cast<Corner>(api_get(in, 1) & 3);
+    clock.visible = api_get(in, 1) != 0;
+    clocks.push_back(clock);
+  }
+  return in.ok;
+}
+
+bool api_decode_text(const ApiFrame& frame, std::string& time, std::string& date) {
+  if (frame.type != ApiMessage::Text) return false;
+  ApiReader in = api_reader(frame);
+  time = api_get_string(in);
+  date = api_get_string(in);
+  return in.ok;
+}
+
+bool api_decode_overlay(const ApiFrame& frame, ApiOverlayRequest& request) {
+  if (frame.type != ApiMessage::Overlay) return false;
+  ApiReader in = api_reader(frame);
+  request.identity = api_get(in, 8);
+  request.duration_ms = static_cast<uint32_t>(api_get(in, 4));
+  request.text = api_get_string(in);
+  return in.ok;
+}
+
+uint64_t api_server_connect(ApiServer& server) {
+  if (server.clients.size() >= kApiMaxClients) {
+    server.stats.refused++;
+    return 0;
+  }
+  if (!server.hello) {
+    auto hello = std::make_shared<std::vector<uint8_t>>();
+    const size_t start = api_begin_frame(*hello, ApiMessage::Hello);
+    api_put(*hello, kApiProtocolVersion, 2);
+    api_end_frame(*hello, start);
+    server.hello = std::move(hello);
+  }
+
+  const uint64_t id = server.next_client++;
+  ApiClient& client = server.clients[id];
+  client.output.push_back(ApiQueued{.frame = server.hello, .topic = 0});
+  server.stats.connects++;
+  return id;
+}
+
+void api_server_disconnect(ApiServer& server, uint64_t client) {
+  auto it = server.clients.find(client);
+  if (it == server.clients.end()) return;
+
+  for (uint32_t i = 0; i < kApiTopicCount; ++i) {
+    if (it->second.topics & kApiTopics[i]) server.subscribers[i]--;
+  }
+  server.clients.erase(it);
+  server.stats.disconnects++;
+}
+
+bool api_server_receive(ApiServer& server, uint64_t client, const uint8_t* data, size_t size) {
+  auto it = server.clients.find(client);
+  if (it == server.clients.end()) return false;
+
+  ApiClient& state = it->second;
+  state.input.insert(state.input.end(), data, data + size);
+  size_t at = 0;
+  for (;;) {
+    ApiFrame frame;
+    const ApiParse parse = api_parse_frame(state.input.data() + at, state.input.size() - at, frame);
+    if (parse == ApiParse::Incomplete) break;
+    if ((parse == ApiParse::Malformed) || !api_handle_frame(server, state, frame)) {
+      server.stats.malformed++;
+      return false;
+    }
+    at += kApiFrameHeader + frame.size;
+  }
+  state.input.erase(state.input.begin(), state.input.begin() + static_cast<ptrdiff_t>(at));
+  return true;
+}
+
+void api_server_set_layout(ApiServer& server, const std::vector<ApiClock>& clocks) {
+  if ((server.known & kApiTopicLayout) && (server.layout == clocks)) return;
+  server.layout = clocks;
+  api_set_topic(server, kApiTopicLayout);
+}
+
+void api_server_set_text(ApiServer& server, std::string_view time, std::string_view date) {
+  if ((server.known & kApiTopicText) && (server.time == time) && (server.date == date)) return;
+  server.time = time;
+  server.date = date;
+  api_set_topic(server, kApiTopicText);
+}
+
+uint32_t api_server_topics(const ApiServer& server) {
+  uint32_t topics = 0;
+  for (uint32_t i = 0; i < kApiTopicCount; ++i) {
+    if (server.subscribers[i]) topics |= kApiTopics[i];
+  }
+  return topics;
+}
+
+uint32_t api_server_flush(ApiServer& server) {
+  const uint32_t dirty = server.dirty;
+  server.dirty = 0;
+  if (!dirty) return 0;
+
+  server.stats.flushes++;
+  const uint64_t encoded = server.stats.encoded;
+  for (uint32_t i = 0; i < kApiTopicCount; ++i) {
+    const uint32_t topic = kApiTopics[i];
+    if (!(dirty & topic) || !server.subscribers[i]) continue; // @NOTE: encoded when somebody subscribes
+
+    const ApiBuffer& frame = api_current(server, i);
+    for (auto& [id, client] : server.clients) {
+      if (client.topics & topic) api_queue(server, client, frame, topic);
+    }
+  }
+  return static_cast<uint32_t>(server.stats.encoded - encoded);
+}
+
+bool api_client_pending(const ApiClient& client) {
+  return !client.output.empty();
+}
+
+void api_client_sent(ApiServer& server, ApiClient& client, size_t size) {
+  server.stats.sent_bytes += size;
+  client.sent += size;
+  while (!client.output.empty() && (client.sent >= client.output.front().frame->size())) {
+    client.sent -= client.output.front().frame->size();
+    client.output.pop_front();
+  }
+}
+
+bool api_overlays_apply(ApiOverlays& overlays, const ApiOverlayRequest& request, uint64_t now_ms) {
+  if (request.text.empty() || (request.duration_ms == 0)) {
+    return std::erase_if(overlays.entries, [&](const ApiOverlay& overlay) { return (request.identity == 0) || (overlay.identity == request.identity); }) != 0;
+  }
+
+  if (overlays.entries.size() >= kApiMaxOverlays) overlays.entries.erase(overlays.entries.begin());
+  auto in_use = [&](uint16_t id) {
+    return std::any_of(overlays.entries.begin(), overlays.entries.end(), [&](const ApiOverlay& overlay) { return overlay.id == id; });
+  };
+  while ((overlays.next_id == 0) || in_use(overlays.next_id)) overlays.next_id++;
+
+  overlays.entries.push_back(ApiOverlay{
+    .id = overlays.next_id++,
+    .identity = request.identity,
+    .text = request.text,
+    .expires_ms = now_ms + std::min(request.duration_ms, kApiMaxOverlayMs),
+  });
+  return true;
+}
+
+bool api_overlays_expire(ApiOverlays& overlays, uint64_t now_ms) {
+  return std::erase_if(overlays.entries, [&](const ApiOverlay& overlay) { return overlay.expires_ms <= now_ms; }) != 0;
+}
+
+uint64_t api_overlays_next_expiry(const ApiOverlays& overlays) {
+  uint64_t next = 0;
+  for (const ApiOverlay& overlay : overlays.entries) {
+    if ((next == 0) || (overlay.expires_ms < next)) next = overlay.expires_ms;
+  }
+  return next;
+}
+
+uint16_t api_overlay_for(const ApiOverlays& overlays, uint64_t identity) {
+  for (auto it = overlays.entries.rbegin(); it != overlays.entries.rend(); ++it) {
+    if ((it->identity == 0) || (it->identity == identity)) return it->id;
+  }
+  return 0;
+}
+
+#ifndef _WIN32
+namespace {
+  #ifdef MSG_NOSIGNAL
+  constexpr int kApiSendFlags = MSG_NOSIGNAL; // @NOTE: a closed peer is an error, not SIGPIPE
+  #else
+  constexpr int kApiSendFlags = 0;
+  #endif
+
+  constexpr int kApiSendParts = 16; // @NOTE: queued frames gathered into one sendmsg
+
+  bool api_socket_configure(int socket) {
+    const int flags = fcntl(socket, F_GETFL, 0);
+    return (flags >= 0) && (fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0) && (fcntl(socket, F_SETFD, FD_CLOEXEC) == 0);
+  }
+
+  void api_socket_drop(ApiSocketServer& transport, ApiServer& server, uint64_t client) {
+    auto it = transport.sockets.find(client);
+    if (it == transport.sockets.end()) return;
+    close(it->second);
+    transport.sockets.erase(it);
+    api_server_disconnect(server, client);
+  }
+
+  // @NOTE: Returns false if the connection is gone.
+  bool api_socket_write(int socket, ApiServer& server, ApiClient& client) {
+    while (api_client_pending(client)) {
+      iovec parts[kApiSendParts];
+      int count = 0;
+      size_t skip = client.sent;
+      for (const ApiQueued& queued : client.output) {
+        if (count == kApiSendParts) break;
+        parts[count++] = iovec{.iov_base = const_cast<uint8_t*>(queued.frame->data() + skip), .iov_len = queued.frame->size() - skip};
+        skip = 0;
+      }
+
+      msghdr message = { };
+      message.msg_iov = parts;
+      message.msg_iovlen = static_cast<decltype(message.msg_iovlen)>(count);
+      const ssize_t written = sendmsg(socket, &message, kApiSendFlags);
+      if (written < 0) {
+        if (errno == EINTR) continue;
+        return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+      }
+      api_client_sent(server, client, static_cast<size_t>(written));
+    }
+    return true;
+  }
+
+  // @NOTE: Returns false if the connection is gone or sent something malformed.
+  bool api_socket_read(int socket, ApiServer& server, uint64_t client) {
+    uint8_t buffer[4096];
+    for (;;) {
+      const ssize_t received = recv(socket, buffer, sizeof(buffer), 0);
+      if (received > 0) {
+        if (!api_server_receive(server, client, buffer, static_cast<size_t>(received))) return false;
+        continue;
+      }
+      if (received == 0) return false;
+      if (errno == EINTR) continue;
+      return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+    }
+  }
+}
+
+bool api_socket_listen(ApiSocketServer& transport, const char* path) {
+  sockaddr_un address = { };
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) return false;
+  strcpy(address.sun_path, path);
+
+  const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) return false;
+  unlink(path);
+  if (!api_socket_configure(listener) || (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) || (listen(listener, SOMAXCONN) != 0)) {
+    close(listener);
+    return false;
+  }
+
+  transport.listener = listener;
+  transport.path = path;
+  return true;
+}
+
+void api_socket_send(ApiSocketServer& transport, ApiServer& server) {
+  std::vector<uint64_t> dropped;
+  for (auto& [id, socket] : transport.sockets) {
+    auto it = server.clients.find(id);
+    if ((it == server.clients.end()) || !api_socket_write(socket, server, it->second)) dropped.push_back(id);
+  }
+  for (uint64_t id : dropped) api_socket_drop(transport, server, id);
+}
+
+void api_socket_poll(ApiSocketServer& transport, ApiServer& server, int timeout_ms) {
+  api_socket_send(transport, server);
+
+  transport.polled.clear();
+  transport.polled_clients.clear();
+  transport.polled.push_back(pollfd{.fd = transport.listener, .events = POLLIN, .revents = 0});
+  for (auto& [id, socket] : transport.sockets) {
+    auto it = server.clients.find(id);
+    const bool pending = (it != server.clients.end()) && api_client_pending(it->second);
+    transport.polled.push_back(pollfd{.fd = socket, .events = static_cast<short>(pending ? (POLLIN | POLLOUT) : POLLIN), .revents = 0});
+    transport.polled_clients.push_back(id);
+  }
+  if (poll(transport.polled.data(), static_cast<nfds_t>(transport.polled.size()), timeout_ms) <= 0) return;
+
+  if (transport.polled[0].revents & POLLIN) {
+    for (;;) {
+      const int socket = accept(transport.listener, nullptr, nullptr);
+      if (socket < 0) break;
+      const uint64_t id = api_socket_configure(socket) ? api_server_connect(server) : 0;
+      if (!id) {
+        close(socket);
+        continue;
+      }
+      transport.sockets[id] = socket;
+    }
+  }
+
+  for (size_t i = 1; i < transport.polled.size(); ++i) {
+    const short events = transport.polled[i].revents;
+    if (!(events & (POLLIN | POLLHUP | POLLERR))) continue;
+
+    const uint64_t id = transport.polled_clients[i - 1];
+    if (!api_socket_read(transport.polled[i].fd, server, id)) api_socket_drop(transport, server, id);
+  }
+  api_socket_send(transport, server); // @NOTE: the hellos and the state for new subscriptions
+}
+
+void api_socket_close(ApiSocketServer& transport, ApiServer& server) {
+  for (auto& [id, socket] : transport.sockets) {
+    close(socket);
+    api_server_disconnect(server, id);
+  }
+  transport.sockets.clear();
+  if (transport.listener >= 0) {
+    close(transport.listener);
+    unlink(transport.path.c_str());
+  }
+  transport.listener = -1;
+}
+#endif
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "base.h"
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+// Local API for other programs on the machine, e.g. a status bar that
+// mirrors the clock or a build script that puts "tests failed" under it.
+// Served on a named pipe on Windows (see common.h) and on a Unix domain
+// socket elsewhere. Every message in either direction is one frame
+//
+//   payload size (4 bytes) | type (1 byte) | payload
+//
+// Integers are little-endian, strings a 2 byte length and UTF-8.
+//
+// A client subscribes to topics and is pushed their state: the current
+// state at once, then whenever it changes, at most once per flush. The app
+// flushes once per tick, every topic that changed is encoded once into a
+// shared buffer and the subscribers' queues only hold references to it, so
+// fanning out to hundreds of clients copies nothing. An update a client
+// has not started to take yet is replaced by a newer one of its topic, a
+// slow client skips states rather than piling them up.
+
+constexpr uint16_t kApiProtocolVersion = 1;
+constexpr uint32_t kApiFrameHeader = 5;
+constexpr uint32_t kApiMaxFrame = 4096; // @NOTE: payload bytes a client may send in one frame
+constexpr uint32_t kApiMaxClients = 1024; // @NOTE: further connections are refused
+constexpr uint32_t kApiMaxOverlayText = 120; // @NOTE: UTF-8 bytes, fits a composed line, see glyph_atlas.h
+constexpr uint32_t kApiMaxOverlayMs = 60 * 60 * 1000;
+constexpr uint32_t kApiMaxOverlays = 16; // @NOTE: shown at once, the oldest one goes first
+constexpr uint32_t kApiTopicCount = 2;
+
+enum class ApiMessage : uint8_t {
+  // @NOTE: client to server
+  Subscribe = 1, // @NOTE: u32 ApiTopic bits, replaces the previous subscription
+  Overlay = 2, // @NOTE: u64 monitor identity or 0 for every monitor, u32 duration ms, string text; an empty text or 0 ms removes the overlays shown for that identity
+  // @NOTE: server to client
+  Hello = 64, // @NOTE: u16 protocol version, sent on connect
+  Layout = 65, // @NOTE: u16 count, per clock u64 monitor identity, i32 left, top, right, bottom of the monitor, u8 corner, u8 visible
+  Text = 66, // @NOTE: string time, string date or the zone line when the clocks show zones
+};
+
+enum ApiTopic : uint32_t {
+  kApiTopicLayout = 1 << 0,
+  kApiTopicText = 1 << 1,
+};
+
+struct ApiClock {
+  uint64_t identity = 0; // @NOTE: of the monitor, see monitor_identity
+  Rect monitor = { };
+  Corner corner = Corner::BottomRight;
+  bool visible = false;
+};
+
+inline bool operator ==(const ApiClock& lhs, const ApiClock& rhs) {
+  return (lhs.identity == rhs.identity) && (lhs.monitor == rhs.monitor) && (lhs.corner == rhs.corner) && (lhs.visible == rhs.visible);
+}
+
+struct ApiOverlayRequest {
+  uint64_t identity = 0; // @NOTE: of the monitor, 0 for every monitor
+  uint32_t duration_ms = 0;
+  std::string text; // @NOTE: UTF-8
+};
+
+struct ApiFrame {
+  ApiMessage type = ApiMessage::Hello;
+  const uint8_t* payload = nullptr;
+  uint32_t size = 0; // @NOTE: of the payload, the frame is kApiFrameHeader bytes more
+};
+
+enum class ApiParse : uint8_t {
+  Complete,
+  Incomplete, // @NOTE: wait for more bytes
+  Malformed, // @NOTE: larger than kApiMaxFrame
+};
+
+ApiParse api_parse_frame(const uint8_t* data, size_t size, ApiFrame& frame);
+
+// For clients.
+void api_encode_subscribe(std::vector<uint8_t>& out, uint32_t topics);
+void api_encode_overlay(std::vector<uint8_t>& out, const ApiOverlayRequest& request);
+bool api_decode_hello(const ApiFrame& frame, uint16_t& version);
+bool api_decode_layout(const ApiFrame& frame, std::vector<ApiClock>& clocks);
+bool api_decode_text(const ApiFrame& frame, std::string& time, std::string& date);
+bool api_decode_overlay(const ApiFrame& frame, ApiOverlayRequest& request);
+
+using ApiBuffer = std::shared_ptr<const std::vector<uint8_t>>;
+
+struct ApiQueued {
+  ApiBuffer frame;
+  uint32_t topic = 0; // @NOTE: ApiTopic, 0 for the hello
+};
+
+struct ApiClient {
+  uint32_t topics = 0;
+  std::vector<uint8_t> input; // @NOTE: the start of a frame still being received
+  std::deque<ApiQueued> output;
+  size_t sent = 0; // @NOTE: bytes of the front frame already written
+};
+
+struct ApiServerStats {
+  uint64_t connects = 0;
+  uint64_t refused = 0; // @NOTE: kApiMaxClients were connected
+  uint64_t disconnects = 0;
+  uint64_t malformed = 0; // @NOTE: clients dropped for a frame they should not have sent
+  uint64_t subscribes = 0;
+  uint64_t overlays = 0;
+  uint64_t flushes = 0; // @NOTE: with at least one topic changed
+  uint64_t encoded = 0; // @NOTE: frames
+  uint64_t encoded_bytes = 0;
+  uint64_t queued = 0; // @NOTE: references to encoded frames handed to clients
+  uint64_t coalesced = 0; // @NOTE: queued updates replaced by a newer one
+  uint64_t sent_bytes = 0;
+};
+
+struct ApiServer {
+  std::unordered_map<uint64_t, ApiClient> clients;
+  uint64_t next_client = 1;
+  uint32_t subscribers[kApiTopicCount] = { };
+  std::vector<ApiClock> layout;
+  std::string time; // @NOTE: UTF-8
+  std::string date;
+  uint32_t known = 0; // @NOTE: topics whose state was set at least once
+  uint32_t dirty = 0; // @NOTE: topics changed since the last flush
+  ApiBuffer current[kApiTopicCount]; // @NOTE: the encoded state, nullptr until needed
+  ApiBuffer hello;
+  std::vector<ApiOverlayRequest> overlays; // @NOTE: received, for the app to take
+  ApiServerStats stats;
+};
+
+// Returns the new client, 0 if it was refused. Queues the hello.
+uint64_t api_server_connect(ApiServer& server);
+void api_server_disconnect(ApiServer& server, uint64_t client);
+
+// Feeds bytes the client sent, in pieces of any size. Returns false if it
+// sent something malformed, the caller disconnects it.
+bool api_server_receive(ApiServer& server, uint64_t client, const uint8_t* data, size_t size);
+
+// Mark the topic dirty if the state differs.
+void api_server_set_layout(ApiServer& server, const std::vector<ApiClock>& clocks);
+void api_server_set_text(ApiServer& server, std::string_view time, std::string_view date);
+
+// Topics somebody subscribed to, the app skips producing the others.
+uint32_t api_server_topics(const ApiServer& server);
+
+// Hands every dirty topic to its subscribers. Returns the number of frames
+// encoded for it.
+uint32_t api_server_flush(ApiServer& server);
+
+bool api_client_pending(const ApiClient& client);
+
+// Takes `size` bytes off the front of the client's queue after they were
+// written, across frames.
+void api_client_sent(ApiServer& server, ApiClient& client, size_t size);
+
+// The overlay messages shown on the clocks, added from the requests of the
+// clients. Ids are never 0, the app passes them to the render thread with
+// the texts.
+struct ApiOverlay {
+  uint16_t id = 0;
+  uint64_t identity = 0; // @NOTE: of the monitor, 0 for every monitor
+  std::string text; // @NOTE: UTF-8
+  uint64_t expires_ms = 0; // @NOTE: monotonic
+};
+
+struct ApiOverlays {
+  std::vector<ApiOverlay> entries; // @NOTE: oldest first
+  uint16_t next_id = 1;
+};
+
+// Returns true if the entries changed.
+bool api_overlays_apply(ApiOverlays& overlays, const ApiOverlayRequest& request, uint64_t now_ms);
+bool api_overlays_expire(ApiOverlays& overlays, uint64_t now_ms);
+
+// 0 if nothing is shown.
+uint64_t api_overlays_next_expiry(const ApiOverlays& overlays);
+
+// The newest overlay for the monitor, 0 for none.
+uint16_t api_overlay_for(const ApiOverlays& overlays, uint64_t identity);
+
+#ifndef _WIN32
+// Unix domain socket transport, everything happens in api_socket_poll on
+// the thread that calls it.
+struct ApiSocketServer {
+  int listener = -1;
+  std::string path;
+  std::unordered_map<uint64_t, int> sockets; // @NOTE: client -> socket
+  std::vector<pollfd> polled; // @NOTE: scratch, the listener first
+  std::vector<uint64_t> polled_clients; // @NOTE: scratch, parallel to polled[1..]
+};
+
+// Replaces a stale socket file at `path`.
+bool api_socket_listen(ApiSocketServer& transport, const char* path);
+
+// Writes what the clients have pending, then waits up to `timeout_ms` to
+// accept connections and read what they sent.
+void api_socket_poll(ApiSocketServer& transport, ApiServer& server, int timeout_ms);
+
+// Writes what the clients have pending without waiting, e.g. right after a flush.
+void api_socket_send(ApiSocketServer& transport, ApiServer& server);
+
+void api_socket_close(ApiSocketServer& transport, ApiServer& server);
+#endif
@@ -0,0 +1,80 @@
+#include "clock_core.h"
+
+namespace {
+  bool has(uint32_t flags, TransientAppFlags flag) { return (flags & (1u << flag)) != 0; }
+}
+
+TickActions plan_tick(uint32_t flags) {
+  TickActions actions;
+  actions.reload_theme = has(flags, kTransientAppFlagColorModeChanged);
+  actions.reload_locale = has(flags, kTransientAppFlagLanguageOrRegionChanged);
+  actions.save_settings = has(flags, kTransientAppFlagSettingsChanged);
+  actions.reformat = has(flags, kTransientAppFlagPowerChanged);
+
+  // @NOTE: A display or settings change only needs the clocks that changed
+  // touched, a lost render target is handled by the render thread.
+  if (has(flags, kTransientAppFlagDisplayChanged)) {
+    actions.reconcile_clocks = true;
+    actions.rebuild_window_index = true;
+  } else if (has(flags, kTransientAppFlagSettingsChanged)) {
+    actions.reconcile_clocks = true;
+  }
+  if (has(flags, kTransientAppFlagResumed)) actions.rebuild_window_index = true;
+  return actions;
+}
+
+bool is_clock_hidden(Settings settings, bool on_primary_monitor, bool covered) {
+  return (on_primary_monitor && !settings.on_primary_display) || (covered && !settings.on_fullscreen);
+}
+
+Int2 compute_clock_window_size(Float2 dpi) {
+  constexpr float base_width = 205.0f;
+  constexpr float base_height = 48.0f;
+  return {static_cast<int>(base_width * dpi.x + 0.5f), static_cast<int>(base_height * dpi.y + 0.5f)};
+}
+
+Int2 fit_clock_window_size(Float2 dpi, Int2 content) {
+  constexpr float base_height = 48.0f;
+  const int padding = static_cast<int>((kClockPadding + kClockMargin) * dpi.x + 0.5f);
+  const int height = static_cast<int>(base_height * dpi.y + 0.5f);
+  return {content.x + padding, (content.y > height) ? content.y : height};
+}
+
+bool settle_clock_fit(ClockFit& fit, Int2 fitted, uint64_t now_ms) {
+  if ((fitted.x > fit.size.x) || (fitted.y > fit.size.y)) {
+    fit.size = {(fitted.x > fit.size.x) ? fitted.x : fit.size.x, (fitted.y > fit.size.y) ? fitted.y : fit.size.y};
+    fit.smaller_since_ms = 0;
+    return true;
+  }
+  if ((fitted.x == fit.size.x) && (fitted.y == fit.size.y)) {
+    fit.smaller_since_ms = 0;
+    return false;
+  }
+
+  if (fit.smaller_since_ms == 0) {
+    fit.peak = fitted;
+    fit.smaller_since_ms = (now_ms > 0) ? now_ms : 1;
+    return false;
+  }
+  fit.peak = {(fitted.x > fit.peak.x) ? fitted.x : fit.peak.x, (fitted.y > fit.peak.y) ? fitted.y : fit.peak.y};
+  if (now_ms - fit.smaller_since_ms < kClockShrinkDelayMs) return false;
+
+  // @NOTE: A few spare pixels are not worth a resize.
+  fit.smaller_since_ms = 0;
+  if ((fit.peak.x > fit.size.x - fit.size.x / kClockShrinkSlack) && (fit.peak.y > fit.size.y - fit.size.y / kClockShrinkSlack)) return false;
+  fit.size = fit.peak;
+  return true;
+}
+
+Int2 compute_clock_window_position(Int2 window_size, Int2 monitor_position, Int2 monitor_size, Corner corner) {
+  if (corner == Corner::BottomLeft)
+    return {monitor_position.x, monitor_position.y + monitor_size.y - window_size.y};
+
+  if (corner == Corner::BottomRight)
+    return {monitor_position.x + monitor_size.x - window_size.x, monitor_position.y + monitor_size.y - window_size.y};
+
+  if (corner == Corner::TopLeft)
+    return {monitor_position.x, monitor_position.y};
+
+  return {monitor_position.x + monitor_size.x - window_size.x, monitor_position.y};
+}
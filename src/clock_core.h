@@ -0,0 +1,59 @@
+#pragma once
+
+#include "base.h"
+#include "settings.h"
+
+// The platform-neutral decisions made on every tick: what a batch of change
+// notifications turns into, where a clock goes on its monitor and whether it
+// is shown. main.cpp only carries them out.
+
+enum TransientAppFlags : uint32_t {
+  kTransientAppFlagColorModeChanged = 1,
+  kTransientAppFlagLanguageOrRegionChanged = 2,
+  kTransientAppFlagSettingsChanged = 3,
+  kTransientAppFlagDisplayChanged = 4,
+  kTransientAppFlagPowerChanged = 5, // @NOTE: into Full or Reduced, see PowerMode
+  kTransientAppFlagResumed = 6, // @NOTE: out of Suspended, the hooks were ignored meanwhile
+};
+
+struct TickActions {
+  bool reload_theme = false;
+  bool reload_locale = false;
+  bool save_settings = false;
+  bool reconcile_clocks = false;
+  bool rebuild_window_index = false;
+  bool reformat = false; // @NOTE: the power mode decides whether the time has seconds
+};
+
+// `flags` has bit i set for each TransientAppFlags value i.
+TickActions plan_tick(uint32_t flags);
+
+bool is_clock_hidden(Settings settings, bool on_primary_monitor, bool covered);
+
+constexpr float kClockPadding = 15.0f; // @NOTE: DIP, on the corner side of the text
+constexpr float kClockMargin = 6.0f; // @NOTE: DIP, on the other side, room for overhanging ink
+
+// The size before the text was measured.
+Int2 compute_clock_window_size(Float2 dpi);
+
+// The size for `content` pixels of text, as high as the taskbar at least.
+Int2 fit_clock_window_size(Float2 dpi, Int2 content);
+
+constexpr uint64_t kClockShrinkDelayMs = 60'000;
+constexpr int kClockShrinkSlack = 16; // @NOTE: shrinks only by more than 1/16 of the size
+
+// The window size a surface settled on. It grows as soon as the text needs
+// more room but shrinks only after the text needed less for
+// kClockShrinkDelayMs, to the most it needed meanwhile and only by more
+// than the slack, so a metrics line switching between units does not
+// resize the windows every second.
+struct ClockFit {
+  Int2 size = { };
+  Int2 peak = { }; // @NOTE: the largest fitted size since `smaller_since_ms`
+  uint64_t smaller_since_ms = 0; // @NOTE: monotonic, 0 while the fitted size is not smaller
+};
+
+// Returns true if `fit.size` changed.
+bool settle_clock_fit(ClockFit& fit, Int2 fitted, uint64_t now_ms);
+
+Int2 compute_clock_window_position(Int2 window_size, Int2 monitor_position, Int2 monitor_size, Corner corner);
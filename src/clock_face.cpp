@@ -0,0 +1,282 @@
+#include "clock_face.h"
+#include "cpu.h"
+#include <math.h>
+
+namespace {
+  constexpr float kTau = 6.28318530718f;
+  constexpr float kFaceRadius = 0.98f;
+  constexpr float kFaceInvEdge = 1.0f / 0.05f;
+  constexpr float kArmLength = 0.78f;
+  constexpr int kMaxHands = 3;
+
+  // @NOTE: One segment from the center to (x, y). Coverage is
+  // smoothstep(edge0, edge0 + 1 / inv_edge_width, -distance), like the shader.
+  struct Hand {
+    float x, y;
+    float inv_length_sq;
+    float edge0, inv_edge_width;
+    float r, g, b;
+  };
+
+  struct FaceSetup {
+    Hand hands[kMaxHands];
+    int hand_count;
+    float x0, y0; // @NOTE: face coordinates of the center of pixel (0, 0)
+    float scale; // @NOTE: face units per pixel
+  };
+
+  Hand make_hand(float turns, float length, float edge0, float edge1, float r, float g, float b) {
+    const float x = length * sinf(turns * kTau);
+    const float y = length * cosf(turns * kTau);
+    return Hand{.x = x, .y = y, .inv_length_sq = 1.0f / (x * x + y * y), .edge0 = edge0, .inv_edge_width = 1.0f / (edge1 - edge0), .r = r, .g = g, .b = b};
+  }
+
+  // @NOTE: Same draw order as misc/icon.glsl: second, minute, hour.
+  FaceSetup make_setup(PixelView target, ClockFace face) {
+    FaceSetup setup = { };
+    if (face.seconds) setup.hands[setup.hand_count++] = make_hand(face.second, kArmLength, -0.12f, -0.10f, 1.0f, 0.0f, 0.0f);
+    setup.hands[setup.hand_count++] = make_hand(face.minute, kArmLength, -0.15f, -0.12f, 0.0f, 0.0f, 0.0f);
+    setup.hands[setup.hand_count++] = make_hand(face.hour, kArmLength * 2.0f / 3.0f, -0.15f, -0.12f, 0.0f, 0.0f, 0.0f);
+
+    const int side = (target.width < target.height) ? target.width : target.height;
+    setup.scale = 2.0f / static_cast<float>(side > 0 ? side : 1);
+    setup.x0 = (0.5f - 0.5f * static_cast<float>(target.width)) * setup.scale;
+    setup.y0 = (0.5f * static_cast<float>(target.height) - 0.5f) * setup.scale;
+    return setup;
+  }
+
+  float smooth01(float t) {
+    t = (t < 0.0f) ? 0.0f : ((t > 1.0f) ? 1.0f : t);
+    return t * t * (3.0f - 2.0f * t);
+  }
+
+  uint32_t pack(float r, float g, float b, float a) {
+    const uint32_t r8 = static_cast<uint32_t>(r * 255.0f + 0.5f);
+    const uint32_t g8 = static_cast<uint32_t>(g * 255.0f + 0.5f);
+    const uint32_t b8 = static_cast<uint32_t>(b * 255.0f + 0.5f);
+    const uint32_t a8 = static_cast<uint32_t>(a * 255.0f + 0.5f);
+    return b8 | (g8 << 8) | (r8 << 16) | (a8 << 24);
+  }
+
+  uint32_t shade(const FaceSetup& setup, float x, float y) {
+    const float a = smooth01((kFaceRadius - sqrtf(x * x + y * y)) * kFaceInvEdge);
+
+    float r = 1.0f, g = 1.0f, b = 1.0f;
+    for (int i = 0; i < setup.hand_count; ++i) {
+      const Hand& hand = setup.hands[i];
+      float h = (x * hand.x + y * hand.y) * hand.inv_length_sq;
+      h = (h < 0.0f) ? 0.0f : ((h > 1.0f) ? 1.0f : h);
+      const float dx = x - hand.x * h;
+      const float dy = y - hand.y * h;
+      const float coverage = smooth01((-sqrtf(dx * dx + dy * dy) - hand.edge0) * hand.inv_edge_width);
+      r = r + (hand.r - r) * coverage;
+      g = g + (hand.g - g) * coverage;
+      b = b + (hand.b - b) * coverage;
+    }
+    return pack(r * a, g * a, b * a, a);
+  }
+
+  // Shades pixels [begin, end) of row `y`.
+  void shade_row_scalar(const FaceSetup& setup, uint32_t* row, int begin, int end, float y) {
+    for (int i = begin; i < end; ++i) row[i] = shade(setup, setup.x0 + static_cast<float>(i) * setup.scale, y);
+  }
+
+  #if CPU_X86
+  __m128 smooth01_sse2(__m128 t) {
+    t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), t)));
+  }
+
+  __m128i to_byte_sse2(__m128 v) {
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+  }
+
+  // @NOTE: Same operations in the same order as shade(). Where the compiler
+  // contracts the scalar path into FMAs (e.g. -march=native) a channel may
+  // round one step apart, the bench holds the kernels to that.
+  int shade_row_sse2(const FaceSetup& setup, uint32_t* row, int width, float y) {
+    const __m128 vy = _mm_set1_ps(y);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+      const float fi = static_cast<float>(i);
+      const __m128 index = _mm_set_ps(fi + 3.0f, fi + 2.0f, fi + 1.0f, fi);
+      const __m128 x = _mm_add_ps(_mm_set1_ps(setup.x0), _mm_mul_ps(index, _mm_set1_ps(setup.scale)));
+
+      const __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(vy, vy)));
+      const __m128 a = smooth01_sse2(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(kFaceRadius), len), _mm_set1_ps(kFaceInvEdge)));
+
+      __m128 r = one, g = one, b = one;
+      for (int k = 0; k < setup.hand_count; ++k) {
+        const Hand& hand = setup.hands[k];
+        const __m128 hx = _mm_set1_ps(hand.x);
+        const __m128 hy = _mm_set1_ps(hand.y);
+        __m128 h = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(x, hx), _mm_mul_ps(vy, hy)), _mm_set1_ps(hand.inv_length_sq));
+        h = _mm_min_ps(_mm_max_ps(h, zero), one);
+        const __m128 dx = _mm_sub_ps(x, _mm_mul_ps(hx, h));
+        const __m128 dy = _mm_sub_ps(vy, _mm_mul_ps(hy, h));
+        const __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        const __m128 coverage = smooth01_sse2(_mm_mul_ps(_mm_sub_ps(_mm_sub_ps(zero, d), _mm_set1_ps(hand.edge0)), _mm_set1_ps(hand.inv_edge_width)));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(hand.r), r), coverage));
+        g = _mm_add_ps(g, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(hand.g), g), coverage));
+        b = _mm_add_ps(b, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(hand.b), b), coverage));
+      }
+
+      __m128i pixel = to_byte_sse2(_mm_mul_ps(b, a));
+      pixel = _mm_or_si128(pixel, _mm_slli_epi32(to_byte_sse2(_mm_mul_ps(g, a)), 8));
+      pixel = _mm_or_si128(pixel, _mm_slli_epi32(to_byte_sse2(_mm_mul_ps(r, a)), 16));
+      pixel = _mm_or_si128(pixel, _mm_slli_epi32(to_byte_sse2(a), 24));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), pixel);
+    }
+    return i;
+  }
+
+  // @NOTE: Everything is written out in one function so the whole body gets
+  // the AVX2 target without the rest of the file needing it.
+  CPU_TARGET_AVX2 int shade_row_avx2(const FaceSetup& setup, uint32_t* row, int width, float y) {
+    const __m256 vy = _mm256_set1_ps(y);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 three = _mm256_set1_ps(3.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 byte_scale = _mm256_set1_ps(255.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+      const float fi = static_cast<float>(i);
+      const __m256 index = _mm256_set_ps(fi + 7.0f, fi + 6.0f, fi + 5.0f, fi + 4.0f, fi + 3.0f, fi + 2.0f, fi + 1.0f, fi);
+      const __m256 x = _mm256_add_ps(_mm256_set1_ps(setup.x0), _mm256_mul_ps(index, _mm256_set1_ps(setup.scale)));
+
+      const __m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(vy, vy)));
+      __m256 a = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(kFaceRadius), len), _mm256_set1_ps(kFaceInvEdge));
+      a = _mm256_min_ps(_mm256_max_ps(a, zero), one);
+      a = _mm256_mul_ps(_mm256_mul_ps(a, a), _mm256_sub_ps(three, _mm256_mul_ps(two, a)));
+
+      __m256 r = one, g = one, b = one;
+      for (int k = 0; k < setup.hand_count; ++k) {
+        const Hand& hand = setup.hands[k];
+        const __m256 hx = _mm256_set1_ps(hand.x);
+        const __m256 hy = _mm256_set1_ps(hand.y);
+        __m256 h = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(x, hx), _mm256_mul_ps(vy, hy)), _mm256_set1_ps(hand.inv_length_sq));
+        h = _mm256_min_ps(_mm256_max_ps(h, zero), one);
+        const __m256 dx = _mm256_sub_ps(x, _mm256_mul_ps(hx, h));
+        const __m256 dy = _mm256_sub_ps(vy, _mm256_mul_ps(hy, h));
+        const __m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 coverage = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(zero, d), _mm256_set1_ps(hand.edge0)), _mm256_set1_ps(hand.inv_edge_width));
+        coverage = _mm256_min_ps(_mm256_max_ps(coverage, zero), one);
+        coverage = _mm256_mul_ps(_mm256_mul_ps(coverage, coverage), _mm256_sub_ps(three, _mm256_mul_ps(two, coverage)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(hand.r), r), coverage));
+        g = _mm256_add_ps(g, _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(hand.g), g), coverage));
+        b = _mm256_add_ps(b, _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(hand.b), b), coverage));
+      }
+
+      const __m256i b8 = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(b, a), byte_scale), half));
+      const __m256i g8 = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(g, a), byte_scale), half));
+      const __m256i r8 = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(r, a), byte_scale), half));
+      const __m256i a8 = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(a, byte_scale), half));
+      const __m256i pixel = _mm256_or_si256(_mm256_or_si256(b8, _mm256_slli_epi32(g8, 8)), _mm256_or_si256(_mm256_slli_epi32(r8, 16), _mm256_slli_epi32(a8, 24)));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + i), pixel);
+    }
+    return i;
+  }
+  #endif
+}
+
+ClockFace make_clock_face(CivilTime time, bool seconds, bool smooth) {
+  const float second = static_cast<float>(time.second % 60u) + (smooth ? static_cast<float>(time.milliseconds % 1000u) / 1000.0f : 0.0f);
+  const float minute = static_cast<float>(time.minute % 60u) + second / 60.0f;
+  const float hour = static_cast<float>(time.hour % 12u) + minute / 60.0f;
+  return ClockFace{.hour = hour / 12.0f, .minute = minute / 60.0f, .second = second / 60.0f, .seconds = seconds};
+}
+
+ClockFace make_icon_clock_face() {
+  return ClockFace{.hour = 0.375f, .minute = 0.75f, .second = 0.0f, .seconds = true};
+}
+
+ClockFaceKernel best_clock_face_kernel() {
+  #if CPU_X86
+  static const ClockFaceKernel kernel = cpu_has_avx2() ? ClockFaceKernel::Avx2 : ClockFaceKernel::Sse2;
+  return kernel;
+  #else
+  return ClockFaceKernel::Scalar;
+  #endif
+}
+
+const char* clock_face_kernel_name(ClockFaceKernel kernel) {
+  switch (kernel) {
+    case ClockFaceKernel::Scalar: return "scalar";
+    case ClockFaceKernel::Sse2: return "sse2";
+    case ClockFaceKernel::Avx2: return "avx2";
+  }
+  return "unknown";
+}
+
+void rasterize_clock_face(PixelView target, ClockFace face, ClockFaceKernel kernel) {
+  const FaceSetup setup = make_setup(target, face);
+
+  for (int y = 0; y < target.height; ++y) {
+    uint32_t* row = target.pixels + static_cast<ptrdiff_t>(y) * target.stride;
+    const float fy = setup.y0 - static_cast<float>(y) * setup.scale;
+
+    int done = 0;
+    #if CPU_X86
+    if (kernel == ClockFaceKernel::Avx2) done = shade_row_avx2(setup, row, target.width, fy);
+    else if (kernel == ClockFaceKernel::Sse2) done = shade_row_sse2(setup, row, target.width, fy);
+    #endif
+    shade_row_scalar(setup, row, done, target.width, fy);
+  }
+}
+
+void rasterize_seconds_arc(PixelView target, float turns, float r, float g, float b) {
+  const int side = (target.width < target.height) ? target.width : target.height;
+  const float radius = 0.5f * static_cast<float>(side) - 0.5f;
+  const float half_thickness = (radius * 0.15f > 0.75f) ? radius * 0.15f : 0.75f;
+  const float center_radius = radius - half_thickness;
+  const float cx = 0.5f * static_cast<float>(target.width);
+  const float cy = 0.5f * static_cast<float>(target.height);
+  constexpr float kTrackAlpha = 0.25f;
+
+  for (int y = 0; y < target.height; ++y) {
+    uint32_t* row = target.pixels + static_cast<ptrdiff_t>(y) * target.stride;
+    const float dy = static_cast<float>(y) + 0.5f - cy;
+    for (int x = 0; x < target.width; ++x) {
+      const float dx = static_cast<float>(x) + 0.5f - cx;
+      const float distance = fabsf(sqrtf(dx * dx + dy * dy) - center_radius) - half_thickness;
+      float coverage = 0.5f - distance;
+      coverage = (coverage < 0.0f) ? 0.0f : ((coverage > 1.0f) ? 1.0f : coverage);
+      if (coverage == 0.0f) {
+        row[x] = 0;
+        continue;
+      }
+
+      // @NOTE: Angle from twelve o'clock, clockwise, y grows downwards.
+      float angle = atan2f(dx, -dy) / kTau;
+      if (angle < 0.0f) angle += 1.0f;
+      const float a = coverage * ((angle <= turns) ? 1.0f : kTrackAlpha);
+      row[x] = pack(r * a, g * a, b * a, a);
+    }
+  }
+}
+
+float seconds_turns(CivilTime time) {
+  return (static_cast<float>(time.second % 60u) + static_cast<float>(time.milliseconds % 1000u) / 1000.0f) / 60.0f;
+}
+
+void unpremultiply(PixelView target) {
+  for (int y = 0; y < target.height; ++y) {
+    uint32_t* row = target.pixels + static_cast<ptrdiff_t>(y) * target.stride;
+    for (int x = 0; x < target.width; ++x) {
+      const uint32_t p = row[x];
+      const uint32_t a = p >> 24;
+      if ((a == 0) || (a == 255)) continue;
+
+      const uint32_t b = ((p & 0xff) * 255 + a / 2) / a;
+      const uint32_t g = (((p >> 8) & 0xff) * 255 + a / 2) / a;
+      const uint32_t r = (((p >> 16) & 0xff) * 255 + a / 2) / a;
+      row[x] = (a << 24) | ((r > 255 ? 255 : r) << 16) | ((g > 255 ? 255 : g) << 8) | (b > 255 ? 255 : b);
+    }
+  }
+}
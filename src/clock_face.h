@@ -0,0 +1,46 @@
+#pragma once
+
+#include "base.h"
+
+// CPU rasterizer for the analog clock face from misc/icon.glsl. The same
+// signed distance functions (a circle and three segments) are evaluated per
+// pixel into premultiplied BGRA, by a scalar reference or by SSE2/AVX2
+// kernels that process 4/8 pixels at a time.
+
+struct ClockFace {
+  float hour = 0.0f; // @NOTE: hand positions in turns, 0 = twelve o'clock, clockwise
+  float minute = 0.0f;
+  float second = 0.0f;
+  bool seconds = true; // @NOTE: draw the second hand
+};
+
+enum class ClockFaceKernel : uint8_t {
+  Scalar,
+  Sse2,
+  Avx2,
+};
+
+// With `smooth` the hands include the milliseconds and sweep.
+ClockFace make_clock_face(CivilTime time, bool seconds, bool smooth = false);
+
+// The fixed time shown by the app icon.
+ClockFace make_icon_clock_face();
+
+// Best kernel supported by this CPU and build.
+ClockFaceKernel best_clock_face_kernel();
+const char* clock_face_kernel_name(ClockFaceKernel kernel);
+
+// Fills the whole view. The face is centered and fits the shorter side.
+void rasterize_clock_face(PixelView target, ClockFace face, ClockFaceKernel kernel);
+
+// The smooth seconds indicator: a ring filled clockwise from twelve o'clock
+// up to `turns`, the rest of it a faint track. Fills the whole view, the
+// ring is centered and fits the shorter side. Scalar only, it is a few
+// hundred pixels.
+void rasterize_seconds_arc(PixelView target, float turns, float r, float g, float b);
+
+// Position of the sweeping second hand, in turns.
+float seconds_turns(CivilTime time);
+
+// Converts premultiplied pixels to straight alpha, as HICONs want them.
+void unpremultiply(PixelView target);
@@ -0,0 +1,83 @@
+#include "clock_table.h"
+#include "clock_core.h"
+#include <assert.h>
+
+std::vector<Monitor> clock_table_limit_monitors(const std::vector<Monitor>& monitors) {
+  if (monitors.size() <= kClockTableMaxClocks) return monitors;
+  return std::vector<Monitor>(monitors.begin(), monitors.begin() + kClockTableMaxClocks);
+}
+
+uint32_t clock_table_push(ClockTable& table, const ClockRow& row) {
+  const uint32_t index = clock_table_size(table);
+  assert((index < kClockTableMaxClocks) && "a clock past what a snapshot carries, see clock_table_limit_monitors");
+  table.monitor_rects.push_back(make_rect(row.monitor.position, row.monitor.size));
+  table.on_primary_monitor.push_back(is_primary_monitor(row.monitor));
+  table.hidden.push_back(row.hidden);
+  table.disabled.push_back(row.disabled);
+  table.surfaces.push_back(row.surface);
+  table.generations.push_back(row.generation);
+  table.windows.push_back(row.window);
+  table.monitors.push_back(row.monitor);
+  table.corners.push_back(row.corner);
+  table.contrasts.push_back(row.contrast);
+  table.alerts.push_back(row.alert);
+  table.overlays.push_back(row.overlay);
+  table.rows[row.window] = index;
+  return index;
+}
+
+ClockRow clock_table_row(const ClockTable& table, uint32_t row) {
+  return ClockRow{
+    .window = table.windows[row],
+    .monitor = table.monitors[row],
+    .corner = table.corners[row],
+    .contrast = table.contrasts[row],
+    .surface = table.surfaces[row],
+    .generation = table.generations[row],
+    .hidden = table.hidden[row] != 0,
+    .disabled = table.disabled[row] != 0,
+    .alert = table.alerts[row] != 0,
+    .overlay = table.overlays[row],
+  };
+}
+
+void clock_table_clear(ClockTable& table) {
+  table = { };
+}
+
+uint32_t clock_table_find(const ClockTable& table, uintptr_t window) {
+  auto it = table.rows.find(window);
+  return (it == table.rows.end()) ? kClockTableNone : it->second;
+}
+
+uint32_t clock_table_update_visibility(ClockTable& table, const WindowIndex& windows, Settings settings, std::vector<uint32_t>& toggled) {
+  uint32_t visible_count = 0;
+  const uint32_t count = clock_table_size(table);
+  const bool watched = windows.covered.size() == count; // @NOTE: see watch_monitor_rects
+  for (uint32_t i = 0; i < count; ++i) {
+    const bool covered = watched ? (windows.covered[i] != 0) : window_index_has_covering_window(windows, table.monitor_rects[i]);
+    const uint8_t hide = (table.disabled[i] != 0) || is_clock_hidden(settings, table.on_primary_monitor[i] != 0, covered);
+    if (hide != table.hidden[i]) {
+      table.hidden[i] = hide;
+      toggled.push_back(i);
+    }
+    visible_count += hide ^ 1u;
+  }
+  return visible_count;
+}
+
+void clock_table_fill_snapshot(const ClockTable& table, const SurfaceCache& surfaces, FrameSnapshot& snapshot) {
+  const uint32_t count = clock_table_size(table);
+  // @NOTE: Field by field, building a SnapshotClock and copying it stalls
+  // on store forwarding.
+  for (uint32_t i = 0; i < count; ++i) {
+    SnapshotClock& clock = snapshot.clocks[i];
+    clock.window = table.windows[i];
+    clock.surface = table.surfaces[i];
+    clock.key = surfaces.slots[table.surfaces[i]].key;
+    clock.generation = table.generations[i];
+    clock.monitor = table.monitor_rects[i];
+    clock.visible = table.hidden[i] == 0;
+  }
+  snapshot.clock_count = count;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "base.h"
+#include "backdrop.h"
+#include "render_queue.h"
+#include "settings.h"
+#include "surface_cache.h"
+#include "window_index.h"
+#include <unordered_map>
+#include <vector>
+
+// The clocks, one row per monitor, stored as a structure of arrays. The
+// fields every tick walks (visibility, surface, generation) sit in their
+// own contiguous arrays, the ones only touched when a monitor, the corner
+// or a backdrop changes are kept apart, so the per-tick passes stay tight
+// loops even with dozens of monitors.
+//
+// Rows are dense and keep the monitor order; `rows` maps a window handle
+// to its row so a lookup by handle does not scan the table.
+
+constexpr uint32_t kClockTableNone = 0xffffffff;
+constexpr uint32_t kClockTableMaxClocks = kSnapshotMaxClocks; // @NOTE: every clock has to fit a FrameSnapshot
+
+// One clock, for adding rows and for carrying a row over into a new table.
+struct ClockRow {
+  uintptr_t window = 0; // @NOTE: HWND on Windows
+  Monitor monitor = { }; // @NOTE: the monitor the clock was placed for
+  Corner corner = Corner::BottomRight;
+  BackdropContrast contrast = { };
+  uint32_t surface = 0; // @NOTE: SurfaceCache slot
+  uint32_t generation = 0; // @NOTE: see SnapshotClock::generation
+  bool hidden = false;
+  bool disabled = false; // @NOTE: its monitor's profile hides it, see MonitorProfile
+  bool alert = false; // @NOTE: an alarm for its monitor went off
+  uint16_t overlay = 0; // @NOTE: see SurfaceKey::overlay
+};
+
+struct ClockTable {
+  // @NOTE: hot
+  std::vector<Rect> monitor_rects;
+  std::vector<uint8_t> on_primary_monitor;
+  std::vector<uint8_t> hidden;
+  std::vector<uint8_t> disabled;
+  std::vector<uint32_t> surfaces;
+  std::vector<uint32_t> generations;
+
+  // @NOTE: cold
+  std::vector<uintptr_t> windows;
+  std::vector<Monitor> monitors;
+  std::vector<Corner> corners;
+  std::vector<BackdropContrast> contrasts;
+  std::vector<uint8_t> alerts;
+  std::vector<uint16_t> overlays;
+
+  std::unordered_map<uintptr_t, uint32_t> rows; // @NOTE: window -> row
+};
+
+inline uint32_t clock_table_size(const ClockTable& table) { return static_cast<uint32_t>(table.windows.size()); }
+
+// The monitors that get a clock: the first kClockTableMaxClocks, the rest
+// are never drawn. Callers place the clocks for these only.
+std::vector<Monitor> clock_table_limit_monitors(const std::vector<Monitor>& monitors);
+
+// Returns the row of the new clock. The table holds at most
+// kClockTableMaxClocks rows.
+uint32_t clock_table_push(ClockTable& table, const ClockRow& row);
+ClockRow clock_table_row(const ClockTable& table, uint32_t row);
+void clock_table_clear(ClockTable& table);
+
+// kClockTableNone if no clock has that window.
+uint32_t clock_table_find(const ClockTable& table, uintptr_t window);
+
+// The visibility pass of the tick. Appends the rows whose hidden state
+// flipped to `toggled`, the caller shows or hides their windows. Returns
+// the number of visible clocks. When `windows` watches the monitor rects
+// in row order its coverage flags are read directly, without hashing.
+uint32_t clock_table_update_visibility(ClockTable& table, const WindowIndex& windows, Settings settings, std::vector<uint32_t>& toggled);
+
+// Fills the clocks of a snapshot, every row fits.
+void clock_table_fill_snapshot(const ClockTable& table, const SurfaceCache& surfaces, FrameSnapshot& snapshot);
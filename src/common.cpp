@@ -1,7 +1,13 @@
 #include "common.h"
+#include "time_zone.h"
 #include <stdio.h>
+#include <string.h>
 #include <dwmapi.h>
 #include <shellscalingapi.h>
+#include <winsock2.h>
+#include <ws2ipdef.h>
+#include <iphlpapi.h>
+#include <wtsapi32.h>
 
 namespace {
   namespace registry {
@@ -13,27 +19,19 @@ namespace {
       return result;
     }
   }
-}
-
-Settings load_settings(const std::wstring& filename) {
-  FILE* f = _wfopen(filename.c_str(), L"rb");
-  if (!f) return { };
 
-  Settings settings;
-  bool ok = (fread(&settings, sizeof(settings), 1, f) == 1);
-
-  fclose(f);
-  return ok ? settings : Settings{ };
-}
+  // @NOTE: From winnt.h, spelled out so no GUID library has to be linked.
+  constexpr GUID kConsoleDisplayState = {0x6fe69556, 0x704a, 0x47a0, {0x8f, 0x24, 0xc2, 0x8d, 0x93, 0x6f, 0xda, 0x47}};
+  constexpr GUID kAcDcPowerSource = {0x5d3e9a59, 0xe9d5, 0x4b00, {0xa6, 0xbd, 0xff, 0x34, 0xff, 0x51, 0x65, 0x48}};
+  constexpr GUID kPowerSavingStatus = {0xe00958c0, 0xc213, 0x4ace, {0xac, 0x77, 0xfe, 0xcc, 0xed, 0x2e, 0xee, 0xa5}};
 
-bool save_settings(const std::wstring& filename, Settings settings) {
-  FILE* f = _wfopen(filename.c_str(), L"wb");
-  if (!f) return false;
-
-  bool ok = (fwrite(&settings, sizeof(settings), 1, f) == 1);
-
-  fclose(f);
-  return ok;
+  namespace locale_info {
+    std::wstring read_string(const std::wstring& locale, LCTYPE type) {
+      wchar_t buffer[128];
+      if (GetLocaleInfoEx(locale.c_str(), type, buffer, static_cast<int>(std::size(buffer))) == 0) return L"";
+      return buffer;
+    }
+  }
 }
 
 namespace common {
@@ -44,6 +42,43 @@ namespace common {
     return buffer + std::wstring(L"Win11Clock\\");
   }
 
+  bool map_file(const std::wstring& filename, MappedFile& mapped) {
+    mapped = { };
+    mapped.file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (mapped.file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mapped.file, &size) || (size.QuadPart == 0)) {
+      unmap_file(mapped);
+      return size.QuadPart == 0; // @NOTE: an empty file cannot be mapped but is valid
+    }
+
+    mapped.mapping = CreateFileMappingW(mapped.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    mapped.data = mapped.mapping ? static_cast<const char*>(MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (!mapped.data) {
+      unmap_file(mapped);
+      return false;
+    }
+    mapped.size = static_cast<size_t>(size.QuadPart);
+    return true;
+  }
+
+  void unmap_file(MappedFile& mapped) {
+    if (mapped.data) UnmapViewOfFile(mapped.data);
+    if (mapped.mapping) CloseHandle(mapped.mapping);
+    if (mapped.file != INVALID_HANDLE_VALUE) CloseHandle(mapped.file);
+    mapped = { };
+  }
+
+  uint64_t get_file_version(const std::wstring& filename) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(filename.c_str(), GetFileExInfoStandard, &data)) return 0;
+
+    const uint64_t write_time = (static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+    const uint64_t size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    return write_time ^ (size * 0x9e3779b97f4a7c15ull);
+  }
+
   std::wstring get_user_default_locale_name() {
     wchar_t buffer[LOCALE_NAME_MAX_LENGTH];
     if (GetUserDefaultLocaleName(buffer, static_cast<int>(std::size(buffer))) == 0) return L"";
@@ -72,44 +107,119 @@ namespace common {
     return result;
   }
 
-  std::wstring format_date(SYSTEMTIME time, const std::wstring& locale, const std::wstring& date_format) {
-    constexpr int stack_buffer_size = 128;
-    wchar_t stack_buffer[stack_buffer_size];
-
-    if (GetDateFormatEx(locale.c_str(), 0, &time, date_format.c_str(), stack_buffer, stack_buffer_size, nullptr) != 0)
-      return stack_buffer;
+  LocaleNames get_locale_names(const std::wstring& locale) {
+    LocaleNames result;
+    for (LCTYPE i = 0; i < 12; ++i) {
+      result.month_names[i] = locale_info::read_string(locale, LOCALE_SMONTHNAME1 + i);
+      result.genitive_month_names[i] = locale_info::read_string(locale, (LOCALE_SMONTHNAME1 + i) | LOCALE_RETURN_GENITIVE_NAMES);
+      result.abbreviated_month_names[i] = locale_info::read_string(locale, LOCALE_SABBREVMONTHNAME1 + i);
+    }
 
-    if (GetLastError() == ERROR_INSUFFICIENT_BUFFER) {
-      int required = GetDateFormatEx(locale.c_str(), 0, &time, date_format.c_str(), nullptr, 0, nullptr);
-      int required_no_null = required - 1;
+    // @NOTE: LOCALE_SDAYNAME1 is Monday, LocaleNames starts from Sunday like SYSTEMTIME.
+    for (LCTYPE i = 0; i < 7; ++i) {
+      result.day_names[(i + 1) % 7] = locale_info::read_string(locale, LOCALE_SDAYNAME1 + i);
+      result.abbreviated_day_names[(i + 1) % 7] = locale_info::read_string(locale, LOCALE_SABBREVDAYNAME1 + i);
+    }
 
-      std::wstring buffer(static_cast<size_t>(required_no_null), '\0'); // @NOTE: Since C++11 always allocates +1 for null
-      GetDateFormatEx(locale.c_str(), 0, &time, date_format.c_str(), buffer.data(), required, nullptr);
+    result.am = locale_info::read_string(locale, LOCALE_S1159);
+    result.pm = locale_info::read_string(locale, LOCALE_S2359);
+    return result;
+  }
 
-      return buffer;
+  bool is_gregorian_locale(const std::wstring& locale) {
+    DWORD calendar = CAL_GREGORIAN;
+    if (GetLocaleInfoEx(locale.c_str(), LOCALE_ICALENDARTYPE | LOCALE_RETURN_NUMBER, reinterpret_cast<LPWSTR>(&calendar), sizeof(calendar) / sizeof(wchar_t)) == 0) return true;
+
+    switch (calendar) {
+      case CAL_GREGORIAN:
+      case CAL_GREGORIAN_US:
+      case CAL_GREGORIAN_ME_FRENCH:
+      case CAL_GREGORIAN_ARABIC:
+      case CAL_GREGORIAN_XLIT_ENGLISH:
+      case CAL_GREGORIAN_XLIT_FRENCH: return true;
+      default: return false;
     }
-
-    return L"";
   }
 
-  std::wstring format_time(SYSTEMTIME time, const std::wstring& locale, const std::wstring& time_format) {
-    constexpr int stack_buffer_size = 128;
-    wchar_t stack_buffer[stack_buffer_size];
+  std::wstring format_date(const std::wstring& locale, const std::wstring& picture, CivilTime time) {
+    const SYSTEMTIME system_time = {
+      .wYear = time.year,
+      .wMonth = time.month,
+      .wDayOfWeek = time.day_of_week,
+      .wDay = time.day,
+    };
+    wchar_t buffer[kFormattedTextCapacity];
+    if (GetDateFormatEx(locale.c_str(), 0, &system_time, picture.c_str(), buffer, static_cast<int>(std::size(buffer)), nullptr) == 0) return L"";
+    return buffer;
+  }
 
-    if (GetTimeFormatEx(locale.c_str(), 0, &time, time_format.c_str(), stack_buffer, stack_buffer_size) != 0)
-      return stack_buffer;
+  CivilTime get_local_time() {
+    SYSTEMTIME time;
+    GetLocalTime(&time);
+    return CivilTime{
+      .year = time.wYear,
+      .month = time.wMonth,
+      .day_of_week = time.wDayOfWeek,
+      .day = time.wDay,
+      .hour = time.wHour,
+      .minute = time.wMinute,
+      .second = time.wSecond,
+      .milliseconds = time.wMilliseconds,
+    };
+  }
 
-    if (GetLastError() == ERROR_INSUFFICIENT_BUFFER) {
-      int required = GetTimeFormatEx(locale.c_str(), 0, &time, time_format.c_str(), nullptr, 0);
-      int required_no_null = required - 1;
+  int64_t get_unix_time_ms() {
+    FILETIME time;
+    GetSystemTimePreciseAsFileTime(&time);
+    const int64_t ticks = static_cast<int64_t>((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime);
+    return (ticks - 116444736000000000ll) / 10000; // @NOTE: 100 ns ticks since 1601
+  }
 
-      std::wstring buffer(static_cast<size_t>(required_no_null), '\0'); // @NOTE: Since C++11 always allocates +1 for null
-      GetTimeFormatEx(locale.c_str(), 0, &time, time_format.c_str(), buffer.data(), required);
+  int64_t local_wall_seconds_from_utc(int64_t utc_seconds) {
+    const uint64_t ticks = static_cast<uint64_t>(utc_seconds * 10000000ll + 116444736000000000ll);
+    const FILETIME utc_time = {.dwLowDateTime = static_cast<DWORD>(ticks), .dwHighDateTime = static_cast<DWORD>(ticks >> 32)};
+
+    SYSTEMTIME utc, local;
+    if (!FileTimeToSystemTime(&utc_time, &utc) || !SystemTimeToTzSpecificLocalTime(nullptr, &utc, &local)) return utc_seconds;
+
+    CivilTime civil = { };
+    civil.year = local.wYear;
+    civil.month = local.wMonth;
+    civil.day = local.wDay;
+    civil.hour = local.wHour;
+    civil.minute = local.wMinute;
+    civil.second = local.wSecond;
+    return unix_seconds_from_civil(civil);
+  }
 
-      return buffer;
+  bool sample_system_metrics(MetricsCounters& counters) {
+    // @NOTE: Kernel time includes the idle time. In 100 ns units.
+    FILETIME idle, kernel, user;
+    if (!GetSystemTimes(&idle, &kernel, &user)) return false;
+    auto ticks = [](FILETIME time) { return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+    counters.cpu_total = ticks(kernel) + ticks(user);
+    counters.cpu_busy = counters.cpu_total - ticks(idle);
+
+    MEMORYSTATUSEX memory = {.dwLength = sizeof(MEMORYSTATUSEX)};
+    if (!GlobalMemoryStatusEx(&memory)) return false;
+    counters.memory_total = memory.ullTotalPhys;
+    counters.memory_used = memory.ullTotalPhys - memory.ullAvailPhys;
+
+    // @NOTE: Physical adapters only. Filter drivers and virtual switches
+    // show up as interfaces of their own that count the same traffic again.
+    MIB_IF_TABLE2* table = nullptr;
+    if (GetIfTable2(&table) != NO_ERROR) return false;
+    counters.net_received = 0;
+    counters.net_sent = 0;
+    for (ULONG i = 0; i < table->NumEntries; ++i) {
+      const MIB_IF_ROW2& row = table->Table[i];
+      if (!row.InterfaceAndOperStatusFlags.HardwareInterface || row.InterfaceAndOperStatusFlags.FilterInterface || (row.Type == IF_TYPE_SOFTWARE_LOOPBACK)) continue;
+
+      counters.net_received += row.InOctets;
+      counters.net_sent += row.OutOctets;
     }
-
-    return L"";
+    FreeMibTable(table);
+    return true;
   }
 
   Int2 window_client_size(HWND window) {
@@ -133,7 +243,20 @@ namespace common {
       const Int2 size = { rect->right - rect->left, rect->bottom - rect->top };
       const Float2 dpi = common::get_dpi_scale(monitor);
 
-      monitors->push_back(Monitor{ .handle = monitor, .position = position, .size = size, .dpi = dpi });
+      // @NOTE: The device interface path is the same for a monitor on the
+      // same port across reconnects and reboots, unlike the HMONITOR and
+      // the \\.\DISPLAYn name. The name is the fallback.
+      uint64_t identity = 0;
+      MONITORINFOEXW info = { };
+      info.cbSize = sizeof(info);
+      if (GetMonitorInfoW(monitor, &info)) {
+        DISPLAY_DEVICEW device = { };
+        device.cb = sizeof(device);
+        const wchar_t* path = EnumDisplayDevicesW(info.szDevice, 0, &device, EDD_GET_DEVICE_INTERFACE_NAME) ? device.DeviceID : info.szDevice;
+        identity = monitor_identity(path, wcslen(path));
+      }
+
+      monitors->push_back(Monitor{ .handle = reinterpret_cast<uintptr_t>(monitor), .position = position, .size = size, .dpi = dpi, .identity = identity });
 
       return TRUE;
     };
@@ -143,25 +266,6 @@ namespace common {
     return result;
   }
 
-  Int2 compute_clock_window_size(Float2 dpi) {
-    constexpr float base_width = 205.0f;
-    constexpr float base_height = 48.0f;
-    return {static_cast<int>(base_width * dpi.x + 0.5f), static_cast<int>(base_height * dpi.y + 0.5f)};
-  }
-
-  Int2 compute_clock_window_position(Int2 window_size, Int2 monitor_position, Int2 monitor_size, Corner corner) {
-    if (corner == Corner::BottomLeft)
-      return {monitor_position.x, monitor_position.y + monitor_size.y - window_size.y};
-
-    if (corner == Corner::BottomRight)
-      return {monitor_position.x + monitor_size.x - window_size.x, monitor_position.y + monitor_size.y - window_size.y};
-
-    if (corner == Corner::TopLeft)
-      return {monitor_position.x, monitor_position.y};
-
-    return {monitor_position.x + monitor_size.x - window_size.x, monitor_position.y};
-  }
-
   std::vector<HWND> get_desktop_windows() {
     auto callback = [](HWND window, LPARAM lparam) -> BOOL {
       reinterpret_cast<std::vector<HWND>*>(lparam)->push_back(window);
@@ -174,20 +278,246 @@ namespace common {
     return result;
   }
 
-  bool monitor_has_fullscreen_window(HMONITOR monitor, const std::vector<HWND>& windows) {
-    MONITORINFO info = {.cbSize = sizeof(MONITORINFO)};
-    if (GetMonitorInfo(monitor, &info) == 0) return false;
+  bool is_top_level_window(HWND window) {
+    return GetAncestor(window, GA_PARENT) == GetDesktopWindow();
+  }
+
+  bool is_topmost_window(HWND window) {
+    return (GetWindowLongPtrW(window, GWL_EXSTYLE) & WS_EX_TOPMOST) != 0;
+  }
 
-    for (HWND window : windows) {
-      if (IsWindowVisible(window)) {
-        RECT wr;
-        if (DwmGetWindowAttribute(window, DWMWA_EXTENDED_FRAME_BOUNDS, &wr, static_cast<DWORD>(sizeof(wr))) == S_OK) {
-          if (EqualRect(&info.rcMonitor, &wr)) return true;
+  // @NOTE: True if a visible window above `window` in the z-order overlaps it.
+  bool is_window_covered(HWND window) {
+    RECT wr;
+    if (!GetWindowRect(window, &wr)) return false;
+
+    for (HWND above = GetWindow(window, GW_HWNDPREV); above; above = GetWindow(above, GW_HWNDPREV)) {
+      RECT ar, overlap;
+      if (IsWindowVisible(above) && GetWindowRect(above, &ar) && IntersectRect(&overlap, &wr, &ar)) return true;
+    }
+    return false;
+  }
+
+  WindowState get_window_state(HWND window) {
+    RECT wr;
+    if (DwmGetWindowAttribute(window, DWMWA_EXTENDED_FRAME_BOUNDS, &wr, static_cast<DWORD>(sizeof(wr))) != S_OK) return { };
+
+    return WindowState{.frame = {wr.left, wr.top, wr.right, wr.bottom}, .visible = IsWindowVisible(window) == TRUE};
+  }
+
+  void register_power_notifications(HWND window, PowerNotifications& notifications) {
+    const GUID* settings[] = {&kConsoleDisplayState, &kAcDcPowerSource, &kPowerSavingStatus};
+    static_assert(std::size(settings) == std::size(notifications.settings));
+    for (size_t i = 0; i < std::size(settings); ++i) notifications.settings[i] = RegisterPowerSettingNotification(window, settings[i], DEVICE_NOTIFY_WINDOW_HANDLE);
+    notifications.session = WTSRegisterSessionNotification(window, NOTIFY_FOR_THIS_SESSION) == TRUE;
+  }
+
+  void unregister_power_notifications(HWND window, PowerNotifications& notifications) {
+    for (HPOWERNOTIFY& setting : notifications.settings) {
+      if (setting) UnregisterPowerSettingNotification(setting);
+      setting = nullptr;
+    }
+    if (notifications.session) WTSUnRegisterSessionNotification(window);
+    notifications.session = false;
+  }
+
+  bool power_event_from_session(WPARAM change, PowerEvent& event) {
+    switch (change) {
+      case WTS_SESSION_LOCK: event = PowerEvent::Lock; return true;
+      case WTS_SESSION_UNLOCK: event = PowerEvent::Unlock; return true;
+      case WTS_CONSOLE_CONNECT:
+      case WTS_REMOTE_CONNECT: event = PowerEvent::SessionConnect; return true;
+      case WTS_CONSOLE_DISCONNECT:
+      case WTS_REMOTE_DISCONNECT: event = PowerEvent::SessionDisconnect; return true;
+    }
+    return false;
+  }
+
+  bool power_event_from_setting(const POWERBROADCAST_SETTING& setting, PowerEvent& event) {
+    if (setting.DataLength < sizeof(DWORD)) return false;
+
+    DWORD value;
+    memcpy(&value, setting.Data, sizeof(value));
+    if (IsEqualGUID(setting.PowerSetting, kConsoleDisplayState)) event = (value == 0) ? PowerEvent::DisplayOff : PowerEvent::DisplayOn; // @NOTE: 2 is dimmed
+    else if (IsEqualGUID(setting.PowerSetting, kAcDcPowerSource)) event = (value == static_cast<DWORD>(PoAc)) ? PowerEvent::AcPower : PowerEvent::BatteryPower;
+    else if (IsEqualGUID(setting.PowerSetting, kPowerSavingStatus)) event = (value != 0) ? PowerEvent::SaverOn : PowerEvent::SaverOff;
+    else return false;
+    return true;
+  }
+
+  struct ApiPipe {
+    OVERLAPPED read = { };
+    OVERLAPPED write = { };
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    uint64_t client = 0;
+    ApiPipeServer* transport = nullptr;
+    ApiBuffer writing_frame; // @NOTE: kept alive until its write completed
+    bool reading = false; // @NOTE: also while its completion routine runs
+    bool writing = false;
+    bool closed = false; // @NOTE: deleted once nothing is in flight
+    uint8_t buffer[4096] = { };
+  };
+
+  namespace {
+    void api_pipe_release(ApiPipe* pipe) {
+      if (pipe->closed && !pipe->reading && !pipe->writing) delete pipe;
+    }
+
+    // @NOTE: Closing cancels what is in flight, the completion routines
+    // still run with ERROR_OPERATION_ABORTED and release the pipe.
+    void api_pipe_drop(ApiPipe* pipe) {
+      if (pipe->closed) return;
+      pipe->closed = true;
+      ApiPipeServer& transport = *pipe->transport;
+      api_server_disconnect(*transport.server, pipe->client);
+      transport.pipes.erase(pipe->client);
+      CloseHandle(pipe->handle);
+      api_pipe_release(pipe);
+    }
+
+    void CALLBACK api_pipe_write_done(DWORD error, DWORD size, LPOVERLAPPED overlapped);
+
+    // @NOTE: One frame at a time, the front of the client's queue is never
+    // replaced, so the buffer stays put while it is written.
+    void api_pipe_write(ApiPipe* pipe) {
+      if (pipe->writing || pipe->closed) return;
+      ApiServer& server = *pipe->transport->server;
+      auto it = server.clients.find(pipe->client);
+      if ((it == server.clients.end()) || !api_client_pending(it->second)) return;
+
+      const ApiClient& client = it->second;
+      pipe->writing_frame = client.output.front().frame;
+      pipe->write = { };
+      const DWORD size = static_cast<DWORD>(pipe->writing_frame->size() - client.sent);
+      if (!WriteFileEx(pipe->handle, pipe->writing_frame->data() + client.sent, size, &pipe->write, api_pipe_write_done)) {
+        pipe->writing_frame.reset();
+        api_pipe_drop(pipe);
+        return;
+      }
+      pipe->writing = true;
+    }
+
+    void CALLBACK api_pipe_write_done(DWORD error, DWORD size, LPOVERLAPPED overlapped) {
+      ApiPipe* pipe = CONTAINING_RECORD(overlapped, ApiPipe, write);
+      pipe->writing = false;
+      pipe->writing_frame.reset();
+      if (pipe->closed) {
+        api_pipe_release(pipe);
+        return;
+      }
+      if (error != ERROR_SUCCESS) {
+        api_pipe_drop(pipe);
+        return;
+      }
+
+      ApiServer& server = *pipe->transport->server;
+      if (auto it = server.clients.find(pipe->client); it != server.clients.end()) api_client_sent(server, it->second, size);
+      api_pipe_write(pipe);
+    }
+
+    void CALLBACK api_pipe_read_done(DWORD error, DWORD size, LPOVERLAPPED overlapped);
+
+    void api_pipe_read(ApiPipe* pipe) {
+      pipe->read = { };
+      if (!ReadFileEx(pipe->handle, pipe->buffer, static_cast<DWORD>(sizeof(pipe->buffer)), &pipe->read, api_pipe_read_done)) {
+        api_pipe_drop(pipe);
+        return;
+      }
+      pipe->reading = true;
+    }
+
+    void CALLBACK api_pipe_read_done(DWORD error, DWORD size, LPOVERLAPPED overlapped) {
+      ApiPipe* pipe = CONTAINING_RECORD(overlapped, ApiPipe, read);
+      if (!pipe->closed) {
+        ApiPipeServer& transport = *pipe->transport;
+        if ((error != ERROR_SUCCESS) || !api_server_receive(*transport.server, pipe->client, pipe->buffer, size)) {
+          api_pipe_drop(pipe);
+        } else {
+          if (transport.received) transport.received();
+          api_pipe_write(pipe); // @NOTE: the state of new subscriptions
         }
       }
+
+      pipe->reading = false;
+      if (pipe->closed) {
+        api_pipe_release(pipe);
+        return;
+      }
+      api_pipe_read(pipe);
     }
 
-    return false;
+    // @NOTE: Starts connecting the next instance. A client that connected
+    // between creating and connecting it counts as connected as well.
+    void api_pipe_wait(ApiPipeServer& transport, bool first) {
+      DWORD session = 0;
+      ProcessIdToSessionId(GetCurrentProcessId(), &session);
+      wchar_t name[64];
+      swprintf(name, std::size(name), L"\\\\.\\pipe\\clock-api-%lu", session);
+
+      const DWORD open_mode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0u);
+      transport.waiting = CreateNamedPipeW(name, open_mode, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, PIPE_UNLIMITED_INSTANCES, 64 * 1024, kApiMaxFrame + kApiFrameHeader, 0, nullptr);
+      if (transport.waiting == INVALID_HANDLE_VALUE) return;
+
+      transport.connect = { };
+      transport.connect.hEvent = transport.connect_event;
+      const DWORD error = ConnectNamedPipe(transport.waiting, &transport.connect) ? ERROR_PIPE_CONNECTED : GetLastError();
+      if (error == ERROR_PIPE_CONNECTED) SetEvent(transport.connect_event);
+      else if (error != ERROR_IO_PENDING) {
+        CloseHandle(transport.waiting);
+        transport.waiting = INVALID_HANDLE_VALUE;
+      }
+    }
+  }
+
+  bool api_pipe_listen(ApiPipeServer& transport, ApiServer& server) {
+    transport.server = &server;
+    transport.connect_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!transport.connect_event) return false;
+
+    api_pipe_wait(transport, true);
+    return transport.waiting != INVALID_HANDLE_VALUE;
+  }
+
+  void api_pipe_accept(ApiPipeServer& transport) {
+    ResetEvent(transport.connect_event);
+    if (transport.waiting == INVALID_HANDLE_VALUE) return;
+
+    DWORD ignored = 0;
+    const bool connected = GetOverlappedResult(transport.waiting, &transport.connect, &ignored, FALSE) || (GetLastError() == ERROR_PIPE_CONNECTED);
+    const HANDLE handle = transport.waiting;
+    transport.waiting = INVALID_HANDLE_VALUE;
+    api_pipe_wait(transport, false);
+
+    const uint64_t client = connected ? api_server_connect(*transport.server) : 0;
+    if (!client) {
+      CloseHandle(handle);
+      return;
+    }
+    ApiPipe* pipe = new ApiPipe;
+    pipe->handle = handle;
+    pipe->client = client;
+    pipe->transport = &transport;
+    transport.pipes[client] = pipe;
+    api_pipe_write(pipe); // @NOTE: the hello
+    if (!pipe->closed) api_pipe_read(pipe);
+  }
+
+  void api_pipe_send(ApiPipeServer& transport) {
+    std::vector<ApiPipe*> pipes;
+    pipes.reserve(transport.pipes.size());
+    for (auto& [client, pipe] : transport.pipes) pipes.push_back(pipe);
+    for (ApiPipe* pipe : pipes) api_pipe_write(pipe); // @NOTE: a failed write only drops its own pipe
+  }
+
+  void api_pipe_close(ApiPipeServer& transport) {
+    std::vector<ApiPipe*> pipes;
+    for (auto& [client, pipe] : transport.pipes) pipes.push_back(pipe);
+    for (ApiPipe* pipe : pipes) api_pipe_drop(pipe);
+    if (transport.waiting != INVALID_HANDLE_VALUE) CloseHandle(transport.waiting);
+    transport.waiting = INVALID_HANDLE_VALUE;
+    while (SleepEx(0, TRUE) == WAIT_IO_COMPLETION) { } // @NOTE: lets the cancelled pipes go
+    if (transport.connect_event) CloseHandle(transport.connect_event);
+    transport.connect_event = nullptr;
   }
 
   bool read_use_light_theme_from_registry() {
@@ -3,67 +3,105 @@
 // @TODO: ugh, windows.h include in a header..
 #include <windows.h>
 #include <stdint.h>
+#include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
+#include "base.h"
+#include "clock_api.h"
+#include "clock_core.h"
+#include "datetime_format.h"
+#include "power_state.h"
+#include "settings.h"
+#include "system_metrics.h"
+#include "window_index.h"
 
-struct Int2 { int x, y; };
-
-struct Float2 { float x, y; };
-
-enum Corner : uint8_t {
-  BottomLeft = 0,
-  BottomRight = 1,
-  TopLeft = 2,
-  TopRight = 3,
-};
-
-inline bool is_left(Corner corner) { return (corner == Corner::BottomLeft) || (corner == Corner::TopLeft); }
-inline bool is_right(Corner corner) { return !is_left(corner); }
-
-struct Settings {
-  Corner corner = Corner::BottomRight;
-  bool long_date = false;
-  bool long_time = false;
-  bool on_primary_display = false;
-  bool on_fullscreen = false;
-};
-
-static_assert(sizeof(Settings) == 5);
-
-Settings load_settings(const std::wstring& filename);
-bool save_settings(const std::wstring& filename, Settings settings);
-
-inline bool operator ==(Settings lhs, Settings rhs) { return memcmp(&lhs, &rhs, sizeof(Settings)) == 0; }
-inline bool operator !=(Settings lhs, Settings rhs) { return !(lhs == rhs); }
+namespace common {
+  std::wstring get_temp_directory();
 
-struct Monitor {
-  HMONITOR handle = nullptr;
-  Int2 position = { };
-  Int2 size = { };
-  Float2 dpi = {1.0f, 1.0f};
-};
+  // @NOTE: Read-only view of a whole file, `data` stays valid until
+  // unmap_file.
+  struct MappedFile {
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+    const char* data = nullptr;
+    size_t size = 0;
+  };
 
-// https://devblogs.microsoft.com/oldnewthing/20070809-00/?p=25643
-inline bool is_primary_monitor(const Monitor& monitor) { return (monitor.position.x == 0) && (monitor.position.y == 0); }
+  bool map_file(const std::wstring& filename, MappedFile& mapped);
+  void unmap_file(MappedFile& mapped);
 
-namespace common {
-  std::wstring get_temp_directory();
+  // Last write time and size of a file, 0 if it does not exist.
+  uint64_t get_file_version(const std::wstring& filename);
 
   std::wstring get_user_default_locale_name();
   std::wstring get_date_format(const std::wstring& locale, DWORD format_flag);
   std::wstring get_time_format(const std::wstring& locale, DWORD format_flag);
-  std::wstring format_date(SYSTEMTIME time, const std::wstring& locale, const std::wstring& date_format);
-  std::wstring format_time(SYSTEMTIME time, const std::wstring& locale, const std::wstring& time_format);
+  LocaleNames get_locale_names(const std::wstring& locale);
+
+  // The locale's calendar (its LOCALE_ICALENDARTYPE) is Gregorian or one of
+  // its localized variants, see compile_text.
+  bool is_gregorian_locale(const std::wstring& locale);
+
+  // GetDateFormatEx in the locale's calendar, with the era and its years.
+  std::wstring format_date(const std::wstring& locale, const std::wstring& picture, CivilTime time);
+  CivilTime get_local_time();
+  int64_t get_unix_time_ms();
+  int64_t local_wall_seconds_from_utc(int64_t utc_seconds); // @NOTE: see calendar.h
+
+  // MetricsProvider for Windows, GetSystemTimes, GlobalMemoryStatusEx and
+  // GetIfTable2 in one pass.
+  bool sample_system_metrics(MetricsCounters& counters);
 
   Float2 get_dpi_scale(HMONITOR monitor);
   std::vector<Monitor> get_display_monitors();
 
   Int2 window_client_size(HWND window);
-  Int2 compute_clock_window_size(Float2 dpi);
-  Int2 compute_clock_window_position(Int2 window_size, Int2 monitor_position, Int2 monitor_size, Corner corner);
 
   std::vector<HWND> get_desktop_windows();
-  bool monitor_has_fullscreen_window(HMONITOR monitor, const std::vector<HWND>& windows);
+  bool is_top_level_window(HWND window);
+  bool is_topmost_window(HWND window);
+  bool is_window_covered(HWND window);
+  WindowState get_window_state(HWND window);
+
+  // @NOTE: Session changes and the power settings power_event_from_setting
+  // understands. Each setting is sent once right away with its current value.
+  struct PowerNotifications {
+    HPOWERNOTIFY settings[3] = { };
+    bool session = false;
+  };
+
+  void register_power_notifications(HWND window, PowerNotifications& notifications);
+  void unregister_power_notifications(HWND window, PowerNotifications& notifications);
+
+  // The PowerEvent a WM_WTSSESSION_CHANGE or a PBT_POWERSETTINGCHANGE stands
+  // for, false for the ones the app does not follow.
+  bool power_event_from_session(WPARAM change, PowerEvent& event);
+  bool power_event_from_setting(const POWERBROADCAST_SETTING& setting, PowerEvent& event);
+
+  // Named pipe transport for the local API, see clock_api.h. The pipe is
+  // \\.\pipe\clock-api-<session id>, local clients only. Reads and writes
+  // complete through ReadFileEx/WriteFileEx routines, which run in the
+  // alertable waits of the thread that listens. When `connect_event` is
+  // signaled a client connected, call api_pipe_accept.
+  struct ApiPipe;
+
+  struct ApiPipeServer {
+    ApiServer* server = nullptr;
+    HANDLE waiting = INVALID_HANDLE_VALUE; // @NOTE: the instance the next client connects to
+    OVERLAPPED connect = { };
+    HANDLE connect_event = nullptr;
+    std::unordered_map<uint64_t, ApiPipe*> pipes; // @NOTE: client -> pipe
+    std::function<void()> received = { }; // @NOTE: after a client's frames were handled
+  };
+
+  // False if the pipe cannot be created, e.g. another process has it.
+  bool api_pipe_listen(ApiPipeServer& transport, ApiServer& server);
+  void api_pipe_accept(ApiPipeServer& transport);
+
+  // Starts writing to every client with something pending, e.g. after a flush.
+  void api_pipe_send(ApiPipeServer& transport);
+  void api_pipe_close(ApiPipeServer& transport);
 
   bool read_use_light_theme_from_registry();
   void open_region_control_panel();
@@ -0,0 +1,26 @@
+#include "cpu.h"
+
+#if CPU_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+bool cpu_has_avx2() {
+  #if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) return false;
+
+  // @NOTE: The OS has to save the YMM registers too.
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || ((_xgetbv(0) & 6) != 6)) return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+  #else
+  return __builtin_cpu_supports("avx2");
+  #endif
+}
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+// CPU feature checks shared by the SIMD kernels. On x86 the SSE2 kernels
+// are always available, AVX2 ones are compiled with CPU_TARGET_AVX2 and
+// only called after cpu_has_avx2().
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define CPU_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define CPU_TARGET_AVX2
+#else
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define CPU_X86 0
+#endif
+
+#if CPU_X86
+bool cpu_has_avx2();
+#endif
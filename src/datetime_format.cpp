@@ -0,0 +1,313 @@
+#include "datetime_format.h"
+#include <algorithm>
+
+namespace {
+  uint32_t count_repeats(const std::wstring& picture, size_t at) {
+    uint32_t count = 1;
+    while ((at + count < picture.size()) && (picture[at + count] == picture[at])) ++count;
+    return count;
+  }
+
+  FormatTokenKind pick(uint32_t count, FormatTokenKind one, FormatTokenKind two) {
+    return (count == 1) ? one : two;
+  }
+
+  uint32_t field_of(FormatTokenKind kind) {
+    switch (kind) {
+      case FormatTokenKind::Literal: return 0;
+      case FormatTokenKind::Day:
+      case FormatTokenKind::Day2:
+      case FormatTokenKind::DayNameShort:
+      case FormatTokenKind::DayName: return kFormatFieldDay;
+      case FormatTokenKind::Month:
+      case FormatTokenKind::Month2:
+      case FormatTokenKind::MonthNameShort:
+      case FormatTokenKind::MonthName:
+      case FormatTokenKind::MonthNameGenitive: return kFormatFieldMonth;
+      case FormatTokenKind::Year:
+      case FormatTokenKind::Year2:
+      case FormatTokenKind::Year4: return kFormatFieldYear;
+      case FormatTokenKind::Hour12:
+      case FormatTokenKind::Hour12_2:
+      case FormatTokenKind::Hour24:
+      case FormatTokenKind::Hour24_2:
+      case FormatTokenKind::AmPmShort:
+      case FormatTokenKind::AmPm: return kFormatFieldHour;
+      case FormatTokenKind::Minute:
+      case FormatTokenKind::Minute2: return kFormatFieldMinute;
+      case FormatTokenKind::Second:
+      case FormatTokenKind::Second2: return kFormatFieldSecond;
+    }
+    return 0;
+  }
+
+  // @NOTE: Tokens that always render to the same number of characters can be
+  // patched in place without moving anything after them.
+  bool is_fixed_width(FormatTokenKind kind) {
+    return (kind == FormatTokenKind::Day2) || (kind == FormatTokenKind::Month2) ||
+      (kind == FormatTokenKind::Year2) || (kind == FormatTokenKind::Year4) ||
+      (kind == FormatTokenKind::Hour12_2) || (kind == FormatTokenKind::Hour24_2) ||
+      (kind == FormatTokenKind::Minute2) || (kind == FormatTokenKind::Second2);
+  }
+
+  uint32_t changed_fields(CivilTime a, CivilTime b) {
+    uint32_t result = 0;
+    if (a.second != b.second) result |= kFormatFieldSecond;
+    if (a.minute != b.minute) result |= kFormatFieldMinute;
+    if (a.hour != b.hour) result |= kFormatFieldHour;
+    if ((a.day != b.day) || (a.day_of_week != b.day_of_week)) result |= kFormatFieldDay;
+    if (a.month != b.month) result |= kFormatFieldMonth;
+    if (a.year != b.year) result |= kFormatFieldYear;
+    return result;
+  }
+
+  struct Writer {
+    wchar_t* out;
+    uint32_t capacity;
+    uint32_t length;
+
+    void put(wchar_t c) {
+      if (length + 1 < capacity) out[length++] = c;
+    }
+
+    void put(const wchar_t* s, size_t n) {
+      for (size_t i = 0; i < n; ++i) put(s[i]);
+    }
+
+    void put(const std::wstring& s) { put(s.data(), s.size()); }
+
+    void number(uint32_t value, uint32_t min_digits) {
+      wchar_t digits[10];
+      uint32_t n = 0;
+      do {
+        digits[n++] = static_cast<wchar_t>(L'0' + value % 10);
+        value /= 10;
+      } while (value != 0);
+      while (n < min_digits) digits[n++] = L'0';
+      while (n > 0) put(digits[--n]);
+    }
+  };
+
+  void write_token(Writer& w, const FormatProgram& program, const FormatToken& token, const LocaleNames& names, CivilTime time) {
+    const uint32_t hour12 = (time.hour % 12 == 0) ? 12u : static_cast<uint32_t>(time.hour % 12);
+    const std::wstring& ampm = (time.hour < 12) ? names.am : names.pm;
+    const uint32_t month = (time.month >= 1 && time.month <= 12) ? time.month - 1u : 0u;
+    const uint32_t weekday = time.day_of_week % 7u;
+
+    switch (token.kind) {
+      case FormatTokenKind::Literal: w.put(program.literals.data() + token.literal_offset, token.literal_length); break;
+      case FormatTokenKind::Day: w.number(time.day, 1); break;
+      case FormatTokenKind::Day2: w.number(time.day, 2); break;
+      case FormatTokenKind::DayNameShort: w.put(names.abbreviated_day_names[weekday]); break;
+      case FormatTokenKind::DayName: w.put(names.day_names[weekday]); break;
+      case FormatTokenKind::Month: w.number(time.month, 1); break;
+      case FormatTokenKind::Month2: w.number(time.month, 2); break;
+      case FormatTokenKind::MonthNameShort: w.put(names.abbreviated_month_names[month]); break;
+      case FormatTokenKind::MonthName: w.put(names.month_names[month]); break;
+      case FormatTokenKind::MonthNameGenitive: w.put(names.genitive_month_names[month]); break;
+      case FormatTokenKind::Year: w.number(time.year % 100u, 1); break;
+      case FormatTokenKind::Year2: w.number(time.year % 100u, 2); break;
+      case FormatTokenKind::Year4: w.number(time.year, 4); break;
+      case FormatTokenKind::Hour12: w.number(hour12, 1); break;
+      case FormatTokenKind::Hour12_2: w.number(hour12, 2); break;
+      case FormatTokenKind::Hour24: w.number(time.hour, 1); break;
+      case FormatTokenKind::Hour24_2: w.number(time.hour, 2); break;
+      case FormatTokenKind::Minute: w.number(time.minute, 1); break;
+      case FormatTokenKind::Minute2: w.number(time.minute, 2); break;
+      case FormatTokenKind::Second: w.number(time.second, 1); break;
+      case FormatTokenKind::Second2: w.number(time.second, 2); break;
+      case FormatTokenKind::AmPmShort: if (!ampm.empty()) w.put(ampm[0]); break;
+      case FormatTokenKind::AmPm: w.put(ampm); break;
+    }
+  }
+
+  void push_literal(FormatProgram& program, const wchar_t* s, size_t n) {
+    if (n == 0) return;
+
+    // @NOTE: Merge adjacent literals so that "', 'yyyy" is a single token.
+    if (!program.tokens.empty() && program.tokens.back().kind == FormatTokenKind::Literal) {
+      program.literals.append(s, n);
+      program.tokens.back().literal_length = static_cast<uint16_t>(program.tokens.back().literal_length + n);
+      return;
+    }
+
+    // @TODO: Anything past kMaxFormatTokens is dropped. No real locale picture comes close.
+    if (program.tokens.size() >= kMaxFormatTokens) return;
+
+    FormatToken token = {.kind = FormatTokenKind::Literal, .literal_offset = static_cast<uint16_t>(program.literals.size()), .literal_length = static_cast<uint16_t>(n)};
+    program.literals.append(s, n);
+    program.tokens.push_back(token);
+  }
+}
+
+FormatProgram compile_format(const std::wstring& picture) {
+  FormatProgram program;
+
+  // @NOTE: Windows uses the genitive month name when a day number is in the
+  // same picture, e.g. "d MMMM" in Slavic locales.
+  bool has_day_number = false;
+
+  size_t i = 0;
+  while (i < picture.size()) {
+    const wchar_t c = picture[i];
+
+    if (c == L'\'') {
+      ++i;
+      while (i < picture.size()) {
+        if (picture[i] == L'\'') {
+          if ((i + 1 < picture.size()) && (picture[i + 1] == L'\'')) {
+            push_literal(program, L"'", 1);
+            i += 2;
+            continue;
+          }
+          ++i;
+          break;
+        }
+        push_literal(program, &picture[i], 1);
+        ++i;
+      }
+      continue;
+    }
+
+    const uint32_t count = count_repeats(picture, i);
+    FormatTokenKind kind = FormatTokenKind::Literal;
+    switch (c) {
+      case L'd': kind = (count == 1) ? FormatTokenKind::Day : (count == 2) ? FormatTokenKind::Day2 : (count == 3) ? FormatTokenKind::DayNameShort : FormatTokenKind::DayName; break;
+      case L'M': kind = (count == 1) ? FormatTokenKind::Month : (count == 2) ? FormatTokenKind::Month2 : (count == 3) ? FormatTokenKind::MonthNameShort : FormatTokenKind::MonthName; break;
+      case L'y': kind = (count == 1) ? FormatTokenKind::Year : (count == 2) ? FormatTokenKind::Year2 : FormatTokenKind::Year4; break;
+      case L'h': kind = pick(count, FormatTokenKind::Hour12, FormatTokenKind::Hour12_2); break;
+      case L'H': kind = pick(count, FormatTokenKind::Hour24, FormatTokenKind::Hour24_2); break;
+      case L'm': kind = pick(count, FormatTokenKind::Minute, FormatTokenKind::Minute2); break;
+      case L's': kind = pick(count, FormatTokenKind::Second, FormatTokenKind::Second2); break;
+      case L't': kind = pick(count, FormatTokenKind::AmPmShort, FormatTokenKind::AmPm); break;
+      case L'g': i += count; continue; // @NOTE: Era, dropped. Only Gregorian dates are compiled, see compile_text.
+      default: push_literal(program, &picture[i], count); i += count; continue;
+    }
+
+    if ((kind == FormatTokenKind::Day) || (kind == FormatTokenKind::Day2)) has_day_number = true;
+
+    if (program.tokens.size() < kMaxFormatTokens) {
+      program.tokens.push_back(FormatToken{.kind = kind});
+      program.fields |= field_of(kind);
+    }
+    i += count;
+  }
+
+  if (has_day_number) {
+    for (FormatToken& token : program.tokens) {
+      if (token.kind == FormatTokenKind::MonthName) token.kind = FormatTokenKind::MonthNameGenitive;
+    }
+  }
+
+  return program;
+}
+
+bool render_format(const FormatProgram& program, const LocaleNames& names, CivilTime time, FormattedText& out) {
+  const uint32_t dirty = changed_fields(out.time, time) & program.fields;
+  if (out.valid && dirty == 0) {
+    out.time = time;
+    return false;
+  }
+
+  // @NOTE: A truncated render can't be patched, the offsets past the end are meaningless.
+  if (out.valid && (out.length + 1 < kFormattedTextCapacity)) {
+    bool patchable = true;
+    for (const FormatToken& token : program.tokens) {
+      if ((field_of(token.kind) & dirty) && !is_fixed_width(token.kind)) {
+        patchable = false;
+        break;
+      }
+    }
+
+    if (patchable) {
+      for (size_t i = 0; i < program.tokens.size(); ++i) {
+        const FormatToken& token = program.tokens[i];
+        if ((field_of(token.kind) & dirty) == 0) continue;
+
+        Writer w = {.out = out.text + out.offsets[i], .capacity = kFormattedTextCapacity - out.offsets[i], .length = 0};
+        write_token(w, program, token, names, time);
+      }
+      out.time = time;
+      return true;
+    }
+  }
+
+  Writer w = {.out = out.text, .capacity = kFormattedTextCapacity, .length = 0};
+  for (size_t i = 0; i < program.tokens.size(); ++i) {
+    out.offsets[i] = static_cast<uint16_t>(w.length);
+    write_token(w, program, program.tokens[i], names, time);
+  }
+  out.text[w.length] = L'\0';
+  out.length = w.length;
+  out.time = time;
+  out.valid = true;
+  return true;
+}
+
+FormatProgram compile_text(const std::wstring& text) {
+  FormatProgram program;
+  push_literal(program, text.data(), text.size());
+  return program;
+}
+
+// @NOTE: Interprets the picture directly and shares nothing with
+// compile_format and render_format but the Writer, so the bench can check
+// the two against each other.
+std::wstring format_picture(const std::wstring& picture, const LocaleNames& names, CivilTime time) {
+  bool has_day_number = false;
+  bool quoted = false;
+  for (size_t i = 0; i < picture.size(); ++i) {
+    if (picture[i] == L'\'') quoted = !quoted;
+    else if (!quoted && (picture[i] == L'd') && (count_repeats(picture, i) <= 2) && ((i == 0) || (picture[i - 1] != L'd'))) has_day_number = true;
+  }
+
+  const uint32_t hour12 = (time.hour % 12 == 0) ? 12u : static_cast<uint32_t>(time.hour % 12);
+  const std::wstring& ampm = (time.hour < 12) ? names.am : names.pm;
+  const uint32_t month = (time.month >= 1 && time.month <= 12) ? time.month - 1u : 0u;
+  const uint32_t weekday = time.day_of_week % 7u;
+
+  wchar_t buffer[kFormattedTextCapacity];
+  Writer w = {.out = buffer, .capacity = kFormattedTextCapacity, .length = 0};
+  size_t i = 0;
+  while (i < picture.size()) {
+    if (picture[i] == L'\'') {
+      for (++i; i < picture.size(); ++i) {
+        if (picture[i] != L'\'') w.put(picture[i]);
+        else if ((i + 1 < picture.size()) && (picture[i + 1] == L'\'')) w.put(picture[i++]);
+        else break;
+      }
+      ++i;
+      continue;
+    }
+
+    const uint32_t count = count_repeats(picture, i);
+    switch (picture[i]) {
+      case L'd':
+        if (count <= 2) w.number(time.day, count);
+        else w.put((count == 3) ? names.abbreviated_day_names[weekday] : names.day_names[weekday]);
+        break;
+      case L'M':
+        if (count <= 2) w.number(time.month, count);
+        else if (count == 3) w.put(names.abbreviated_month_names[month]);
+        else w.put(has_day_number ? names.genitive_month_names[month] : names.month_names[month]);
+        break;
+      case L'y':
+        if (count <= 2) w.number(time.year % 100u, count);
+        else w.number(time.year, 4);
+        break;
+      case L'h': w.number(hour12, std::min(count, 2u)); break;
+      case L'H': w.number(time.hour, std::min(count, 2u)); break;
+      case L'm': w.number(time.minute, std::min(count, 2u)); break;
+      case L's': w.number(time.second, std::min(count, 2u)); break;
+      case L't':
+        if (count > 1) w.put(ampm);
+        else if (!ampm.empty()) w.put(ampm[0]);
+        break;
+      case L'g': break;
+      default: w.put(picture.data() + i, count); break;
+    }
+    i += count;
+  }
+
+  return std::wstring(buffer, w.length);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "base.h"
+#include <string>
+#include <vector>
+
+// Locale date/time pictures ("H:mm", "dddd, MMMM d, yyyy", ...) compiled
+// once into a token program. Rendering a program writes into a fixed buffer,
+// patches only the fields that changed since the previous render and never
+// allocates.
+
+struct LocaleNames {
+  std::wstring month_names[12];
+  std::wstring genitive_month_names[12];
+  std::wstring abbreviated_month_names[12];
+  std::wstring day_names[7]; // 0 = Sunday
+  std::wstring abbreviated_day_names[7]; // 0 = Sunday
+  std::wstring am;
+  std::wstring pm;
+};
+
+enum FormatField : uint32_t {
+  kFormatFieldSecond = 1 << 0,
+  kFormatFieldMinute = 1 << 1,
+  kFormatFieldHour = 1 << 2,
+  kFormatFieldDay = 1 << 3,
+  kFormatFieldMonth = 1 << 4,
+  kFormatFieldYear = 1 << 5,
+};
+
+enum class FormatTokenKind : uint8_t {
+  Literal,
+  Day, Day2, DayNameShort, DayName,
+  Month, Month2, MonthNameShort, MonthName, MonthNameGenitive,
+  Year, Year2, Year4,
+  Hour12, Hour12_2, Hour24, Hour24_2,
+  Minute, Minute2,
+  Second, Second2,
+  AmPmShort, AmPm,
+};
+
+struct FormatToken {
+  FormatTokenKind kind = FormatTokenKind::Literal;
+  uint16_t literal_offset = 0;
+  uint16_t literal_length = 0;
+};
+
+constexpr uint32_t kMaxFormatTokens = 32;
+constexpr uint32_t kFormattedTextCapacity = 128;
+
+struct FormatProgram {
+  std::vector<FormatToken> tokens;
+  std::wstring literals;
+  uint32_t fields = 0; // see FormatField
+};
+
+struct FormattedText {
+  wchar_t text[kFormattedTextCapacity] = { };
+  uint32_t length = 0;
+  uint16_t offsets[kMaxFormatTokens] = { };
+  CivilTime time = { };
+  bool valid = false;
+};
+
+FormatProgram compile_format(const std::wstring& picture);
+
+// Returns true if the text changed.
+bool render_format(const FormatProgram& program, const LocaleNames& names, CivilTime time, FormattedText& out);
+
+// A program that renders `text` as it is. Pictures are compiled for the
+// Gregorian calendar only and drop the era ('g'), the app formats the dates
+// of locales with other calendars with the OS once a day and compiles the
+// result with this.
+FormatProgram compile_text(const std::wstring& text);
+
+// Reference implementation that re-parses the picture and allocates a new
+// string on every call, like the GetDateFormatEx/GetTimeFormatEx path did.
+std::wstring format_picture(const std::wstring& picture, const LocaleNames& names, CivilTime time);
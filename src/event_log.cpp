@@ -0,0 +1,485 @@
+#include "event_log.h"
+#include <iterator>
+#include <string.h>
+
+namespace {
+  const char* kEventKindNames[] = {
+    "start",
+    "tick",
+    "topmost_check",
+    "foreground",
+    "window_update",
+    "window_remove",
+    "wininichange",
+    "displaychange",
+    "devicechange",
+    "dpichanged",
+    "timechange",
+    "settings_change",
+    "backdrop",
+    "alarm",
+    "power",
+    "overlay",
+  };
+
+  static_assert(std::size(kEventKindNames) == static_cast<size_t>(EventKind::Count));
+
+  void put_u(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+      out.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+  }
+
+  void put_s(std::vector<uint8_t>& out, int64_t value) {
+    put_u(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+  }
+
+  void put_float(std::vector<uint8_t>& out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_u(out, bits);
+  }
+
+  void put_rect(std::vector<uint8_t>& out, Rect r) {
+    put_s(out, r.left);
+    put_s(out, r.top);
+    put_s(out, r.right);
+    put_s(out, r.bottom);
+  }
+
+  void put_string(std::vector<uint8_t>& out, const std::wstring& s) {
+    put_u(out, s.size());
+    for (wchar_t ch : s) put_u(out, static_cast<uint64_t>(ch));
+  }
+
+  void put_civil(std::vector<uint8_t>& out, CivilTime t) {
+    const uint16_t fields[] = {t.year, t.month, t.day_of_week, t.day, t.hour, t.minute, t.second, t.milliseconds};
+    for (uint16_t field : fields) put_u(out, field);
+  }
+
+  void put_settings(std::vector<uint8_t>& out, Settings s) {
+    put_u(out, static_cast<uint64_t>(s.corner));
+    put_u(out, (s.long_date ? 1u : 0u) | (s.long_time ? 2u : 0u) | (s.on_primary_display ? 4u : 0u) | (s.on_fullscreen ? 8u : 0u) | (s.analog ? 16u : 0u) | (s.smooth_seconds ? 32u : 0u) | (s.adaptive_contrast ? 64u : 0u) | (s.system_metrics ? 128u : 0u));
+  }
+
+  void put_profiles(std::vector<uint8_t>& out, const MonitorProfiles& profiles) {
+    put_u(out, profiles.size());
+    for (const MonitorProfile& profile : profiles) {
+      put_u(out, profile.identity);
+      put_u(out, profile.flags);
+      put_u(out, static_cast<uint64_t>(profile.corner));
+    }
+  }
+
+  struct ByteReader {
+    const uint8_t* p = nullptr;
+    const uint8_t* end = nullptr;
+    bool ok = true;
+  };
+
+  uint64_t get_u(ByteReader& in) {
+    uint64_t value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+      if (in.p == in.end) break;
+      const uint8_t byte = *in.p++;
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return value;
+    }
+    in.ok = false;
+    return 0;
+  }
+
+  int64_t get_s(ByteReader& in) {
+    const uint64_t value = get_u(in);
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  int get_int(ByteReader& in) {
+    return static_cast<int>(get_s(in));
+  }
+
+  float get_float(ByteReader& in) {
+    const uint32_t bits = static_cast<uint32_t>(get_u(in));
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  Rect get_rect(ByteReader& in) {
+    Rect r;
+    r.left = get_int(in);
+    r.top = get_int(in);
+    r.right = get_int(in);
+    r.bottom = get_int(in);
+    return r;
+  }
+
+  std::wstring get_string(ByteReader& in) {
+    const uint64_t length = get_u(in);
+    std::wstring s;
+    if (length > static_cast<uint64_t>(in.end - in.p)) { // @NOTE: every character takes at least a byte
+      in.ok = false;
+      return s;
+    }
+    s.resize(static_cast<size_t>(length));
+    for (wchar_t& ch : s) ch = static_cast<wchar_t>(get_u(in));
+    return s;
+  }
+
+  CivilTime get_civil(ByteReader& in) {
+    uint16_t fields[8];
+    for (uint16_t& field : fields) field = static_cast<uint16_t>(get_u(in));
+    return CivilTime{fields[0], fields[1], fields[2], fields[3], fields[4], fields[5], fields[6], fields[7]};
+  }
+
+  Settings get_settings(ByteReader& in) {
+    Settings s;
+    s.corner = static_cast<Corner>(get_u(in));
+    const uint64_t bits = get_u(in);
+    s.long_date = (bits & 1) != 0;
+    s.long_time = (bits & 2) != 0;
+    s.on_primary_display = (bits & 4) != 0;
+    s.on_fullscreen = (bits & 8) != 0;
+    s.analog = (bits & 16) != 0;
+    s.smooth_seconds = (bits & 32) != 0;
+    s.adaptive_contrast = (bits & 64) != 0;
+    s.system_metrics = (bits & 128) != 0;
+    return s;
+  }
+
+  MonitorProfiles get_profiles(ByteReader& in) {
+    MonitorProfiles profiles;
+    const uint64_t count = get_u(in);
+    for (uint64_t i = 0; (i < count) && in.ok; ++i) {
+      MonitorProfile profile;
+      profile.identity = get_u(in);
+      profile.flags = static_cast<uint8_t>(get_u(in));
+      profile.corner = static_cast<Corner>(get_u(in));
+      profiles.push_back(profile);
+    }
+    return profiles;
+  }
+
+  void put_window(std::vector<uint8_t>& out, const WindowEntry& window) {
+    put_u(out, window.id);
+    put_u(out, window.state.visible ? 1 : 0);
+    put_rect(out, window.state.frame);
+  }
+
+  WindowEntry get_window(ByteReader& in) {
+    WindowEntry window;
+    window.id = get_u(in);
+    window.state.visible = get_u(in) != 0;
+    window.state.frame = get_rect(in);
+    return window;
+  }
+
+  // @NOTE: Works on both const and mutable names.
+  template <typename Names, typename Fn>
+  void for_each_name(Names& names, Fn&& fn) {
+    for (auto& name : names.month_names) fn(name);
+    for (auto& name : names.genitive_month_names) fn(name);
+    for (auto& name : names.abbreviated_month_names) fn(name);
+    for (auto& name : names.day_names) fn(name);
+    for (auto& name : names.abbreviated_day_names) fn(name);
+    fn(names.am);
+    fn(names.pm);
+  }
+
+  void put_sections(std::vector<uint8_t>& out, const Event& event) {
+    put_u(out, event.sections);
+    if (event.sections & kEventSectionTheme) put_u(out, event.light_theme ? 1 : 0);
+    if (event.sections & kEventSectionLocale) {
+      put_string(out, event.pictures.short_date);
+      put_string(out, event.pictures.long_date);
+      put_string(out, event.pictures.short_time);
+      put_string(out, event.pictures.long_time);
+      for_each_name(event.names, [&](const std::wstring& name) { put_string(out, name); });
+    }
+    if (event.sections & kEventSectionMonitors) {
+      put_u(out, event.monitors.size());
+      for (const Monitor& monitor : event.monitors) {
+        put_u(out, monitor.handle);
+        put_s(out, monitor.position.x);
+        put_s(out, monitor.position.y);
+        put_s(out, monitor.size.x);
+        put_s(out, monitor.size.y);
+        put_float(out, monitor.dpi.x);
+        put_float(out, monitor.dpi.y);
+        put_u(out, monitor.identity);
+      }
+    }
+    if (event.sections & kEventSectionWindows) {
+      put_u(out, event.windows.size());
+      for (const WindowEntry& window : event.windows) put_window(out, window);
+    }
+  }
+
+  void get_sections(ByteReader& in, Event& event) {
+    event.sections = static_cast<uint32_t>(get_u(in));
+    if (event.sections & kEventSectionTheme) event.light_theme = get_u(in) != 0;
+    if (event.sections & kEventSectionLocale) {
+      event.pictures.short_date = get_string(in);
+      event.pictures.long_date = get_string(in);
+      event.pictures.short_time = get_string(in);
+      event.pictures.long_time = get_string(in);
+      for_each_name(event.names, [&](std::wstring& name) { name = get_string(in); });
+    }
+    if (event.sections & kEventSectionMonitors) {
+      const uint64_t count = get_u(in);
+      for (uint64_t i = 0; (i < count) && in.ok; ++i) {
+        Monitor monitor;
+        monitor.handle = static_cast<uintptr_t>(get_u(in));
+        monitor.position.x = get_int(in);
+        monitor.position.y = get_int(in);
+        monitor.size.x = get_int(in);
+        monitor.size.y = get_int(in);
+        monitor.dpi.x = get_float(in);
+        monitor.dpi.y = get_float(in);
+        monitor.identity = get_u(in);
+        event.monitors.push_back(monitor);
+      }
+    }
+    if (event.sections & kEventSectionWindows) {
+      const uint64_t count = get_u(in);
+      for (uint64_t i = 0; (i < count) && in.ok; ++i) event.windows.push_back(get_window(in));
+    }
+  }
+
+  bool write_bytes(FILE* f, const void* data, size_t size) {
+    return fwrite(data, 1, size, f) == size;
+  }
+}
+
+const char* event_kind_name(EventKind kind) {
+  const size_t index = static_cast<size_t>(kind);
+  return (index < std::size(kEventKindNames)) ? kEventKindNames[index] : "unknown";
+}
+
+bool event_log_begin(EventLogWriter& writer, FILE* file) {
+  writer = { };
+  writer.file = file;
+
+  const uint32_t header[2] = {kEventLogMagic, kEventLogVersion};
+  writer.bytes = sizeof(header);
+  return write_bytes(file, header, sizeof(header));
+}
+
+bool event_log_write(EventLogWriter& writer, const Event& event) {
+  if (!writer.file) return false;
+
+  std::vector<uint8_t>& payload = writer.payload;
+  payload.clear();
+  switch (event.kind) {
+    case EventKind::Start: {
+      put_civil(payload, event.civil);
+      put_settings(payload, event.settings);
+      put_profiles(payload, event.profiles);
+      put_sections(payload, event);
+      break;
+    }
+    case EventKind::Tick: {
+      put_civil(payload, event.civil);
+      put_u(payload, event.flags);
+      put_sections(payload, event);
+      break;
+    }
+    case EventKind::TopmostCheck: {
+      put_u(payload, event.lost.size());
+      for (bool lost : event.lost) put_u(payload, lost ? 1 : 0);
+      break;
+    }
+    case EventKind::Foreground: {
+      put_u(payload, (event.has_frame ? 1u : 0u) | (event.topmost ? 2u : 0u));
+      if (event.has_frame) put_rect(payload, event.frame);
+      break;
+    }
+    case EventKind::WindowUpdate: {
+      put_window(payload, event.windows.front());
+      break;
+    }
+    case EventKind::WindowRemove: {
+      put_u(payload, event.windows.front().id);
+      break;
+    }
+    case EventKind::WinIniChange:
+    case EventKind::Power: {
+      put_u(payload, event.flags);
+      break;
+    }
+    case EventKind::TimeChange: {
+      put_civil(payload, event.civil);
+      break;
+    }
+    case EventKind::SettingsChange: {
+      put_settings(payload, event.settings);
+      put_profiles(payload, event.profiles);
+      break;
+    }
+    case EventKind::Backdrop: {
+      put_u(payload, event.backdrops.size());
+      for (const BackdropEntry& entry : event.backdrops) {
+        put_u(payload, entry.clock);
+        put_u(payload, entry.sample.hash);
+        put_u(payload, entry.sample.mean);
+        put_u(payload, entry.sample.deviation);
+      }
+      break;
+    }
+    case EventKind::Alarm: {
+      put_u(payload, event.alerts.size());
+      for (bool alert : event.alerts) put_u(payload, alert ? 1 : 0);
+      break;
+    }
+    case EventKind::Overlay: {
+      put_u(payload, event.overlays.size());
+      for (uint16_t overlay : event.overlays) put_u(payload, overlay);
+      break;
+    }
+    case EventKind::DisplayChange:
+    case EventKind::DeviceChange:
+    case EventKind::DpiChange:
+    case EventKind::Count: {
+      break;
+    }
+  }
+
+  std::vector<uint8_t> head;
+  head.push_back(static_cast<uint8_t>(event.kind));
+  put_u(head, (event.time_ms >= writer.last_ms) ? event.time_ms - writer.last_ms : 0);
+  put_u(head, payload.size());
+  writer.last_ms = event.time_ms;
+
+  if (!write_bytes(writer.file, head.data(), head.size()) || !write_bytes(writer.file, payload.data(), payload.size())) return false;
+  writer.events++;
+  writer.bytes += head.size() + payload.size();
+  return true;
+}
+
+bool event_log_open(EventLogReader& reader, FILE* file) {
+  reader = { };
+  reader.file = file;
+
+  uint32_t header[2];
+  return (fread(header, 1, sizeof(header), file) == sizeof(header)) && (header[0] == kEventLogMagic) && (header[1] == kEventLogVersion);
+}
+
+bool event_log_read(EventLogReader& reader, Event& event) {
+  event = { };
+
+  const int kind = fgetc(reader.file);
+  if (kind == EOF) return false;
+
+  // @NOTE: The two varints of the record head, read a byte at a time.
+  uint64_t head[2] = { };
+  for (uint64_t& value : head) {
+    for (uint32_t shift = 0;; shift += 7) {
+      const int byte = fgetc(reader.file);
+      if ((byte == EOF) || (shift >= 64)) {
+        reader.failed = true;
+        return false;
+      }
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) break;
+    }
+  }
+
+  if ((kind >= static_cast<int>(EventKind::Count)) || (head[1] > (1u << 24))) {
+    reader.failed = true;
+    return false;
+  }
+
+  reader.payload.resize(static_cast<size_t>(head[1]));
+  if (fread(reader.payload.data(), 1, reader.payload.size(), reader.file) != reader.payload.size()) {
+    reader.failed = true;
+    return false;
+  }
+
+  reader.last_ms += head[0];
+  event.kind = static_cast<EventKind>(kind);
+  event.time_ms = reader.last_ms;
+
+  ByteReader in = {.p = reader.payload.data(), .end = reader.payload.data() + reader.payload.size()};
+  switch (event.kind) {
+    case EventKind::Start: {
+      event.civil = get_civil(in);
+      event.settings = get_settings(in);
+      event.profiles = get_profiles(in);
+      get_sections(in, event);
+      break;
+    }
+    case EventKind::Tick: {
+      event.civil = get_civil(in);
+      event.flags = static_cast<uint32_t>(get_u(in));
+      get_sections(in, event);
+      break;
+    }
+    case EventKind::TopmostCheck: {
+      const uint64_t count = get_u(in);
+      for (uint64_t i = 0; (i < count) && in.ok; ++i) event.lost.push_back(get_u(in) != 0);
+      break;
+    }
+    case EventKind::Foreground: {
+      const uint64_t bits = get_u(in);
+      event.has_frame = (bits & 1) != 0;
+      event.topmost = (bits & 2) != 0;
+      if (event.has_frame) event.frame = get_rect(in);
+      break;
+    }
+    case EventKind::WindowUpdate: {
+      event.windows.push_back(get_window(in));
+      break;
+    }
+    case EventKind::WindowRemove: {
+      event.windows.push_back(WindowEntry{.id = get_u(in)});
+      break;
+    }
+    case EventKind::WinIniChange:
+    case EventKind::Power: {
+      event.flags = static_cast<uint32_t>(get_u(in));
+      break;
+    }
+    case EventKind::TimeChange: {
+      event.civil = get_civil(in);
+      break;
+    }
+    case EventKind::SettingsChange: {
+      event.settings = get_settings(in);
+      event.profiles = get_profiles(in);
+      break;
+    }
+    case EventKind::Backdrop: {
+      const uint64_t count = get_u(in);
+      for (uint64_t i = 0; (i < count) && in.ok; ++i) {
+        BackdropEntry entry;
+        entry.clock = static_cast<uint32_t>(get_u(in));
+        entry.sample.hash = get_u(in);
+        entry.sample.mean = static_cast<uint8_t>(get_u(in));
+        entry.sample.deviation = static_cast<uint8_t>(get_u(in));
+        event.backdrops.push_back(entry);
+      }
+      break;
+    }
+    case EventKind::Alarm: {
+      const uint64_t count = get_u(in);
+      for (uint64_t i = 0; (i < count) && in.ok; ++i) event.alerts.push_back(get_u(in) != 0);
+      break;
+    }
+    case EventKind::Overlay: {
+      const uint64_t count = get_u(in);
+      for (uint64_t i = 0; (i < count) && in.ok; ++i) event.overlays.push_back(static_cast<uint16_t>(get_u(in)));
+      break;
+    }
+    case EventKind::DisplayChange:
+    case EventKind::DeviceChange:
+    case EventKind::DpiChange:
+    case EventKind::Count: {
+      break;
+    }
+  }
+
+  if (!in.ok) reader.failed = true;
+  return in.ok;
+}
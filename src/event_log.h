@@ -0,0 +1,124 @@
+#pragma once
+
+#include "backdrop.h"
+#include "base.h"
+#include "datetime_format.h"
+#include "settings.h"
+#include "window_index.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Binary log of every input the app reacts to, together with the answers
+// to the platform queries it made while reacting (monitors, windows, the
+// theme, the locale, lost z-order, the backdrop behind the clocks), so that
+// a session can be replayed offline and deterministically (see replay.h).
+//
+// The file is an 8 byte header followed by records:
+//
+//   kind (1 byte) | ms since the previous record | payload size | payload
+//
+// All integers are LEB128, signed ones zigzag encoded, so most records are
+// a handful of bytes.
+
+constexpr uint32_t kEventLogMagic = 0x4b4c4345; // @NOTE: "ECLK"
+constexpr uint32_t kEventLogVersion = 2; // @NOTE: 2 added the monitor identities and profiles
+
+enum class EventKind : uint8_t {
+  Start, // @NOTE: the state at startup, has every section
+  Tick, // @NOTE: the tick timer fired, `flags` are the pending TransientAppFlags
+  TopmostCheck, // @NOTE: the topmost timer fired, `lost` has one entry per checked clock
+  Foreground, // @NOTE: win_event_hook
+  WindowUpdate, // @NOTE: window_index_hook, `windows` has the one window
+  WindowRemove,
+  WinIniChange, // @NOTE: `flags` has kEventWinIni* bits
+  DisplayChange,
+  DeviceChange,
+  DpiChange,
+  TimeChange, // @NOTE: `civil` is the time after the change
+  SettingsChange, // @NOTE: from the tray menu
+  Backdrop, // @NOTE: the backdrop timer fired, `backdrops` has the clocks whose backdrop changed
+  Alarm, // @NOTE: an alarm went off or its alert ended, `alerts` has one entry per clock
+  Power, // @NOTE: `flags` is the PowerEvent
+  Overlay, // @NOTE: an overlay message was shown or ended, `overlays` has one id per clock
+  Count,
+};
+
+const char* event_kind_name(EventKind kind);
+
+enum EventWinIni : uint32_t {
+  kEventWinIniColorSet = 1 << 0,
+  kEventWinIniIntl = 1 << 1,
+};
+
+// Which of the optional query results a Start or Tick record carries.
+enum EventSection : uint32_t {
+  kEventSectionTheme = 1 << 0,
+  kEventSectionLocale = 1 << 1, // @NOTE: the format pictures and the locale names
+  kEventSectionMonitors = 1 << 2,
+  kEventSectionWindows = 1 << 3,
+};
+
+struct FormatPictures {
+  std::wstring short_date;
+  std::wstring long_date;
+  std::wstring short_time;
+  std::wstring long_time;
+};
+
+struct WindowEntry {
+  WindowId id = 0;
+  WindowState state = { };
+};
+
+struct BackdropEntry {
+  uint32_t clock = 0; // @NOTE: index into the clocks
+  BackdropSample sample = { };
+};
+
+struct Event {
+  EventKind kind = EventKind::Tick;
+  uint64_t time_ms = 0; // @NOTE: monotonic
+  uint32_t flags = 0;
+  uint32_t sections = 0; // see EventSection
+  CivilTime civil = { }; // @NOTE: Start, Tick and TimeChange
+  Settings settings = { }; // @NOTE: Start and SettingsChange
+  MonitorProfiles profiles = { }; // @NOTE: Start and SettingsChange
+  bool light_theme = false;
+  FormatPictures pictures = { };
+  LocaleNames names = { };
+  std::vector<Monitor> monitors = { };
+  std::vector<WindowEntry> windows = { };
+  Rect frame = { }; // @NOTE: Foreground, the new foreground window if `has_frame`
+  bool has_frame = false;
+  bool topmost = false;
+  std::vector<bool> lost = { };
+  std::vector<BackdropEntry> backdrops = { };
+  std::vector<bool> alerts = { };
+  std::vector<uint16_t> overlays = { }; // @NOTE: see SurfaceKey::overlay
+};
+
+struct EventLogWriter {
+  FILE* file = nullptr;
+  uint64_t last_ms = 0;
+  uint64_t events = 0;
+  uint64_t bytes = 0;
+  std::vector<uint8_t> payload; // @NOTE: scratch
+};
+
+// Writes the header. The writer does not own the file.
+bool event_log_begin(EventLogWriter& writer, FILE* file);
+bool event_log_write(EventLogWriter& writer, const Event& event);
+
+struct EventLogReader {
+  FILE* file = nullptr;
+  uint64_t last_ms = 0;
+  bool failed = false; // @NOTE: set when a record is truncated or malformed
+  std::vector<uint8_t> payload; // @NOTE: scratch
+};
+
+// Checks the header.
+bool event_log_open(EventLogReader& reader, FILE* file);
+
+// Returns false at the end of the log or when `failed` got set.
+bool event_log_read(EventLogReader& reader, Event& event);
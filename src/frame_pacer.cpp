@@ -0,0 +1,84 @@
+#include "frame_pacer.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+  // The latest slot that started at or before `now_us`.
+  uint64_t slot_at(const FramePacer& pacer, uint64_t now_us) {
+    return (now_us >= pacer.phase_us) ? (now_us - pacer.phase_us) / pacer.interval_us : 0;
+  }
+
+  uint32_t percentile(std::vector<uint32_t>& values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[static_cast<size_t>(p * static_cast<double>(values.size() - 1))];
+  }
+}
+
+uint64_t frame_pacer_slot_time(const FramePacer& pacer, uint64_t slot) {
+  return pacer.phase_us + slot * pacer.interval_us;
+}
+
+void frame_pacer_retarget(FramePacer& pacer, uint64_t interval_us, uint64_t phase_us, uint64_t now_us) {
+  pacer.interval_us = std::max<uint64_t>(interval_us, 1);
+  pacer.phase_us = phase_us % pacer.interval_us;
+  pacer.next_slot = slot_at(pacer, now_us);
+}
+
+FrameTiming frame_pacer_begin(FramePacer& pacer, uint64_t now_us) {
+  const uint64_t next_time = frame_pacer_slot_time(pacer, pacer.next_slot);
+  if (now_us < next_time) return FrameTiming{.render = false, .wait_us = next_time - now_us};
+
+  // @NOTE: Only the latest slot that started is worth rendering, the ones
+  // before it are gone.
+  const uint64_t slot = slot_at(pacer, now_us);
+  pacer.stats.dropped += slot - pacer.next_slot;
+  pacer.next_slot = slot + 1;
+
+  const uint64_t deadline = frame_pacer_slot_time(pacer, slot + 1);
+  if (deadline - now_us < pacer.estimate_us) {
+    pacer.stats.dropped++;
+    return FrameTiming{.render = false, .wait_us = deadline - now_us};
+  }
+
+  pacer.slot = slot;
+  pacer.frame_start_us = now_us;
+  return FrameTiming{.render = true, .wait_us = 0, .deadline_us = deadline};
+}
+
+void frame_pacer_end(FramePacer& pacer, uint64_t now_us) {
+  const uint64_t frame_us = (now_us > pacer.frame_start_us) ? now_us - pacer.frame_start_us : 0;
+  const uint64_t lateness_us = pacer.frame_start_us - frame_pacer_slot_time(pacer, pacer.slot);
+
+  pacer.stats.frames++;
+  if (now_us > frame_pacer_slot_time(pacer, pacer.slot + 1)) pacer.stats.missed++;
+
+  const uint32_t index = static_cast<uint32_t>(pacer.history++ & (kFramePacerHistory - 1));
+  pacer.frame_times_us[index] = static_cast<uint32_t>(std::min<uint64_t>(frame_us, UINT32_MAX));
+  pacer.lateness_us[index] = static_cast<uint32_t>(std::min<uint64_t>(lateness_us, UINT32_MAX));
+
+  // @NOTE: Capped so that one long frame cannot make the pacer give up on
+  // every slot after it.
+  const uint64_t estimate = (7 * static_cast<uint64_t>(pacer.estimate_us) + frame_us) / 8;
+  pacer.estimate_us = static_cast<uint32_t>(std::min<uint64_t>(estimate, pacer.interval_us * 3 / 4));
+}
+
+uint64_t frame_pacer_wait_us(const FramePacer& pacer, uint64_t now_us) {
+  const uint64_t next_time = frame_pacer_slot_time(pacer, pacer.next_slot);
+  return (now_us < next_time) ? next_time - now_us : 0;
+}
+
+FramePacerReport frame_pacer_report(const FramePacer& pacer) {
+  const size_t count = static_cast<size_t>(std::min<uint64_t>(pacer.history, kFramePacerHistory));
+  std::vector<uint32_t> frame_times(pacer.frame_times_us, pacer.frame_times_us + count);
+  std::vector<uint32_t> lateness(pacer.lateness_us, pacer.lateness_us + count);
+
+  return FramePacerReport{
+    .stats = pacer.stats,
+    .frame_p50_us = percentile(frame_times, 0.5),
+    .frame_p99_us = percentile(frame_times, 0.99),
+    .frame_max_us = percentile(frame_times, 1.0),
+    .lateness_p50_us = percentile(lateness, 0.5),
+    .lateness_p99_us = percentile(lateness, 0.99),
+  };
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "base.h"
+
+// Paces an animation to a fixed frame interval, usually the display refresh.
+// Frames are aligned to the slots `phase_us + k * interval_us` and each one
+// has until the next slot to finish. When a wakeup comes too late to make
+// its slot, e.g. after a stall, the pacer drops the slot and waits for the
+// next one it can still make instead of queueing the backlog, so a stall
+// costs frames but never adds latency.
+//
+// Times are microseconds on any monotonic clock.
+
+struct FramePacerStats {
+  uint64_t frames = 0;
+  uint64_t dropped = 0; // @NOTE: slots skipped because the wakeup or the previous frame was late
+  uint64_t missed = 0; // @NOTE: frames that finished after their deadline
+};
+
+constexpr uint32_t kFramePacerHistory = 512; // @NOTE: must be a power of two
+
+struct FramePacer {
+  uint64_t interval_us = 16667;
+  uint64_t phase_us = 0;
+  uint64_t next_slot = 0; // @NOTE: the first slot that may still be rendered
+  uint64_t slot = 0; // @NOTE: the slot of the frame in flight
+  uint64_t frame_start_us = 0;
+  uint32_t estimate_us = 0; // @NOTE: smoothed frame time, used to give up on a slot early
+  uint32_t frame_times_us[kFramePacerHistory] = { };
+  uint32_t lateness_us[kFramePacerHistory] = { }; // @NOTE: frame start after its slot
+  uint64_t history = 0; // @NOTE: samples written so far
+  FramePacerStats stats;
+};
+
+struct FrameTiming {
+  bool render = false; // @NOTE: false means wait `wait_us` and ask again
+  uint64_t wait_us = 0;
+  uint64_t deadline_us = 0;
+};
+
+struct FramePacerReport {
+  FramePacerStats stats;
+  uint32_t frame_p50_us = 0;
+  uint32_t frame_p99_us = 0;
+  uint32_t frame_max_us = 0;
+  uint32_t lateness_p50_us = 0;
+  uint32_t lateness_p99_us = 0;
+};
+
+// Changes the target, e.g. when the refresh rate changes. Keeps the stats.
+void frame_pacer_retarget(FramePacer& pacer, uint64_t interval_us, uint64_t phase_us, uint64_t now_us);
+
+uint64_t frame_pacer_slot_time(const FramePacer& pacer, uint64_t slot);
+
+// Call on every wakeup. Either starts a frame for the latest slot that can
+// still be made or says how long to wait for the next one.
+FrameTiming frame_pacer_begin(FramePacer& pacer, uint64_t now_us);
+
+// Call when the frame started by frame_pacer_begin is presented.
+void frame_pacer_end(FramePacer& pacer, uint64_t now_us);
+
+// Time until the next slot that may be rendered.
+uint64_t frame_pacer_wait_us(const FramePacer& pacer, uint64_t now_us);
+
+// Percentiles over the latest kFramePacerHistory frames.
+FramePacerReport frame_pacer_report(const FramePacer& pacer);
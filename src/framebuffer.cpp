@@ -0,0 +1,127 @@
+#include "framebuffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+  void* aligned_alloc_bytes(size_t size) {
+    #if defined(_MSC_VER)
+    return _aligned_malloc(size, kFramebufferAlignment);
+    #else
+    return aligned_alloc(kFramebufferAlignment, (size + kFramebufferAlignment - 1) / kFramebufferAlignment * kFramebufferAlignment);
+    #endif
+  }
+
+  void aligned_free_bytes(void* p) {
+    #if defined(_MSC_VER)
+    _aligned_free(p);
+    #else
+    free(p);
+    #endif
+  }
+
+  uint32_t* row_of(PixelView view, int y) {
+    return view.pixels + static_cast<ptrdiff_t>(y) * view.stride;
+  }
+}
+
+int framebuffer_stride_for(int width) {
+  constexpr int pixels_per_line = kFramebufferAlignment / static_cast<int>(sizeof(uint32_t));
+  return (width + pixels_per_line - 1) / pixels_per_line * pixels_per_line;
+}
+
+bool framebuffer_alloc(Framebuffer& fb, int width, int height) {
+  framebuffer_free(fb);
+
+  const int stride = framebuffer_stride_for(width);
+  void* storage = aligned_alloc_bytes(static_cast<size_t>(stride) * static_cast<size_t>(height) * sizeof(uint32_t));
+  if (!storage) return false;
+
+  memset(storage, 0, static_cast<size_t>(stride) * static_cast<size_t>(height) * sizeof(uint32_t));
+  fb.pixels = static_cast<uint32_t*>(storage);
+  fb.width = width;
+  fb.height = height;
+  fb.stride = stride;
+  fb.owned = storage;
+  return true;
+}
+
+void framebuffer_wrap(Framebuffer& fb, uint32_t* pixels, int width, int height, int stride) {
+  framebuffer_free(fb);
+  fb.pixels = pixels;
+  fb.width = width;
+  fb.height = height;
+  fb.stride = stride;
+}
+
+void framebuffer_free(Framebuffer& fb) {
+  if (fb.owned) aligned_free_bytes(fb.owned);
+  fb = { };
+}
+
+PixelView framebuffer_view(const Framebuffer& fb) {
+  return PixelView{.pixels = fb.pixels, .width = fb.width, .height = fb.height, .stride = fb.stride};
+}
+
+PixelView framebuffer_subview(const Framebuffer& fb, Rect rect) {
+  const Rect r = intersect_rect(rect, Rect{0, 0, fb.width, fb.height});
+  if (is_empty(r)) return { };
+
+  return PixelView{.pixels = fb.pixels + static_cast<ptrdiff_t>(r.top) * fb.stride + r.left, .width = r.right - r.left, .height = r.bottom - r.top, .stride = fb.stride};
+}
+
+void framebuffer_record_present(Framebuffer& fb, Rect rect) {
+  const Rect r = intersect_rect(rect, Rect{0, 0, fb.width, fb.height});
+  fb.stats.presents++;
+  fb.stats.bytes_presented += static_cast<uint64_t>(r.right - r.left) * static_cast<uint64_t>(r.bottom - r.top) * sizeof(uint32_t);
+}
+
+void fill_pixels(PixelView target, Rect rect, uint32_t color) {
+  const Rect r = intersect_rect(rect, Rect{0, 0, target.width, target.height});
+  if (is_empty(r)) return;
+
+  const size_t count = static_cast<size_t>(r.right - r.left);
+  for (int y = r.top; y < r.bottom; ++y) {
+    uint32_t* row = row_of(target, y) + r.left;
+    if (color == 0) {
+      memset(row, 0, count * sizeof(uint32_t));
+    } else {
+      for (size_t x = 0; x < count; ++x) row[x] = color;
+    }
+  }
+}
+
+void copy_pixels(PixelView target, Int2 position, PixelView source) {
+  const Rect r = intersect_rect(Rect{position.x, position.y, position.x + source.width, position.y + source.height}, Rect{0, 0, target.width, target.height});
+  if (is_empty(r)) return;
+
+  const size_t count = static_cast<size_t>(r.right - r.left);
+  for (int y = r.top; y < r.bottom; ++y) {
+    memcpy(row_of(target, y) + r.left, row_of(source, y - position.y) + (r.left - position.x), count * sizeof(uint32_t));
+  }
+}
+
+void blend_pixels(PixelView target, Int2 position, PixelView source, Rect clip) {
+  Rect r = intersect_rect(Rect{position.x, position.y, position.x + source.width, position.y + source.height}, Rect{0, 0, target.width, target.height});
+  r = intersect_rect(r, clip);
+  if (is_empty(r)) return;
+
+  for (int y = r.top; y < r.bottom; ++y) {
+    const uint32_t* src = row_of(source, y - position.y) - position.x;
+    uint32_t* dst = row_of(target, y);
+    for (int x = r.left; x < r.right; ++x) dst[x] = blend_over(dst[x], src[x]);
+  }
+}
+
+// @NOTE: Premultiplied src-over, exact to within rounding of x / 255.
+uint32_t blend_over(uint32_t dst, uint32_t src) {
+  const uint32_t alpha = src >> 24;
+  if (alpha == 255) return src;
+  if (alpha == 0) return dst;
+
+  const uint32_t inv = 255 - alpha;
+  uint32_t rb = (dst & 0x00ff00ff) * inv + 0x00800080;
+  rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+  uint32_t ag = ((dst >> 8) & 0x00ff00ff) * inv + 0x00800080;
+  ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+  return src + (rb | ag);
+}
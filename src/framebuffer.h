@@ -0,0 +1,48 @@
+#pragma once
+
+#include "base.h"
+
+// Directly addressable premultiplied BGRA pixels. On Windows the storage is
+// a DIB section that GDI reads from without an intermediate copy, elsewhere
+// an aligned heap block. Rows start on kFramebufferAlignment boundaries so
+// the kernels below can work on whole vectors.
+
+constexpr int kFramebufferAlignment = 64; // @NOTE: bytes
+
+struct FramebufferStats {
+  uint64_t bytes_presented = 0; // @NOTE: handed to the compositor, see framebuffer_record_present
+  uint64_t presents = 0;
+};
+
+struct Framebuffer {
+  uint32_t* pixels = nullptr;
+  int width = 0;
+  int height = 0;
+  int stride = 0; // @NOTE: in pixels
+  void* owned = nullptr; // @NOTE: set if the storage was allocated by framebuffer_alloc
+  FramebufferStats stats;
+};
+
+// Stride (in pixels) that keeps every row aligned.
+int framebuffer_stride_for(int width);
+
+bool framebuffer_alloc(Framebuffer& fb, int width, int height);
+
+// Wraps externally owned pixels, e.g. the bits of a DIB section.
+void framebuffer_wrap(Framebuffer& fb, uint32_t* pixels, int width, int height, int stride);
+
+void framebuffer_free(Framebuffer& fb);
+
+PixelView framebuffer_view(const Framebuffer& fb);
+
+// The part of the framebuffer covered by `rect`, clipped to the bounds.
+PixelView framebuffer_subview(const Framebuffer& fb, Rect rect);
+
+void framebuffer_record_present(Framebuffer& fb, Rect rect);
+
+// Kernels. `rect` is clipped to the target.
+void fill_pixels(PixelView target, Rect rect, uint32_t color);
+void copy_pixels(PixelView target, Int2 position, PixelView source);
+void blend_pixels(PixelView target, Int2 position, PixelView source, Rect clip); // @NOTE: premultiplied src-over
+
+uint32_t blend_over(uint32_t dst, uint32_t src);
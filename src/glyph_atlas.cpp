@@ -0,0 +1,166 @@
+#include "glyph_atlas.h"
+#include <string.h>
+
+namespace {
+  // Blends the tile with its pen at (pen_x, top), clipped to `clip`.
+  void blit_tile(const GlyphAtlas& atlas, const GlyphTile& tile, PixelView target, int pen_x, int top, Rect clip) {
+    const PixelView source = {
+      .pixels = const_cast<uint32_t*>(atlas.pixels.data()) + static_cast<ptrdiff_t>(tile.rect.top) * atlas.width + tile.rect.left,
+      .width = tile.rect.right - tile.rect.left,
+      .height = tile.rect.bottom - tile.rect.top,
+      .stride = atlas.width,
+    };
+    blend_pixels(target, Int2{pen_x - kGlyphPad, top}, source, clip);
+  }
+
+  int line_width(const GlyphAtlas& atlas, const wchar_t* text, uint32_t length) {
+    int width = 0;
+    for (uint32_t i = 0; i < length; ++i) width += glyph_atlas_find(atlas, text[i])->advance;
+    return width;
+  }
+
+  ComposedLine layout_line(const GlyphAtlas& atlas, TextLayout layout, const wchar_t* text, uint32_t length) {
+    ComposedLine line;
+    memcpy(line.text, text, length * sizeof(wchar_t));
+    line.length = length;
+    line.x = layout.align_right ? layout.right - line_width(atlas, text, length) : layout.left;
+    return line;
+  }
+
+  // Clears `clip` and redraws every glyph of the line that touches it.
+  void draw_line(const GlyphAtlas& atlas, PixelView target, const ComposedLine& line, int top, Rect clip) {
+    fill_pixels(target, clip, 0);
+
+    int pen = line.x;
+    for (uint32_t i = 0; i < line.length; ++i) {
+      const GlyphTile* tile = glyph_atlas_find(atlas, line.text[i]);
+      if ((pen + tile->advance + kGlyphPad > clip.left) && (pen - kGlyphPad < clip.right)) blit_tile(atlas, *tile, target, pen, top, clip);
+      pen += tile->advance;
+    }
+  }
+
+  Rect line_extent(const GlyphAtlas& atlas, const ComposedLine& line, int top) {
+    if (line.length == 0) return { };
+    return {line.x - kGlyphPad, top, line.x + line_width(atlas, line.text, line.length) + kGlyphPad, top + atlas.line_height};
+  }
+
+  // The part of the line that differs between `previous` and `current`.
+  Rect changed_span(const GlyphAtlas& atlas, const ComposedLine& previous, const ComposedLine& current, int top) {
+    const bool same_shape = (previous.x == current.x) && (previous.length == current.length) &&
+      (line_width(atlas, previous.text, previous.length) == line_width(atlas, current.text, current.length));
+
+    if (!same_shape) return union_rect(line_extent(atlas, previous, top), line_extent(atlas, current, top));
+
+    // @NOTE: Same start and same total advance, so the pens agree before the
+    // first and after the last changed character.
+    uint32_t first = 0;
+    while ((first < current.length) && (previous.text[first] == current.text[first])) first++;
+    if (first == current.length) return { };
+
+    uint32_t last = current.length - 1;
+    while ((last > first) && (previous.text[last] == current.text[last])) last--;
+
+    int pen = current.x;
+    int x0 = pen;
+    for (uint32_t i = 0; i <= last; ++i) {
+      if (i == first) x0 = pen;
+      pen += glyph_atlas_find(atlas, current.text[i])->advance;
+    }
+    return {x0 - kGlyphPad, top, pen + kGlyphPad, top + atlas.line_height};
+  }
+}
+
+void glyph_atlas_init(GlyphAtlas& atlas, int width, int height, int line_height) {
+  atlas.pixels.assign(static_cast<size_t>(width) * static_cast<size_t>(height), 0);
+  atlas.width = width;
+  atlas.height = height;
+  atlas.line_height = line_height;
+  atlas.shelf = { };
+  atlas.tiles.clear();
+}
+
+const GlyphTile* glyph_atlas_find(const GlyphAtlas& atlas, wchar_t ch) {
+  auto it = atlas.tiles.find(ch);
+  return (it != atlas.tiles.end()) ? &it->second : nullptr;
+}
+
+const GlyphTile* glyph_atlas_insert(GlyphAtlas& atlas, wchar_t ch, int advance) {
+  const int width = advance + 2 * kGlyphPad;
+  if (width > atlas.width) return nullptr;
+
+  // @NOTE: Every tile is one line high, so the shelves are too.
+  if (atlas.shelf.x + width > atlas.width) atlas.shelf = {0, atlas.shelf.y + atlas.line_height};
+  if (atlas.shelf.y + atlas.line_height > atlas.height) return nullptr;
+
+  const GlyphTile tile = {.rect = {atlas.shelf.x, atlas.shelf.y, atlas.shelf.x + width, atlas.shelf.y + atlas.line_height}, .advance = advance};
+  atlas.shelf.x += width;
+  return &(atlas.tiles[ch] = tile);
+}
+
+PixelView glyph_atlas_tile_pixels(GlyphAtlas& atlas, const GlyphTile& tile) {
+  return PixelView{
+    .pixels = atlas.pixels.data() + static_cast<ptrdiff_t>(tile.rect.top) * atlas.width + tile.rect.left,
+    .width = tile.rect.right - tile.rect.left,
+    .height = tile.rect.bottom - tile.rect.top,
+    .stride = atlas.width,
+  };
+}
+
+bool can_compose_text(const wchar_t* text, uint32_t length) {
+  if (length > kComposedLineCapacity) return false;
+
+  for (uint32_t i = 0; i < length; ++i) {
+    if ((text[i] >= 0xd800) && (text[i] <= 0xdfff)) return false; // @NOTE: surrogate pair halves
+  }
+  return true;
+}
+
+Rect compose_text(TextCompositor& compositor, const GlyphAtlas& atlas, PixelView target, TextLayout layout, const wchar_t* const* lines, const uint32_t* lengths, uint32_t line_count) {
+  const Rect bounds = {0, 0, target.width, target.height};
+  compositor.stats.frames++;
+
+  if (!compositor.valid || (compositor.line_count != line_count)) {
+    compose_text_full(atlas, target, layout, lines, lengths, line_count);
+    for (uint32_t i = 0; i < line_count; ++i) compositor.lines[i] = layout_line(atlas, layout, lines[i], lengths[i]);
+    compositor.line_count = line_count;
+    compositor.valid = true;
+    compositor.stats.full_redraws++;
+    compositor.stats.frame_pixels_touched = static_cast<uint32_t>(target.width * target.height);
+    compositor.stats.pixels_touched += compositor.stats.frame_pixels_touched;
+    return bounds;
+  }
+
+  Rect dirty = { };
+  compositor.stats.frame_pixels_touched = 0;
+  for (uint32_t i = 0; i < line_count; ++i) {
+    const int top = layout.top + static_cast<int>(i) * atlas.line_height;
+    const ComposedLine line = layout_line(atlas, layout, lines[i], lengths[i]);
+    const Rect span = intersect_rect(changed_span(atlas, compositor.lines[i], line, top), bounds);
+    compositor.lines[i] = line;
+    if (is_empty(span)) continue;
+
+    draw_line(atlas, target, line, top, span);
+    compositor.stats.frame_pixels_touched += static_cast<uint32_t>((span.right - span.left) * (span.bottom - span.top));
+    dirty = union_rect(dirty, span);
+  }
+
+  compositor.stats.pixels_touched += compositor.stats.frame_pixels_touched;
+  return dirty;
+}
+
+void compose_text_full(const GlyphAtlas& atlas, PixelView target, TextLayout layout, const wchar_t* const* lines, const uint32_t* lengths, uint32_t line_count) {
+  const Rect bounds = {0, 0, target.width, target.height};
+  fill_pixels(target, bounds, 0);
+
+  for (uint32_t i = 0; i < line_count; ++i) {
+    const int top = layout.top + static_cast<int>(i) * atlas.line_height;
+    const ComposedLine line = layout_line(atlas, layout, lines[i], lengths[i]);
+
+    int pen = line.x;
+    for (uint32_t j = 0; j < line.length; ++j) {
+      const GlyphTile* tile = glyph_atlas_find(atlas, line.text[j]);
+      blit_tile(atlas, *tile, target, pen, top, bounds);
+      pen += tile->advance;
+    }
+  }
+}
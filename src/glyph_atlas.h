@@ -0,0 +1,96 @@
+#pragma once
+
+#include "base.h"
+#include "framebuffer.h"
+#include <unordered_map>
+#include <vector>
+
+// Pre-rasterized glyphs for one (font, size, DPI, color), and a compositor
+// that builds the clock text out of them. After the first frame only the
+// characters that changed since the previous frame are cleared and
+// re-blitted; everything works on premultiplied BGRA so it does not care
+// who rasterized the glyphs.
+//
+// A tile is `kGlyphPad` pixels wider than the advance on both sides so that
+// overhanging ink is kept, neighbouring tiles are blended with src-over.
+
+constexpr int kGlyphPad = 2;
+constexpr int kGlyphAtlasSize = 512;
+constexpr uint32_t kComposedLineCapacity = 128;
+constexpr uint32_t kComposedMaxLines = 4; // @NOTE: time, date, the system metrics and an overlay message
+
+struct GlyphTile {
+  Rect rect = { }; // @NOTE: in atlas pixels, advance + 2 * kGlyphPad wide, line_height high
+  int advance = 0;
+};
+
+struct GlyphAtlas {
+  std::vector<uint32_t> pixels;
+  int width = 0;
+  int height = 0;
+  int line_height = 0;
+  Int2 shelf = { }; // @NOTE: next free position on the current shelf
+  std::unordered_map<wchar_t, GlyphTile> tiles;
+};
+
+void glyph_atlas_init(GlyphAtlas& atlas, int width, int height, int line_height);
+const GlyphTile* glyph_atlas_find(const GlyphAtlas& atlas, wchar_t ch);
+
+// Reserves a tile for `ch`, the caller rasterizes the glyph into
+// glyph_atlas_tile_pixels with its pen at (kGlyphPad, 0). Returns nullptr
+// when the atlas is full.
+const GlyphTile* glyph_atlas_insert(GlyphAtlas& atlas, wchar_t ch, int advance);
+PixelView glyph_atlas_tile_pixels(GlyphAtlas& atlas, const GlyphTile& tile);
+
+struct ComposedLine {
+  wchar_t text[kComposedLineCapacity] = { };
+  uint32_t length = 0;
+  int x = 0; // @NOTE: pen position of the first glyph
+};
+
+struct TextLayout {
+  int left = 0; // @NOTE: text is laid out between left and right
+  int right = 0;
+  int top = 0; // @NOTE: top of the first line
+  bool align_right = false;
+};
+
+struct TextCompositorStats {
+  uint64_t frames = 0;
+  uint64_t full_redraws = 0;
+  uint64_t pixels_touched = 0;
+  uint32_t frame_pixels_touched = 0;
+};
+
+struct TextCompositor {
+  ComposedLine lines[kComposedMaxLines];
+  uint32_t line_count = 0;
+  bool valid = false; // @NOTE: false = the target does not hold the previous frame
+  TextCompositorStats stats;
+};
+
+// True if every character can be composed from the atlas, i.e. it is in the
+// BMP and fits the line buffer.
+bool can_compose_text(const wchar_t* text, uint32_t length);
+
+// Adds tiles for the characters in `text` that are not in the atlas yet by
+// calling `rasterize(ch, tile pixels)`. `measure(ch)` returns the advance.
+// Returns false if the atlas ran out of space.
+template <typename Measure, typename Rasterize>
+bool glyph_atlas_ensure(GlyphAtlas& atlas, const wchar_t* text, uint32_t length, Measure&& measure, Rasterize&& rasterize) {
+  for (uint32_t i = 0; i < length; ++i) {
+    if (glyph_atlas_find(atlas, text[i])) continue;
+
+    const GlyphTile* tile = glyph_atlas_insert(atlas, text[i], measure(text[i]));
+    if (!tile) return false;
+    rasterize(text[i], glyph_atlas_tile_pixels(atlas, *tile));
+  }
+  return true;
+}
+
+// Composes the lines into `target`, touching only what changed since the
+// previous call. Returns the dirty rectangle, empty if nothing changed.
+Rect compose_text(TextCompositor& compositor, const GlyphAtlas& atlas, PixelView target, TextLayout layout, const wchar_t* const* lines, const uint32_t* lengths, uint32_t line_count);
+
+// Reference that clears and redraws everything.
+void compose_text_full(const GlyphAtlas& atlas, PixelView target, TextLayout layout, const wchar_t* const* lines, const uint32_t* lengths, uint32_t line_count);
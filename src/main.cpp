@@ -3,11 +3,14 @@
 #pragma comment(lib, "dwmapi.lib")
 #pragma comment(lib, "dwrite.lib")
 #pragma comment(lib, "gdi32.lib")
+#pragma comment(lib, "iphlpapi.lib")
 #pragma comment(lib, "shcore.lib")
 #pragma comment(lib, "shell32.lib")
 #pragma comment(lib, "user32.lib")
+#pragma comment(lib, "wtsapi32.lib")
 
 #include "common.h"
+#include "trace.h"
 #include <bitset>
 #include <windows.h>
 #include <shellapi.h>
@@ -15,95 +18,319 @@
 #include <d2d1.h>
 #include <dwrite.h>
 #include "common.cpp"
+#include "settings.cpp"
+#include "clock_core.cpp"
+#include "datetime_format.cpp"
+#include "tick_scheduler.cpp"
+#include "power_state.cpp"
+#include "frame_pacer.cpp"
+#include "time_zone.cpp"
+#include "surface_cache.cpp"
+#include "render_queue.cpp"
+#include "event_log.cpp"
+#include "window_index.cpp"
+#include "monitor_diff.cpp"
+#include "framebuffer.cpp"
+#include "glyph_atlas.cpp"
+#include "cpu.cpp"
+#include "clock_face.cpp"
+#include "backdrop.cpp"
+#include "topmost_guard.cpp"
+#include "clock_table.cpp"
+#include "startup_graph.cpp"
+#include "calendar.cpp"
+#include "timer_wheel.cpp"
+#include "alarms.cpp"
+#include "system_metrics.cpp"
+#include "text_metrics.cpp"
+#include "clock_api.cpp"
+#ifdef CLOCK_TRACE
+#include "trace.cpp"
+#endif
 
 constexpr UINT WM_CLOCK_NOTIFY_COMMAND = (WM_USER + 1);
+constexpr UINT_PTR kTickTimer = 1;
+constexpr UINT_PTR kTopmostTimer = 2;
+constexpr UINT_PTR kBackdropTimer = 3;
+constexpr UINT_PTR kCalendarTimer = 4; // @NOTE: on the calendar flyout
+constexpr UINT_PTR kAlarmTimer = 5; // @NOTE: one-shot, at the next alarm deadline
+constexpr UINT_PTR kSettingsTimer = 6; // @NOTE: one-shot, writes the settings, see SettingsWriteCoalescer
+constexpr UINT_PTR kApiTimer = 7; // @NOTE: formats the text for the API, only while somebody subscribed to it
+constexpr UINT_PTR kOverlayTimer = 8; // @NOTE: one-shot, at the next overlay expiry
+constexpr UINT kCalendarReindexMs = 2000;
+constexpr int64_t kCalendarAgendaDays = 14;
+constexpr size_t kCalendarAgendaRows = 8;
+constexpr Int2 kCalendarFlyoutSize = {300, 520}; // @NOTE: at 96 dpi
+constexpr uint32_t kStartupWorkers = 3;
 
 enum AppFlags : uint32_t {
   kAppFlagUseLightTheme = 0,
 };
 
-enum TransientAppFlags : uint32_t {
-  kTransientAppFlagRecreateRequested = 0,
-  kTransientAppFlagColorModeChanged = 1,
-  kTransientAppFlagLanguageOrRegionChanged = 2,
-  kTransientAppFlagSettingsChanged = 3,
-};
-
 struct DateTimeFormat {
   std::wstring locale;
-  std::wstring short_date;
-  std::wstring long_date;
-  std::wstring short_time;
-  std::wstring long_time;
+  FormatPictures pictures;
+  LocaleNames names;
+  FormatProgram short_date;
+  FormatProgram long_date;
+  FormatProgram short_time;
+  FormatProgram long_time;
+  bool os_dates = false; // @NOTE: the locale's calendar is not Gregorian, see update_os_dates
+  uint32_t os_dates_day = 0; // @NOTE: yyyymmdd the dates were formatted for
 };
 
+// @NOTE: The compiled pictures only know the Gregorian calendar and no eras.
+// With any other calendar the dates are formatted by GetDateFormatEx and
+// compiled to plain text, again whenever the day changes. The times do not
+// depend on the calendar. Returns true if the dates changed.
+bool update_os_dates(DateTimeFormat& format, CivilTime time) {
+  const uint32_t day = time.year * 10000u + time.month * 100u + time.day;
+  if (!format.os_dates || (format.os_dates_day == day)) return false;
+
+  format.os_dates_day = day;
+  format.short_date = compile_text(common::format_date(format.locale, format.pictures.short_date, time));
+  format.long_date = compile_text(common::format_date(format.locale, format.pictures.long_date, time));
+  return true;
+}
+
 void update_datetime_format(DateTimeFormat& format) {
   format.locale = common::get_user_default_locale_name();
-  format.short_date = common::get_date_format(format.locale, DATE_SHORTDATE);
-  format.long_date = common::get_date_format(format.locale, DATE_LONGDATE);
-  format.short_time = common::get_time_format(format.locale, TIME_NOSECONDS);
-  format.long_time = common::get_time_format(format.locale, 0);
+  format.names = common::get_locale_names(format.locale);
+  format.pictures = FormatPictures{
+    .short_date = common::get_date_format(format.locale, DATE_SHORTDATE),
+    .long_date = common::get_date_format(format.locale, DATE_LONGDATE),
+    .short_time = common::get_time_format(format.locale, TIME_NOSECONDS),
+    .long_time = common::get_time_format(format.locale, 0),
+  };
+  format.short_date = compile_format(format.pictures.short_date);
+  format.long_date = compile_format(format.pictures.long_date);
+  format.short_time = compile_format(format.pictures.short_time);
+  format.long_time = compile_format(format.pictures.long_time);
+  format.os_dates = !common::is_gregorian_locale(format.locale);
+  format.os_dates_day = 0;
+  update_os_dates(format, common::get_local_time());
 }
 
 struct DateTime {
-  std::wstring short_date;
-  std::wstring short_time;
-  std::wstring long_date;
-  std::wstring long_time;
+  FormattedText short_date;
+  FormattedText short_time;
+  FormattedText long_date;
+  FormattedText long_time;
 };
 
 void update_datetime(DateTime& datetime, const DateTimeFormat& format) {
-  SYSTEMTIME time;
-  GetLocalTime(&time);
-  datetime.short_date = common::format_date(time, format.locale, format.short_date);
-  datetime.long_date = common::format_date(time, format.locale, format.long_date);
-  datetime.short_time = common::format_time(time, format.locale, format.short_time);
-  datetime.long_time = common::format_time(time, format.locale, format.long_time);
+  TRACE_SCOPE(UpdateDateTime);
+  const CivilTime time = common::get_local_time();
+  render_format(format.short_date, format.names, time, datetime.short_date);
+  render_format(format.long_date, format.names, time, datetime.long_date);
+  render_format(format.short_time, format.names, time, datetime.short_time);
+  render_format(format.long_time, format.names, time, datetime.long_time);
 }
 
-struct ClockWindow {
-  HWND window = nullptr;
+// @NOTE: Rendering resources, shared by every clock with the same SurfaceKey.
+// Created, used and destroyed by the render thread only.
+struct Surface {
   ID2D1DCRenderTarget* rt = nullptr;
   ID2D1SolidColorBrush* brush = nullptr;
   HDC memory_dc = nullptr;
-  HBITMAP bitmap = nullptr;
+  HBITMAP bitmap = nullptr; // @NOTE: top-down 32 bpp DIB section, rows padded to the framebuffer stride
+  Framebuffer framebuffer; // @NOTE: wraps the bitmap's bits
   IDWriteTextFormat* text_format = nullptr;
-  float dpi_scale = 1.0f;
-  bool on_primary_monitor = false;
+  IDWriteTextFormat* glyph_format = nullptr; // @NOTE: leading/near aligned, for rasterizing single glyphs
+  Int2 size = { };
+  ClockFit fit; // @NOTE: what fit_surface settled on, see settle_clock_fit
+  GlyphAtlas atlas;
+  TextCompositor compositor;
+  uint64_t serial = 0; // @NOTE: number of renders so far
+  Rect dirty = { }; // @NOTE: what the latest render changed
+  SurfaceKey key;
+  std::wstring locale;
+  uint32_t generation = 0; // @NOTE: tells apart surfaces that reused a slot
+  uint64_t rendered_frame = 0; // @NOTE: Renderer::frame of the latest render
+  Rect face = { }; // @NOTE: where the analog face was drawn, the rest is clear
+  bool lost = false; // @NOTE: the render target has to be recreated
+};
+
+struct PresentedClock {
+  HWND window = nullptr;
+  uint32_t generation = 0; // @NOTE: SnapshotClock::generation
+  uint32_t surface_generation = 0;
+  uint64_t serial = 0; // @NOTE: Surface::serial the window shows
+};
+
+// @NOTE: Owns every rendering resource. After startup only the render
+// thread touches it, except for publishing to `queue` and setting `wake`.
+struct Renderer {
+  ID2D1Factory* d2d = nullptr;
+  IDWriteFactory* dwrite = nullptr;
+  std::vector<Surface> surfaces; // @NOTE: indexed by SurfaceCache slot
+  std::unordered_map<HWND, PresentedClock> presented;
+  uint32_t next_surface_generation = 0;
+  uint64_t frame = 0;
+  FrameSnapshot snapshot; // @NOTE: the latest one taken from the queue
+  FrameTexts texts;
+  FormattedText metrics_line;
+  MetricsSampler metrics; // @NOTE: only sampled while the snapshot shows the line
+  TextMetricsCache text_metrics; // @NOTE: sizes the surfaces, see fit_surface
+  TickScheduler scheduler;
+  FramePacer pacer; // @NOTE: drives the frames while the snapshot animates
+  HANDLE frame_timer = nullptr; // @NOTE: high resolution waitable timer for the pacer, may be missing
+  int64_t qpc_frequency = 1;
+  RenderQueue queue;
+  HANDLE wake = nullptr; // @NOTE: auto-reset event, set after publishing and to quit
+  HANDLE thread = nullptr;
+  std::atomic<bool> quit{false};
+  std::atomic<uint64_t> first_present_ns{0}; // @NOTE: startup_now_ns of the first present, 0 until then
+};
+
+// @NOTE: Scratch DIB the desktop behind a clock is copied into, grown to
+// the largest clock.
+struct BackdropCapture {
+  HDC dc = nullptr;
+  HBITMAP bitmap = nullptr;
+  uint32_t* pixels = nullptr;
+  Int2 size = { };
 };
 
 struct App {
   DateTimeFormat format;
   DateTime datetime;
   Settings settings;
-  std::vector<ClockWindow> clocks;
-  ID2D1Factory* d2d = nullptr;
-  IDWriteFactory* dwrite = nullptr;
+  MonitorProfiles profiles;
+  uint64_t settings_generation = 0; // @NOTE: see SettingsFile
+  SettingsWriteCoalescer settings_writes;
+  ClockTable clocks;
+  uint32_t next_clock_generation = 0;
+  SurfaceCache surface_cache;
+  WindowIndex windows;
+  TopmostGuard topmost;
   std::bitset<8> transient_flags; // see TransientAppFlags
   std::bitset<8> flags; // see AppFlags
   std::wstring settings_absolute_path;
+  std::wstring zones_absolute_path;
+  TimeZoneDatabase time_zones;
+  std::vector<ZoneClock> zones;
+  TickScheduler scheduler;
+  PowerState power;
+  common::PowerNotifications power_notifications;
+  HWND message_window = nullptr;
+  std::shared_ptr<const FrameFormat> frame_format;
+  FrameSnapshot published; // @NOTE: the latest snapshot handed to the renderer
+  Renderer renderer;
+  BackdropCapture backdrop;
+  EventLogWriter event_log; // @NOTE: only open when started with --record
+  Event recording; // @NOTE: the Start or Tick record being put together
+  StartupGraph startup;
+  std::wstring startup_report_path; // @NOTE: cleared once the report is written
+  std::wstring calendar_absolute_path;
+  CalendarIndex calendar;
+  uint64_t calendar_version = 0; // @NOTE: common::get_file_version of the indexed file
+  HWND calendar_window = nullptr;
+  int64_t calendar_month = 0; // @NOTE: wall clock seconds of the first of the shown month
+  std::wstring alarms_absolute_path;
+  Alarms alarms;
+  uint64_t alarms_version = 0; // @NOTE: common::get_file_version of the loaded file
+  ApiServer api;
+  common::ApiPipeServer api_pipe;
+  TickScheduler api_scheduler; // @NOTE: for the text topic
+  FrameTexts api_texts; // @NOTE: for the text topic
+  ApiOverlays overlays;
+  std::shared_ptr<const std::vector<SnapshotOverlay>> overlay_texts; // @NOTE: nullptr while none is shown
 };
 
+bool is_recording(const App& app) {
+  return app.event_log.file != nullptr;
+}
+
+void record_event(App& app, Event& event) {
+  if (!is_recording(app)) return;
+  event.time_ms = GetTickCount64();
+  event_log_write(app.event_log, event);
+}
+
+void record_event(App& app, EventKind kind) {
+  Event event = {.kind = kind};
+  record_event(app, event);
+}
+
+// @NOTE: Query results the current Start or Tick record has to carry for
+// the replay.
+void record_monitors(App& app, const std::vector<Monitor>& monitors) {
+  if (!is_recording(app)) return;
+  app.recording.sections |= kEventSectionMonitors;
+  app.recording.monitors = monitors;
+}
+
+void record_locale(App& app) {
+  if (!is_recording(app)) return;
+  app.recording.sections |= kEventSectionLocale;
+  app.recording.pictures = app.format.pictures;
+  app.recording.names = app.format.names;
+}
+
+void record_theme(App& app) {
+  if (!is_recording(app)) return;
+  app.recording.sections |= kEventSectionTheme;
+  app.recording.light_theme = app.flags.test(kAppFlagUseLightTheme);
+}
+
+// @NOTE: While suspended the changes pile up in transient_flags until the
+// resume expedites the tick.
+void expedite_tick(App& app) {
+  if (app.power.mode == PowerMode::Suspended) return;
+  if (tick_scheduler_expedite(app.scheduler, GetTickCount64(), kTickExpediteDelayMs))
+    SetTimer(app.message_window, kTickTimer, kTickExpediteDelayMs, nullptr);
+}
+
 DWRITE_TEXT_ALIGNMENT get_text_alignment_for(Corner corner) {
   return is_left(corner) ? DWRITE_TEXT_ALIGNMENT_LEADING : DWRITE_TEXT_ALIGNMENT_TRAILING;
 }
 
-ClockWindow create_clock_window(const Monitor& monitor, Corner corner, ID2D1Factory* d2d, App* app) {
-  constexpr DWORD window_style = WS_POPUP;
-  constexpr DWORD extended_window_style = WS_EX_TOOLWINDOW | WS_EX_TOPMOST | WS_EX_LAYERED | WS_EX_TRANSPARENT;
-  HWND window = CreateWindowExW(extended_window_style, L"clock-class", L"", window_style, 0, 0, CW_USEDEFAULT, CW_USEDEFAULT, nullptr, nullptr, GetModuleHandleW(nullptr), nullptr);
-  SetWindowLongPtrW(window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(app));
+int measure_line_height(const Renderer& renderer, IDWriteTextFormat* format) {
+  IDWriteTextLayout* layout = nullptr;
+  if (renderer.dwrite->CreateTextLayout(L"0", 1, format, 1000.0f, 1000.0f, &layout) != S_OK) return 1;
 
-  const Int2 size = common::compute_clock_window_size(monitor.dpi);
-  const Int2 position = common::compute_clock_window_position(size, monitor.position, monitor.size, corner);
-  const UINT show_flag = (is_primary_monitor(monitor) && !app->settings.on_primary_display) ? static_cast<UINT>(SWP_HIDEWINDOW) : static_cast<UINT>(SWP_SHOWWINDOW);
-  SetWindowPos(window, HWND_TOPMOST, position.x, position.y, size.x, size.y, SWP_NOACTIVATE | show_flag);
+  DWRITE_TEXT_METRICS metrics = { };
+  layout->GetMetrics(&metrics);
+  layout->Release();
+  return static_cast<int>(metrics.height + 0.999f);
+}
+
+int measure_glyph_advance(const Renderer& renderer, IDWriteTextFormat* format, wchar_t ch) {
+  IDWriteTextLayout* layout = nullptr;
+  if (renderer.dwrite->CreateTextLayout(&ch, 1, format, 1000.0f, 1000.0f, &layout) != S_OK) return 0;
+
+  DWRITE_TEXT_METRICS metrics = { };
+  layout->GetMetrics(&metrics);
+  layout->Release();
+  return static_cast<int>(metrics.widthIncludingTrailingWhitespace + 0.5f);
+}
+
+TextExtent measure_text_extent(const Renderer& renderer, IDWriteTextFormat* format, const wchar_t* text, uint32_t length) {
+  IDWriteTextLayout* layout = nullptr;
+  if (renderer.dwrite->CreateTextLayout(text, length, format, 10000.0f, 1000.0f, &layout) != S_OK) return { };
+
+  DWRITE_TEXT_METRICS metrics = { };
+  layout->GetMetrics(&metrics);
+  layout->Release();
+  return TextExtent{.width = static_cast<int>(metrics.widthIncludingTrailingWhitespace + 0.999f), .height = static_cast<int>(metrics.height + 0.999f)};
+}
 
-  HDC window_dc = GetDC(window);
-  HDC memory_dc = CreateCompatibleDC(window_dc);
-  HBITMAP bitmap = CreateCompatibleBitmap(window_dc, size.x, size.y);
+Surface create_surface(SurfaceKey key, const std::wstring& locale, Int2 size, Renderer& renderer) {
+  BITMAPINFO info = { };
+  info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+  info.bmiHeader.biWidth = framebuffer_stride_for(size.x); // @NOTE: keeps every row aligned
+  info.bmiHeader.biHeight = -size.y; // @NOTE: top-down
+  info.bmiHeader.biPlanes = 1;
+  info.bmiHeader.biBitCount = 32;
+  info.bmiHeader.biCompression = BI_RGB;
+
+  HDC screen_dc = GetDC(nullptr);
+  HDC memory_dc = CreateCompatibleDC(screen_dc);
+  void* bits = nullptr;
+  HBITMAP bitmap = CreateDIBSection(screen_dc, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
   SelectObject(memory_dc, bitmap);
-  ReleaseDC(window, window_dc);
+  ReleaseDC(nullptr, screen_dc);
 
   D2D1_RENDER_TARGET_PROPERTIES props = { };
   props.type = D2D1_RENDER_TARGET_TYPE_DEFAULT;
@@ -114,118 +341,1248 @@ ClockWindow create_clock_window(const Monitor& monitor, Corner corner, ID2D1Fact
   props.minLevel = D2D1_FEATURE_LEVEL_DEFAULT;
 
   ID2D1DCRenderTarget* rt = nullptr;
-  d2d->CreateDCRenderTarget(&props, &rt);
+  renderer.d2d->CreateDCRenderTarget(&props, &rt);
 
   ID2D1SolidColorBrush* brush = nullptr;
   rt->CreateSolidColorBrush(D2D1::ColorF(1.0f, 1.0f, 1.0f, 1.0f), &brush);
 
-  constexpr float default_font_size = 12.0f;
-  float fontsize = monitor.dpi.x * default_font_size;
-
   IDWriteTextFormat* format = nullptr;
-  app->dwrite->CreateTextFormat(L"Segoe UI Variable Display", nullptr, DWRITE_FONT_WEIGHT_REGULAR, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, fontsize, app->format.locale.c_str(), &format);
-  format->SetTextAlignment(get_text_alignment_for(app->settings.corner));
+  renderer.dwrite->CreateTextFormat(L"Segoe UI Variable Display", nullptr, DWRITE_FONT_WEIGHT_REGULAR, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, key.font_size, locale.c_str(), &format);
+  format->SetTextAlignment(get_text_alignment_for(key.corner));
   format->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_CENTER);
 
-  return ClockWindow{.window = window, .rt = rt, .brush = brush, .memory_dc = memory_dc, .bitmap = bitmap, .text_format = format, .dpi_scale = monitor.dpi.x, .on_primary_monitor = is_primary_monitor(monitor)};
+  IDWriteTextFormat* glyph_format = nullptr;
+  renderer.dwrite->CreateTextFormat(L"Segoe UI Variable Display", nullptr, DWRITE_FONT_WEIGHT_REGULAR, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, key.font_size, locale.c_str(), &glyph_format);
+  glyph_format->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_LEADING);
+  glyph_format->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_NEAR);
+  glyph_format->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP);
+
+  Surface surface = {.rt = rt, .brush = brush, .memory_dc = memory_dc, .bitmap = bitmap, .text_format = format, .glyph_format = glyph_format, .size = size, .key = key, .locale = locale};
+  framebuffer_wrap(surface.framebuffer, static_cast<uint32_t*>(bits), size.x, size.y, framebuffer_stride_for(size.x));
+  glyph_atlas_init(surface.atlas, kGlyphAtlasSize, kGlyphAtlasSize, measure_line_height(renderer, glyph_format));
+  return surface;
+}
+
+void destroy_surface(Surface& surface) {
+  if (surface.glyph_format) surface.glyph_format->Release();
+  if (surface.text_format) surface.text_format->Release();
+  if (surface.brush) surface.brush->Release();
+  if (surface.rt) surface.rt->Release();
+  if (surface.memory_dc) DeleteDC(surface.memory_dc);
+  if (surface.bitmap) DeleteObject(surface.bitmap);
+  framebuffer_free(surface.framebuffer);
+  surface = { };
+}
+
+// @NOTE: The UI thread only hands out slots, the render thread creates and
+// destroys the resources behind them when it sees the next snapshot.
+uint32_t acquire_surface(App& app, SurfaceKey key) {
+  bool created = false;
+  return surface_cache_acquire(app.surface_cache, key, &created);
+}
+
+void release_surface(App& app, uint32_t slot) {
+  surface_cache_release(app.surface_cache, slot);
+}
+
+SurfaceKey clock_surface_key(const App& app, const Monitor& monitor, Corner corner, const BackdropContrast& contrast) {
+  const TextContrast text = text_contrast_for(contrast, app.settings.adaptive_contrast, app.flags.test(kAppFlagUseLightTheme));
+  return make_surface_key(monitor.dpi, corner, text.dark_text, text.shadow);
+}
+
+// @NOTE: Moves every clock to the surface matching its text color, shadow
+// alert and overlay, after the theme, the settings, its backdrop, an alarm or
+// an overlay message changed.
+void update_clock_surfaces(App& app) {
+  ClockTable& clocks = app.clocks;
+  for (uint32_t i = 0; i < clock_table_size(clocks); ++i) {
+    SurfaceKey key = app.surface_cache.slots[clocks.surfaces[i]].key;
+    const TextContrast text = text_contrast_for(clocks.contrasts[i], app.settings.adaptive_contrast, app.flags.test(kAppFlagUseLightTheme));
+    const bool alert = clocks.alerts[i] != 0;
+    const uint16_t overlay = clocks.overlays[i];
+    if ((key.dark_text == text.dark_text) && (key.shadow == text.shadow) && (key.alert == alert) && (key.overlay == overlay)) continue;
+
+    key.dark_text = text.dark_text;
+    key.shadow = text.shadow;
+    key.alert = alert;
+    key.overlay = overlay;
+    const uint32_t previous = clocks.surfaces[i];
+    clocks.surfaces[i] = acquire_surface(app, key);
+    clocks.generations[i] = ++app.next_clock_generation;
+    release_surface(app, previous);
+  }
+}
+
+ClockRow create_clock_window(const Monitor& monitor, Corner corner, App* app) {
+  constexpr DWORD window_style = WS_POPUP;
+  constexpr DWORD extended_window_style = WS_EX_TOOLWINDOW | WS_EX_TOPMOST | WS_EX_LAYERED | WS_EX_TRANSPARENT;
+  HWND window = CreateWindowExW(extended_window_style, L"clock-class", L"", window_style, 0, 0, CW_USEDEFAULT, CW_USEDEFAULT, nullptr, nullptr, GetModuleHandleW(nullptr), nullptr);
+  SetWindowLongPtrW(window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(app));
+
+  const Int2 size = compute_clock_window_size(monitor.dpi);
+  const Int2 position = compute_clock_window_position(size, monitor.position, monitor.size, corner);
+  const bool disabled = is_monitor_disabled(app->profiles, monitor);
+  const bool hidden = disabled || is_clock_hidden(app->settings, is_primary_monitor(monitor), false);
+  const UINT show_flag = hidden ? static_cast<UINT>(SWP_HIDEWINDOW) : static_cast<UINT>(SWP_SHOWWINDOW);
+  SetWindowPos(window, HWND_TOPMOST, position.x, position.y, size.x, size.y, SWP_NOACTIVATE | show_flag);
+
+  const uint32_t surface = acquire_surface(*app, clock_surface_key(*app, monitor, corner, BackdropContrast{ }));
+
+  return ClockRow{.window = reinterpret_cast<uintptr_t>(window), .monitor = monitor, .corner = corner, .surface = surface, .generation = ++app->next_clock_generation, .hidden = hidden, .disabled = disabled};
 };
 
-void destroy_clock_window(ClockWindow& clock) {
-  if (clock.text_format) clock.text_format->Release();
-  if (clock.brush) clock.brush->Release();
-  if (clock.rt) clock.rt->Release();
-  if (clock.memory_dc) DeleteDC(clock.memory_dc);
-  if (clock.bitmap) DeleteObject(clock.bitmap);
-  if (clock.window) DestroyWindow(clock.window);
-  clock = { };
+// @NOTE: Moves an existing clock to a new monitor geometry, DPI or corner.
+// The window is kept, the surface only changes if its key does.
+void update_clock_window(App& app, ClockRow& clock, const Monitor& monitor, Corner corner) {
+  // @NOTE: Keeps the size the render thread fitted to the text, its next
+  // present corrects size and position after a DPI change.
+  HWND window = reinterpret_cast<HWND>(clock.window);
+  Int2 size = common::window_client_size(window);
+  if ((size.x == 0) || (size.y == 0)) size = compute_clock_window_size(monitor.dpi);
+  const Int2 position = compute_clock_window_position(size, monitor.position, monitor.size, corner);
+  SetWindowPos(window, HWND_TOPMOST, position.x, position.y, size.x, size.y, SWP_NOACTIVATE);
+
+  const SurfaceKey key = clock_surface_key(app, monitor, corner, clock.contrast);
+  if (key != app.surface_cache.slots[clock.surface].key) {
+    const uint32_t previous = clock.surface;
+    clock.surface = acquire_surface(app, key);
+    release_surface(app, previous);
+  }
+
+  clock.monitor = monitor;
+  clock.corner = corner;
+  clock.generation = ++app.next_clock_generation;
+}
+
+void destroy_clock_window(App& app, const ClockRow& clock) {
+  release_surface(app, clock.surface);
+  if (clock.window) DestroyWindow(reinterpret_cast<HWND>(clock.window));
 }
 
-const ClockWindow* find_clock_by_hwnd(const App& app, HWND window) {
-  for (size_t i = 0; i < app.clocks.size(); ++i) {
-    if (app.clocks[i].window == window) return app.clocks.data() + i;
+// @NOTE: Multi-threaded because the startup creates the first surfaces on
+// several threads at once, after that only the render thread uses it.
+bool init_direct2d(Renderer& renderer) {
+  return (D2D1CreateFactory(D2D1_FACTORY_TYPE_MULTI_THREADED, &renderer.d2d) == S_OK) &&
+    (DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory), reinterpret_cast<IUnknown**>(&renderer.dwrite)) == S_OK);
+}
+
+void watch_monitor_rects(App& app) {
+  window_index_watch(app.windows, app.clocks.monitor_rects);
+  topmost_guard_watch(app.topmost, app.clocks.monitor_rects);
+}
+
+// @NOTE: The monitors that get a clock, the list as it came is recorded,
+// the replay limits it the same way.
+std::vector<Monitor> clock_monitors(App& app, const std::vector<Monitor>& monitors) {
+  record_monitors(app, monitors);
+  if (monitors.size() > kClockTableMaxClocks) {
+    wchar_t message[96];
+    swprintf_s(message, L"%u monitors, clocks only on the first %u\n", static_cast<unsigned>(monitors.size()), kClockTableMaxClocks);
+    OutputDebugStringW(message);
   }
-  return nullptr;
+  return clock_table_limit_monitors(monitors);
 }
 
-bool init_direct2d(App& app) {
-  return (D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &app.d2d) == S_OK) &&
-    (DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory), reinterpret_cast<IUnknown**>(&app.dwrite)) == S_OK);
+void create_clock_windows(App& app, const std::vector<Monitor>& all_monitors) {
+  const std::vector<Monitor> monitors = clock_monitors(app, all_monitors);
+  for (const Monitor& monitor : monitors) {
+    clock_table_push(app.clocks, create_clock_window(monitor, monitor_corner(app.settings, app.profiles, monitor), &app));
+  }
+  watch_monitor_rects(app);
 }
 
-void create_clock_windows(App& app) {
-  for (const Monitor& monitor : common::get_display_monitors()) {
-    app.clocks.push_back(create_clock_window(monitor, app.settings.corner, app.d2d, &app));
+// @NOTE: Brings the clocks in line with the current monitors and settings,
+// touching only the clocks whose monitor or corner actually changed.
+void reconcile_clock_windows(App& app) {
+  TRACE_SCOPE(ReconcileClocks);
+  const std::vector<Monitor> monitors = clock_monitors(app, common::get_display_monitors());
+
+  ClockTable clocks;
+  for (const MonitorDiffOp& op : diff_monitors(app.clocks.monitors, monitors)) {
+    switch (op.change) {
+      case MonitorChange::Remove: {
+        destroy_clock_window(app, clock_table_row(app.clocks, op.old_index));
+        break;
+      }
+      case MonitorChange::Add: {
+        const Monitor& monitor = monitors[op.new_index];
+        clock_table_push(clocks, create_clock_window(monitor, monitor_corner(app.settings, app.profiles, monitor), &app));
+        break;
+      }
+      case MonitorChange::Keep:
+      case MonitorChange::Move:
+      case MonitorChange::Rescale: {
+        ClockRow clock = clock_table_row(app.clocks, op.old_index);
+        const Monitor& monitor = monitors[op.new_index];
+        const Corner corner = monitor_corner(app.settings, app.profiles, monitor);
+        if ((op.change != MonitorChange::Keep) || (clock.corner != corner)) {
+          update_clock_window(app, clock, monitor, corner);
+        } else {
+          clock.monitor = monitor;
+        }
+        clock.disabled = is_monitor_disabled(app.profiles, monitor); // @NOTE: the visibility pass shows or hides it
+        clock_table_push(clocks, clock);
+        break;
+      }
+    }
   }
+
+  app.clocks = std::move(clocks);
+  watch_monitor_rects(app);
 }
 
 void destroy_clock_windows(App& app) {
-  for (ClockWindow& clock : app.clocks) destroy_clock_window(clock);
-  app.clocks.clear();
+  for (uint32_t i = 0; i < clock_table_size(app.clocks); ++i) destroy_clock_window(app, clock_table_row(app.clocks, i));
+  clock_table_clear(app.clocks);
 }
 
-LRESULT CALLBACK window_callback(HWND window, UINT message, WPARAM wparam, LPARAM lparam) {
-  if (App* app = reinterpret_cast<App*>(GetWindowLongPtrW(window, GWLP_USERDATA)); app) {
-    SetWindowPos(window, HWND_TOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE); // @TODO: too much?
-    switch (message) {
-      case WM_PAINT: {
-        if (const ClockWindow* clock = find_clock_by_hwnd(*app, window); clock) {
-          const Int2 size = common::window_client_size(window);
-          const float width = static_cast<float>(size.x);
-          const float height = static_cast<float>(size.y);
-
-          RECT bind_rect = {0, 0, size.x, size.y};
-          clock->rt->BindDC(clock->memory_dc, &bind_rect);
-          clock->rt->BeginDraw();
-          clock->rt->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
-          clock->rt->SetTransform(D2D1::IdentityMatrix());
-          clock->rt->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f));
-
-          #ifdef CLOCK_DEBUG
-          clock->brush->SetColor(D2D1_COLOR_F{1.0f, 0.0f, 0.0f, 1.0f});
-          clock->rt->DrawRectangle(D2D1::RectF(0.0f, 0.0f, width, height), clock->brush);
-          #endif
-
-          const bool left = is_left(app->settings.corner);
-          const float pad_left = left ? 15.0f * clock->dpi_scale : 0.0f;
-          const float pad_right = !left ? 15.0f * clock->dpi_scale : 0.0f;
-          D2D1_RECT_F rect = D2D1::RectF(pad_left, 0.0f, width - pad_right, height);
-
-          const std::wstring& time = app->settings.long_time ? app->datetime.long_time : app->datetime.short_time;
-          const std::wstring& date = app->settings.long_date ? app->datetime.long_date : app->datetime.short_date;
-          const std::wstring datetime = time + L"\n" + date; // @TODO: wasteful
-
-          clock->brush->SetColor(app->flags.test(kAppFlagUseLightTheme) ? D2D1_COLOR_F{0.0f, 0.0f, 0.0f, 1.0f} : D2D1_COLOR_F{1.0f, 1.0f, 1.0f, 1.0f});
-          clock->rt->DrawText(datetime.c_str(), static_cast<UINT32>(datetime.length()), clock->text_format, rect, clock->brush);
-
-          const bool presentationError = (clock->rt->EndDraw() == D2DERR_RECREATE_TARGET);
-          if (presentationError) app->transient_flags.set(kTransientAppFlagRecreateRequested);
-
-          HDC desktop_dc = GetDC(nullptr);
-          POINT source_point = { };
-          SIZE windowSize = {size.x, size.y};
-          BLENDFUNCTION blend = {.BlendOp = AC_SRC_OVER, .SourceConstantAlpha = 255, .AlphaFormat = AC_SRC_ALPHA};
-          UpdateLayeredWindow(window, desktop_dc, nullptr, &windowSize, clock->memory_dc, &source_point, 0, &blend, ULW_ALPHA);
-          ReleaseDC(nullptr, desktop_dc);
-        }
-        ValidateRect(window, nullptr);
-        return 0;
+// @NOTE: Full resync of the window index. Normally the index is kept up to
+// date by win events, this is only needed at startup, after display changes
+// and after a suspension, which ignored them.
+// @NOTE: Only queries, so the startup can run it off the main thread while
+// the clocks are being created.
+std::vector<WindowEntry> query_desktop_windows() {
+  std::vector<HWND> windows;
+  {
+    TRACE_SCOPE(GetDesktopWindows);
+    windows = common::get_desktop_windows();
+  }
+  std::vector<WindowEntry> entries;
+  entries.reserve(windows.size());
+  for (HWND window : windows) entries.push_back(WindowEntry{.id = reinterpret_cast<uintptr_t>(window), .state = common::get_window_state(window)});
+  return entries;
+}
+
+void apply_desktop_windows(App& app, const std::vector<WindowEntry>& entries) {
+  window_index_clear(app.windows);
+  for (const WindowEntry& entry : entries) window_index_update(app.windows, entry.id, entry.state);
+  if (is_recording(app)) {
+    app.recording.sections |= kEventSectionWindows;
+    app.recording.windows = entries;
+  }
+}
+
+void rebuild_window_index(App& app) {
+  apply_desktop_windows(app, query_desktop_windows());
+}
+
+D2D1_COLOR_F get_text_color_for(SurfaceKey key) {
+  if (key.alert) return key.dark_text ? D2D1_COLOR_F{0.75f, 0.15f, 0.0f, 1.0f} : D2D1_COLOR_F{1.0f, 0.45f, 0.2f, 1.0f};
+  return key.dark_text ? D2D1_COLOR_F{0.0f, 0.0f, 0.0f, 1.0f} : D2D1_COLOR_F{1.0f, 1.0f, 1.0f, 1.0f};
+}
+
+D2D1_COLOR_F get_shadow_color_for(SurfaceKey key) {
+  return key.dark_text ? D2D1_COLOR_F{1.0f, 1.0f, 1.0f, 0.6f} : D2D1_COLOR_F{0.0f, 0.0f, 0.0f, 0.6f};
+}
+
+// @NOTE: The shadow is the text once more, offset down and right.
+float get_shadow_offset_for(SurfaceKey key) {
+  const float offset = static_cast<float>(static_cast<int>(surface_key_dpi_scale(key).x + 0.5f));
+  return (offset < 1.0f) ? 1.0f : offset;
+}
+
+// @NOTE: Time, date, the metrics line if the snapshot shows it and the
+// surface's overlay message if it has one.
+uint32_t clock_text_lines(const Renderer& renderer, SurfaceKey key, const wchar_t** lines, uint32_t* lengths) {
+  const FormattedText* texts[3] = {&renderer.texts.time, &renderer.texts.date, &renderer.metrics_line};
+  uint32_t count = renderer.snapshot.metrics ? 3 : 2;
+  for (uint32_t i = 0; i < count; ++i) {
+    lines[i] = texts[i]->text;
+    lengths[i] = texts[i]->length;
+  }
+  if (key.overlay && renderer.snapshot.overlays) {
+    for (const SnapshotOverlay& overlay : *renderer.snapshot.overlays) {
+      if (overlay.id != key.overlay) continue;
+      lines[count] = overlay.text.c_str();
+      lengths[count] = static_cast<uint32_t>(std::min<size_t>(overlay.text.size(), kComposedLineCapacity));
+      count++;
+      break;
+    }
+  }
+  return count;
+}
+
+// @NOTE: Full Direct2D/DirectWrite path, used when the text cannot be
+// composed from glyph tiles.
+void render_surface_direct(Renderer& renderer, Surface& surface, SurfaceKey key) {
+  const float width = static_cast<float>(surface.size.x);
+  const float height = static_cast<float>(surface.size.y);
+  const float dpi_scale = surface_key_dpi_scale(key).x;
+
+  RECT bind_rect = {0, 0, surface.size.x, surface.size.y};
+  surface.rt->BindDC(surface.memory_dc, &bind_rect);
+  {
+    TRACE_SCOPE(D2DBeginDraw);
+    surface.rt->BeginDraw();
+  }
+  surface.rt->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
+  surface.rt->SetTransform(D2D1::IdentityMatrix());
+  surface.rt->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f));
+
+  #ifdef CLOCK_DEBUG
+  surface.brush->SetColor(D2D1_COLOR_F{1.0f, 0.0f, 0.0f, 1.0f});
+  surface.rt->DrawRectangle(D2D1::RectF(0.0f, 0.0f, width, height), surface.brush);
+  #endif
+
+  const bool left = is_left(key.corner);
+  const float pad_left = left ? kClockPadding * dpi_scale : 0.0f;
+  const float pad_right = !left ? kClockPadding * dpi_scale : 0.0f;
+  D2D1_RECT_F rect = D2D1::RectF(pad_left, 0.0f, width - pad_right, height);
+
+  const wchar_t* lines[kComposedMaxLines];
+  uint32_t lengths[kComposedMaxLines];
+  const uint32_t line_count = clock_text_lines(renderer, key, lines, lengths);
+
+  wchar_t datetime[kComposedMaxLines * (kFormattedTextCapacity + 1)];
+  UINT32 datetime_length = 0;
+  for (uint32_t i = 0; i < line_count; ++i) {
+    const uint32_t length = std::min(lengths[i], kFormattedTextCapacity);
+    if (i > 0) datetime[datetime_length++] = L'\n';
+    memcpy(datetime + datetime_length, lines[i], length * sizeof(wchar_t));
+    datetime_length += length;
+  }
+
+  {
+    TRACE_SCOPE(D2DDrawText);
+    if (key.shadow) {
+      const float offset = get_shadow_offset_for(key);
+      surface.brush->SetColor(get_shadow_color_for(key));
+      surface.rt->DrawText(datetime, datetime_length, surface.text_format, D2D1::RectF(rect.left + offset, rect.top + offset, rect.right + offset, rect.bottom + offset), surface.brush);
+    }
+    surface.brush->SetColor(get_text_color_for(key));
+    surface.rt->DrawText(datetime, datetime_length, surface.text_format, rect, surface.brush);
+  }
+
+  HRESULT end_draw_result;
+  {
+    TRACE_SCOPE(D2DEndDraw);
+    end_draw_result = surface.rt->EndDraw();
+  }
+  if (end_draw_result == D2DERR_RECREATE_TARGET) surface.lost = true;
+}
+
+// @NOTE: Uses the surface bitmap as scratch space, so the next compose has
+// to redraw everything.
+void rasterize_glyph(Surface& surface, SurfaceKey key, wchar_t ch, PixelView tile) {
+  RECT bind_rect = {0, 0, surface.size.x, surface.size.y};
+  surface.rt->BindDC(surface.memory_dc, &bind_rect);
+  surface.rt->BeginDraw();
+  surface.rt->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
+  surface.rt->SetTransform(D2D1::IdentityMatrix());
+  surface.rt->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f));
+  if (key.shadow) {
+    const float offset = get_shadow_offset_for(key);
+    surface.brush->SetColor(get_shadow_color_for(key));
+    surface.rt->DrawText(&ch, 1, surface.glyph_format, D2D1::RectF(static_cast<float>(kGlyphPad) + offset, offset, static_cast<float>(tile.width) + offset, static_cast<float>(tile.height) + offset), surface.brush);
+  }
+  surface.brush->SetColor(get_text_color_for(key));
+  surface.rt->DrawText(&ch, 1, surface.glyph_format, D2D1::RectF(static_cast<float>(kGlyphPad), 0.0f, static_cast<float>(tile.width), static_cast<float>(tile.height)), surface.brush);
+  if (surface.rt->EndDraw() == D2DERR_RECREATE_TARGET) surface.lost = true;
+  GdiFlush();
+
+  copy_pixels(tile, Int2{0, 0}, framebuffer_subview(surface.framebuffer, Rect{0, 0, tile.width, tile.height}));
+  surface.compositor.valid = false;
+}
+
+bool ensure_glyphs(const Renderer& renderer, Surface& surface, SurfaceKey key, const wchar_t* text, uint32_t length) {
+  auto measure = [&](wchar_t ch) { return measure_glyph_advance(renderer, surface.glyph_format, ch); };
+  auto rasterize = [&](wchar_t ch, PixelView tile) { rasterize_glyph(surface, key, ch, tile); };
+  return glyph_atlas_ensure(surface.atlas, text, length, measure, rasterize);
+}
+
+// @NOTE: Analog mode, the face is as high as the clock and sits on the
+// corner side. Once the rest is clear only the face is redrawn. Returns the
+// part of the framebuffer that changed.
+Rect render_clock_face(const Renderer& renderer, Surface& surface, SurfaceKey key) {
+  const Framebuffer& fb = surface.framebuffer;
+  const Rect bounds = {0, 0, fb.width, fb.height};
+  const int side = fb.height;
+  const int pad = static_cast<int>(kClockPadding * surface_key_dpi_scale(key).x);
+  const int x = is_left(key.corner) ? pad : fb.width - side - pad;
+  const Rect face_rect = {x, 0, x + side, side};
+
+  GdiFlush();
+  const bool redraw_all = surface.face != face_rect;
+  fill_pixels(framebuffer_view(fb), redraw_all ? bounds : face_rect, 0);
+  const PixelView face = framebuffer_subview(fb, face_rect);
+  rasterize_clock_face(face, make_clock_face(renderer.texts.time.time, renderer.snapshot.seconds, renderer.snapshot.smooth), best_clock_face_kernel());
+
+  surface.face = face_rect;
+  surface.compositor.valid = false;
+  return redraw_all ? bounds : face_rect;
+}
+
+// @NOTE: Smooth seconds in digital mode, a ring in the padding on the
+// corner side, clear of the text. Returns the part of the framebuffer that
+// changed.
+Rect render_seconds_arc(const Renderer& renderer, Surface& surface, SurfaceKey key) {
+  const int pad = static_cast<int>(kClockPadding * surface_key_dpi_scale(key).x);
+  const int side = pad * 3 / 4;
+  const int x = is_left(key.corner) ? (pad - side) / 2 : surface.size.x - pad + (pad - side) / 2;
+  const int y = (surface.size.y - side) / 2;
+  const Rect rect = {x, y, x + side, y + side};
+
+  GdiFlush();
+  const D2D1_COLOR_F color = get_text_color_for(key);
+  rasterize_seconds_arc(framebuffer_subview(surface.framebuffer, rect), seconds_turns(renderer.texts.time.time), color.r, color.g, color.b);
+  return rect;
+}
+
+// @NOTE: Composes the text from the surface's glyph atlas, only the
+// characters that changed since the previous frame are redrawn. Returns the
+// part of the framebuffer that changed.
+Rect render_surface_pixels(Renderer& renderer, Surface& surface, SurfaceKey key) {
+  const Rect bounds = {0, 0, surface.size.x, surface.size.y};
+  if (renderer.snapshot.analog) return render_clock_face(renderer, surface, key);
+  surface.face = { };
+
+  const wchar_t* lines[kComposedMaxLines];
+  uint32_t lengths[kComposedMaxLines];
+  const uint32_t line_count = clock_text_lines(renderer, key, lines, lengths);
+
+  auto ensure_lines = [&] {
+    for (uint32_t i = 0; i < line_count; ++i) {
+      if (!ensure_glyphs(renderer, surface, key, lines[i], lengths[i])) return false;
+    }
+    return true;
+  };
+  bool composable = true;
+  for (uint32_t i = 0; i < line_count; ++i) composable = composable && can_compose_text(lines[i], lengths[i]);
+  if (composable && !ensure_lines()) {
+    // @NOTE: Atlas full, e.g. after many locale changes. Start over once.
+    glyph_atlas_init(surface.atlas, surface.atlas.width, surface.atlas.height, surface.atlas.line_height);
+    composable = ensure_lines();
+  }
+
+  if (!composable) {
+    render_surface_direct(renderer, surface, key);
+    surface.compositor.valid = false;
+    if (renderer.snapshot.smooth) render_seconds_arc(renderer, surface, key);
+    return bounds;
+  }
+
+  const int pad = static_cast<int>(kClockPadding * surface_key_dpi_scale(key).x);
+  const bool left = is_left(key.corner);
+  const TextLayout layout = {
+    .left = left ? pad : 0,
+    .right = left ? surface.size.x : surface.size.x - pad,
+    .top = std::max(0, (surface.size.y - static_cast<int>(line_count) * surface.atlas.line_height) / 2),
+    .align_right = !left,
+  };
+
+  GdiFlush();
+  const PixelView target = framebuffer_view(surface.framebuffer);
+  Rect dirty = compose_text(surface.compositor, surface.atlas, target, layout, lines, lengths, line_count);
+  if (renderer.snapshot.smooth) dirty = union_rect(dirty, render_seconds_arc(renderer, surface, key));
+
+  #ifdef CLOCK_DEBUG
+  fill_pixels(target, Rect{0, 0, target.width, 1}, 0xffff0000);
+  fill_pixels(target, Rect{0, target.height - 1, target.width, target.height}, 0xffff0000);
+  fill_pixels(target, Rect{0, 0, 1, target.height}, 0xffff0000);
+  fill_pixels(target, Rect{target.width - 1, 0, target.width, target.height}, 0xffff0000);
+  return bounds;
+  #else
+  return dirty;
+  #endif
+}
+
+// @NOTE: The room the current text takes on the surface, from the text
+// metrics cache. Lines are only laid out again when their shape changes.
+Int2 measure_clock_content(Renderer& renderer, const Surface& surface) {
+  const Float2 dpi = surface_key_dpi_scale(surface.key);
+  if (renderer.snapshot.analog) return Int2{compute_clock_window_size(dpi).y, 0}; // @NOTE: the face is a square as high as the taskbar
+
+  const wchar_t* lines[kComposedMaxLines];
+  uint32_t lengths[kComposedMaxLines];
+  const uint32_t line_count = clock_text_lines(renderer, surface.key, lines, lengths);
+  const TextFont font = {.family = 0, .size = surface.key.font_size, .dpi = surface.key.dpi};
+  auto measure = [&](const wchar_t* text, uint32_t length) { return measure_text_extent(renderer, surface.text_format, text, length); };
+
+  Int2 content = { };
+  for (uint32_t i = 0; i < line_count; ++i) {
+    const TextExtent extent = text_metrics_measure(renderer.text_metrics, font, lines[i], lengths[i], measure);
+    content.x = std::max(content.x, extent.width);
+    content.y += extent.height;
+  }
+  return content;
+}
+
+// @NOTE: Recreates the surface at the size its text needs, which only
+// happens when a measured extent changed and settled. The glyph atlas is
+// kept, every clock on the surface is moved and resized by its next present.
+void fit_surface(Renderer& renderer, Surface& surface) {
+  const Int2 fitted = fit_clock_window_size(surface_key_dpi_scale(surface.key), measure_clock_content(renderer, surface));
+  settle_clock_fit(surface.fit, fitted, GetTickCount64());
+  const Int2 size = surface.fit.size;
+  if ((size.x == surface.size.x) && (size.y == surface.size.y)) return;
+
+  GlyphAtlas atlas = std::move(surface.atlas);
+  const ClockFit fit = surface.fit;
+  const SurfaceKey key = surface.key;
+  const std::wstring locale = surface.locale;
+  destroy_surface(surface);
+  surface = create_surface(key, locale, size, renderer);
+  surface.fit = fit;
+  surface.atlas = std::move(atlas);
+  surface.generation = ++renderer.next_surface_generation;
+}
+
+void render_surface(Renderer& renderer, Surface& surface) {
+  surface.dirty = render_surface_pixels(renderer, surface, surface.key);
+  surface.serial++;
+}
+
+PresentedClock& find_presented_clock(Renderer& renderer, HWND window) {
+  PresentedClock& presented = renderer.presented[window];
+  presented.window = window;
+  return presented;
+}
+
+// @NOTE: The window keeps what it was last given, so when it is exactly one
+// render of the same surface behind only the dirty rectangle has to be
+// handed over.
+void present_clock(Renderer& renderer, const SnapshotClock& clock, Surface& surface) {
+  HWND window = reinterpret_cast<HWND>(clock.window);
+  PresentedClock& presented = find_presented_clock(renderer, window);
+  const bool same = (presented.generation == clock.generation) && (presented.surface_generation == surface.generation);
+  if (same && (presented.serial == surface.serial)) return;
+
+  const Rect full = {0, 0, surface.size.x, surface.size.y};
+  const bool partial = same && (presented.serial != 0) && (presented.serial + 1 == surface.serial);
+  const Rect dirty = partial ? surface.dirty : full;
+  presented = PresentedClock{.window = window, .generation = clock.generation, .surface_generation = surface.generation, .serial = surface.serial};
+  if (is_empty(dirty)) return;
+
+  // @NOTE: A full present also places the window, its size follows the
+  // text, see fit_surface.
+  const Rect& monitor = clock.monitor;
+  const Int2 position = compute_clock_window_position(surface.size, Int2{monitor.left, monitor.top}, Int2{monitor.right - monitor.left, monitor.bottom - monitor.top}, clock.key.corner);
+  POINT destination = {position.x, position.y};
+
+  HDC desktop_dc = GetDC(nullptr);
+  POINT source_point = { };
+  SIZE window_size = {surface.size.x, surface.size.y};
+  RECT dirty_rect = {dirty.left, dirty.top, dirty.right, dirty.bottom};
+  BLENDFUNCTION blend = {.BlendOp = AC_SRC_OVER, .SourceConstantAlpha = 255, .AlphaFormat = AC_SRC_ALPHA};
+  UPDATELAYEREDWINDOWINFO info = {
+    .cbSize = sizeof(UPDATELAYEREDWINDOWINFO),
+    .hdcDst = desktop_dc,
+    .pptDst = partial ? nullptr : &destination,
+    .psize = &window_size,
+    .hdcSrc = surface.memory_dc,
+    .pptSrc = &source_point,
+    .crKey = 0,
+    .pblend = &blend,
+    .dwFlags = ULW_ALPHA,
+    .prcDirty = &dirty_rect,
+  };
+  {
+    TRACE_SCOPE(UpdateLayeredWindow);
+    if (!UpdateLayeredWindowIndirect(window, &info)) presented.serial = 0;
+    else if (renderer.first_present_ns.load(std::memory_order_relaxed) == 0) renderer.first_present_ns.store(startup_now_ns(), std::memory_order_relaxed);
+  }
+  ReleaseDC(nullptr, desktop_dc);
+  framebuffer_record_present(surface.framebuffer, dirty);
+}
+
+// @NOTE: Brings the surfaces in line with the snapshot: creates missing
+// ones, recreates those whose key or locale changed or whose render target
+// was lost and destroys the ones no clock uses anymore. Returns true if
+// anything was (re)created.
+bool sync_surfaces(Renderer& renderer) {
+  const FrameSnapshot& snapshot = renderer.snapshot;
+  if (!snapshot.format) return false;
+
+  bool created = false;
+  std::vector<bool> used(renderer.surfaces.size(), false);
+  for (uint32_t i = 0; i < snapshot.clock_count; ++i) {
+    const SnapshotClock& clock = snapshot.clocks[i];
+    if (clock.surface >= renderer.surfaces.size()) {
+      renderer.surfaces.resize(clock.surface + 1);
+      used.resize(clock.surface + 1, false);
+    }
+
+    Surface& surface = renderer.surfaces[clock.surface];
+    if (!surface.rt || surface.lost || (surface.key != clock.key) || (surface.locale != snapshot.format->locale)) {
+      // @NOTE: Same DPI, same text, so the fitted size still holds.
+      const bool same_dpi = surface.rt && (surface.key.dpi == clock.key.dpi);
+      const Int2 size = same_dpi ? surface.size : compute_clock_window_size(surface_key_dpi_scale(clock.key));
+      const ClockFit fit = same_dpi ? surface.fit : ClockFit{ };
+      destroy_surface(surface);
+      surface = create_surface(clock.key, snapshot.format->locale, size, renderer);
+      surface.fit = fit;
+      surface.generation = ++renderer.next_surface_generation;
+      created = true;
+    }
+    used[clock.surface] = true;
+  }
+
+  for (size_t i = 0; i < renderer.surfaces.size(); ++i) {
+    if (!used[i] && renderer.surfaces[i].rt) destroy_surface(renderer.surfaces[i]);
+  }
+
+  if (renderer.presented.size() > snapshot.clock_count) {
+    std::unordered_map<HWND, PresentedClock> presented;
+    for (uint32_t i = 0; i < snapshot.clock_count; ++i) {
+      HWND window = reinterpret_cast<HWND>(snapshot.clocks[i].window);
+      if (auto it = renderer.presented.find(window); it != renderer.presented.end()) presented.emplace(window, it->second);
+    }
+    renderer.presented = std::move(presented);
+  }
+  return created;
+}
+
+// @NOTE: Formats the text for the current time, rasterizes every surface a
+// visible clock uses once and presents it to those clocks.
+void render_frame(Renderer& renderer) {
+  const FrameSnapshot& snapshot = renderer.snapshot;
+  if (!snapshot.format) return;
+
+  TRACE_SCOPE(RenderFrame);
+  {
+    TRACE_SCOPE(UpdateDateTime);
+    frame_texts_render(renderer.texts, snapshot.format, common::get_local_time(), common::get_unix_time_ms());
+  }
+  if (snapshot.metrics) {
+    TRACE_SCOPE(SampleMetrics);
+    if (metrics_sampler_tick(renderer.metrics, GetTickCount64()) || !renderer.metrics_line.valid) render_metrics_line(renderer.metrics, renderer.metrics_line);
+  }
+
+  renderer.frame++;
+  auto rendered_frame = [&](uint32_t surface) -> uint64_t& { return renderer.surfaces[surface].rendered_frame; };
+  auto render = [&](uint32_t surface) {
+    fit_surface(renderer, renderer.surfaces[surface]);
+    render_surface(renderer, renderer.surfaces[surface]);
+  };
+  auto present = [&](const SnapshotClock& clock) { present_clock(renderer, clock, renderer.surfaces[clock.surface]); };
+  snapshot_render_frame(snapshot, renderer.frame, rendered_frame, render, present);
+}
+
+uint64_t qpc_to_us(int64_t ticks, int64_t frequency) {
+  return static_cast<uint64_t>((ticks / frequency) * 1'000'000 + (ticks % frequency) * 1'000'000 / frequency);
+}
+
+uint64_t render_now_us(const Renderer& renderer) {
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  return qpc_to_us(now.QuadPart, renderer.qpc_frequency);
+}
+
+// @NOTE: Frames are paced to DWM's composition clock. With monitors of
+// different refresh rates that is the rate DWM composes at, so every clock
+// gets a new frame for every composition.
+void update_frame_target(Renderer& renderer) {
+  uint64_t interval_us = 16667;
+  uint64_t phase_us = 0;
+  DWM_TIMING_INFO info = { };
+  info.cbSize = sizeof(DWM_TIMING_INFO);
+  if ((DwmGetCompositionTimingInfo(nullptr, &info) == S_OK) && (info.qpcRefreshPeriod > 0)) {
+    interval_us = qpc_to_us(static_cast<int64_t>(info.qpcRefreshPeriod), renderer.qpc_frequency);
+    phase_us = qpc_to_us(static_cast<int64_t>(info.qpcVBlank), renderer.qpc_frequency);
+  }
+  frame_pacer_retarget(renderer.pacer, interval_us, phase_us, render_now_us(renderer));
+}
+
+// @NOTE: Waits for the wake event or `wait_us`, to the microsecond when the
+// high resolution timer is available.
+void wait_for_wake(const Renderer& renderer, uint64_t wait_us) {
+  if (wait_us == UINT64_MAX) {
+    WaitForSingleObject(renderer.wake, INFINITE);
+    return;
+  }
+
+  LARGE_INTEGER due;
+  due.QuadPart = -static_cast<LONGLONG>(wait_us * 10); // @NOTE: relative, in 100 ns
+  if (renderer.frame_timer && SetWaitableTimerEx(renderer.frame_timer, &due, 0, nullptr, nullptr, nullptr, 0)) {
+    HANDLE handles[2] = {renderer.wake, renderer.frame_timer};
+    WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+    return;
+  }
+  WaitForSingleObject(renderer.wake, static_cast<DWORD>((wait_us + 999) / 1000));
+}
+
+DWORD WINAPI render_thread(void* parameter) {
+  Renderer& renderer = *static_cast<Renderer*>(parameter);
+  renderer.frame_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+  renderer.metrics.provider.sample = common::sample_system_metrics;
+
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  renderer.qpc_frequency = frequency.QuadPart;
+
+  uint64_t wait_us = UINT64_MAX;
+  for (;;) {
+    wait_for_wake(renderer, wait_us);
+    if (renderer.quit.load(std::memory_order_acquire)) break;
+
+    tick_scheduler_wakeup(renderer.scheduler, GetTickCount64());
+    if (render_queue_take_latest(renderer.queue, renderer.snapshot)) {
+      if (!renderer.snapshot.metrics || (renderer.snapshot.power == PowerMode::Suspended)) {
+        metrics_sampler_reset(renderer.metrics); // @NOTE: the next pass would average over the time it was off
+        renderer.metrics_line = { };
       }
+      sync_surfaces(renderer);
+      if (snapshot_animates(renderer.snapshot)) update_frame_target(renderer); // @NOTE: monitors may have changed
+    }
+
+    if (renderer.snapshot.power == PowerMode::Suspended) {
+      wait_us = UINT64_MAX; // @NOTE: until the resume publishes
+      continue;
+    }
+
+    if (!snapshot_animates(renderer.snapshot)) {
+      render_frame(renderer);
+      if (sync_surfaces(renderer)) render_frame(renderer); // @NOTE: a render target was lost
+      wait_us = 1000ull * tick_scheduler_plan(renderer.scheduler, GetTickCount64(), common::get_local_time(), snapshot_tick_granularity(renderer.snapshot));
+      continue;
+    }
+
+    const FrameTiming timing = frame_pacer_begin(renderer.pacer, render_now_us(renderer));
+    if (timing.render) {
+      render_frame(renderer);
+      if (sync_surfaces(renderer)) render_frame(renderer);
+      frame_pacer_end(renderer.pacer, render_now_us(renderer));
+      TRACE_COUNTER(DroppedFrames, renderer.pacer.stats.dropped);
+      TRACE_COUNTER(MissedFrames, renderer.pacer.stats.missed);
+    }
+    wait_us = timing.render ? frame_pacer_wait_us(renderer.pacer, render_now_us(renderer)) : timing.wait_us;
+  }
+
+  for (Surface& surface : renderer.surfaces) destroy_surface(surface);
+  if (renderer.frame_timer) CloseHandle(renderer.frame_timer);
+  return 0;
+}
+
+// @NOTE: On battery the time drops its seconds, it is only redrawn once a
+// minute.
+std::shared_ptr<const FrameFormat> make_frame_format(const DateTimeFormat& format, const Settings& settings, const std::vector<ZoneClock>& zones, PowerMode power) {
+  auto frame_format = std::make_shared<FrameFormat>();
+  frame_format->locale = format.locale;
+  frame_format->names = format.names;
+  frame_format->time = (settings.long_time && (power == PowerMode::Full)) ? format.long_time : format.short_time;
+  frame_format->date = settings.long_date ? format.long_date : format.short_date;
+  frame_format->zones = zones;
+  return frame_format;
+}
+
+void load_settings(App& app) {
+  const SettingsFile file = settings_load(app.settings_absolute_path);
+  app.settings = file.settings;
+  app.profiles = file.profiles;
+  app.settings_generation = file.generation;
+}
+
+void save_settings(App& app) {
+  SettingsFile file = {.settings = app.settings, .profiles = app.profiles, .generation = app.settings_generation};
+  settings_save(app.settings_absolute_path, file);
+  app.settings_generation = file.generation;
+}
+
+// @NOTE: The write happens on kSettingsTimer, once the changes stopped.
+void schedule_settings_write(App& app) {
+  const uint64_t now = GetTickCount64();
+  const uint64_t deadline = settings_coalescer_change(app.settings_writes, now);
+  SetTimer(app.message_window, kSettingsTimer, static_cast<UINT>(deadline - now), nullptr);
+}
+
+// @NOTE: zones.txt next to the settings lists the IANA zones to show, see
+// parse_zone_config. The compiled tzdata is looked up in zoneinfo\ there,
+// every zone is read once per run. Zones that cannot be loaded are skipped.
+void load_zone_clocks(App& app) {
+  app.zones.clear();
+
+  FILE* f = _wfopen(app.zones_absolute_path.c_str(), L"rb");
+  if (!f) return;
+
+  std::string text;
+  char buffer[4096];
+  for (size_t n; (n = fread(buffer, 1, sizeof(buffer), f)) > 0;) text.append(buffer, n);
+  fclose(f);
+
+  for (const ZoneConfigEntry& entry : parse_zone_config(text.data(), text.size())) {
+    std::shared_ptr<const TimeZone> zone = time_zone_database_get(app.time_zones, entry.name);
+    if (!zone) continue;
+
+    std::wstring label(static_cast<size_t>(MultiByteToWideChar(CP_UTF8, 0, entry.label.data(), static_cast<int>(entry.label.size()), nullptr, 0)), L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, entry.label.data(), static_cast<int>(entry.label.size()), label.data(), static_cast<int>(label.size()));
+    app.zones.push_back(ZoneClock{.zone = zone, .label = label});
+  }
+}
+
+std::string utf8_from_text(const FormattedText& text) {
+  const int length = WideCharToMultiByte(CP_UTF8, 0, text.text, static_cast<int>(text.length), nullptr, 0, nullptr, nullptr);
+  std::string result(static_cast<size_t>(length), '\0');
+  WideCharToMultiByte(CP_UTF8, 0, text.text, static_cast<int>(text.length), result.data(), length, nullptr, nullptr);
+  return result;
+}
+
+// @NOTE: The text topic has its own timer on the text's granularity, the
+// tick is planned a day ahead and the render thread formats for itself.
+void arm_api_timer(App& app, uint32_t topics) {
+  if (!(topics & kApiTopicText) || !app.frame_format) {
+    KillTimer(app.message_window, kApiTimer);
+    app.api_scheduler.deadline_ms = 0;
+    return;
+  }
+  const uint32_t fields = app.frame_format->time.fields | app.frame_format->date.fields;
+  const TickGranularity granularity = power_tick_granularity(app.power.mode, tick_granularity_for(fields));
+  SetTimer(app.message_window, kApiTimer, tick_scheduler_plan(app.api_scheduler, GetTickCount64(), common::get_local_time(), granularity), nullptr);
+}
+
+// @NOTE: Brings the topics somebody subscribed to up to date and pushes
+// what changed to the API's clients, each topic encoded once for all of them.
+void publish_api(App& app) {
+  const uint32_t topics = api_server_topics(app.api);
+  if (topics & kApiTopicLayout) {
+    std::vector<ApiClock> clocks;
+    const ClockTable& table = app.clocks;
+    for (uint32_t i = 0; i < clock_table_size(table); ++i) {
+      clocks.push_back(ApiClock{.identity = table.monitors[i].identity, .monitor = table.monitor_rects[i], .corner = table.corners[i], .visible = !table.hidden[i] && !table.disabled[i]});
+    }
+    api_server_set_layout(app.api, clocks);
+  }
+  if ((topics & kApiTopicText) && app.frame_format) {
+    frame_texts_render(app.api_texts, app.frame_format, common::get_local_time(), common::get_unix_time_ms());
+    api_server_set_text(app.api, utf8_from_text(app.api_texts.time), utf8_from_text(app.api_texts.date));
+  }
+  api_server_flush(app.api);
+  common::api_pipe_send(app.api_pipe);
+  arm_api_timer(app, topics);
+}
+
+// @NOTE: Hands the render thread a new snapshot if anything it draws from
+// changed. When the queue is full the next (expedited) tick tries again.
+void publish_frame(App& app) {
+  TRACE_SCOPE(PublishFrame);
+  publish_api(app);
+  FrameSnapshot snapshot;
+  snapshot.format = app.frame_format;
+  snapshot.analog = app.settings.analog;
+  snapshot.smooth = app.settings.smooth_seconds;
+  snapshot.seconds = app.settings.long_time && (app.power.mode == PowerMode::Full);
+  snapshot.metrics = app.settings.system_metrics && !app.settings.analog;
+  snapshot.power = app.power.mode;
+  snapshot.overlays = app.overlay_texts;
+  clock_table_fill_snapshot(app.clocks, app.surface_cache, snapshot);
+  if (same_frame_state(snapshot, app.published)) return;
+
+  snapshot.serial = app.published.serial + 1;
+  if (!render_queue_publish(app.renderer.queue, snapshot)) {
+    expedite_tick(app);
+    return;
+  }
+  app.published = snapshot;
+  SetEvent(app.renderer.wake);
+}
+
+void destroy_backdrop_capture(BackdropCapture& capture) {
+  if (capture.dc) DeleteDC(capture.dc);
+  if (capture.bitmap) DeleteObject(capture.bitmap);
+  capture = { };
+}
+
+// @NOTE: Copies the desktop behind `window` into the scratch DIB. Layered
+// windows, the clocks included, are left out unless CAPTUREBLT is given.
+bool capture_backdrop(BackdropCapture& capture, HWND window, PixelView& view) {
+  RECT rect;
+  if (!GetWindowRect(window, &rect)) return false;
+  const int width = rect.right - rect.left;
+  const int height = rect.bottom - rect.top;
+  if ((width <= 0) || (height <= 0)) return false;
+
+  if ((width > capture.size.x) || (height > capture.size.y)) {
+    const Int2 size = {(width > capture.size.x) ? width : capture.size.x, (height > capture.size.y) ? height : capture.size.y};
+    destroy_backdrop_capture(capture);
+
+    BITMAPINFO info = { };
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = size.x;
+    info.bmiHeader.biHeight = -size.y; // @NOTE: top-down
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    void* bits = nullptr;
+    capture.bitmap = CreateDIBSection(nullptr, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+    capture.dc = CreateCompatibleDC(nullptr);
+    if (!capture.bitmap || !capture.dc) {
+      destroy_backdrop_capture(capture);
+      return false;
     }
+    SelectObject(capture.dc, capture.bitmap);
+    capture.pixels = static_cast<uint32_t*>(bits);
+    capture.size = size;
+  }
+
+  HDC screen_dc = GetDC(nullptr);
+  const bool ok = BitBlt(capture.dc, 0, 0, width, height, screen_dc, rect.left, rect.top, SRCCOPY) != FALSE;
+  ReleaseDC(nullptr, screen_dc);
+  GdiFlush();
+
+  view = PixelView{.pixels = capture.pixels, .width = width, .height = height, .stride = capture.size.x};
+  return ok;
+}
+
+// @NOTE: The backdrop timer. Only clocks whose backdrop hash changed are
+// measured, and only a changed decision moves a clock to another surface.
+void sample_backdrops(App& app) {
+  if (!app.settings.adaptive_contrast) return;
+
+  TRACE_SCOPE(SampleBackdrop);
+  const BackdropKernel kernel = best_backdrop_kernel();
+  Event event = {.kind = EventKind::Backdrop};
+  bool changed = false;
+  ClockTable& clocks = app.clocks;
+  for (uint32_t i = 0; i < clock_table_size(clocks); ++i) {
+    PixelView view;
+    if (clocks.hidden[i] || !capture_backdrop(app.backdrop, reinterpret_cast<HWND>(clocks.windows[i]), view)) continue;
+
+    const uint64_t hash = backdrop_hash(view, kernel);
+    if (!backdrop_changed(clocks.contrasts[i], hash)) continue;
+
+    const BackdropSample sample = make_backdrop_sample(hash, backdrop_luma(view, kernel));
+    event.backdrops.push_back(BackdropEntry{.clock = i, .sample = sample});
+    if (backdrop_update(clocks.contrasts[i], sample)) changed = true;
+  }
+  if (!event.backdrops.empty()) record_event(app, event);
+  if (!changed) return;
+
+  update_clock_surfaces(app);
+  publish_frame(app);
+}
+
+// @NOTE: The render thread would create these one after the other for its
+// first frame. At startup they are created in parallel before it starts,
+// the generations are handed out afterwards in slot order.
+void create_startup_surfaces(App& app) {
+  Renderer& renderer = app.renderer;
+  const std::vector<SurfaceSlot>& slots = app.surface_cache.slots;
+  renderer.surfaces.resize(slots.size());
+  startup_parallel_for(static_cast<uint32_t>(slots.size()), kStartupWorkers + 1, [&](uint32_t i) {
+    if (slots[i].refcount > 0) renderer.surfaces[i] = create_surface(slots[i].key, app.format.locale, compute_clock_window_size(surface_key_dpi_scale(slots[i].key)), renderer);
+  });
+  for (Surface& surface : renderer.surfaces) {
+    if (surface.rt) surface.generation = ++renderer.next_surface_generation;
+  }
+}
+
+// @NOTE: Written once, on the first backdrop timer after the first present,
+// so that it includes the time to first paint.
+void write_startup_report(App& app) {
+  const uint64_t first_present_ns = app.renderer.first_present_ns.load(std::memory_order_relaxed);
+  if (app.startup_report_path.empty() || (first_present_ns == 0)) return;
+
+  if (FILE* f = _wfopen(app.startup_report_path.c_str(), L"wb"); f) {
+    startup_graph_write_report(app.startup, f);
+    const uint64_t first_frame_ns = startup_graph_end_ns(app.startup, "first_frame");
+    fprintf(f, "{\"first_frame_us\":%llu,\"first_present_us\":%llu}\n", static_cast<unsigned long long>(first_frame_ns / 1000), static_cast<unsigned long long>((first_present_ns - app.startup.start_ns) / 1000));
+    fclose(f);
+  }
+  app.startup_report_path.clear();
+}
+
+// @NOTE: Only maps the file when its write time or size changed, the build
+// then reparses just the VEVENT blocks that changed.
+bool reindex_calendar(App& app) {
+  const uint64_t version = common::get_file_version(app.calendar_absolute_path);
+  if (version == app.calendar_version) return false;
+
+  TRACE_SCOPE(CalendarIndex);
+  app.calendar_version = version;
+  common::MappedFile mapped;
+  if (!common::map_file(app.calendar_absolute_path, mapped)) {
+    app.calendar = { };
+    return true;
+  }
+  const CalendarParseOptions options = {.utc_to_local = common::local_wall_seconds_from_utc};
+  calendar_index_build(app.calendar, mapped.data, mapped.size, options);
+  common::unmap_file(mapped);
+  return true;
+}
+
+int64_t calendar_shift_month(int64_t month_start, int32_t months) {
+  const CivilTime civil = calendar_civil(month_start);
+  const int32_t index = civil.year * 12 + (civil.month - 1) + months;
+  CivilTime shifted = { };
+  shifted.year = static_cast<uint16_t>(index / 12);
+  shifted.month = static_cast<uint16_t>(index % 12 + 1);
+  shifted.day = 1;
+  return calendar_wall_seconds(shifted);
+}
+
+std::wstring calendar_summary(const CalendarEvent& event) {
+  const int length = MultiByteToWideChar(CP_UTF8, 0, event.summary.data(), static_cast<int>(event.summary.size()), nullptr, 0);
+  std::wstring result(static_cast<size_t>(length), L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, event.summary.data(), static_cast<int>(event.summary.size()), result.data(), length);
+  return result;
+}
+
+// @NOTE: The month grid starts on the Monday before the first of the month,
+// days with an event get a dot. Below it the next meetings from now.
+void paint_calendar_flyout(const App& app, HWND window, HDC dc) {
+  const int dpi = static_cast<int>(GetDpiForWindow(window));
+  auto px = [dpi](int value) { return MulDiv(value, dpi, 96); };
+  const bool light = app.flags.test(kAppFlagUseLightTheme);
+  const COLORREF background = light ? RGB(249, 249, 249) : RGB(32, 32, 32);
+  const COLORREF text = light ? RGB(0, 0, 0) : RGB(255, 255, 255);
+  const COLORREF muted = light ? RGB(110, 110, 110) : RGB(160, 160, 160);
+  const COLORREF accent = light ? RGB(0, 95, 184) : RGB(96, 205, 255);
+
+  RECT client;
+  GetClientRect(window, &client);
+  HBRUSH background_brush = CreateSolidBrush(background);
+  FillRect(dc, &client, background_brush);
+  DeleteObject(background_brush);
+
+  HFONT font = CreateFontW(-px(14), 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY, DEFAULT_PITCH, L"Segoe UI");
+  HFONT bold = CreateFontW(-px(14), 0, 0, 0, FW_SEMIBOLD, FALSE, FALSE, FALSE, DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY, DEFAULT_PITCH, L"Segoe UI");
+  HGDIOBJ previous_font = SelectObject(dc, bold);
+  SetBkMode(dc, TRANSPARENT);
+
+  const CivilTime month = calendar_civil(app.calendar_month);
+  const LocaleNames& names = app.format.names;
+  const std::wstring title = names.month_names[month.month - 1] + L" " + std::to_wstring(month.year);
+  SetTextColor(dc, text);
+  RECT r = {px(16), px(12), client.right - px(16), px(40)};
+  DrawTextW(dc, title.c_str(), -1, &r, DT_LEFT | DT_VCENTER | DT_SINGLELINE);
+
+  const int cell = px(38);
+  const int grid_left = px(16);
+  const int grid_top = px(72);
+  SelectObject(dc, font);
+  SetTextColor(dc, muted);
+  for (int column = 0; column < 7; ++column) {
+    r = {grid_left + column * cell, px(44), grid_left + (column + 1) * cell, grid_top};
+    DrawTextW(dc, names.abbreviated_day_names[(column + 1) % 7].c_str(), -1, &r, DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+  }
+
+  constexpr int64_t kDay = 86400;
+  const int64_t first_day = app.calendar_month / kDay;
+  const int64_t grid_start = first_day - (first_day + 3) % 7; // @NOTE: 1970-01-01 was a Thursday
+  std::vector<CalendarOccurrence> occurrences;
+  calendar_query(app.calendar, grid_start * kDay, (grid_start + 42) * kDay, occurrences);
+  std::bitset<42> busy;
+  for (const CalendarOccurrence& occurrence : occurrences) {
+    const int64_t last = std::max(occurrence.start, occurrence.end - 1) / kDay;
+    for (int64_t day = std::max(occurrence.start / kDay, grid_start); (day <= last) && (day < grid_start + 42); ++day) busy.set(static_cast<size_t>(day - grid_start));
+  }
+
+  const int64_t now = calendar_wall_seconds(common::get_local_time());
+  const int64_t today = now / kDay;
+  HBRUSH accent_brush = CreateSolidBrush(accent);
+  HGDIOBJ previous_brush = SelectObject(dc, accent_brush);
+  HGDIOBJ previous_pen = SelectObject(dc, GetStockObject(NULL_PEN));
+  for (int i = 0; i < 42; ++i) {
+    const int64_t day = grid_start + i;
+    const CivilTime civil = calendar_civil(day * kDay);
+    const int x = grid_left + (i % 7) * cell;
+    const int y = grid_top + (i / 7) * cell;
+    if (day == today) Ellipse(dc, x + px(3), y + px(3), x + cell - px(3), y + cell - px(3));
+
+    SetTextColor(dc, (day == today) ? background : ((civil.month == month.month) ? text : muted));
+    r = {x, y, x + cell, y + cell - px(4)};
+    DrawTextW(dc, std::to_wstring(civil.day).c_str(), -1, &r, DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+    if (busy.test(static_cast<size_t>(i)) && (day != today)) Ellipse(dc, x + cell / 2 - px(2), y + cell - px(9), x + cell / 2 + px(2), y + cell - px(5));
+  }
+  SelectObject(dc, previous_pen);
+  SelectObject(dc, previous_brush);
+  DeleteObject(accent_brush);
+
+  const int agenda_top = grid_top + 6 * cell + px(12);
+  SelectObject(dc, bold);
+  SetTextColor(dc, text);
+  r = {px(16), agenda_top, client.right - px(16), agenda_top + px(28)};
+  DrawTextW(dc, L"Next meetings", -1, &r, DT_LEFT | DT_VCENTER | DT_SINGLELINE);
+
+  SelectObject(dc, font);
+  occurrences.clear();
+  calendar_query(app.calendar, now, now + kCalendarAgendaDays * kDay, occurrences);
+  const int row_height = px(22);
+  size_t rows = 0;
+  for (const CalendarOccurrence& occurrence : occurrences) {
+    if (rows == kCalendarAgendaRows) break;
+    const CalendarEvent& event = app.calendar.events[occurrence.event];
+    if (event.all_day) continue; // @NOTE: the grid already shows them
+
+    const CivilTime civil = calendar_civil(occurrence.start);
+    wchar_t when[64];
+    swprintf_s(when, L"%s %u  %02u:%02u", names.abbreviated_day_names[(occurrence.start / kDay + 4) % 7].c_str(), static_cast<unsigned>(civil.day), static_cast<unsigned>(civil.hour), static_cast<unsigned>(civil.minute));
+    const int y = agenda_top + px(28) + static_cast<int>(rows) * row_height;
+    SetTextColor(dc, muted);
+    r = {px(16), y, px(116), y + row_height};
+    DrawTextW(dc, when, -1, &r, DT_LEFT | DT_VCENTER | DT_SINGLELINE);
+    SetTextColor(dc, text);
+    r = {px(120), y, client.right - px(16), y + row_height};
+    DrawTextW(dc, calendar_summary(event).c_str(), -1, &r, DT_LEFT | DT_VCENTER | DT_SINGLELINE | DT_END_ELLIPSIS | DT_NOPREFIX);
+    rows++;
+  }
+  if (rows == 0) {
+    SetTextColor(dc, muted);
+    r = {px(16), agenda_top + px(28), client.right - px(16), agenda_top + px(28) + row_height};
+    DrawTextW(dc, app.calendar.events.empty() ? L"No calendar.ics found" : L"Nothing in the next two weeks", -1, &r, DT_LEFT | DT_VCENTER | DT_SINGLELINE);
   }
 
+  SelectObject(dc, previous_font);
+  DeleteObject(font);
+  DeleteObject(bold);
+}
+
+LRESULT CALLBACK calendar_window_callback(HWND window, UINT message, WPARAM wparam, LPARAM lparam) {
+  App* app = reinterpret_cast<App*>(GetWindowLongPtrW(window, GWLP_USERDATA));
+  if (!app) return DefWindowProcW(window, message, wparam, lparam);
+
+  switch (message) {
+    case WM_PAINT: {
+      PAINTSTRUCT paint;
+      HDC dc = BeginPaint(window, &paint);
+      RECT client;
+      GetClientRect(window, &client);
+
+      // @NOTE: Painted off screen, the grid would flicker when paging months.
+      HDC buffer = CreateCompatibleDC(dc);
+      HBITMAP bitmap = CreateCompatibleBitmap(dc, client.right, client.bottom);
+      HGDIOBJ previous = SelectObject(buffer, bitmap);
+      paint_calendar_flyout(*app, window, buffer);
+      BitBlt(dc, 0, 0, client.right, client.bottom, buffer, 0, 0, SRCCOPY);
+      SelectObject(buffer, previous);
+      DeleteObject(bitmap);
+      DeleteDC(buffer);
+      EndPaint(window, &paint);
+      return 0;
+    }
+
+    case WM_KEYDOWN: {
+      if (wparam == VK_ESCAPE) DestroyWindow(window);
+      else if (wparam == VK_LEFT) app->calendar_month = calendar_shift_month(app->calendar_month, -1);
+      else if (wparam == VK_RIGHT) app->calendar_month = calendar_shift_month(app->calendar_month, 1);
+      else if (wparam == VK_HOME) app->calendar_month = calendar_shift_month(calendar_wall_seconds(common::get_local_time()), 0);
+      else break;
+      InvalidateRect(window, nullptr, FALSE);
+      return 0;
+    }
+
+    case WM_MOUSEWHEEL: {
+      app->calendar_month = calendar_shift_month(app->calendar_month, (GET_WHEEL_DELTA_WPARAM(wparam) > 0) ? -1 : 1);
+      InvalidateRect(window, nullptr, FALSE);
+      return 0;
+    }
+
+    case WM_TIMER: {
+      if ((wparam == kCalendarTimer) && reindex_calendar(*app)) InvalidateRect(window, nullptr, FALSE);
+      return 0;
+    }
+
+    case WM_ACTIVATE: {
+      if (LOWORD(wparam) == WA_INACTIVE) DestroyWindow(window);
+      return 0;
+    }
+
+    case WM_DESTROY: {
+      KillTimer(window, kCalendarTimer);
+      app->calendar_window = nullptr;
+      return 0;
+    }
+  }
   return DefWindowProcW(window, message, wparam, lparam);
 }
 
+// @NOTE: Opened from the notification area icon, the clocks themselves are
+// click-through. Sits in the corner of the work area next to the cursor and
+// reindexes calendar.ics while it is open.
+void open_calendar_flyout(App& app) {
+  if (app.calendar_window) {
+    SetForegroundWindow(app.calendar_window);
+    return;
+  }
+  reindex_calendar(app);
+  app.calendar_month = calendar_shift_month(calendar_wall_seconds(common::get_local_time()), 0);
+
+  POINT mouse;
+  GetCursorPos(&mouse);
+  MONITORINFO info = {.cbSize = sizeof(MONITORINFO)};
+  GetMonitorInfoW(MonitorFromPoint(mouse, MONITOR_DEFAULTTONEAREST), &info);
+  UINT dpi_x = 96, dpi_y = 96;
+  GetDpiForMonitor(MonitorFromPoint(mouse, MONITOR_DEFAULTTONEAREST), MDT_EFFECTIVE_DPI, &dpi_x, &dpi_y);
+  const int width = MulDiv(kCalendarFlyoutSize.x, static_cast<int>(dpi_x), 96);
+  const int height = MulDiv(kCalendarFlyoutSize.y, static_cast<int>(dpi_y), 96);
+  const RECT& work = info.rcWork;
+  const int x = std::max(static_cast<int>(work.left), std::min(static_cast<int>(mouse.x) - width / 2, static_cast<int>(work.right) - width));
+  const int y = std::max(static_cast<int>(work.top), std::min(static_cast<int>(mouse.y) - height, static_cast<int>(work.bottom) - height));
+
+  HWND window = CreateWindowExW(WS_EX_TOOLWINDOW | WS_EX_TOPMOST, L"calendar-class", L"Calendar", WS_POPUP | WS_BORDER, x, y, width, height, app.message_window, nullptr, GetModuleHandleW(nullptr), nullptr);
+  if (!window) return;
+
+  SetWindowLongPtrW(window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(&app));
+  app.calendar_window = window;
+  SetTimer(window, kCalendarTimer, kCalendarReindexMs, nullptr);
+  ShowWindow(window, SW_SHOW);
+  SetForegroundWindow(window);
+}
+
+// @NOTE: Layered windows are only ever updated through
+// UpdateLayeredWindowIndirect from the render thread.
+LRESULT CALLBACK window_callback(HWND window, UINT message, WPARAM wparam, LPARAM lparam) {
+  return DefWindowProcW(window, message, wparam, lparam);
+}
+
+// @NOTE: Rasterizes the icon artwork at the exact small icon size for `dpi`
+// instead of scaling the one in the resources.
+HICON create_clock_icon(UINT dpi) {
+  const int size = GetSystemMetricsForDpi(SM_CXSMICON, dpi);
+
+  BITMAPINFO info = { };
+  info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+  info.bmiHeader.biWidth = size;
+  info.bmiHeader.biHeight = -size; // @NOTE: top-down
+  info.bmiHeader.biPlanes = 1;
+  info.bmiHeader.biBitCount = 32;
+  info.bmiHeader.biCompression = BI_RGB;
+
+  void* bits = nullptr;
+  HBITMAP color = CreateDIBSection(nullptr, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+  if (!color) return nullptr;
+
+  const PixelView view = {.pixels = static_cast<uint32_t*>(bits), .width = size, .height = size, .stride = size};
+  rasterize_clock_face(view, make_icon_clock_face(), best_clock_face_kernel());
+  unpremultiply(view);
+
+  std::vector<uint8_t> mask_bits(static_cast<size_t>((size + 15) / 16 * 2 * size), 0);
+  HBITMAP mask = CreateBitmap(size, size, 1, 1, mask_bits.data());
+
+  ICONINFO icon_info = {.fIcon = TRUE, .hbmMask = mask, .hbmColor = color};
+  HICON icon = CreateIconIndirect(&icon_info);
+  DeleteObject(mask);
+  DeleteObject(color);
+  return icon;
+}
+
 bool add_notification_area_icon(HWND window) {
+  HICON icon = create_clock_icon(GetDpiForWindow(window));
+
   NOTIFYICONDATAW data = { };
   data.cbSize = sizeof(data);
   data.hWnd = window;
   data.uFlags = NIF_ICON | NIF_MESSAGE | NIF_TIP;
   data.uCallbackMessage = WM_CLOCK_NOTIFY_COMMAND;
-  data.hIcon = LoadIconW(GetModuleHandleW(nullptr), MAKEINTRESOURCEW(1));
+  data.hIcon = icon ? icon : LoadIconW(GetModuleHandleW(nullptr), MAKEINTRESOURCEW(1));
   wcscpy_s(data.szTip, std::size(data.szTip), L"win11-clock");
 
-  return Shell_NotifyIconW(NIM_ADD, &data) == TRUE;
+  const bool ok = Shell_NotifyIconW(NIM_ADD, &data) == TRUE;
+  if (icon) DestroyIcon(icon); // @NOTE: the shell keeps its own copy
+  return ok;
+}
+
+void update_notification_area_icon(HWND window) {
+  HICON icon = create_clock_icon(GetDpiForWindow(window));
+  if (!icon) return;
+
+  NOTIFYICONDATAW data = { };
+  data.cbSize = sizeof(data);
+  data.hWnd = window;
+  data.uFlags = NIF_ICON;
+  data.hIcon = icon;
+  Shell_NotifyIconW(NIM_MODIFY, &data);
+  DestroyIcon(icon);
 }
 
 void remove_notification_area_icon(HWND window) {
@@ -233,6 +1590,146 @@ void remove_notification_area_icon(HWND window) {
   Shell_NotifyIconW(NIM_DELETE, &data);
 }
 
+void show_alarm_notification(HWND window, const std::string& label) {
+  NOTIFYICONDATAW data = { };
+  data.cbSize = sizeof(data);
+  data.hWnd = window;
+  data.uFlags = NIF_INFO;
+  data.dwInfoFlags = NIIF_INFO;
+  wcscpy_s(data.szInfoTitle, std::size(data.szInfoTitle), L"Alarm");
+  // @NOTE: Converted whole and cut in UTF-16, cutting the UTF-8 bytes could
+  // split a character. Never between the halves of a surrogate pair either.
+  std::wstring text(static_cast<size_t>(MultiByteToWideChar(CP_UTF8, 0, label.data(), static_cast<int>(label.size()), nullptr, 0)), L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, label.data(), static_cast<int>(label.size()), text.data(), static_cast<int>(text.size()));
+  size_t length = std::min(text.size(), std::size(data.szInfo) - 1);
+  if ((length < text.size()) && (length > 0) && IS_HIGH_SURROGATE(text[length - 1])) length--;
+  wmemcpy(data.szInfo, text.data(), length);
+  Shell_NotifyIconW(NIM_MODIFY, &data);
+}
+
+// @NOTE: Polled with the backdrop timer, and like the calendar only read
+// when the file's write time or size changed.
+bool load_alarms(App& app) {
+  const uint64_t version = common::get_file_version(app.alarms_absolute_path);
+  if (version == app.alarms_version) return false;
+
+  app.alarms_version = version;
+  std::string text;
+  if (FILE* f = _wfopen(app.alarms_absolute_path.c_str(), L"rb"); f) {
+    char buffer[4096];
+    for (size_t n; (n = fread(buffer, 1, sizeof(buffer), f)) > 0;) text.append(buffer, n);
+    fclose(f);
+  }
+  alarms_configure(app.alarms, parse_alarm_config(text.data(), text.size()), GetTickCount64(), common::get_local_time());
+  return true;
+}
+
+// @NOTE: The tick is planned a day ahead, so the alarms keep their own
+// one-shot timer at the wheel's next deadline and nothing wakes up for
+// them in between.
+void arm_alarm_timer(App& app) {
+  const uint64_t deadline = alarms_next_deadline(app.alarms);
+  if (deadline == UINT64_MAX) {
+    KillTimer(app.message_window, kAlarmTimer);
+    return;
+  }
+  const uint64_t now = GetTickCount64();
+  const uint64_t delay = (deadline > now) ? deadline - now : 0;
+  SetTimer(app.message_window, kAlarmTimer, static_cast<UINT>(std::min<uint64_t>(delay, USER_TIMER_MAXIMUM)), nullptr);
+}
+
+// @NOTE: Clock rows are in monitor order, row + 1 is the monitor an alarm
+// names.
+void apply_alarm_alerts(App& app) {
+  Event event = {.kind = EventKind::Alarm};
+  ClockTable& clocks = app.clocks;
+  for (uint32_t i = 0; i < clock_table_size(clocks); ++i) {
+    const bool alert = alarms_alerting(app.alarms, i + 1);
+    clocks.alerts[i] = alert;
+    event.alerts.push_back(alert);
+  }
+  record_event(app, event);
+  update_clock_surfaces(app);
+  publish_frame(app);
+}
+
+void run_alarms(App& app) {
+  TRACE_SCOPE(Alarms);
+  std::vector<uint32_t> fired;
+  if (alarms_advance(app.alarms, GetTickCount64(), common::get_local_time(), fired)) apply_alarm_alerts(app);
+  for (uint32_t index : fired) show_alarm_notification(app.message_window, app.alarms.entries[index].label);
+  arm_alarm_timer(app);
+}
+
+void arm_overlay_timer(App& app) {
+  const uint64_t expiry = api_overlays_next_expiry(app.overlays);
+  if (expiry == 0) {
+    KillTimer(app.message_window, kOverlayTimer);
+    return;
+  }
+  const uint64_t now = GetTickCount64();
+  SetTimer(app.message_window, kOverlayTimer, static_cast<UINT>(std::clamp<uint64_t>((expiry > now) ? expiry - now : 0, USER_TIMER_MINIMUM, USER_TIMER_MAXIMUM)), nullptr);
+}
+
+// @NOTE: Every clock shows the newest overlay for its monitor as an extra
+// line, the render thread finds the texts in the snapshot.
+void show_overlays(App& app) {
+  std::shared_ptr<std::vector<SnapshotOverlay>> texts;
+  if (!app.overlays.entries.empty()) texts = std::make_shared<std::vector<SnapshotOverlay>>();
+  for (const ApiOverlay& overlay : app.overlays.entries) {
+    const int length = MultiByteToWideChar(CP_UTF8, 0, overlay.text.data(), static_cast<int>(overlay.text.size()), nullptr, 0);
+    std::wstring text(static_cast<size_t>(length), L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, overlay.text.data(), static_cast<int>(overlay.text.size()), text.data(), length);
+    texts->push_back(SnapshotOverlay{.id = overlay.id, .text = std::move(text)});
+  }
+  app.overlay_texts = std::move(texts);
+
+  Event event = {.kind = EventKind::Overlay};
+  ClockTable& clocks = app.clocks;
+  for (uint32_t i = 0; i < clock_table_size(clocks); ++i) {
+    const uint16_t overlay = api_overlay_for(app.overlays, clocks.monitors[i].identity);
+    clocks.overlays[i] = overlay;
+    event.overlays.push_back(overlay);
+  }
+  record_event(app, event);
+  update_clock_surfaces(app);
+  publish_frame(app);
+  arm_overlay_timer(app);
+}
+
+// @NOTE: After a client's frames were handled.
+void apply_api_requests(App& app) {
+  bool changed = false;
+  for (const ApiOverlayRequest& request : app.api.overlays) changed = api_overlays_apply(app.overlays, request, GetTickCount64()) || changed;
+  app.api.overlays.clear();
+  if (changed) show_overlays(app);
+  else publish_api(app); // @NOTE: the state of new subscriptions
+}
+
+// @NOTE: Suspending stops the render thread with the snapshot published
+// here and the tick until the resume, whose tick catches up on whatever
+// piled up meanwhile and renders once.
+void apply_power_event(App& app, PowerEvent event) {
+  Event record = {.kind = EventKind::Power, .flags = static_cast<uint32_t>(event)};
+  record_event(app, record);
+
+  const PowerMode previous = app.power.mode;
+  if (!power_state_apply(app.power, event, GetTickCount64())) return;
+  if (app.power.mode == PowerMode::Suspended) {
+    KillTimer(app.message_window, kTickTimer);
+    app.scheduler.deadline_ms = 0;
+    publish_frame(app);
+    return;
+  }
+
+  app.transient_flags.set(kTransientAppFlagPowerChanged);
+  if (previous == PowerMode::Suspended) {
+    app.transient_flags.set(kTransientAppFlagResumed);
+    if (topmost_guard_trigger_all(app.topmost, GetTickCount64())) SetTimer(app.message_window, kTopmostTimer, app.topmost.coalesce_ms, nullptr);
+  }
+  expedite_tick(app);
+}
+
 LRESULT CALLBACK dummy_window_callback(HWND window, UINT message, WPARAM wparam, LPARAM lparam) {
   if (message == WM_CREATE) {
     add_notification_area_icon(window);
@@ -248,6 +1745,7 @@ LRESULT CALLBACK dummy_window_callback(HWND window, UINT message, WPARAM wparam,
       }
 
       case WM_CLOCK_NOTIFY_COMMAND: {
+        if (lparam == WM_LBUTTONUP) open_calendar_flyout(*app);
         if (lparam == WM_RBUTTONUP) {
           constexpr UINT kCmdPrimaryDisplay = 1;
           constexpr UINT kCmdPositionBottomLeft = 2;
@@ -260,10 +1758,40 @@ LRESULT CALLBACK dummy_window_callback(HWND window, UINT message, WPARAM wparam,
           constexpr UINT kCmdFormatLongTime = 9;
           constexpr UINT kCmdOnFullscreen = 10;
           constexpr UINT kCmdOpenRegionControlPanel = 11;
+          constexpr UINT kCmdAnalog = 12;
+          constexpr UINT kCmdSmoothSeconds = 13;
+          constexpr UINT kCmdAdaptiveContrast = 14;
+          constexpr UINT kCmdCalendar = 15;
+          constexpr UINT kCmdDismissAlarms = 16;
+          constexpr UINT kCmdDisplayDefaultPosition = 17;
+          constexpr UINT kCmdDisplayBottomLeft = 18;
+          constexpr UINT kCmdDisplayBottomRight = 19;
+          constexpr UINT kCmdDisplayTopLeft = 20;
+          constexpr UINT kCmdDisplayTopRight = 21;
+          constexpr UINT kCmdDisplayShowClock = 22;
+          constexpr UINT kCmdSystemMetrics = 23;
           constexpr UINT kCmdQuit = 255;
 
           auto checked = [](bool is) -> UINT { return is ? static_cast<UINT>(MF_CHECKED) : static_cast<UINT>(MF_UNCHECKED); };
 
+          update_datetime(app->datetime, app->format); // @NOTE: for the format samples
+
+          POINT mouse;
+          GetCursorPos(&mouse);
+
+          // @NOTE: "This Display" is the one whose taskbar was clicked.
+          const uintptr_t menu_monitor = reinterpret_cast<uintptr_t>(MonitorFromPoint(mouse, MONITOR_DEFAULTTONEAREST));
+          bool has_display = false;
+          MonitorProfile profile;
+          for (const Monitor& monitor : app->clocks.monitors) {
+            if (monitor.handle != menu_monitor) continue;
+
+            has_display = true;
+            profile.identity = monitor.identity;
+            if (const MonitorProfile* existing = find_monitor_profile(app->profiles, monitor.identity); existing) profile = *existing;
+          }
+          const bool own_corner = (profile.flags & kMonitorProfileCorner) != 0;
+
           HMENU menu = CreatePopupMenu();
 
           HMENU position_menu = CreatePopupMenu();
@@ -273,33 +1801,53 @@ LRESULT CALLBACK dummy_window_callback(HWND window, UINT message, WPARAM wparam,
           AppendMenuW(position_menu, checked(app->settings.corner == Corner::TopRight), kCmdPositionTopRight, L"Top Right");
           AppendMenuW(menu, MF_POPUP, reinterpret_cast<UINT_PTR>(position_menu), L"Position");
 
+          HMENU display_menu = CreatePopupMenu();
+          AppendMenuW(display_menu, checked(!own_corner), kCmdDisplayDefaultPosition, L"Default Position");
+          AppendMenuW(display_menu, checked(own_corner && (profile.corner == Corner::BottomLeft)), kCmdDisplayBottomLeft, L"Bottom Left");
+          AppendMenuW(display_menu, checked(own_corner && (profile.corner == Corner::BottomRight)), kCmdDisplayBottomRight, L"Bottom Right");
+          AppendMenuW(display_menu, checked(own_corner && (profile.corner == Corner::TopLeft)), kCmdDisplayTopLeft, L"Top Left");
+          AppendMenuW(display_menu, checked(own_corner && (profile.corner == Corner::TopRight)), kCmdDisplayTopRight, L"Top Right");
+          AppendMenuW(display_menu, MF_SEPARATOR, 0, nullptr);
+          AppendMenuW(display_menu, checked((profile.flags & kMonitorProfileHidden) == 0), kCmdDisplayShowClock, L"Show Clock");
+          AppendMenuW(menu, MF_POPUP | (has_display ? static_cast<UINT>(MF_ENABLED) : static_cast<UINT>(MF_GRAYED)), reinterpret_cast<UINT_PTR>(display_menu), L"This Display");
+
           HMENU date_menu = CreatePopupMenu();
-          AppendMenuW(date_menu, checked(!app->settings.long_date), kCmdFormatShortDate, app->datetime.short_date.c_str());
-          AppendMenuW(date_menu, checked(app->settings.long_date), kCmdFormatLongDate, app->datetime.long_date.c_str());
+          AppendMenuW(date_menu, checked(!app->settings.long_date), kCmdFormatShortDate, app->datetime.short_date.text);
+          AppendMenuW(date_menu, checked(app->settings.long_date), kCmdFormatLongDate, app->datetime.long_date.text);
           AppendMenuW(menu, MF_POPUP, reinterpret_cast<UINT_PTR>(date_menu), L"Date Format");
 
           HMENU time_menu = CreatePopupMenu();
-          AppendMenuW(time_menu, checked(!app->settings.long_time), kCmdFormatShortTime, app->datetime.short_time.c_str());
-          AppendMenuW(time_menu, checked(app->settings.long_time), kCmdFormatLongTime, app->datetime.long_time.c_str());
+          AppendMenuW(time_menu, checked(!app->settings.long_time), kCmdFormatShortTime, app->datetime.short_time.text);
+          AppendMenuW(time_menu, checked(app->settings.long_time), kCmdFormatLongTime, app->datetime.long_time.text);
           AppendMenuW(menu, MF_POPUP, reinterpret_cast<UINT_PTR>(time_menu), L"Time Format");
 
+          AppendMenuW(menu, checked(app->settings.analog), kCmdAnalog, L"Analog");
+          AppendMenuW(menu, checked(app->settings.smooth_seconds), kCmdSmoothSeconds, L"Smooth Seconds");
+          AppendMenuW(menu, checked(app->settings.adaptive_contrast), kCmdAdaptiveContrast, L"Adaptive Contrast");
+          AppendMenuW(menu, checked(app->settings.system_metrics) | (app->settings.analog ? static_cast<UINT>(MF_GRAYED) : static_cast<UINT>(MF_ENABLED)), kCmdSystemMetrics, L"System Metrics");
           AppendMenuW(menu, checked(app->settings.on_fullscreen), kCmdOnFullscreen, L"On Fullscreen");
           AppendMenuW(menu, checked(app->settings.on_primary_display), kCmdPrimaryDisplay, L"Primary Display");
+          AppendMenuW(menu, MF_STRING, kCmdCalendar, L"Calendar");
+          if (!app->alarms.alerts.empty()) AppendMenuW(menu, MF_STRING, kCmdDismissAlarms, L"Dismiss Alarms");
           AppendMenuW(menu, MF_STRING, kCmdOpenRegionControlPanel, L"Open Region Options");
           AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
           AppendMenuW(menu, MF_STRING, kCmdQuit, L"Exit");
 
           SetForegroundWindow(window);
 
-          POINT mouse;
-          GetCursorPos(&mouse);
           UINT cmd = static_cast<UINT>(TrackPopupMenu(menu, TPM_RETURNCMD | TPM_NONOTIFY, mouse.x, mouse.y, 0, window, nullptr));
 
           DestroyMenu(menu);
           DestroyMenu(position_menu);
+          DestroyMenu(display_menu);
           DestroyMenu(time_menu);
           DestroyMenu(date_menu);
 
+          auto display_corner = [&](bool own, Corner corner) {
+            profile.flags = static_cast<uint8_t>(own ? (profile.flags | kMonitorProfileCorner) : (profile.flags & ~kMonitorProfileCorner));
+            profile.corner = own ? corner : Corner::BottomRight;
+          };
+
           Settings settings = app->settings;
           switch (cmd) {
             case kCmdQuit: DestroyWindow(window); break;
@@ -313,12 +1861,33 @@ LRESULT CALLBACK dummy_window_callback(HWND window, UINT message, WPARAM wparam,
             case kCmdFormatLongTime: settings.long_time = true; break;
             case kCmdFormatShortTime: settings.long_time = false; break;
             case kCmdOnFullscreen: settings.on_fullscreen = !settings.on_fullscreen; break;
+            case kCmdAnalog: settings.analog = !settings.analog; break;
+            case kCmdSmoothSeconds: settings.smooth_seconds = !settings.smooth_seconds; break;
+            case kCmdAdaptiveContrast: settings.adaptive_contrast = !settings.adaptive_contrast; break;
+            case kCmdSystemMetrics: settings.system_metrics = !settings.system_metrics; break;
             case kCmdOpenRegionControlPanel: common::open_region_control_panel(); break;
+            case kCmdCalendar: open_calendar_flyout(*app); break;
+            case kCmdDismissAlarms: {
+              if (alarms_dismiss(app->alarms)) apply_alarm_alerts(*app);
+              arm_alarm_timer(*app);
+              break;
+            }
+            case kCmdDisplayDefaultPosition: display_corner(false, Corner::BottomRight); break;
+            case kCmdDisplayBottomLeft: display_corner(true, Corner::BottomLeft); break;
+            case kCmdDisplayBottomRight: display_corner(true, Corner::BottomRight); break;
+            case kCmdDisplayTopLeft: display_corner(true, Corner::TopLeft); break;
+            case kCmdDisplayTopRight: display_corner(true, Corner::TopRight); break;
+            case kCmdDisplayShowClock: profile.flags = static_cast<uint8_t>(profile.flags ^ kMonitorProfileHidden); break;
           }
-          if (settings != app->settings) {
+          MonitorProfiles profiles = app->profiles;
+          if (has_display) set_monitor_profile(profiles, profile);
+          if ((settings != app->settings) || (profiles != app->profiles)) {
+            Event event = {.kind = EventKind::SettingsChange, .settings = settings, .profiles = profiles};
+            record_event(*app, event);
             app->settings = settings;
+            app->profiles = std::move(profiles);
             app->transient_flags.set(kTransientAppFlagSettingsChanged);
-            app->transient_flags.set(kTransientAppFlagRecreateRequested);
+            expedite_tick(*app);
           }
         }
         return 0;
@@ -326,39 +1895,133 @@ LRESULT CALLBACK dummy_window_callback(HWND window, UINT message, WPARAM wparam,
 
       case WM_WININICHANGE: {
         const wchar_t* name = reinterpret_cast<const wchar_t*>(lparam);
-        if (name && wcscmp(L"ImmersiveColorSet", name) == 0) app->transient_flags.set(kTransientAppFlagColorModeChanged, true);
-        if (name && wcscmp(L"intl", name) == 0) app->transient_flags.set(kTransientAppFlagLanguageOrRegionChanged, true);
+        const uint32_t changes = ((name && wcscmp(L"ImmersiveColorSet", name) == 0) ? kEventWinIniColorSet : 0u) | ((name && wcscmp(L"intl", name) == 0) ? kEventWinIniIntl : 0u);
+        if (changes) {
+          Event event = {.kind = EventKind::WinIniChange, .flags = changes};
+          record_event(*app, event);
+        }
+        if (changes & kEventWinIniColorSet) app->transient_flags.set(kTransientAppFlagColorModeChanged, true);
+        if (changes & kEventWinIniIntl) app->transient_flags.set(kTransientAppFlagLanguageOrRegionChanged, true);
+        if (app->transient_flags.any()) expedite_tick(*app);
         return 0;
       }
 
-      case WM_DEVICECHANGE:  app->transient_flags.set(kTransientAppFlagRecreateRequested); break;
-      case WM_DISPLAYCHANGE: app->transient_flags.set(kTransientAppFlagRecreateRequested); break;
-      case WM_DPICHANGED: app->transient_flags.set(kTransientAppFlagRecreateRequested); break;
+      case WM_DEVICECHANGE: record_event(*app, EventKind::DeviceChange); app->transient_flags.set(kTransientAppFlagDisplayChanged); expedite_tick(*app); break;
+      case WM_DISPLAYCHANGE: record_event(*app, EventKind::DisplayChange); update_notification_area_icon(window); app->transient_flags.set(kTransientAppFlagDisplayChanged); expedite_tick(*app); break;
+      case WM_DPICHANGED: record_event(*app, EventKind::DpiChange); update_notification_area_icon(window); app->transient_flags.set(kTransientAppFlagDisplayChanged); expedite_tick(*app); break;
       case WM_INPUTLANGCHANGE: OutputDebugStringA("WM_INPUTLANGCHANGE\n"); break;
-      case WM_TIMECHANGE: OutputDebugStringA("WM_TIMECHANGE\n"); break;
+      case WM_WTSSESSION_CHANGE: {
+        if (PowerEvent event = PowerEvent::Count; common::power_event_from_session(wparam, event)) apply_power_event(*app, event);
+        return 0;
+      }
+      case WM_POWERBROADCAST: {
+        if (wparam != PBT_POWERSETTINGCHANGE) break;
+        if (PowerEvent event = PowerEvent::Count; common::power_event_from_setting(*reinterpret_cast<const POWERBROADCAST_SETTING*>(lparam), event)) apply_power_event(*app, event);
+        return TRUE;
+      }
+      case WM_TIMECHANGE: {
+        Event event = {.kind = EventKind::TimeChange, .civil = common::get_local_time()};
+        record_event(*app, event);
+        SetEvent(app->renderer.wake); // @NOTE: the render thread re-plans its tick
+        app->calendar_version = 0; // @NOTE: UTC events convert to a different local time
+        alarms_retime(app->alarms, GetTickCount64(), common::get_local_time());
+        arm_alarm_timer(*app);
+        break;
+      }
 
       case WM_TIMER: {
-        if (app->transient_flags.test(kTransientAppFlagColorModeChanged)) app->flags.set(kAppFlagUseLightTheme, common::read_use_light_theme_from_registry());
-        if (app->transient_flags.test(kTransientAppFlagLanguageOrRegionChanged)) update_datetime_format(app->format);
-        if (app->transient_flags.test(kTransientAppFlagSettingsChanged)) save_settings(app->settings_absolute_path, app->settings);
-        if (app->transient_flags.test(kTransientAppFlagRecreateRequested)) {
-          destroy_clock_windows(*app);
-          create_clock_windows(*app);
+        if (wparam == kTopmostTimer) {
+          KillTimer(window, kTopmostTimer);
+          Event event = {.kind = EventKind::TopmostCheck};
+          auto clock_window = [&](uint32_t i) { return reinterpret_cast<HWND>(app->clocks.windows[i]); };
+          auto is_covered = [&](uint32_t i) {
+            const bool lost = common::is_window_covered(clock_window(i));
+            event.lost.push_back(lost);
+            return lost;
+          };
+          auto raise = [&](uint32_t i) { SetWindowPos(clock_window(i), HWND_TOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE); };
+          topmost_guard_enforce(app->topmost, app->clocks.hidden, is_covered, raise);
+          record_event(*app, event);
+          return 0;
+        }
+        if (wparam == kBackdropTimer) {
+          write_startup_report(*app);
+          if (app->power.mode != PowerMode::Suspended) sample_backdrops(*app);
+          if (load_alarms(*app)) arm_alarm_timer(*app);
+          return 0;
+        }
+        if (wparam == kAlarmTimer) {
+          run_alarms(*app);
+          return 0;
+        }
+        if (wparam == kApiTimer) {
+          tick_scheduler_wakeup(app->api_scheduler, GetTickCount64());
+          publish_api(*app);
+          return 0;
+        }
+        if (wparam == kOverlayTimer) {
+          if (api_overlays_expire(app->overlays, GetTickCount64())) show_overlays(*app);
+          else arm_overlay_timer(*app);
+          return 0;
+        }
+        if (wparam == kSettingsTimer) {
+          KillTimer(window, kSettingsTimer);
+          if (settings_coalescer_take(app->settings_writes, GetTickCount64())) save_settings(*app);
+          else if (app->settings_writes.pending) SetTimer(window, kSettingsTimer, USER_TIMER_MINIMUM, nullptr);
+          return 0;
+        }
+        if (wparam != kTickTimer) break;
+        if (app->power.mode == PowerMode::Suspended) {
+          KillTimer(window, kTickTimer); // @NOTE: fired before the suspension killed it
+          return 0;
         }
 
+        TRACE_SCOPE(Tick);
+        tick_scheduler_wakeup(app->scheduler, GetTickCount64());
+        const uint32_t transient_flags = static_cast<uint32_t>(app->transient_flags.to_ulong());
+        const TickActions actions = plan_tick(transient_flags);
         app->transient_flags.reset();
-        update_datetime(app->datetime, app->format);
-
-        // @TODO: this is expensive, the desktop window count is in the hunreds
-        std::vector<HWND> desktop_windows = common::get_desktop_windows();
-        for (const ClockWindow& clock : app->clocks) {
-          if (HMONITOR monitor = MonitorFromWindow(clock.window, MONITOR_DEFAULTTONULL); monitor) {
-            const bool fullscreen = common::monitor_has_fullscreen_window(monitor, desktop_windows);
-            const bool hide = (clock.on_primary_monitor && !app->settings.on_primary_display) || (fullscreen && !app->settings.on_fullscreen);
-            ShowWindow(clock.window, hide ? SW_HIDE : SW_SHOW);
-          }
-          InvalidateRect(clock.window, nullptr, FALSE);
+        app->recording = {.kind = EventKind::Tick, .flags = transient_flags, .civil = common::get_local_time()};
+
+        if (actions.reload_theme) {
+          app->flags.set(kAppFlagUseLightTheme, common::read_use_light_theme_from_registry());
+          record_theme(*app);
+        }
+        if (actions.reload_locale) {
+          update_datetime_format(app->format);
+          load_zone_clocks(*app); // @NOTE: also picks up edits to zones.txt
+          record_locale(*app);
+          app->datetime = { };
         }
+        if (actions.save_settings) schedule_settings_write(*app);
+        const bool dates_changed = update_os_dates(app->format, app->recording.civil);
+        if (dates_changed) app->datetime = { }; // @NOTE: its texts were patched for the replaced programs
+        if (actions.reload_locale || actions.save_settings || actions.reformat || dates_changed) app->frame_format = make_frame_format(app->format, app->settings, app->zones, app->power.mode);
+        if (actions.reconcile_clocks) reconcile_clock_windows(*app);
+        if (actions.reload_theme || actions.save_settings) update_clock_surfaces(*app);
+        if (actions.rebuild_window_index) rebuild_window_index(*app);
+
+        std::vector<uint32_t> toggled;
+        uint32_t visible_count;
+        {
+          TRACE_SCOPE(CoveringWindowLookup);
+          visible_count = clock_table_update_visibility(app->clocks, app->windows, app->settings, toggled);
+        }
+        for (uint32_t row : toggled) {
+          // @NOTE: Showing also puts the clock back on top of the topmost band.
+          HWND clock = reinterpret_cast<HWND>(app->clocks.windows[row]);
+          if (app->clocks.hidden[row]) ShowWindow(clock, SW_HIDE);
+          else SetWindowPos(clock, HWND_TOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE | SWP_SHOWWINDOW);
+        }
+
+        TRACE_COUNTER(VisibleClocks, visible_count);
+        publish_frame(*app);
+        record_event(*app, app->recording);
+
+        // @NOTE: The render thread keeps the text current on its own, this
+        // tick only has to run for changes, which expedite it.
+        const uint32_t delay = tick_scheduler_plan(app->scheduler, GetTickCount64(), common::get_local_time(), TickGranularity::Day);
+        SetTimer(window, kTickTimer, delay, nullptr);
         return 0;
       }
     }
@@ -370,8 +2033,42 @@ LRESULT CALLBACK dummy_window_callback(HWND window, UINT message, WPARAM wparam,
 App app; // @TODO: ugh... global just for the win_event_hook...
 
 void CALLBACK win_event_hook(HWINEVENTHOOK hook, DWORD event, HWND window, LONG id_object, LONG id_child, DWORD id_event_thread, DWORD event_time) {
-  for (const ClockWindow& clock : app.clocks)
-    SetWindowPos(clock.window, HWND_TOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+  if (app.power.mode == PowerMode::Suspended) return; // @NOTE: the resume checks every clock
+
+  RECT wr;
+  Event record = {.kind = EventKind::Foreground};
+  if (window && GetWindowRect(window, &wr)) {
+    record.frame = Rect{wr.left, wr.top, wr.right, wr.bottom};
+    record.has_frame = true;
+    record.topmost = common::is_topmost_window(window);
+  }
+  record_event(app, record);
+
+  const bool armed = record.has_frame ?
+    topmost_guard_trigger(app.topmost, GetTickCount64(), record.frame, record.topmost) :
+    topmost_guard_trigger_all(app.topmost, GetTickCount64());
+
+  if (armed) SetTimer(app.message_window, kTopmostTimer, app.topmost.coalesce_ms, nullptr);
+}
+
+void CALLBACK window_index_hook(HWINEVENTHOOK hook, DWORD event, HWND window, LONG id_object, LONG id_child, DWORD id_event_thread, DWORD event_time) {
+  if (!window || id_object != OBJID_WINDOW || id_child != CHILDID_SELF) return;
+  if (app.power.mode == PowerMode::Suspended) return; // @NOTE: the resume rebuilds the index
+
+  const WindowId id = reinterpret_cast<uintptr_t>(window);
+  bool coverage_changed = false;
+  if (event == EVENT_OBJECT_DESTROY) {
+    Event record = {.kind = EventKind::WindowRemove, .windows = {WindowEntry{.id = id}}};
+    record_event(app, record);
+    coverage_changed = window_index_remove(app.windows, id);
+  } else if (common::is_top_level_window(window)) {
+    const WindowState state = common::get_window_state(window);
+    Event record = {.kind = EventKind::WindowUpdate, .windows = {WindowEntry{.id = id, .state = state}}};
+    record_event(app, record);
+    coverage_changed = window_index_update(app.windows, id, state);
+  }
+
+  if (coverage_changed) expedite_tick(app);
 }
 
 int CALLBACK wWinMain(HINSTANCE instance, HINSTANCE ignored, PWSTR command_line, int show_command) {
@@ -387,37 +2084,157 @@ int CALLBACK wWinMain(HINSTANCE instance, HINSTANCE ignored, PWSTR command_line,
   WNDCLASSW clock_window_class = {.lpfnWndProc = window_callback, .hInstance = instance, .lpszClassName = L"clock-class"};
   RegisterClassW(&clock_window_class);
 
+  WNDCLASSW calendar_window_class = {.style = CS_DROPSHADOW, .lpfnWndProc = calendar_window_callback, .hInstance = instance, .hCursor = LoadCursorW(nullptr, IDC_ARROW), .lpszClassName = L"calendar-class"};
+  RegisterClassW(&calendar_window_class);
+
   const std::wstring temp_directory = common::get_temp_directory();
   SHCreateDirectoryExW(nullptr, temp_directory.c_str(), nullptr);
 
   app.settings_absolute_path = temp_directory + L"settings.dat";
-  app.settings = load_settings(app.settings_absolute_path);
-
-  if (HWND dummy_window = CreateWindowExW(WS_EX_TOOLWINDOW, L"dummy-class", L"", 0, 0, 0, 1, 1, nullptr, nullptr, instance, nullptr); dummy_window) {
-    SetWindowLongPtrW(dummy_window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(&app));
-
-    if (init_direct2d(app)) {
-      update_datetime_format(app.format);
-      update_datetime(app.datetime, app.format);
-
-      app.flags.set(kAppFlagUseLightTheme, common::read_use_light_theme_from_registry());
-      create_clock_windows(app);
+  app.zones_absolute_path = temp_directory + L"zones.txt";
+  app.startup_report_path = temp_directory + L"startup.json";
+  app.calendar_absolute_path = temp_directory + L"calendar.ics";
+  app.alarms_absolute_path = temp_directory + L"alarms.txt";
+  app.time_zones.directory = std::filesystem::path(temp_directory) / L"zoneinfo";
+
+  // @NOTE: --record logs every input to events.bin for misc/replay.cpp.
+  FILE* event_log_file = wcsstr(command_line, L"--record") ? _wfopen((temp_directory + L"events.bin").c_str(), L"wb") : nullptr;
+  if (event_log_file && !event_log_begin(app.event_log, event_log_file)) app.event_log = { };
+
+  // @NOTE: The startup runs as a dependency graph, see startup_graph.h.
+  // Windows are created on this thread because its message loop owns them,
+  // everything else runs wherever a worker is free. The first frame is
+  // published as soon as the clocks and their surfaces exist; the window
+  // index and the hooks are only needed by the ticks after it.
+  app.renderer.wake = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+  app.recording = {.kind = EventKind::Start};
+  bool direct2d = false;
+  std::vector<Monitor> monitors;
+  std::vector<WindowEntry> desktop_windows;
+  HWINEVENTHOOK hook = nullptr;
+  HWINEVENTHOOK lifetime_hook = nullptr;
+  HWINEVENTHOOK location_hook = nullptr;
+
+  StartupGraph& startup = app.startup;
+  const uint32_t settings = startup_graph_add(startup, "settings", StartupThread::Any, { }, [&] {
+    load_settings(app);
+  });
+  const uint32_t factories = startup_graph_add(startup, "factories", StartupThread::Any, { }, [&] {
+    direct2d = init_direct2d(app.renderer);
+  });
+  const uint32_t formats = startup_graph_add(startup, "formats", StartupThread::Any, { }, [&] {
+    update_datetime_format(app.format);
+    update_datetime(app.datetime, app.format);
+    load_zone_clocks(app);
+  });
+  const uint32_t theme = startup_graph_add(startup, "theme", StartupThread::Any, { }, [&] {
+    app.flags.set(kAppFlagUseLightTheme, common::read_use_light_theme_from_registry());
+  });
+  const uint32_t monitor_list = startup_graph_add(startup, "monitors", StartupThread::Any, { }, [&] {
+    monitors = common::get_display_monitors();
+  });
+  const uint32_t window_query = startup_graph_add(startup, "window_query", StartupThread::Any, { }, [&] {
+    desktop_windows = query_desktop_windows();
+  });
+  const uint32_t message_window = startup_graph_add(startup, "message_window", StartupThread::Main, { }, [&] {
+    if (HWND dummy_window = CreateWindowExW(WS_EX_TOOLWINDOW, L"dummy-class", L"", 0, 0, 0, 1, 1, nullptr, nullptr, instance, nullptr); dummy_window) {
+      SetWindowLongPtrW(dummy_window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(&app));
+      app.message_window = dummy_window;
+    }
+  });
+  const uint32_t frame_format = startup_graph_add(startup, "frame_format", StartupThread::Any, {settings, formats}, [&] {
+    app.frame_format = make_frame_format(app.format, app.settings, app.zones, app.power.mode);
+  });
+  const uint32_t clock_windows = startup_graph_add(startup, "clock_windows", StartupThread::Main, {settings, theme, monitor_list}, [&] {
+    create_clock_windows(app, monitors);
+  });
+  const uint32_t surfaces = startup_graph_add(startup, "surfaces", StartupThread::Any, {factories, formats, clock_windows}, [&] {
+    if (direct2d) create_startup_surfaces(app);
+  });
+  const uint32_t first_frame = startup_graph_add(startup, "first_frame", StartupThread::Main, {message_window, frame_format, surfaces}, [&] {
+    if (!app.message_window || !app.renderer.wake || !direct2d) return;
+    app.renderer.thread = CreateThread(nullptr, 0, render_thread, &app.renderer, 0, nullptr);
+    publish_frame(app);
+  });
+  const uint32_t window_index = startup_graph_add(startup, "window_index", StartupThread::Main, {clock_windows, window_query}, [&] {
+    apply_desktop_windows(app, desktop_windows);
+  });
+  startup_graph_add(startup, "hooks", StartupThread::Main, {first_frame, window_index}, [&] {
+    if (!app.renderer.thread) return;
+    expedite_tick(app);
+    SetTimer(app.message_window, kBackdropTimer, kBackdropSampleMs, nullptr);
+    alarms_init(app.alarms, GetTickCount64());
+    power_state_init(app.power, GetTickCount64());
+    common::register_power_notifications(app.message_window, app.power_notifications);
+    load_alarms(app);
+    arm_alarm_timer(app);
+    app.api_pipe.received = [] { apply_api_requests(app); };
+    common::api_pipe_listen(app.api_pipe, app.api); // @NOTE: the clock runs on without the API
+    hook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, nullptr, win_event_hook, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+    lifetime_hook = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_HIDE, nullptr, window_index_hook, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+    location_hook = SetWinEventHook(EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_LOCATIONCHANGE, nullptr, window_index_hook, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+  });
+  {
+    TRACE_SCOPE(Startup);
+    startup_graph_run(startup, kStartupWorkers);
+  }
 
-      const UINT_PTR timer = SetTimer(dummy_window, 0, 1000, nullptr);
-      HWINEVENTHOOK hook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, nullptr, win_event_hook, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
-      for (const ClockWindow& clock : app.clocks) InvalidateRect(clock.window, nullptr, FALSE);
+  // @NOTE: The hooks' callbacks only run once the message loop does, so the
+  // Start record still comes first in the log.
+  app.recording.civil = common::get_local_time();
+  app.recording.settings = app.settings;
+  app.recording.profiles = app.profiles;
+  record_theme(app);
+  record_locale(app);
+  record_event(app, app.recording);
+
+  if (HWND dummy_window = app.message_window; dummy_window && app.renderer.thread) {
+    // @NOTE: Alertable, so the API's pipe completions run between messages.
+    for (bool running = true; running;) {
+      const DWORD handles = app.api_pipe.connect_event ? 1 : 0;
+      const DWORD wait = MsgWaitForMultipleObjectsEx(handles, &app.api_pipe.connect_event, INFINITE, QS_ALLINPUT, MWMO_ALERTABLE | MWMO_INPUTAVAILABLE);
+      if ((handles == 1) && (wait == WAIT_OBJECT_0)) common::api_pipe_accept(app.api_pipe);
 
       MSG msg = { };
-      while (GetMessageW(&msg, nullptr, 0, 0) > 0) {
+      while (running && PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+        if (msg.message == WM_QUIT) {
+          running = false;
+          break;
+        }
         TranslateMessage(&msg);
         DispatchMessageW(&msg);
       }
+    }
+
+    if (app.settings_writes.pending) save_settings(app);
+
+    app.renderer.quit.store(true, std::memory_order_release);
+    SetEvent(app.renderer.wake);
+    WaitForSingleObject(app.renderer.thread, INFINITE);
+    CloseHandle(app.renderer.thread);
 
-      save_settings(app.settings_absolute_path, app.settings);
-      KillTimer(dummy_window, timer);
-      UnhookWinEvent(hook);
+    #ifdef CLOCK_TRACE
+    if (FILE* f = _wfopen((temp_directory + L"trace.bin").c_str(), L"wb"); f) {
+      trace_dump(g_trace, f);
+      fclose(f);
     }
+    #endif
+    KillTimer(dummy_window, kTickTimer);
+    KillTimer(dummy_window, kTopmostTimer);
+    KillTimer(dummy_window, kBackdropTimer);
+    KillTimer(dummy_window, kAlarmTimer);
+    KillTimer(dummy_window, kSettingsTimer);
+    KillTimer(dummy_window, kApiTimer);
+    KillTimer(dummy_window, kOverlayTimer);
+    common::api_pipe_close(app.api_pipe);
+    common::unregister_power_notifications(dummy_window, app.power_notifications);
+    destroy_backdrop_capture(app.backdrop);
+    UnhookWinEvent(hook);
+    UnhookWinEvent(lifetime_hook);
+    UnhookWinEvent(location_hook);
   }
+  if (app.renderer.wake) CloseHandle(app.renderer.wake);
+  if (event_log_file) fclose(event_log_file);
   ReleaseMutex(mutex);
 
   return 0;
@@ -0,0 +1,58 @@
+#include "monitor_diff.h"
+
+namespace {
+  constexpr uint32_t kUnmatched = UINT32_MAX;
+
+  MonitorChange classify(const Monitor& previous, const Monitor& current) {
+    if ((previous.dpi.x != current.dpi.x) || (previous.dpi.y != current.dpi.y)) return MonitorChange::Rescale;
+    if (make_rect(previous.position, previous.size) != make_rect(current.position, current.size)) return MonitorChange::Move;
+    return MonitorChange::Keep;
+  }
+}
+
+std::vector<MonitorDiffOp> diff_monitors(const std::vector<Monitor>& previous, const std::vector<Monitor>& current) {
+  std::vector<uint32_t> match(current.size(), kUnmatched); // @NOTE: current index -> previous index
+  std::vector<bool> used(previous.size(), false);
+
+  // @NOTE: Handles usually survive a display change, fall back to the
+  // rectangle for monitors that were re-enumerated with a new handle.
+  for (uint32_t i = 0; i < current.size(); ++i) {
+    for (uint32_t j = 0; j < previous.size(); ++j) {
+      if (!used[j] && (previous[j].handle == current[i].handle)) {
+        match[i] = j;
+        used[j] = true;
+        break;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < current.size(); ++i) {
+    if (match[i] != kUnmatched) continue;
+
+    const Rect rect = make_rect(current[i].position, current[i].size);
+    for (uint32_t j = 0; j < previous.size(); ++j) {
+      if (!used[j] && (make_rect(previous[j].position, previous[j].size) == rect)) {
+        match[i] = j;
+        used[j] = true;
+        break;
+      }
+    }
+  }
+
+  std::vector<MonitorDiffOp> result;
+  result.reserve(previous.size() + current.size());
+
+  for (uint32_t j = 0; j < previous.size(); ++j) {
+    if (!used[j]) result.push_back(MonitorDiffOp{.change = MonitorChange::Remove, .old_index = j});
+  }
+
+  for (uint32_t i = 0; i < current.size(); ++i) {
+    if (match[i] == kUnmatched) {
+      result.push_back(MonitorDiffOp{.change = MonitorChange::Add, .new_index = i});
+    } else {
+      result.push_back(MonitorDiffOp{.change = classify(previous[match[i]], current[i]), .old_index = match[i], .new_index = i});
+    }
+  }
+
+  return result;
+}
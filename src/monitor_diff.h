@@ -0,0 +1,26 @@
+#pragma once
+
+#include "base.h"
+#include <vector>
+
+// Diffs the monitor layout the clocks were created for against a freshly
+// enumerated one, so a display change only touches the clocks that actually
+// changed instead of destroying and recreating every window.
+
+enum class MonitorChange : uint8_t {
+  Keep, // @NOTE: same geometry and DPI, the handle may be new
+  Move, // @NOTE: same DPI, new position or size: reposition, reuse the surface
+  Rescale, // @NOTE: DPI changed: resize and move to another surface
+  Add,
+  Remove,
+};
+
+struct MonitorDiffOp {
+  MonitorChange change = MonitorChange::Keep;
+  uint32_t old_index = 0; // @NOTE: unused for Add
+  uint32_t new_index = 0; // @NOTE: unused for Remove
+};
+
+// Monitors are matched by handle first, the remaining ones by their rectangle.
+// Removes come first in the result, then one op per new monitor in order.
+std::vector<MonitorDiffOp> diff_monitors(const std::vector<Monitor>& previous, const std::vector<Monitor>& current);
@@ -0,0 +1,48 @@
+#include "power_state.h"
+
+void power_state_init(PowerState& state, uint64_t now_ms) {
+  state.mode_since_ms = now_ms;
+}
+
+PowerMode power_mode_for(const PowerState& state) {
+  if (state.display_off || state.locked || state.detached) return PowerMode::Suspended;
+  if (state.on_battery || state.battery_saver) return PowerMode::Reduced;
+  return PowerMode::Full;
+}
+
+bool power_state_apply(PowerState& state, PowerEvent event, uint64_t now_ms) {
+  state.stats.events++;
+  switch (event) {
+    case PowerEvent::DisplayOn: state.display_off = false; break;
+    case PowerEvent::DisplayOff: state.display_off = true; break;
+    case PowerEvent::Lock: state.locked = true; break;
+    case PowerEvent::Unlock: state.locked = false; break;
+    case PowerEvent::SessionConnect: state.detached = false; break;
+    case PowerEvent::SessionDisconnect: state.detached = true; break;
+    case PowerEvent::AcPower: state.on_battery = false; break;
+    case PowerEvent::BatteryPower: state.on_battery = true; break;
+    case PowerEvent::SaverOn: state.battery_saver = true; break;
+    case PowerEvent::SaverOff: state.battery_saver = false; break;
+    case PowerEvent::Count: break;
+  }
+
+  const PowerMode mode = power_mode_for(state);
+  if (mode == state.mode) return false;
+
+  power_state_account(state, now_ms);
+  if (state.mode == PowerMode::Suspended) state.stats.resumes++;
+  state.stats.changes++;
+  state.mode = mode;
+  return true;
+}
+
+void power_state_account(PowerState& state, uint64_t now_ms) {
+  if (now_ms > state.mode_since_ms) state.stats.mode_ms[static_cast<size_t>(state.mode)] += now_ms - state.mode_since_ms;
+  state.mode_since_ms = now_ms;
+}
+
+TickGranularity power_tick_granularity(PowerMode mode, TickGranularity granularity) {
+  if (mode == PowerMode::Suspended) return TickGranularity::Day;
+  if ((mode == PowerMode::Reduced) && (granularity == TickGranularity::Second)) return TickGranularity::Minute;
+  return granularity;
+}
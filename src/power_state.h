@@ -0,0 +1,63 @@
+#pragma once
+
+#include "base.h"
+#include "tick_scheduler.h"
+
+// Whether anybody can see the clocks and how much the app may spend on
+// keeping them current. Fed by the display power, session lock, remote
+// session and power source notifications. While nothing can be seen the
+// app neither renders nor looks at other windows; on battery the text
+// drops its seconds and is redrawn once a minute. Leaving suspension takes
+// one catch-up tick that rebuilds the window index and renders once.
+
+enum class PowerEvent : uint8_t {
+  DisplayOn, // @NOTE: also dimmed
+  DisplayOff,
+  Lock,
+  Unlock,
+  SessionConnect, // @NOTE: to the console or a remote client
+  SessionDisconnect,
+  AcPower,
+  BatteryPower, // @NOTE: also a UPS
+  SaverOn, // @NOTE: battery saver
+  SaverOff,
+  Count,
+};
+
+enum class PowerMode : uint8_t {
+  Full,
+  Reduced, // @NOTE: minute granularity, no seconds, no animation
+  Suspended, // @NOTE: no rendering, no window enumeration, no ticks
+  Count,
+};
+
+struct PowerStats {
+  uint64_t events = 0;
+  uint64_t changes = 0; // @NOTE: of the mode
+  uint64_t resumes = 0; // @NOTE: out of Suspended, each one a catch-up tick
+  uint64_t mode_ms[static_cast<size_t>(PowerMode::Count)] = { }; // @NOTE: time spent in each mode, see power_state_account
+};
+
+struct PowerState {
+  bool display_off = false;
+  bool locked = false;
+  bool detached = false; // @NOTE: the session has neither the console nor a remote client
+  bool on_battery = false;
+  bool battery_saver = false;
+  PowerMode mode = PowerMode::Full;
+  uint64_t mode_since_ms = 0; // @NOTE: monotonic
+  PowerStats stats;
+};
+
+void power_state_init(PowerState& state, uint64_t now_ms);
+
+PowerMode power_mode_for(const PowerState& state);
+
+// Returns true if the mode changed.
+bool power_state_apply(PowerState& state, PowerEvent event, uint64_t now_ms);
+
+// Adds the time in the current mode up to `now_ms` to the stats.
+void power_state_account(PowerState& state, uint64_t now_ms);
+
+// `granularity` coarsened to what `mode` allows.
+TickGranularity power_tick_granularity(PowerMode mode, TickGranularity granularity);
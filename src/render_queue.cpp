@@ -0,0 +1,63 @@
+#include "render_queue.h"
+
+bool same_frame_state(const FrameSnapshot& lhs, const FrameSnapshot& rhs) {
+  if ((lhs.format != rhs.format) || (lhs.analog != rhs.analog) || (lhs.smooth != rhs.smooth) || (lhs.seconds != rhs.seconds) || (lhs.metrics != rhs.metrics) || (lhs.power != rhs.power) || (lhs.overlays != rhs.overlays) || (lhs.clock_count != rhs.clock_count)) return false;
+
+  for (uint32_t i = 0; i < lhs.clock_count; ++i) {
+    const SnapshotClock& a = lhs.clocks[i];
+    const SnapshotClock& b = rhs.clocks[i];
+    if ((a.window != b.window) || (a.surface != b.surface) || (a.key != b.key) || (a.generation != b.generation) || (a.monitor != b.monitor) || (a.visible != b.visible)) return false;
+  }
+  return true;
+}
+
+bool frame_texts_render(FrameTexts& texts, const std::shared_ptr<const FrameFormat>& format, CivilTime time, int64_t utc_ms) {
+  if (texts.format != format) {
+    texts = { };
+    texts.format = format;
+  }
+  if (!format) return false;
+
+  bool changed = render_format(format->time, format->names, time, texts.time);
+  if (format->zones.empty()) changed |= render_format(format->date, format->names, time, texts.date);
+  else changed |= render_zone_line(format->zones, format->time, format->names, utc_ms, texts.zone_line, texts.date);
+  return changed;
+}
+
+TickGranularity snapshot_tick_granularity(const FrameSnapshot& snapshot) {
+  bool visible = false;
+  for (uint32_t i = 0; i < snapshot.clock_count; ++i) visible = visible || snapshot.clocks[i].visible;
+  if (!snapshot.format || !visible) return TickGranularity::Day;
+
+  if (snapshot.metrics && !snapshot.analog) return power_tick_granularity(snapshot.power, TickGranularity::Second); // @NOTE: sampled about every second
+
+  const uint32_t fields = snapshot.analog ? (kFormatFieldMinute | (snapshot.seconds ? kFormatFieldSecond : 0u)) : (snapshot.format->time.fields | snapshot.format->date.fields);
+  return power_tick_granularity(snapshot.power, tick_granularity_for(fields));
+}
+
+bool snapshot_animates(const FrameSnapshot& snapshot) {
+  if (!snapshot.format || !snapshot.smooth || (snapshot.power != PowerMode::Full)) return false;
+  for (uint32_t i = 0; i < snapshot.clock_count; ++i) {
+    if (snapshot.clocks[i].visible) return true;
+  }
+  return false;
+}
+
+bool render_queue_publish(RenderQueue& queue, const FrameSnapshot& snapshot) {
+  if (!spsc_queue_push(queue.queue, snapshot)) {
+    queue.stats.rejected++;
+    return false;
+  }
+  queue.stats.published++;
+  return true;
+}
+
+bool render_queue_take_latest(RenderQueue& queue, FrameSnapshot& latest) {
+  uint64_t count = 0;
+  while (spsc_queue_pop(queue.queue, latest)) count++;
+  if (count == 0) return false;
+
+  queue.stats.consumed += count;
+  queue.stats.superseded += count - 1;
+  return true;
+}
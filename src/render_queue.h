@@ -0,0 +1,155 @@
+#pragma once
+
+#include "base.h"
+#include "datetime_format.h"
+#include "power_state.h"
+#include "surface_cache.h"
+#include "tick_scheduler.h"
+#include "time_zone.h"
+#include <atomic>
+#include <memory>
+
+// Hand-off from the UI thread to the render thread. The UI thread publishes
+// an immutable FrameSnapshot whenever something that affects the pixels
+// changes (settings, theme, locale, monitors, visibility); the render thread
+// owns every rendering resource, formats the text itself on its own tick and
+// only ever looks at the latest snapshot.
+//
+// The queue is a bounded single-producer/single-consumer ring, neither side
+// ever takes a lock or waits for the other.
+
+constexpr uint32_t kSnapshotMaxClocks = 64;
+constexpr uint32_t kRenderQueueCapacity = 8; // @NOTE: must be a power of two
+
+template <typename T, uint32_t Capacity>
+struct SpscQueue {
+  static_assert((Capacity & (Capacity - 1)) == 0);
+
+  std::atomic<uint32_t> head{0}; // @NOTE: next item to pop, written by the consumer only
+  uint8_t head_padding[60] = { }; // @NOTE: keeps head and tail on separate cache lines
+  std::atomic<uint32_t> tail{0}; // @NOTE: next item to push, written by the producer only
+  uint8_t tail_padding[60] = { };
+  T items[Capacity];
+};
+
+// Returns false if the queue is full.
+template <typename T, uint32_t Capacity>
+bool spsc_queue_push(SpscQueue<T, Capacity>& queue, const T& item) {
+  const uint32_t tail = queue.tail.load(std::memory_order_relaxed);
+  if (tail - queue.head.load(std::memory_order_acquire) == Capacity) return false;
+
+  queue.items[tail & (Capacity - 1)] = item;
+  queue.tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+// Returns false if the queue is empty.
+template <typename T, uint32_t Capacity>
+bool spsc_queue_pop(SpscQueue<T, Capacity>& queue, T& item) {
+  const uint32_t head = queue.head.load(std::memory_order_relaxed);
+  if (head == queue.tail.load(std::memory_order_acquire)) return false;
+
+  item = std::move(queue.items[head & (Capacity - 1)]);
+  queue.head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+// What the render thread needs to format the text on its own. Shared, never
+// modified after it is published.
+struct FrameFormat {
+  std::wstring locale;
+  LocaleNames names;
+  FormatProgram time;
+  FormatProgram date;
+  std::vector<ZoneClock> zones; // @NOTE: replace the date line with their times when not empty
+};
+
+// The texts a FrameFormat renders: the time, and the date or, when the
+// format has zones, the zone line in its place, like the clocks show them.
+struct FrameTexts {
+  std::shared_ptr<const FrameFormat> format; // @NOTE: the texts were rendered with, kept alive so a new one never compares equal
+  FormattedText time;
+  FormattedText date; // @NOTE: or the zone line
+  ZoneLine zone_line;
+};
+
+// Renders the texts for `time`, the zones for `utc_ms`. Texts rendered with
+// another format are started over, their offsets do not fit the new
+// programs. Returns true if a text changed.
+bool frame_texts_render(FrameTexts& texts, const std::shared_ptr<const FrameFormat>& format, CivilTime time, int64_t utc_ms);
+
+// The text of an overlay message a clock shows, see SurfaceKey::overlay.
+struct SnapshotOverlay {
+  uint16_t id = 0;
+  std::wstring text;
+};
+
+struct SnapshotClock {
+  uintptr_t window = 0;
+  uint32_t surface = 0; // @NOTE: SurfaceCache slot
+  SurfaceKey key;
+  uint32_t generation = 0; // @NOTE: changes whenever the window is resized or moved to another surface
+  Rect monitor = { }; // @NOTE: the window sits in its corner, sized by the render thread
+  bool visible = false;
+};
+
+struct FrameSnapshot {
+  uint64_t serial = 0;
+  std::shared_ptr<const FrameFormat> format;
+  bool analog = false;
+  bool smooth = false; // @NOTE: animate the seconds at the display refresh rate
+  bool seconds = false; // @NOTE: analog second hand
+  bool metrics = false; // @NOTE: digital only, the system metrics line under the date
+  PowerMode power = PowerMode::Full; // @NOTE: nothing is rendered while Suspended
+  std::shared_ptr<const std::vector<SnapshotOverlay>> overlays; // @NOTE: replaced whenever an overlay comes or goes
+  uint32_t clock_count = 0;
+  SnapshotClock clocks[kSnapshotMaxClocks];
+};
+
+// True if both describe the same pixels, the serial is ignored.
+bool same_frame_state(const FrameSnapshot& lhs, const FrameSnapshot& rhs);
+
+// How often the render thread has to wake up for the snapshot. With every
+// clock hidden nothing has to be redrawn until the next snapshot, on
+// battery at most once a minute.
+TickGranularity snapshot_tick_granularity(const FrameSnapshot& snapshot);
+
+// True if the render thread has to draw at the display refresh rate.
+bool snapshot_animates(const FrameSnapshot& snapshot);
+
+// One frame over the visible clocks: `render(surface)` the first time a
+// clock of the frame uses the surface, then `present(clock)` for each of
+// them. `rendered_frame(surface)` is the frame the surface was last rendered
+// in, `frame` has to be new.
+template <typename RenderedFrame, typename Render, typename Present>
+void snapshot_render_frame(const FrameSnapshot& snapshot, uint64_t frame, RenderedFrame&& rendered_frame, Render&& render, Present&& present) {
+  for (uint32_t i = 0; i < snapshot.clock_count; ++i) {
+    const SnapshotClock& clock = snapshot.clocks[i];
+    if (!clock.visible) continue;
+
+    uint64_t& rendered = rendered_frame(clock.surface);
+    if (rendered != frame) {
+      render(clock.surface);
+      rendered = frame;
+    }
+    present(clock);
+  }
+}
+
+struct RenderQueueStats {
+  uint64_t published = 0; // @NOTE: producer side
+  uint64_t rejected = 0; // @NOTE: producer side, the queue was full
+  uint64_t consumed = 0; // @NOTE: consumer side
+  uint64_t superseded = 0; // @NOTE: consumer side, skipped for a newer snapshot
+};
+
+struct RenderQueue {
+  SpscQueue<FrameSnapshot, kRenderQueueCapacity> queue;
+  RenderQueueStats stats; // @NOTE: each field is written by one side only
+};
+
+// Producer. Returns false if the queue is full, the caller publishes again later.
+bool render_queue_publish(RenderQueue& queue, const FrameSnapshot& snapshot);
+
+// Consumer. Drains the queue into `latest`, returns false if it was empty.
+bool render_queue_take_latest(RenderQueue& queue, FrameSnapshot& latest);
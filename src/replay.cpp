@@ -0,0 +1,497 @@
+#include "replay.h"
+#include "monitor_diff.h"
+
+namespace {
+  constexpr uint32_t kReplayFrameMs = 16;
+
+  bool is_leap_year(uint32_t year) {
+    return ((year % 4 == 0) && (year % 100 != 0)) || (year % 400 == 0);
+  }
+
+  uint32_t days_in_month(uint32_t year, uint32_t month) {
+    constexpr uint8_t kDays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return ((month == 2) && is_leap_year(year)) ? 29u : kDays[(month - 1) % 12];
+  }
+
+  CivilTime civil_at(const ReplayModel& model, uint64_t now_ms) {
+    return civil_time_add_ms(model.civil, (now_ms > model.civil_ms) ? now_ms - model.civil_ms : 0);
+  }
+
+  void sync_civil(ReplayModel& model, CivilTime civil, uint64_t now_ms) {
+    model.civil = civil;
+    model.civil_ms = now_ms;
+  }
+
+  void set_flag(ReplayModel& model, TransientAppFlags flag) {
+    model.transient_flags |= 1u << flag;
+  }
+
+  // @NOTE: expedite_tick, which waits for the resume while suspended.
+  void expedite(ReplayModel& model) {
+    if (model.power.mode != PowerMode::Suspended) model.stats.expedites++;
+  }
+
+  void compile_locale(ReplayModel& model, const Event& event) {
+    model.names = event.names;
+    model.short_date = compile_format(event.pictures.short_date);
+    model.long_date = compile_format(event.pictures.long_date);
+    model.short_time = compile_format(event.pictures.short_time);
+    model.long_time = compile_format(event.pictures.long_time);
+  }
+
+  // @NOTE: make_frame_format in main.cpp.
+  void update_frame_format(ReplayModel& model) {
+    auto frame_format = std::make_shared<FrameFormat>();
+    frame_format->names = model.names;
+    frame_format->time = (model.settings.long_time && (model.power.mode == PowerMode::Full)) ? model.long_time : model.short_time;
+    frame_format->date = model.settings.long_date ? model.long_date : model.short_date;
+    model.frame_format = frame_format;
+  }
+
+  // @NOTE: clock_surface_key
+  SurfaceKey surface_key_for(const ReplayModel& model, const Monitor& monitor, const BackdropContrast& contrast) {
+    const TextContrast text = text_contrast_for(contrast, model.settings.adaptive_contrast, model.light_theme);
+    return make_surface_key(monitor.dpi, monitor_corner(model.settings, model.profiles, monitor), text.dark_text, text.shadow);
+  }
+
+  uint32_t acquire_surface(ReplayModel& model, SurfaceKey key) {
+    bool created = false;
+    return surface_cache_acquire(model.surfaces, key, &created);
+  }
+
+  // @NOTE: create_clock_window
+  ClockRow create_clock(ReplayModel& model, const Monitor& monitor) {
+    model.stats.clocks_created++;
+    model.stats.zorder_calls++;
+    const bool disabled = is_monitor_disabled(model.profiles, monitor);
+    return ClockRow{
+      .window = ++model.next_window,
+      .monitor = monitor,
+      .corner = monitor_corner(model.settings, model.profiles, monitor),
+      .surface = acquire_surface(model, surface_key_for(model, monitor, BackdropContrast{ })),
+      .generation = ++model.next_generation,
+      .hidden = disabled || is_clock_hidden(model.settings, is_primary_monitor(monitor), false),
+      .disabled = disabled,
+    };
+  }
+
+  // @NOTE: update_clock_window
+  void update_clock(ReplayModel& model, ClockRow& clock, const Monitor& monitor) {
+    model.stats.clocks_updated++;
+    model.stats.zorder_calls++;
+
+    const SurfaceKey key = surface_key_for(model, monitor, clock.contrast);
+    if (key != model.surfaces.slots[clock.surface].key) {
+      const uint32_t previous = clock.surface;
+      clock.surface = acquire_surface(model, key);
+      surface_cache_release(model.surfaces, previous);
+    }
+    clock.monitor = monitor;
+    clock.corner = monitor_corner(model.settings, model.profiles, monitor);
+    clock.generation = ++model.next_generation;
+  }
+
+  void destroy_clock(ReplayModel& model, const ClockRow& clock) {
+    model.stats.clocks_destroyed++;
+    surface_cache_release(model.surfaces, clock.surface);
+  }
+
+  void watch_monitor_rects(ReplayModel& model) {
+    window_index_watch(model.windows, model.clocks.monitor_rects);
+    topmost_guard_watch(model.topmost, model.clocks.monitor_rects);
+  }
+
+  // @NOTE: reconcile_clock_windows
+  void reconcile_clocks(ReplayModel& model, const std::vector<Monitor>& all_monitors) {
+    const std::vector<Monitor> monitors = clock_table_limit_monitors(all_monitors);
+    ClockTable clocks;
+    for (const MonitorDiffOp& op : diff_monitors(model.clocks.monitors, monitors)) {
+      switch (op.change) {
+        case MonitorChange::Remove: {
+          destroy_clock(model, clock_table_row(model.clocks, op.old_index));
+          break;
+        }
+        case MonitorChange::Add: {
+          clock_table_push(clocks, create_clock(model, monitors[op.new_index]));
+          break;
+        }
+        case MonitorChange::Keep:
+        case MonitorChange::Move:
+        case MonitorChange::Rescale: {
+          ClockRow clock = clock_table_row(model.clocks, op.old_index);
+          const Monitor& monitor = monitors[op.new_index];
+          if ((op.change != MonitorChange::Keep) || (clock.corner != monitor_corner(model.settings, model.profiles, monitor))) {
+            update_clock(model, clock, monitor);
+          } else {
+            clock.monitor = monitor;
+          }
+          clock.disabled = is_monitor_disabled(model.profiles, monitor);
+          clock_table_push(clocks, clock);
+          break;
+        }
+      }
+    }
+
+    model.clocks = std::move(clocks);
+    watch_monitor_rects(model);
+  }
+
+  void recreate_clocks(ReplayModel& model, const std::vector<Monitor>& monitors) {
+    for (uint32_t i = 0; i < clock_table_size(model.clocks); ++i) destroy_clock(model, clock_table_row(model.clocks, i));
+    clock_table_clear(model.clocks);
+    for (const Monitor& monitor : clock_table_limit_monitors(monitors)) clock_table_push(model.clocks, create_clock(model, monitor));
+    watch_monitor_rects(model);
+  }
+
+  // @NOTE: update_clock_surfaces
+  void update_clock_surfaces(ReplayModel& model) {
+    ClockTable& clocks = model.clocks;
+    for (uint32_t i = 0; i < clock_table_size(clocks); ++i) {
+      SurfaceKey key = model.surfaces.slots[clocks.surfaces[i]].key;
+      const TextContrast text = text_contrast_for(clocks.contrasts[i], model.settings.adaptive_contrast, model.light_theme);
+      const bool alert = clocks.alerts[i] != 0;
+      const uint16_t overlay = clocks.overlays[i];
+      if ((key.dark_text == text.dark_text) && (key.shadow == text.shadow) && (key.alert == alert) && (key.overlay == overlay)) continue;
+
+      key.dark_text = text.dark_text;
+      key.shadow = text.shadow;
+      key.alert = alert;
+      key.overlay = overlay;
+      const uint32_t previous = clocks.surfaces[i];
+      clocks.surfaces[i] = acquire_surface(model, key);
+      clocks.generations[i] = ++model.next_generation;
+      surface_cache_release(model.surfaces, previous);
+    }
+  }
+
+  void rebuild_window_index(ReplayModel& model, const std::vector<WindowEntry>& windows) {
+    model.stats.window_index_rebuilds++;
+    window_index_clear(model.windows);
+    for (const WindowEntry& window : windows) window_index_update(model.windows, window.id, window.state);
+  }
+
+  // @NOTE: render_frame on the render thread. `fresh` is set when a new
+  // snapshot arrived, every clock is then presented in full.
+  void render_frame(ReplayModel& model, uint64_t now_ms, bool fresh) {
+    const FrameSnapshot& snapshot = model.published;
+    if (snapshot.power == PowerMode::Suspended) {
+      model.render_deadline_ms = 0; // @NOTE: waits for the next snapshot
+      return;
+    }
+    tick_scheduler_wakeup(model.render_scheduler, now_ms);
+    model.stats.frames++;
+
+    const CivilTime civil = civil_at(model, now_ms);
+    if (snapshot.format) {
+      model.stats.formats += 2;
+      const bool time_changed = render_format(snapshot.format->time, snapshot.format->names, civil, model.time);
+      const bool date_changed = render_format(snapshot.format->date, snapshot.format->names, civil, model.date);
+      const bool changed = time_changed || date_changed || snapshot.metrics || snapshot.analog || snapshot.smooth; // @NOTE: the metrics are not recorded, assume new numbers
+      if (changed) model.stats.text_changes++;
+
+      std::vector<bool> rendered(model.surfaces.slots.size(), false);
+      for (uint32_t i = 0; i < snapshot.clock_count; ++i) {
+        const SnapshotClock& clock = snapshot.clocks[i];
+        if (!clock.visible) continue;
+
+        if (!rendered[clock.surface]) {
+          rendered[clock.surface] = true;
+          model.stats.rasterizations++;
+        }
+        if (changed || fresh) model.stats.presents++;
+      }
+    }
+
+    // @NOTE: Animating, the pacer runs at the refresh rate, 60 Hz here.
+    const uint32_t delay = snapshot_animates(snapshot) ? kReplayFrameMs : tick_scheduler_plan(model.render_scheduler, now_ms, civil, snapshot_tick_granularity(snapshot));
+    model.render_deadline_ms = now_ms + delay;
+  }
+
+  // @NOTE: publish_frame
+  void publish_frame(ReplayModel& model, uint64_t now_ms) {
+    FrameSnapshot snapshot;
+    snapshot.format = model.frame_format;
+    snapshot.analog = model.settings.analog;
+    snapshot.smooth = model.settings.smooth_seconds;
+    snapshot.seconds = model.settings.long_time && (model.power.mode == PowerMode::Full);
+    snapshot.metrics = model.settings.system_metrics && !model.settings.analog;
+    snapshot.power = model.power.mode;
+    clock_table_fill_snapshot(model.clocks, model.surfaces, snapshot);
+    if (same_frame_state(snapshot, model.published)) return;
+
+    snapshot.serial = model.published.serial + 1;
+    model.published = snapshot;
+    model.stats.snapshots++;
+    render_frame(model, now_ms, true);
+  }
+
+  // @NOTE: The visibility pass of the tick.
+  void update_visibility(ReplayModel& model) {
+    std::vector<uint32_t> toggled;
+    clock_table_update_visibility(model.clocks, model.windows, model.settings, toggled);
+    model.stats.zorder_calls += toggled.size();
+  }
+
+  void start(ReplayModel& model, const Event& event) {
+    model.started = true;
+    model.start_ms = event.time_ms;
+    sync_civil(model, event.civil, event.time_ms);
+    model.settings = event.settings;
+    model.profiles = event.profiles;
+    model.light_theme = event.light_theme;
+    power_state_init(model.power, event.time_ms);
+    compile_locale(model, event);
+    update_frame_format(model);
+
+    recreate_clocks(model, event.monitors);
+    rebuild_window_index(model, event.windows);
+    model.stats.expedites++;
+    publish_frame(model, event.time_ms);
+  }
+
+  // @NOTE: The WM_TIMER tick.
+  void tick(ReplayModel& model, const Event& event) {
+    model.stats.ticks++;
+    sync_civil(model, event.civil, event.time_ms);
+    if (event.flags != model.transient_flags) model.stats.divergences++;
+
+    const TickActions actions = plan_tick(event.flags);
+    model.transient_flags = 0;
+
+    auto needs = [&](EventSection section) {
+      if (event.sections & section) return true;
+      model.stats.divergences++;
+      return false;
+    };
+
+    if (actions.reload_theme && needs(kEventSectionTheme)) {
+      model.stats.theme_reloads++;
+      model.light_theme = event.light_theme;
+    }
+    if (actions.reload_locale && needs(kEventSectionLocale)) {
+      model.stats.locale_reloads++;
+      compile_locale(model, event);
+    }
+    if (actions.save_settings) settings_coalescer_change(model.settings_writes, event.time_ms);
+    if (actions.reconcile_clocks && needs(kEventSectionMonitors)) {
+      model.stats.reconciles++;
+      reconcile_clocks(model, event.monitors);
+    }
+    if (actions.reload_theme || actions.save_settings) update_clock_surfaces(model);
+    if (actions.rebuild_window_index && needs(kEventSectionWindows)) rebuild_window_index(model, event.windows);
+    if (actions.reload_locale || actions.save_settings || actions.reformat) update_frame_format(model);
+
+    update_visibility(model);
+    publish_frame(model, event.time_ms);
+  }
+
+  void check_topmost(ReplayModel& model, const Event& event) {
+    // @NOTE: A clock the recording has no answer for counts as not covered.
+    size_t next = 0;
+    bool overrun = false;
+    auto is_covered = [&](uint32_t) {
+      if (next == event.lost.size()) {
+        overrun = true;
+        return false;
+      }
+      return static_cast<bool>(event.lost[next++]);
+    };
+    auto raise = [&](uint32_t) { model.stats.zorder_calls++; };
+    topmost_guard_enforce(model.topmost, model.clocks.hidden, is_covered, raise);
+    if (overrun || (next != event.lost.size())) model.stats.divergences++;
+  }
+
+  // @NOTE: sample_backdrops
+  void sample_backdrops(ReplayModel& model, const Event& event) {
+    if (!model.settings.adaptive_contrast) model.stats.divergences++;
+
+    bool changed = false;
+    for (const BackdropEntry& entry : event.backdrops) {
+      if ((entry.clock >= clock_table_size(model.clocks)) || !backdrop_changed(model.clocks.contrasts[entry.clock], entry.sample.hash)) {
+        model.stats.divergences++;
+        continue;
+      }
+      model.stats.backdrop_samples++;
+      if (backdrop_update(model.clocks.contrasts[entry.clock], entry.sample)) {
+        model.stats.contrast_changes++;
+        changed = true;
+      }
+    }
+    if (!changed) return;
+
+    update_clock_surfaces(model);
+    publish_frame(model, event.time_ms);
+  }
+
+  // @NOTE: apply_power_event
+  void apply_power(ReplayModel& model, PowerEvent event, uint64_t now_ms) {
+    const PowerMode previous = model.power.mode;
+    if (!power_state_apply(model.power, event, now_ms)) return;
+    if (model.power.mode == PowerMode::Suspended) {
+      publish_frame(model, now_ms);
+      return;
+    }
+
+    set_flag(model, kTransientAppFlagPowerChanged);
+    if (previous == PowerMode::Suspended) {
+      set_flag(model, kTransientAppFlagResumed);
+      topmost_guard_trigger_all(model.topmost, now_ms);
+    }
+    expedite(model);
+  }
+
+  // @NOTE: The tick, the hooks and the backdrop sampling drop their work
+  // while suspended, nothing of the kind is recorded.
+  bool is_ignored_while_suspended(EventKind kind) {
+    return (kind == EventKind::Tick) || (kind == EventKind::Foreground) || (kind == EventKind::WindowUpdate) || (kind == EventKind::WindowRemove) || (kind == EventKind::Backdrop);
+  }
+
+  // @NOTE: the kAlarmTimer handler
+  void apply_alerts(ReplayModel& model, const Event& event) {
+    ClockTable& clocks = model.clocks;
+    if (event.alerts.size() != clock_table_size(clocks)) {
+      model.stats.divergences++;
+      return;
+    }
+
+    for (uint32_t i = 0; i < clock_table_size(clocks); ++i) clocks.alerts[i] = event.alerts[i];
+    update_clock_surfaces(model);
+    publish_frame(model, event.time_ms);
+  }
+
+  // @NOTE: apply_overlays
+  void apply_overlays(ReplayModel& model, const Event& event) {
+    ClockTable& clocks = model.clocks;
+    if (event.overlays.size() != clock_table_size(clocks)) {
+      model.stats.divergences++;
+      return;
+    }
+
+    for (uint32_t i = 0; i < clock_table_size(clocks); ++i) clocks.overlays[i] = event.overlays[i];
+    update_clock_surfaces(model);
+    publish_frame(model, event.time_ms);
+  }
+}
+
+CivilTime civil_time_add_ms(CivilTime time, uint64_t ms) {
+  uint64_t carry = time.milliseconds + ms;
+  time.milliseconds = static_cast<uint16_t>(carry % 1000);
+  carry = time.second + carry / 1000;
+  time.second = static_cast<uint16_t>(carry % 60);
+  carry = time.minute + carry / 60;
+  time.minute = static_cast<uint16_t>(carry % 60);
+  carry = time.hour + carry / 60;
+  time.hour = static_cast<uint16_t>(carry % 24);
+
+  for (uint64_t days = carry / 24; days > 0; --days) {
+    time.day_of_week = static_cast<uint16_t>((time.day_of_week + 1) % 7);
+    if (++time.day > days_in_month(time.year, time.month)) {
+      time.day = 1;
+      if (++time.month > 12) {
+        time.month = 1;
+        time.year++;
+      }
+    }
+  }
+  return time;
+}
+
+void replay_advance(ReplayModel& model, uint64_t now_ms) {
+  while ((model.render_deadline_ms != 0) && (model.render_deadline_ms <= now_ms)) {
+    render_frame(model, model.render_deadline_ms, false);
+  }
+  if (settings_coalescer_take(model.settings_writes, now_ms)) model.stats.settings_saves++;
+  if (model.started) power_state_account(model.power, now_ms);
+  if (now_ms > model.start_ms) model.stats.simulated_ms = now_ms - model.start_ms;
+}
+
+bool replay_event(ReplayModel& model, const Event& event) {
+  if (!model.started && (event.kind != EventKind::Start)) return false;
+
+  replay_advance(model, event.time_ms);
+  model.stats.events++;
+  if ((model.power.mode == PowerMode::Suspended) && is_ignored_while_suspended(event.kind)) {
+    model.stats.divergences++;
+    return true;
+  }
+
+  switch (event.kind) {
+    case EventKind::Start: {
+      if (model.started) return false;
+      start(model, event);
+      break;
+    }
+    case EventKind::Tick: {
+      tick(model, event);
+      break;
+    }
+    case EventKind::TopmostCheck: {
+      check_topmost(model, event);
+      break;
+    }
+    case EventKind::Foreground: {
+      if (event.has_frame) topmost_guard_trigger(model.topmost, event.time_ms, event.frame, event.topmost);
+      else topmost_guard_trigger_all(model.topmost, event.time_ms);
+      break;
+    }
+    case EventKind::WindowUpdate:
+    case EventKind::WindowRemove: {
+      if (event.windows.empty()) return false;
+
+      model.stats.window_events++;
+      const WindowEntry& window = event.windows.front();
+      const bool coverage_changed = (event.kind == EventKind::WindowRemove) ?
+        window_index_remove(model.windows, window.id) :
+        window_index_update(model.windows, window.id, window.state);
+      if (coverage_changed) expedite(model);
+      break;
+    }
+    case EventKind::WinIniChange: {
+      if (event.flags & kEventWinIniColorSet) set_flag(model, kTransientAppFlagColorModeChanged);
+      if (event.flags & kEventWinIniIntl) set_flag(model, kTransientAppFlagLanguageOrRegionChanged);
+      if (model.transient_flags) expedite(model);
+      break;
+    }
+    case EventKind::DisplayChange:
+    case EventKind::DeviceChange:
+    case EventKind::DpiChange: {
+      set_flag(model, kTransientAppFlagDisplayChanged);
+      expedite(model);
+      break;
+    }
+    case EventKind::TimeChange: {
+      // @NOTE: The render thread is woken up and re-plans.
+      sync_civil(model, event.civil, event.time_ms);
+      render_frame(model, event.time_ms, false);
+      break;
+    }
+    case EventKind::SettingsChange: {
+      model.settings = event.settings;
+      model.profiles = event.profiles;
+      set_flag(model, kTransientAppFlagSettingsChanged);
+      expedite(model);
+      break;
+    }
+    case EventKind::Backdrop: {
+      sample_backdrops(model, event);
+      break;
+    }
+    case EventKind::Alarm: {
+      apply_alerts(model, event);
+      break;
+    }
+    case EventKind::Overlay: {
+      apply_overlays(model, event);
+      break;
+    }
+    case EventKind::Power: {
+      if (event.flags >= static_cast<uint32_t>(PowerEvent::Count)) return false;
+      apply_power(model, static_cast<PowerEvent>(event.flags), event.time_ms);
+      break;
+    }
+    case EventKind::Count: {
+      return false;
+    }
+  }
+  return true;
+}
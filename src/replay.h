@@ -0,0 +1,91 @@
+#pragma once
+
+#include "base.h"
+#include "clock_core.h"
+#include "clock_table.h"
+#include "event_log.h"
+#include "power_state.h"
+#include "render_queue.h"
+#include "surface_cache.h"
+#include "tick_scheduler.h"
+#include "topmost_guard.h"
+#include "window_index.h"
+
+// Drives the platform-neutral parts of the app with a recorded event log
+// (see event_log.h): the tick plan, clock reconciliation, visibility, the
+// topmost guard, the power state, the snapshots handed to the render thread
+// and the render thread's own wakeups. Time is simulated, so a day of events replays in
+// milliseconds. Every platform call the app would make is counted instead.
+//
+// The model mirrors what the handlers in main.cpp do; when they change,
+// this has to follow.
+
+struct ReplayStats {
+  uint64_t events = 0;
+  uint64_t simulated_ms = 0;
+  uint64_t divergences = 0; // @NOTE: recorded inputs the model did not expect, e.g. other pending flags
+  uint64_t ticks = 0;
+  uint64_t expedites = 0;
+  uint64_t reconciles = 0;
+  uint64_t clocks_created = 0;
+  uint64_t clocks_updated = 0; // @NOTE: moved, rescaled or given another corner
+  uint64_t clocks_destroyed = 0;
+  uint64_t theme_reloads = 0;
+  uint64_t locale_reloads = 0;
+  uint64_t settings_saves = 0; // @NOTE: coalesced writes, see SettingsWriteCoalescer
+  uint64_t window_index_rebuilds = 0;
+  uint64_t window_events = 0;
+  uint64_t zorder_calls = 0; // @NOTE: SetWindowPos(HWND_TOPMOST) and ShowWindow
+  uint64_t backdrop_samples = 0; // @NOTE: clocks whose backdrop changed and was measured
+  uint64_t contrast_changes = 0; // @NOTE: samples that changed the text color or shadow
+  uint64_t snapshots = 0; // @NOTE: published to the render thread
+  uint64_t frames = 0; // @NOTE: render thread wakeups
+  uint64_t formats = 0; // @NOTE: render_format calls
+  uint64_t text_changes = 0; // @NOTE: frames where the text changed
+  uint64_t rasterizations = 0; // @NOTE: surfaces rendered
+  uint64_t presents = 0; // @NOTE: UpdateLayeredWindowIndirect calls
+};
+
+struct ReplayModel {
+  bool started = false;
+  Settings settings;
+  MonitorProfiles profiles;
+  SettingsWriteCoalescer settings_writes;
+  bool light_theme = false;
+  LocaleNames names;
+  FormatProgram short_date;
+  FormatProgram long_date;
+  FormatProgram short_time;
+  FormatProgram long_time;
+  std::shared_ptr<const FrameFormat> frame_format;
+  ClockTable clocks; // @NOTE: the windows are made up, unique per clock
+  uint32_t next_generation = 0;
+  uintptr_t next_window = 0;
+  SurfaceCache surfaces;
+  WindowIndex windows;
+  TopmostGuard topmost;
+  uint32_t transient_flags = 0; // see TransientAppFlags
+  PowerState power;
+  FrameSnapshot published;
+
+  // @NOTE: the render thread
+  TickScheduler render_scheduler;
+  uint64_t render_deadline_ms = 0; // @NOTE: 0 = waiting for a snapshot
+  FormattedText time;
+  FormattedText date;
+
+  // @NOTE: wall clock, `civil` was the local time at monotonic `civil_ms`
+  CivilTime civil = { };
+  uint64_t civil_ms = 0;
+  uint64_t start_ms = 0;
+
+  ReplayStats stats;
+};
+
+// Returns false if the event cannot be applied, e.g. anything before Start.
+bool replay_event(ReplayModel& model, const Event& event);
+
+// Runs the render thread up to `now_ms`, e.g. the end of the capture.
+void replay_advance(ReplayModel& model, uint64_t now_ms);
+
+CivilTime civil_time_add_ms(CivilTime time, uint64_t ms);
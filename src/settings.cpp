@@ -0,0 +1,232 @@
+#include "settings.h"
+#include <algorithm>
+#include <iterator>
+#include <stddef.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+  // @NOTE: Over the header with checksum = 0 and the records, so a torn or
+  // flipped generation is caught too.
+  uint32_t settings_checksum(SettingsFileHeader header, const uint8_t* records, size_t size) {
+    header.checksum = 0;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&header);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(header); ++i) hash = (hash ^ bytes[i]) * 16777619u;
+    for (size_t i = 0; i < size; ++i) hash = (hash ^ records[i]) * 16777619u;
+    return hash;
+  }
+
+  // @NOTE: The fields after the corner, in the order they are stored.
+  constexpr bool Settings::* kSettingsFlags[] = {
+    &Settings::long_date,
+    &Settings::long_time,
+    &Settings::on_primary_display,
+    &Settings::on_fullscreen,
+    &Settings::analog,
+    &Settings::smooth_seconds,
+    &Settings::adaptive_contrast,
+    &Settings::system_metrics,
+  };
+
+  static_assert(std::size(kSettingsFlags) == sizeof(Settings) - 1);
+
+  bool is_corner(uint8_t value) { return value <= static_cast<uint8_t>(Corner::TopRight); }
+
+  // @NOTE: Field by field from the `size` bytes there are. A byte that is
+  // no Corner or bool leaves its field at the default, copying it would put
+  // an invalid value in the struct.
+  Settings decode_settings_record(const uint8_t* p, size_t size) {
+    Settings settings;
+    if ((size > 0) && is_corner(p[0])) settings.corner = static_cast<Corner>(p[0]);
+    for (size_t i = 0; (i < std::size(kSettingsFlags)) && (i + 1 < size); ++i) {
+      if (p[i + 1] <= 1) settings.*kSettingsFlags[i] = p[i + 1] != 0;
+    }
+    return settings;
+  }
+
+  // @NOTE: A corner that is no Corner drops kMonitorProfileCorner, so the
+  // monitor falls back to Settings::corner.
+  MonitorProfile decode_profile_record(const uint8_t* p, size_t size) {
+    uint8_t bytes[sizeof(MonitorProfile)];
+    const MonitorProfile defaults;
+    memcpy(bytes, &defaults, sizeof(bytes));
+    memcpy(bytes, p, std::min(size, sizeof(bytes)));
+
+    MonitorProfile profile;
+    memcpy(&profile.identity, bytes + offsetof(MonitorProfile, identity), sizeof(profile.identity));
+    profile.flags = bytes[offsetof(MonitorProfile, flags)];
+    const uint8_t corner = bytes[offsetof(MonitorProfile, corner)];
+    if (is_corner(corner)) profile.corner = static_cast<Corner>(corner);
+    else profile.flags &= static_cast<uint8_t>(~kMonitorProfileCorner);
+    return profile;
+  }
+
+  FILE* settings_open(const std::filesystem::path& path, bool write) {
+    #ifdef _WIN32
+    return _wfopen(path.c_str(), write ? L"wb" : L"rb");
+    #else
+    return fopen(path.c_str(), write ? "wb" : "rb");
+    #endif
+  }
+
+  // @NOTE: One read of the whole file.
+  bool settings_read_file(const std::filesystem::path& path, SettingsFile& file) {
+    std::error_code error;
+    const uintmax_t size = std::filesystem::file_size(path, error);
+    if (error || (size > sizeof(SettingsFileHeader) + sizeof(Settings) + kSettingsMaxProfiles * 64ull)) return false;
+
+    FILE* f = settings_open(path, false);
+    if (!f) return false;
+
+    std::vector<uint8_t> data(static_cast<size_t>(size));
+    const bool ok = fread(data.data(), 1, data.size(), f) == data.size();
+    fclose(f);
+    return ok && decode_settings(data.data(), data.size(), file);
+  }
+
+  bool settings_flush(FILE* f) {
+    if (fflush(f) != 0) return false;
+    #ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+    #else
+    return fsync(fileno(f)) == 0;
+    #endif
+  }
+}
+
+uint64_t monitor_identity(const wchar_t* device_path, size_t length) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < length; ++i) {
+    // @NOTE: The path is case-insensitive and its case is not stable.
+    const wchar_t ch = ((device_path[i] >= L'a') && (device_path[i] <= L'z')) ? static_cast<wchar_t>(device_path[i] - L'a' + L'A') : device_path[i];
+    hash = (hash ^ static_cast<uint64_t>(ch)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+const MonitorProfile* find_monitor_profile(const MonitorProfiles& profiles, uint64_t identity) {
+  auto it = std::lower_bound(profiles.begin(), profiles.end(), identity, [](const MonitorProfile& profile, uint64_t id) { return profile.identity < id; });
+  return ((it != profiles.end()) && (it->identity == identity)) ? &*it : nullptr;
+}
+
+void set_monitor_profile(MonitorProfiles& profiles, const MonitorProfile& profile) {
+  auto it = std::lower_bound(profiles.begin(), profiles.end(), profile.identity, [](const MonitorProfile& p, uint64_t id) { return p.identity < id; });
+  const bool found = (it != profiles.end()) && (it->identity == profile.identity);
+  if (profile.flags == 0) {
+    if (found) profiles.erase(it);
+  } else if (found) {
+    *it = profile;
+  } else {
+    profiles.insert(it, profile);
+  }
+}
+
+Corner monitor_corner(Settings settings, const MonitorProfiles& profiles, const Monitor& monitor) {
+  const MonitorProfile* profile = find_monitor_profile(profiles, monitor.identity);
+  return (profile && (profile->flags & kMonitorProfileCorner)) ? profile->corner : settings.corner;
+}
+
+bool is_monitor_disabled(const MonitorProfiles& profiles, const Monitor& monitor) {
+  const MonitorProfile* profile = find_monitor_profile(profiles, monitor.identity);
+  return profile && (profile->flags & kMonitorProfileHidden);
+}
+
+std::vector<uint8_t> encode_settings(const SettingsFile& file) {
+  SettingsFileHeader header;
+  header.header_size = sizeof(SettingsFileHeader);
+  header.settings_size = sizeof(Settings);
+  header.profile_size = sizeof(MonitorProfile);
+  header.profile_count = static_cast<uint32_t>(file.profiles.size());
+  header.generation = file.generation;
+
+  std::vector<uint8_t> data(sizeof(header) + sizeof(Settings) + file.profiles.size() * sizeof(MonitorProfile));
+  memcpy(data.data() + sizeof(header), &file.settings, sizeof(Settings));
+  if (!file.profiles.empty()) memcpy(data.data() + sizeof(header) + sizeof(Settings), file.profiles.data(), file.profiles.size() * sizeof(MonitorProfile));
+  header.checksum = settings_checksum(header, data.data() + sizeof(header), data.size() - sizeof(header));
+  memcpy(data.data(), &header, sizeof(header));
+  return data;
+}
+
+bool decode_settings(const uint8_t* data, size_t size, SettingsFile& file) {
+  uint32_t magic = 0;
+  memcpy(&magic, data, std::min(size, sizeof(magic)));
+  if (magic != kSettingsFileMagic) {
+    // @NOTE: Version 1, the bare struct. A newer file cut short is not one.
+    if ((size < kSettingsV1MinSize) || (size > kSettingsV1MaxSize) || !is_corner(data[0])) return false;
+    file = { };
+    file.settings = decode_settings_record(data, size);
+    file.generation = 1;
+    return true;
+  }
+
+  SettingsFileHeader header;
+  if (size < sizeof(header)) return false;
+  memcpy(&header, data, sizeof(header));
+  if ((header.version < 2) || (header.header_size < sizeof(header)) || (header.settings_size == 0) || (header.profile_size < sizeof(uint64_t)) || (header.profile_count > kSettingsMaxProfiles)) return false;
+
+  const size_t expected = header.header_size + header.settings_size + static_cast<size_t>(header.profile_count) * header.profile_size;
+  if ((size != expected) || (settings_checksum(header, data + header.header_size, size - header.header_size) != header.checksum)) return false;
+
+  SettingsFile result;
+  result.generation = header.generation;
+  const uint8_t* p = data + header.header_size;
+  result.settings = decode_settings_record(p, header.settings_size);
+  p += header.settings_size;
+
+  result.profiles.resize(header.profile_count);
+  for (MonitorProfile& profile : result.profiles) {
+    profile = decode_profile_record(p, header.profile_size);
+    p += header.profile_size;
+  }
+
+  // @NOTE: Only ever written sorted, anything else is not a file we wrote.
+  for (size_t i = 1; i < result.profiles.size(); ++i) {
+    if (result.profiles[i - 1].identity >= result.profiles[i].identity) return false;
+  }
+  file = std::move(result);
+  return true;
+}
+
+SettingsFile settings_load(const std::filesystem::path& path) {
+  SettingsFile saved;
+  SettingsFile pending;
+  const bool has_saved = settings_read_file(path, saved);
+  const bool has_pending = settings_read_file(std::filesystem::path(path) += ".tmp", pending);
+  if (has_pending && (!has_saved || (pending.generation > saved.generation))) return pending;
+  return has_saved ? saved : SettingsFile{ };
+}
+
+bool settings_save(const std::filesystem::path& path, SettingsFile& file) {
+  file.generation++;
+  const std::vector<uint8_t> data = encode_settings(file);
+  const std::filesystem::path temporary = std::filesystem::path(path) += ".tmp";
+
+  FILE* f = settings_open(temporary, true);
+  if (!f) return false;
+  const bool written = (fwrite(data.data(), 1, data.size(), f) == data.size()) && settings_flush(f);
+  if ((fclose(f) != 0) || !written) return false;
+
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error); // @NOTE: replaces `path` in one step, also on Windows
+  return !error;
+}
+
+uint64_t settings_coalescer_change(SettingsWriteCoalescer& coalescer, uint64_t now_ms) {
+  if (!coalescer.pending) {
+    coalescer.pending = true;
+    coalescer.first_change_ms = now_ms;
+  }
+  coalescer.deadline_ms = std::min(now_ms + kSettingsCoalesceMs, coalescer.first_change_ms + kSettingsMaxDelayMs);
+  return coalescer.deadline_ms;
+}
+
+bool settings_coalescer_take(SettingsWriteCoalescer& coalescer, uint64_t now_ms) {
+  if (!coalescer.pending || (now_ms < coalescer.deadline_ms)) return false;
+
+  coalescer = { };
+  return true;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "base.h"
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+struct Settings {
+  Corner corner = Corner::BottomRight;
+  bool long_date = false;
+  bool long_time = false;
+  bool on_primary_display = false;
+  bool on_fullscreen = false;
+  bool analog = false;
+  bool smooth_seconds = false;
+  bool adaptive_contrast = true; // @NOTE: text color from the backdrop instead of the theme
+  bool system_metrics = false; // @NOTE: third line with CPU, memory and network use, see system_metrics.h
+};
+
+static_assert(sizeof(Settings) == 9);
+
+inline bool operator ==(Settings lhs, Settings rhs) { return memcmp(&lhs, &rhs, sizeof(Settings)) == 0; }
+inline bool operator !=(Settings lhs, Settings rhs) { return !(lhs == rhs); }
+
+enum MonitorProfileFlags : uint8_t {
+  kMonitorProfileCorner = 1 << 0, // @NOTE: `corner` replaces Settings::corner
+  kMonitorProfileHidden = 1 << 1, // @NOTE: no clock on this monitor
+};
+
+// What one monitor does differently from the settings, keyed by
+// Monitor::identity so it survives reconnects, reboots and the monitor
+// order changing.
+struct MonitorProfile {
+  uint64_t identity = 0;
+  uint8_t flags = 0; // see MonitorProfileFlags
+  Corner corner = Corner::BottomRight;
+  uint8_t padding[6] = { }; // @NOTE: written as is, so no indeterminate bytes
+};
+
+static_assert(sizeof(MonitorProfile) == 16);
+
+inline bool operator ==(const MonitorProfile& lhs, const MonitorProfile& rhs) { return memcmp(&lhs, &rhs, sizeof(MonitorProfile)) == 0; }
+inline bool operator !=(const MonitorProfile& lhs, const MonitorProfile& rhs) { return !(lhs == rhs); }
+
+// Hash of the monitor's device interface path, which names the panel
+// (from its EDID) and the port it is plugged into.
+uint64_t monitor_identity(const wchar_t* device_path, size_t length);
+
+// @NOTE: sorted by identity, no two with the same one
+using MonitorProfiles = std::vector<MonitorProfile>;
+
+// nullptr if the monitor has no profile.
+const MonitorProfile* find_monitor_profile(const MonitorProfiles& profiles, uint64_t identity);
+
+// Replaces the monitor's profile, a profile without flags is removed.
+void set_monitor_profile(MonitorProfiles& profiles, const MonitorProfile& profile);
+
+Corner monitor_corner(Settings settings, const MonitorProfiles& profiles, const Monitor& monitor);
+bool is_monitor_disabled(const MonitorProfiles& profiles, const Monitor& monitor);
+
+// The settings file:
+//
+//   SettingsFileHeader
+//   Settings                      settings_size bytes
+//   MonitorProfile[profile_count] profile_size bytes each
+//
+// Every record is the raw struct. New fields are only ever appended, so a
+// reader decodes the prefix it knows of each record field by field and
+// leaves the rest at their defaults, and an older reader skips what it does
+// not know. A bool or Corner byte out of range keeps its default too. The
+// checksum covers the known header fields and every record, a file that
+// fails it or is cut short is ignored as a whole.
+//
+// Version 1 files are a bare Settings struct of 5 to 8 bytes, from before
+// the header, and are read as such.
+
+constexpr uint32_t kSettingsFileMagic = 0x53314357; // @NOTE: "WC1S"
+constexpr uint16_t kSettingsFileVersion = 2;
+constexpr size_t kSettingsV1MinSize = 5; // @NOTE: the oldest bare Settings
+constexpr size_t kSettingsV1MaxSize = 8; // @NOTE: the last bare Settings
+constexpr uint32_t kSettingsMaxProfiles = 4096;
+
+struct SettingsFileHeader {
+  uint32_t magic = kSettingsFileMagic;
+  uint16_t version = kSettingsFileVersion;
+  uint16_t header_size = 0;
+  uint16_t settings_size = 0;
+  uint16_t profile_size = 0;
+  uint32_t profile_count = 0;
+  uint64_t generation = 0; // @NOTE: incremented by every write
+  uint32_t checksum = 0;
+  uint32_t reserved = 0;
+};
+
+static_assert(sizeof(SettingsFileHeader) == 32);
+
+struct SettingsFile {
+  Settings settings;
+  MonitorProfiles profiles;
+  uint64_t generation = 0; // @NOTE: 0 = defaults, nothing was read
+};
+
+std::vector<uint8_t> encode_settings(const SettingsFile& file);
+
+// Returns false and leaves `file` alone if `data` is not a complete
+// settings file of any version.
+bool decode_settings(const uint8_t* data, size_t size, SettingsFile& file);
+
+// A write goes to `<path>.tmp`, is flushed to disk and then renamed over
+// `path`, so a crash leaves either the old or the new file. Loading takes
+// whichever of the two is intact and newer, which also picks up a write
+// that was flushed but not renamed. Defaults if neither is.
+SettingsFile settings_load(const std::filesystem::path& path);
+bool settings_save(const std::filesystem::path& path, SettingsFile& file);
+
+// Changes are written kSettingsCoalesceMs after the last one, so a burst
+// of menu clicks is a single write, but never later than kSettingsMaxDelayMs
+// after the first.
+constexpr uint32_t kSettingsCoalesceMs = 1000;
+constexpr uint32_t kSettingsMaxDelayMs = 5000;
+
+struct SettingsWriteCoalescer {
+  bool pending = false;
+  uint64_t first_change_ms = 0;
+  uint64_t deadline_ms = 0;
+};
+
+// Returns the deadline for the write.
+uint64_t settings_coalescer_change(SettingsWriteCoalescer& coalescer, uint64_t now_ms);
+
+// True once, when the pending write is due.
+bool settings_coalescer_take(SettingsWriteCoalescer& coalescer, uint64_t now_ms);
@@ -0,0 +1,149 @@
+#include "startup_graph.h"
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string.h>
+#include <thread>
+
+namespace {
+  struct StartupRun {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<uint32_t> main_queue;
+    std::deque<uint32_t> any_queue;
+    std::vector<uint32_t> waiting; // @NOTE: unfinished dependencies per node
+    std::vector<std::vector<uint32_t>> dependents;
+    size_t finished = 0;
+  };
+
+  void enqueue(StartupGraph& graph, StartupRun& run, uint32_t node) {
+    if (graph.nodes[node].thread == StartupThread::Main) run.main_queue.push_back(node);
+    else run.any_queue.push_back(node);
+  }
+
+  void execute(StartupGraph& graph, StartupRun& run, uint32_t node, uint32_t worker) {
+    StartupNode& n = graph.nodes[node];
+    n.worker = worker;
+    n.start_ns = startup_now_ns() - graph.start_ns;
+    if (n.task) n.task();
+    n.end_ns = startup_now_ns() - graph.start_ns;
+
+    std::lock_guard<std::mutex> lock(run.mutex);
+    for (uint32_t dependent : run.dependents[node]) {
+      if (--run.waiting[dependent] == 0) enqueue(graph, run, dependent);
+    }
+    run.finished++;
+    run.ready.notify_all();
+  }
+
+  // @NOTE: Workers only take Any nodes. The calling thread takes Main nodes
+  // first and helps with Any nodes only when there are no workers, so that
+  // it is free the moment the next Main node, e.g. the first frame, is
+  // ready.
+  bool take(StartupRun& run, size_t count, bool main, bool help, uint32_t& node) {
+    std::unique_lock<std::mutex> lock(run.mutex);
+    run.ready.wait(lock, [&] {
+      return (run.finished == count) || (main && !run.main_queue.empty()) || ((!main || help) && !run.any_queue.empty());
+    });
+    if (main && !run.main_queue.empty()) {
+      node = run.main_queue.front();
+      run.main_queue.pop_front();
+      return true;
+    }
+    if ((!main || help) && !run.any_queue.empty()) {
+      node = run.any_queue.front();
+      run.any_queue.pop_front();
+      return true;
+    }
+    return false;
+  }
+}
+
+uint64_t startup_now_ns() {
+  using namespace std::chrono;
+  return static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+uint32_t startup_graph_add(StartupGraph& graph, const char* name, StartupThread thread, std::vector<uint32_t> after, std::function<void()> task) {
+  const uint32_t index = static_cast<uint32_t>(graph.nodes.size());
+  assert(std::all_of(after.begin(), after.end(), [&](uint32_t dependency) { return dependency < index; }) && "a startup node depends on a later one"); // @NOTE: keeps the graph acyclic
+  graph.nodes.push_back(StartupNode{.name = name, .thread = thread, .after = std::move(after), .task = std::move(task)});
+  return index;
+}
+
+void startup_graph_run(StartupGraph& graph, uint32_t workers) {
+  graph.start_ns = startup_now_ns();
+  const size_t count = graph.nodes.size();
+
+  StartupRun run;
+  run.waiting.resize(count);
+  run.dependents.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    run.waiting[i] = static_cast<uint32_t>(graph.nodes[i].after.size());
+    for (uint32_t dependency : graph.nodes[i].after) run.dependents[dependency].push_back(i);
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    if (run.waiting[i] == 0) enqueue(graph, run, i);
+  }
+
+  std::vector<std::thread> threads;
+  for (uint32_t w = 1; w <= workers; ++w) {
+    threads.emplace_back([&graph, &run, count, w] {
+      for (uint32_t node; take(run, count, false, false, node);) execute(graph, run, node, w);
+    });
+  }
+  for (uint32_t node; take(run, count, true, workers == 0, node);) execute(graph, run, node, 0);
+  for (std::thread& thread : threads) thread.join();
+
+  graph.wall_ns = startup_now_ns() - graph.start_ns;
+}
+
+void startup_parallel_for(uint32_t count, uint32_t threads, const std::function<void(uint32_t)>& task) {
+  std::atomic<uint32_t> next{0};
+  auto work = [&] {
+    for (uint32_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) task(i);
+  };
+
+  std::vector<std::thread> helpers;
+  for (uint32_t t = 1; (t < threads) && (t < count); ++t) helpers.emplace_back(work);
+  work();
+  for (std::thread& helper : helpers) helper.join();
+}
+
+StartupReport startup_graph_report(const StartupGraph& graph) {
+  StartupReport report = {.wall_ns = graph.wall_ns};
+
+  // @NOTE: Dependencies come first, so one pass in order finds the longest
+  // chain ending at each node.
+  std::vector<uint64_t> path(graph.nodes.size(), 0);
+  for (size_t i = 0; i < graph.nodes.size(); ++i) {
+    const StartupNode& node = graph.nodes[i];
+    const uint64_t duration = node.end_ns - node.start_ns;
+    uint64_t longest = 0;
+    for (uint32_t dependency : node.after) longest = (path[dependency] > longest) ? path[dependency] : longest;
+    path[i] = longest + duration;
+    report.serial_ns += duration;
+    report.critical_path_ns = (path[i] > report.critical_path_ns) ? path[i] : report.critical_path_ns;
+  }
+  return report;
+}
+
+uint64_t startup_graph_end_ns(const StartupGraph& graph, const char* name) {
+  for (const StartupNode& node : graph.nodes) {
+    if (strcmp(node.name, name) == 0) return node.end_ns;
+  }
+  return 0;
+}
+
+void startup_graph_write_report(const StartupGraph& graph, FILE* f) {
+  for (const StartupNode& node : graph.nodes) {
+    fprintf(f, "{\"node\":\"%s\",\"worker\":%u,\"start_us\":%llu,\"end_us\":%llu}\n", node.name, node.worker, static_cast<unsigned long long>(node.start_ns / 1000), static_cast<unsigned long long>(node.end_ns / 1000));
+  }
+
+  const StartupReport report = startup_graph_report(graph);
+  fprintf(f, "{\"wall_us\":%llu,\"serial_us\":%llu,\"critical_path_us\":%llu}\n", static_cast<unsigned long long>(report.wall_ns / 1000), static_cast<unsigned long long>(report.serial_ns / 1000), static_cast<unsigned long long>(report.critical_path_ns / 1000));
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "base.h"
+#include <functional>
+#include <stdio.h>
+#include <vector>
+
+// Runs the startup work as a dependency graph instead of one step after
+// the other. A node runs once every node it depends on has finished;
+// independent nodes run at the same time on a few worker threads. Nodes
+// that have to run on the calling thread, e.g. ones creating windows that
+// thread's message loop will own, are marked StartupThread::Main.
+//
+// A node can only depend on nodes added before it, so the graph cannot
+// have cycles. Every node is timed, the report compares the wall time with
+// the serial time (the sum of the nodes) and the critical path (the
+// longest chain of dependencies, the best any schedule can do).
+
+enum class StartupThread : uint8_t {
+  Any,
+  Main,
+};
+
+struct StartupNode {
+  const char* name = "";
+  StartupThread thread = StartupThread::Any;
+  std::vector<uint32_t> after = { }; // @NOTE: indices of the nodes this one waits for
+  std::function<void()> task = { };
+  uint64_t start_ns = 0; // @NOTE: since the graph started
+  uint64_t end_ns = 0;
+  uint32_t worker = 0; // @NOTE: 0 = the calling thread
+};
+
+struct StartupGraph {
+  std::vector<StartupNode> nodes;
+  uint64_t start_ns = 0; // @NOTE: startup_now_ns when the graph started
+  uint64_t wall_ns = 0;
+};
+
+uint64_t startup_now_ns();
+
+// Returns the index of the node. Every index in `after` must be smaller,
+// anything else is a bug in the graph and asserts.
+uint32_t startup_graph_add(StartupGraph& graph, const char* name, StartupThread thread, std::vector<uint32_t> after, std::function<void()> task);
+
+// Runs every node and returns when they are all done. With 0 workers
+// everything runs on the calling thread in the order it was added.
+void startup_graph_run(StartupGraph& graph, uint32_t workers);
+
+// Runs `task(i)` for i in [0, count) on up to `threads` threads including
+// the calling one, for fanning a node out, e.g. one resource per monitor.
+void startup_parallel_for(uint32_t count, uint32_t threads, const std::function<void(uint32_t)>& task);
+
+struct StartupReport {
+  uint64_t wall_ns = 0;
+  uint64_t serial_ns = 0;
+  uint64_t critical_path_ns = 0;
+};
+
+StartupReport startup_graph_report(const StartupGraph& graph);
+
+// Nanoseconds since the graph started at which `name` finished, 0 if there
+// is no such node.
+uint64_t startup_graph_end_ns(const StartupGraph& graph, const char* name);
+
+// One JSON object per node and one for the totals:
+//
+//   {"node":"settings","worker":1,"start_us":12,"end_us":140}
+//   {"wall_us":...,"serial_us":...,"critical_path_us":...}
+void startup_graph_write_report(const StartupGraph& graph, FILE* f);
@@ -0,0 +1,43 @@
+#include "surface_cache.h"
+
+SurfaceKey make_surface_key(Float2 dpi, Corner corner, bool dark_text, bool shadow) {
+  return SurfaceKey{
+    .dpi = static_cast<uint32_t>(dpi.x * 96.0f + 0.5f),
+    .font_size = kDefaultFontSize * dpi.x,
+    .corner = corner,
+    .dark_text = dark_text,
+    .shadow = shadow,
+  };
+}
+
+Float2 surface_key_dpi_scale(SurfaceKey key) {
+  const float scale = static_cast<float>(key.dpi) / 96.0f;
+  return {scale, scale};
+}
+
+uint32_t surface_cache_acquire(SurfaceCache& cache, SurfaceKey key, bool* created) {
+  uint32_t free_slot = static_cast<uint32_t>(cache.slots.size());
+  for (uint32_t i = 0; i < cache.slots.size(); ++i) {
+    SurfaceSlot& slot = cache.slots[i];
+    if (slot.refcount == 0) {
+      if (free_slot == cache.slots.size()) free_slot = i;
+      continue;
+    }
+    if (slot.key == key) {
+      slot.refcount++;
+      *created = false;
+      return i;
+    }
+  }
+
+  if (free_slot == cache.slots.size()) cache.slots.push_back({ });
+  cache.slots[free_slot] = SurfaceSlot{.key = key, .refcount = 1};
+  *created = true;
+  return free_slot;
+}
+
+bool surface_cache_release(SurfaceCache& cache, uint32_t slot) {
+  if (slot >= cache.slots.size() || cache.slots[slot].refcount == 0) return false;
+
+  return --cache.slots[slot].refcount == 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "base.h"
+#include <vector>
+
+// Clocks that would render identical pixels (same DPI, corner, text color,
+// shadow and font size) share one surface. A surface is rasterized at most once per
+// frame and then presented to every clock window that references it, see
+// snapshot_render_frame.
+
+struct SurfaceKey {
+  uint32_t dpi = 96;
+  float font_size = 12.0f;
+  Corner corner = Corner::BottomRight;
+  bool dark_text = false; // @NOTE: for a light backdrop
+  bool shadow = false;
+  bool alert = false; // @NOTE: an alarm went off, see alarms.h
+  uint16_t overlay = 0; // @NOTE: id of the overlay message shown as an extra line, 0 for none, see clock_api.h
+};
+
+inline bool operator ==(SurfaceKey lhs, SurfaceKey rhs) {
+  return (lhs.dpi == rhs.dpi) && (lhs.font_size == rhs.font_size) && (lhs.corner == rhs.corner) && (lhs.dark_text == rhs.dark_text) && (lhs.shadow == rhs.shadow) && (lhs.alert == rhs.alert) && (lhs.overlay == rhs.overlay);
+}
+inline bool operator !=(SurfaceKey lhs, SurfaceKey rhs) { return !(lhs == rhs); }
+
+struct SurfaceSlot {
+  SurfaceKey key;
+  uint32_t refcount = 0;
+};
+
+struct SurfaceCache {
+  std::vector<SurfaceSlot> slots;
+};
+
+constexpr float kDefaultFontSize = 12.0f;
+
+SurfaceKey make_surface_key(Float2 dpi, Corner corner, bool dark_text, bool shadow);
+Float2 surface_key_dpi_scale(SurfaceKey key);
+
+// `created` is set when the slot is new and the caller has to create its resources.
+uint32_t surface_cache_acquire(SurfaceCache& cache, SurfaceKey key, bool* created);
+
+// Returns true when the last reference is gone and the caller has to destroy the resources.
+bool surface_cache_release(SurfaceCache& cache, uint32_t slot);
@@ -0,0 +1,288 @@
+#include "system_metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+
+namespace {
+  // @NOTE: Skips to the next unsigned number on the line, false at its end.
+  bool metrics_next_number(const char*& p, const char* end, uint64_t& value) {
+    while ((p < end) && (*p != '\n') && ((*p < '0') || (*p > '9'))) p++;
+    if ((p == end) || (*p == '\n')) return false;
+
+    value = 0;
+    while ((p < end) && (*p >= '0') && (*p <= '9')) value = value * 10 + static_cast<uint64_t>(*p++ - '0');
+    return true;
+  }
+
+  const char* metrics_next_line(const char* p, const char* end) {
+    const char* newline = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+    return newline ? newline + 1 : end;
+  }
+
+  bool metrics_starts_with(const char* p, const char* end, const char* prefix) {
+    const size_t length = strlen(prefix);
+    return (static_cast<size_t>(end - p) >= length) && (memcmp(p, prefix, length) == 0);
+  }
+
+  uint64_t metrics_delta(uint64_t current, uint64_t previous) {
+    return (current > previous) ? current - previous : 0; // @NOTE: a counter that went back was reset
+  }
+
+  // @NOTE: Reads the whole file with the stdio buffer off, i.e. one read
+  // call for the small ones. A read that fills the buffer may have stopped
+  // short of the end, so the buffer grows and the read goes on.
+  bool metrics_read(FILE* f, std::vector<char>& buffer, size_t& length) {
+    if (!f) return false;
+
+    if (buffer.empty()) buffer.resize(kProcMetricsBuffer);
+    rewind(f);
+    length = 0;
+    for (;;) {
+      const size_t wanted = buffer.size() - length;
+      const size_t read = fread(buffer.data() + length, 1, wanted, f);
+      length += read;
+      if (read < wanted) break;
+      buffer.resize(buffer.size() * 2);
+    }
+    return (length > 0) && !ferror(f);
+  }
+
+  FILE* metrics_open(const char* root, const char* name) {
+    char path[512];
+    if (snprintf(path, sizeof(path), "%s/%s", root, name) >= static_cast<int>(sizeof(path))) return nullptr;
+
+    FILE* f = fopen(path, "rb");
+    if (f) setvbuf(f, nullptr, _IONBF, 0);
+    return f;
+  }
+
+  struct MetricsText {
+    wchar_t text[kFormattedTextCapacity];
+    uint32_t length = 0;
+  };
+
+  void metrics_put(MetricsText& out, wchar_t ch) {
+    if (out.length < kFormattedTextCapacity) out.text[out.length++] = ch;
+  }
+
+  void metrics_put(MetricsText& out, const wchar_t* text) {
+    while (*text) metrics_put(out, *text++);
+  }
+
+  // @NOTE: Padded to `width` with figure spaces, which are as wide as a
+  // digit, so the line keeps its size while the numbers change.
+  void metrics_put_number(MetricsText& out, uint64_t value, uint32_t width = 0) {
+    wchar_t digits[20];
+    uint32_t count = 0;
+    do {
+      digits[count++] = static_cast<wchar_t>(L'0' + value % 10);
+      value /= 10;
+    } while (value > 0);
+    for (uint32_t i = count; i < width; ++i) metrics_put(out, static_cast<wchar_t>(0x2007));
+    while (count > 0) metrics_put(out, digits[--count]);
+  }
+
+  // @NOTE: "512B", " 34K", "1.2M", one decimal below 10 of a unit.
+  void metrics_put_bytes(MetricsText& out, uint64_t bytes) {
+    constexpr wchar_t kUnits[] = {L'B', L'K', L'M', L'G', L'T'};
+    uint32_t unit = 0;
+    uint64_t scale = 1;
+    while ((unit + 1 < sizeof(kUnits) / sizeof(kUnits[0])) && (bytes >= scale * 1024)) {
+      scale *= 1024;
+      unit++;
+    }
+
+    const uint64_t tenths = (bytes * 10 + scale / 2) / scale;
+    if ((unit > 0) && (tenths < 100)) {
+      metrics_put_number(out, tenths / 10);
+      metrics_put(out, L'.');
+      metrics_put_number(out, tenths % 10);
+    } else {
+      metrics_put_number(out, (tenths + 5) / 10, 3);
+    }
+    metrics_put(out, kUnits[unit]);
+  }
+}
+
+bool metrics_sampler_tick(MetricsSampler& sampler, uint64_t now_ms) {
+  if (now_ms < sampler.next_pass_ms) return false;
+  sampler.next_pass_ms = now_ms + kMetricsIntervalMs * 3 / 4;
+
+  MetricsCounters counters;
+  const auto start = std::chrono::steady_clock::now();
+  const bool ok = sampler.provider.sample && sampler.provider.sample(counters);
+  const uint64_t elapsed_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+  sampler.stats.sample_ns += elapsed_ns;
+  if (elapsed_ns > sampler.stats.max_sample_ns) sampler.stats.max_sample_ns = elapsed_ns;
+  if (!ok) {
+    // @NOTE: Keeps `previous`, so the next good pass spans the gap.
+    sampler.stats.failures++;
+    return false;
+  }
+  sampler.stats.samples++;
+
+  const MetricsCounters previous = sampler.previous;
+  const uint64_t elapsed_ms = now_ms - sampler.previous_ms;
+  const bool had_previous = sampler.has_previous;
+  sampler.previous = counters;
+  sampler.previous_ms = now_ms;
+  sampler.has_previous = true;
+  if (!had_previous || (elapsed_ms == 0)) return false;
+
+  MetricsRates rates;
+  const uint64_t total = metrics_delta(counters.cpu_total, previous.cpu_total);
+  const uint64_t busy = std::min(metrics_delta(counters.cpu_busy, previous.cpu_busy), total);
+  rates.cpu_permille = static_cast<uint16_t>((total > 0) ? (busy * 1000 + total / 2) / total : 0);
+  rates.memory_used = counters.memory_used;
+  rates.memory_permille = static_cast<uint16_t>((counters.memory_total > 0) ? std::min<uint64_t>((counters.memory_used * 1000 + counters.memory_total / 2) / counters.memory_total, 1000) : 0);
+  rates.received_per_s = metrics_delta(counters.net_received, previous.net_received) * 1000 / elapsed_ms;
+  rates.sent_per_s = metrics_delta(counters.net_sent, previous.net_sent) * 1000 / elapsed_ms;
+
+  sampler.latest = rates;
+  sampler.has_rates = true;
+  metrics_ring_push(sampler.cpu, rates.cpu_permille);
+  return true;
+}
+
+void metrics_sampler_reset(MetricsSampler& sampler) {
+  sampler.previous = { };
+  sampler.previous_ms = 0;
+  sampler.has_previous = false;
+  sampler.next_pass_ms = 0;
+  sampler.latest = { };
+  sampler.has_rates = false;
+  sampler.cpu = { };
+}
+
+bool render_metrics_line(const MetricsSampler& sampler, FormattedText& out) {
+  MetricsText line;
+  metrics_put(line, L"CPU ");
+  if (sampler.has_rates) {
+    const MetricsRates& rates = sampler.latest;
+    metrics_put_number(line, (rates.cpu_permille + 5u) / 10u, 2);
+    metrics_put(line, L"% ");
+    for (uint32_t age = std::min(sampler.cpu.count, kMetricsSparkline); age > 0; --age) {
+      const uint32_t level = std::min<uint32_t>(metrics_ring_at(sampler.cpu, age - 1) * 8u / 1000u, 7u);
+      metrics_put(line, static_cast<wchar_t>(0x2581 + level));
+    }
+    metrics_put(line, L" MEM ");
+    metrics_put_number(line, (rates.memory_permille + 5u) / 10u, 2);
+    metrics_put(line, L"% \u2193");
+    metrics_put_bytes(line, rates.received_per_s);
+    metrics_put(line, L" \u2191");
+    metrics_put_bytes(line, rates.sent_per_s);
+  } else {
+    metrics_put(line, L"MEM");
+  }
+
+  if (out.valid && (out.length == line.length) && (wmemcmp(out.text, line.text, line.length) == 0)) return false;
+
+  memcpy(out.text, line.text, line.length * sizeof(wchar_t));
+  if (line.length < kFormattedTextCapacity) out.text[line.length] = L'\0';
+  out.length = line.length;
+  out.valid = true;
+  return true;
+}
+
+bool parse_proc_stat(const char* text, size_t length, MetricsCounters& counters) {
+  // @NOTE: The first line sums every CPU, in clock ticks:
+  // cpu  user nice system idle iowait irq softirq steal guest guest_nice
+  // Guest time is already in user and nice.
+  const char* p = text;
+  const char* end = text + length;
+  if (!metrics_starts_with(p, end, "cpu ")) return false;
+
+  uint64_t fields[8] = { };
+  uint32_t count = 0;
+  while ((count < 8) && metrics_next_number(p, end, fields[count])) count++;
+  if (count < 4) return false;
+
+  uint64_t total = 0;
+  for (uint64_t field : fields) total += field;
+  counters.cpu_total = total;
+  counters.cpu_busy = total - fields[3] - fields[4]; // @NOTE: not idle, not waiting for I/O
+  return true;
+}
+
+bool parse_proc_meminfo(const char* text, size_t length, MetricsCounters& counters) {
+  uint64_t total = 0;
+  uint64_t available = 0;
+  uint64_t mem_free = 0;
+  bool has_total = false;
+  bool has_available = false;
+  bool has_free = false;
+  const char* end = text + length;
+  for (const char* p = text; p < end; p = metrics_next_line(p, end)) {
+    const char* q = p;
+    if (metrics_starts_with(p, end, "MemTotal:")) has_total = metrics_next_number(q, end, total);
+    else if (metrics_starts_with(p, end, "MemAvailable:")) has_available = metrics_next_number(q, end, available);
+    else if (metrics_starts_with(p, end, "MemFree:")) has_free = metrics_next_number(q, end, mem_free);
+    if (has_total && has_available) break;
+  }
+  if (!has_total || (!has_available && !has_free)) return false;
+
+  // @NOTE: In kB. MemAvailable is missing before Linux 3.14.
+  const uint64_t unused = has_available ? available : mem_free;
+  counters.memory_total = total * 1024;
+  counters.memory_used = ((total > unused) ? total - unused : 0) * 1024;
+  return true;
+}
+
+bool parse_proc_net_dev(const char* text, size_t length, MetricsCounters& counters) {
+  // @NOTE: Two header lines, then "  eth0: rx_bytes rx_packets ... (8 receive
+  // fields) tx_bytes ..." per interface.
+  const char* end = text + length;
+  const char* p = metrics_next_line(metrics_next_line(text, end), end);
+  uint64_t received = 0;
+  uint64_t sent = 0;
+  for (; p < end; p = metrics_next_line(p, end)) {
+    const char* line_end = metrics_next_line(p, end);
+    if (line_end[-1] != '\n') return false; // @NOTE: cut short, its last number may be too
+    const char* colon = static_cast<const char*>(memchr(p, ':', static_cast<size_t>(line_end - p)));
+    if (!colon) continue;
+
+    const char* name = p;
+    while ((name < colon) && (*name == ' ')) name++;
+    if ((colon - name == 2) && (memcmp(name, "lo", 2) == 0)) continue;
+
+    const char* q = colon + 1;
+    uint64_t fields[9] = { };
+    uint32_t count = 0;
+    while ((count < 9) && metrics_next_number(q, line_end, fields[count])) count++;
+    if (count < 9) return false;
+
+    received += fields[0];
+    sent += fields[8];
+  }
+
+  counters.net_received = received;
+  counters.net_sent = sent;
+  return true;
+}
+
+bool proc_metrics_open(ProcMetricsSource& source, const char* root) {
+  source.stat = metrics_open(root, "stat");
+  source.meminfo = metrics_open(root, "meminfo");
+  source.net_dev = metrics_open(root, "net/dev");
+  source.buffer.resize(kProcMetricsBuffer);
+  if (source.stat && source.meminfo && source.net_dev) return true;
+
+  proc_metrics_close(source);
+  return false;
+}
+
+void proc_metrics_close(ProcMetricsSource& source) {
+  if (source.stat) fclose(source.stat);
+  if (source.meminfo) fclose(source.meminfo);
+  if (source.net_dev) fclose(source.net_dev);
+  source.stat = nullptr;
+  source.meminfo = nullptr;
+  source.net_dev = nullptr;
+}
+
+bool proc_metrics_sample(ProcMetricsSource& source, MetricsCounters& counters) {
+  size_t length = 0;
+  if (!metrics_read(source.stat, source.buffer, length) || !parse_proc_stat(source.buffer.data(), length, counters)) return false;
+  if (!metrics_read(source.meminfo, source.buffer, length) || !parse_proc_meminfo(source.buffer.data(), length, counters)) return false;
+  return metrics_read(source.net_dev, source.buffer, length) && parse_proc_net_dev(source.buffer.data(), length, counters);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "base.h"
+#include "datetime_format.h"
+#include <stdio.h>
+#include <functional>
+#include <vector>
+
+// Machine-wide CPU, memory and network use for the optional third line under
+// the time and date. A provider reads every counter in one pass, the rates
+// are the differences between two passes kMetricsIntervalMs apart. The
+// last kMetricsHistory CPU rates are kept in a fixed ring for the sparkline
+// and the line is formatted straight into a FormattedText, so once the
+// provider's buffer fits its files nothing allocates.
+
+constexpr uint32_t kMetricsIntervalMs = 1000;
+constexpr uint32_t kMetricsHistory = 32; // @NOTE: must be a power of two
+constexpr uint32_t kMetricsSparkline = 8; // @NOTE: newest rates shown, at most kMetricsHistory
+constexpr uint64_t kMetricsSampleBudgetNs = 250'000; // @NOTE: mean cost of a sample, checked by the bench
+
+// Raw counters from one pass. Cumulative ones only mean something as the
+// difference to an earlier pass of the same provider.
+struct MetricsCounters {
+  uint64_t cpu_busy = 0; // @NOTE: cumulative, in the provider's unit
+  uint64_t cpu_total = 0; // @NOTE: cumulative, same unit
+  uint64_t memory_used = 0; // @NOTE: bytes
+  uint64_t memory_total = 0; // @NOTE: bytes
+  uint64_t net_received = 0; // @NOTE: cumulative bytes, every interface but loopback
+  uint64_t net_sent = 0; // @NOTE: cumulative bytes
+};
+
+// Reads every counter in one pass, false if they cannot be read.
+struct MetricsProvider {
+  std::function<bool(MetricsCounters& counters)> sample = { };
+};
+
+struct MetricsRates {
+  uint16_t cpu_permille = 0;
+  uint16_t memory_permille = 0;
+  uint64_t memory_used = 0; // @NOTE: bytes
+  uint64_t received_per_s = 0; // @NOTE: bytes
+  uint64_t sent_per_s = 0; // @NOTE: bytes
+};
+
+template <typename T, uint32_t Capacity>
+struct MetricsRing {
+  static_assert((Capacity & (Capacity - 1)) == 0);
+
+  T items[Capacity] = { };
+  uint32_t count = 0; // @NOTE: saturates at Capacity
+  uint32_t next = 0; // @NOTE: where the next item goes
+};
+
+template <typename T, uint32_t Capacity>
+void metrics_ring_push(MetricsRing<T, Capacity>& ring, T item) {
+  ring.items[ring.next & (Capacity - 1)] = item;
+  ring.next++;
+  if (ring.count < Capacity) ring.count++;
+}
+
+// The `age`-th newest item, 0 is the latest. `age` must be below `count`.
+template <typename T, uint32_t Capacity>
+T metrics_ring_at(const MetricsRing<T, Capacity>& ring, uint32_t age) {
+  return ring.items[(ring.next - 1 - age) & (Capacity - 1)];
+}
+
+struct MetricsStats {
+  uint64_t samples = 0;
+  uint64_t failures = 0; // @NOTE: the provider could not read its counters
+  uint64_t sample_ns = 0; // @NOTE: total time spent in the provider
+  uint64_t max_sample_ns = 0;
+};
+
+struct MetricsSampler {
+  MetricsProvider provider;
+  MetricsCounters previous;
+  uint64_t previous_ms = 0; // @NOTE: monotonic time of `previous`
+  bool has_previous = false;
+  uint64_t next_pass_ms = 0; // @NOTE: monotonic, earliest time for the next pass, also after a failed one
+  MetricsRates latest;
+  bool has_rates = false; // @NOTE: two passes made it
+  MetricsRing<uint16_t, kMetricsHistory> cpu; // @NOTE: permille
+  MetricsStats stats;
+};
+
+// Called on every frame, passes over the provider about once per
+// kMetricsIntervalMs. The ticks come on wall clock seconds, so a pass is due
+// a quarter interval early rather than skipping a tick that came a little
+// early. Returns true if `latest` and the ring changed.
+bool metrics_sampler_tick(MetricsSampler& sampler, uint64_t now_ms);
+
+// Forgets the counters and the history, keeps the provider and the stats.
+void metrics_sampler_reset(MetricsSampler& sampler);
+
+// "CPU 12% <sparkline> MEM 52% <down>1.2M <up> 34K", the sparkline of the
+// kMetricsSparkline newest CPU rates in block elements U+2581-U+2588, the
+// arrows U+2193/U+2191. Numbers are padded with figure spaces, so the line
+// only changes its width with the units. Just "CPU MEM" until two passes
+// made it. Returns true if the text changed.
+bool render_metrics_line(const MetricsSampler& sampler, FormattedText& out);
+
+// Parsers for the /proc files, false if the expected fields are missing or
+// /proc/net/dev ends within a line.
+bool parse_proc_stat(const char* text, size_t length, MetricsCounters& counters);
+bool parse_proc_meminfo(const char* text, size_t length, MetricsCounters& counters);
+bool parse_proc_net_dev(const char* text, size_t length, MetricsCounters& counters);
+
+// Linux provider reading /proc/stat, /proc/meminfo and /proc/net/dev under
+// `root`. The files are kept open and read to their end each pass, usually
+// with one call. The buffer starts at kProcMetricsBuffer and doubles while a
+// file does not fit, e.g. /proc/net/dev on a host with many interfaces.
+constexpr size_t kProcMetricsBuffer = 16384;
+
+struct ProcMetricsSource {
+  FILE* stat = nullptr;
+  FILE* meminfo = nullptr;
+  FILE* net_dev = nullptr;
+  std::vector<char> buffer;
+};
+
+bool proc_metrics_open(ProcMetricsSource& source, const char* root);
+void proc_metrics_close(ProcMetricsSource& source);
+bool proc_metrics_sample(ProcMetricsSource& source, MetricsCounters& counters);
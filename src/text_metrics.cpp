@@ -0,0 +1,63 @@
+#include "text_metrics.h"
+#include <string.h>
+
+namespace {
+  wchar_t text_shape_char(wchar_t ch) {
+    if (((ch >= L'0') && (ch <= L'9')) || (ch == 0x2007)) return L'0'; // @NOTE: and figure spaces, as wide as a digit
+    if ((ch >= 0x2581) && (ch <= 0x2588)) return static_cast<wchar_t>(0x2581); // @NOTE: the sparkline's block elements, see system_metrics.h
+    return ch;
+  }
+
+  bool text_font_equal(TextFont lhs, TextFont rhs) {
+    return (lhs.family == rhs.family) && (lhs.size == rhs.size) && (lhs.dpi == rhs.dpi);
+  }
+
+  bool text_shape_equal(const std::wstring& shape, const wchar_t* text, uint32_t length) {
+    if (shape.size() != length) return false;
+    for (uint32_t i = 0; i < length; ++i) {
+      if (shape[i] != text_shape_char(text[i])) return false;
+    }
+    return true;
+  }
+}
+
+uint64_t text_shape_hash(TextFont font, const wchar_t* text, uint32_t length) {
+  uint32_t size_bits = 0;
+  memcpy(&size_bits, &font.size, sizeof(size_bits));
+  const uint64_t seeds[] = {font.family, size_bits, font.dpi, length};
+
+  uint64_t hash = 14695981039346656037ull;
+  for (uint64_t seed : seeds) hash = (hash ^ seed) * 1099511628211ull;
+  for (uint32_t i = 0; i < length; ++i) hash = (hash ^ static_cast<uint64_t>(text_shape_char(text[i]))) * 1099511628211ull;
+  return hash;
+}
+
+const TextExtent* text_metrics_find(TextMetricsCache& cache, TextFont font, const wchar_t* text, uint32_t length) {
+  cache.stats.lookups++;
+  auto it = cache.entries.find(text_shape_hash(font, text, length));
+  if (it == cache.entries.end()) {
+    cache.stats.misses++;
+    return nullptr;
+  }
+  if (!text_font_equal(it->second.font, font) || !text_shape_equal(it->second.shape, text, length)) {
+    cache.stats.misses++;
+    cache.stats.collisions++;
+    return nullptr;
+  }
+
+  cache.stats.hits++;
+  return &it->second.extent;
+}
+
+void text_metrics_insert(TextMetricsCache& cache, TextFont font, const wchar_t* text, uint32_t length, TextExtent extent) {
+  if (cache.entries.size() >= kTextMetricsMaxEntries) {
+    cache.entries.clear();
+    cache.stats.resets++;
+  }
+
+  TextMetricsEntry& entry = cache.entries[text_shape_hash(font, text, length)]; // @NOTE: replaces a colliding shape
+  entry.font = font;
+  entry.shape.resize(length);
+  for (uint32_t i = 0; i < length; ++i) entry.shape[i] = text_shape_char(text[i]);
+  entry.extent = extent;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "base.h"
+#include <string>
+#include <unordered_map>
+
+// Measured extents of the clock's lines, cached by font and the shape of the
+// text: the text with every ASCII digit and figure space (U+2007) folded to
+// '0'. The clock font has tabular digits, so "12:34:56" and "09:10:11" take
+// the same room and a line is only measured again when its structure
+// changes, e.g. from 9:59 to 10:00 or to a longer month name. The block
+// elements of the metrics sparkline are fixed width as well and fold to
+// U+2581. Measuring is up to the caller, e.g. a DirectWrite text layout.
+
+constexpr uint32_t kTextMetricsMaxEntries = 512; // @NOTE: cleared when full, e.g. after many locale changes
+
+struct TextFont {
+  uint32_t family = 0; // @NOTE: the caller's id for the family and weight
+  float size = 0.0f; // @NOTE: in pixels
+  uint32_t dpi = 96;
+};
+
+// In pixels.
+struct TextExtent {
+  int width = 0;
+  int height = 0;
+};
+
+inline bool operator ==(TextExtent lhs, TextExtent rhs) { return (lhs.width == rhs.width) && (lhs.height == rhs.height); }
+inline bool operator !=(TextExtent lhs, TextExtent rhs) { return !(lhs == rhs); }
+
+struct TextMetricsStats {
+  uint64_t lookups = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0; // @NOTE: the caller measured
+  uint64_t collisions = 0; // @NOTE: misses on another shape with the same hash
+  uint64_t resets = 0;
+};
+
+struct TextMetricsEntry {
+  TextFont font;
+  std::wstring shape;
+  TextExtent extent;
+};
+
+struct TextMetricsCache {
+  std::unordered_map<uint64_t, TextMetricsEntry> entries = { }; // @NOTE: by text_shape_hash
+  TextMetricsStats stats;
+};
+
+uint64_t text_shape_hash(TextFont font, const wchar_t* text, uint32_t length);
+
+// nullptr if the shape was not measured with `font` yet.
+const TextExtent* text_metrics_find(TextMetricsCache& cache, TextFont font, const wchar_t* text, uint32_t length);
+void text_metrics_insert(TextMetricsCache& cache, TextFont font, const wchar_t* text, uint32_t length, TextExtent extent);
+
+// The cached extent, or `measure(text, length)` on a miss.
+template <typename Measure>
+TextExtent text_metrics_measure(TextMetricsCache& cache, TextFont font, const wchar_t* text, uint32_t length, Measure&& measure) {
+  if (const TextExtent* extent = text_metrics_find(cache, font, text, length); extent) return *extent;
+
+  const TextExtent extent = measure(text, length);
+  text_metrics_insert(cache, font, text, length, extent);
+  return extent;
+}
@@ -0,0 +1,71 @@
+#include "tick_scheduler.h"
+#include "datetime_format.h"
+#include <algorithm>
+#include <bit>
+
+TickGranularity tick_granularity_for(uint32_t fields) {
+  if (fields & kFormatFieldSecond) return TickGranularity::Second;
+  if (fields & (kFormatFieldMinute | kFormatFieldHour)) return TickGranularity::Minute;
+  return TickGranularity::Day;
+}
+
+uint32_t ms_until_boundary(CivilTime time, TickGranularity granularity) {
+  const uint32_t ms_into_second = time.milliseconds % 1000u;
+  const uint32_t second = time.second % 60u;
+  const uint32_t minute = time.minute % 60u;
+  const uint32_t hour = time.hour % 24u;
+
+  switch (granularity) {
+    case TickGranularity::Second: return 1000u - ms_into_second;
+    case TickGranularity::Minute: return (60u - second) * 1000u - ms_into_second;
+    case TickGranularity::Day: return ((24u - hour) * 3600u - minute * 60u - second) * 1000u - ms_into_second;
+  }
+  return 1000u - ms_into_second;
+}
+
+void tick_scheduler_wakeup(TickScheduler& scheduler, uint64_t now_ms) {
+  scheduler.stats.wakeups++;
+  if (scheduler.expedited) {
+    scheduler.stats.expedited++;
+  } else if (scheduler.deadline_ms != 0) {
+    const uint64_t lateness = (now_ms > scheduler.deadline_ms) ? now_ms - scheduler.deadline_ms : 0;
+    const uint32_t bucket = std::min(static_cast<uint32_t>(std::bit_width(lateness)), kTickLatenessBuckets - 1);
+    scheduler.stats.total_lateness_ms += lateness;
+    scheduler.stats.lateness_histogram[bucket]++;
+  }
+  scheduler.expedited = false;
+}
+
+uint32_t tick_scheduler_plan(TickScheduler& scheduler, uint64_t now_ms, CivilTime time, TickGranularity granularity) {
+  uint32_t delay = ms_until_boundary(time, granularity) + kTickSlackMs;
+  if (delay > kTickMaxDelayMs) delay = kTickMaxDelayMs;
+
+  scheduler.deadline_ms = now_ms + delay;
+  scheduler.expedited = false;
+  return delay;
+}
+
+uint64_t tick_lateness_percentile(const TickSchedulerStats& stats, double p) {
+  uint64_t total = 0;
+  for (uint64_t count : stats.lateness_histogram) total += count;
+  if (total == 0) return 0;
+
+  const uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total - 1));
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < kTickLatenessBuckets; ++i) {
+    seen += stats.lateness_histogram[i];
+    if (seen <= rank) continue;
+    if (i == 0) return 0;
+    return (i + 1 < kTickLatenessBuckets) ? (1ull << i) - 1 : 1ull << (i - 1);
+  }
+  return 1ull << (kTickLatenessBuckets - 2);
+}
+
+bool tick_scheduler_expedite(TickScheduler& scheduler, uint64_t now_ms, uint32_t delay_ms) {
+  const uint64_t deadline = now_ms + delay_ms;
+  if ((scheduler.deadline_ms != 0) && (scheduler.deadline_ms <= deadline)) return false;
+
+  scheduler.deadline_ms = deadline;
+  scheduler.expedited = true;
+  return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "base.h"
+
+// Decides when the app needs to wake up next. Instead of a fixed 1000 ms
+// timer the next wakeup is phase-locked to the next wall-clock boundary
+// where the visible text actually changes. All inputs are passed in (the
+// monotonic `now_ms` and the wall-clock `time`), so the scheduler can be
+// driven by a simulated clock.
+
+enum class TickGranularity : uint8_t {
+  Second,
+  Minute,
+  Day,
+};
+
+constexpr uint32_t kTickLatenessBuckets = 12;
+
+struct TickSchedulerStats {
+  uint64_t wakeups = 0;
+  uint64_t expedited = 0;
+  uint64_t total_lateness_ms = 0; // @NOTE: sum of (wakeup - deadline) over scheduled wakeups
+  uint64_t lateness_histogram[kTickLatenessBuckets] = { }; // @NOTE: scheduled wakeups, bucket 0 on time, bucket i [2^(i-1), 2^i) ms late, the last one everything later
+};
+
+struct TickScheduler {
+  uint64_t deadline_ms = 0; // @NOTE: monotonic, 0 = nothing scheduled
+  bool expedited = false;
+  TickSchedulerStats stats;
+};
+
+constexpr uint32_t kTickSlackMs = 2; // @NOTE: wake just after the edge, never just before it
+constexpr uint32_t kTickMaxDelayMs = 15 * 60 * 1000; // @NOTE: bounds the damage if a DST shift moves midnight
+constexpr uint32_t kTickExpediteDelayMs = 50; // @NOTE: coalesces bursts of change notifications into one wakeup
+
+// Granularity needed to keep text using the given FormatField set up to date.
+TickGranularity tick_granularity_for(uint32_t fields);
+
+uint32_t ms_until_boundary(CivilTime time, TickGranularity granularity);
+
+// Called at the start of a wakeup.
+void tick_scheduler_wakeup(TickScheduler& scheduler, uint64_t now_ms);
+
+// Called at the end of a wakeup, returns the delay until the next one.
+uint32_t tick_scheduler_plan(TickScheduler& scheduler, uint64_t now_ms, CivilTime time, TickGranularity granularity);
+
+// Lateness in ms that `p` (0-1) of the scheduled wakeups did not exceed, the
+// upper end of its histogram bucket. The last bucket reports its lower end.
+uint64_t tick_lateness_percentile(const TickSchedulerStats& stats, double p);
+
+// Pulls the next wakeup to at most `delay_ms` from now. Returns true if the
+// deadline moved and the platform timer has to be re-armed.
+bool tick_scheduler_expedite(TickScheduler& scheduler, uint64_t now_ms, uint32_t delay_ms);
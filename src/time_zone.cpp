@@ -0,0 +1,477 @@
+#include "time_zone.h"
+#include <algorithm>
+#include <limits>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+  constexpr int64_t kMinTime = std::numeric_limits<int64_t>::min();
+  constexpr int64_t kMaxTime = std::numeric_limits<int64_t>::max();
+  constexpr size_t kMaxZoneFileSize = 1 << 20;
+
+  uint32_t read_u32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+  }
+
+  int64_t read_time(const uint8_t* p, size_t time_size) {
+    if (time_size == 4) return static_cast<int32_t>(read_u32(p));
+    return static_cast<int64_t>((static_cast<uint64_t>(read_u32(p)) << 32) | read_u32(p + 4));
+  }
+
+  struct TzifHeader {
+    uint8_t version = 0;
+    uint32_t isutcnt = 0;
+    uint32_t isstdcnt = 0;
+    uint32_t leapcnt = 0;
+    uint32_t timecnt = 0;
+    uint32_t typecnt = 0;
+    uint32_t charcnt = 0;
+  };
+
+  constexpr size_t kTzifHeaderSize = 44;
+
+  bool read_header(const uint8_t* data, size_t size, TzifHeader& header) {
+    if ((size < kTzifHeaderSize) || (memcmp(data, "TZif", 4) != 0)) return false;
+
+    header.version = data[4];
+    header.isutcnt = read_u32(data + 20);
+    header.isstdcnt = read_u32(data + 24);
+    header.leapcnt = read_u32(data + 28);
+    header.timecnt = read_u32(data + 32);
+    header.typecnt = read_u32(data + 36);
+    header.charcnt = read_u32(data + 40);
+    return (header.typecnt > 0) && (header.typecnt <= 256) && (header.charcnt > 0);
+  }
+
+  size_t block_size(const TzifHeader& header, size_t time_size) {
+    return static_cast<size_t>(header.timecnt) * (time_size + 1) + static_cast<size_t>(header.typecnt) * 6 + header.charcnt +
+      static_cast<size_t>(header.leapcnt) * (time_size + 4) + header.isstdcnt + header.isutcnt;
+  }
+
+  int64_t floor_div(int64_t a, int64_t b) {
+    return (a / b) - (((a % b) != 0) && ((a < 0) != (b < 0)) ? 1 : 0);
+  }
+
+  // @NOTE: https://howardhinnant.github.io/date_algorithms.html
+  int64_t days_from_civil(int64_t year, uint32_t month, uint32_t day) {
+    year -= (month <= 2) ? 1 : 0;
+    const int64_t era = floor_div(year, 400);
+    const uint32_t year_of_era = static_cast<uint32_t>(year - era * 400);
+    const uint32_t day_of_year = (153 * ((month > 2) ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const uint32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + static_cast<int64_t>(day_of_era) - 719468;
+  }
+
+  bool is_leap_year(int64_t year) {
+    return ((year % 4 == 0) && (year % 100 != 0)) || (year % 400 == 0);
+  }
+
+  uint32_t days_in_month(int64_t year, uint32_t month) {
+    constexpr uint8_t kDays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return ((month == 2) && is_leap_year(year)) ? 29u : kDays[month - 1];
+  }
+
+  int64_t year_of(int64_t utc_seconds) {
+    return civil_from_unix_ms(utc_seconds * 1000).year;
+  }
+
+  // POSIX TZ strings as found in the footer of TZif files, e.g.
+  // "EST5EDT,M3.2.0,M11.1.0" or "<+0330>-3:30".
+  struct PosixDate {
+    char kind = 'M'; // @NOTE: 'M' month.week.day, 'J' 1-365 without Feb 29, 'D' 0-365
+    int32_t month = 0;
+    int32_t week = 0;
+    int32_t day = 0;
+    int32_t time = 7200; // @NOTE: seconds after local midnight, may be negative or past 24h
+  };
+
+  struct PosixRule {
+    std::string std_name;
+    std::string dst_name;
+    int32_t std_offset = 0; // @NOTE: seconds east of UTC
+    int32_t dst_offset = 0;
+    bool has_dst = false;
+    bool has_rule = false;
+    PosixDate start;
+    PosixDate end;
+  };
+
+  bool parse_number(const char*& p, int32_t& value, int32_t max) {
+    if ((*p < '0') || (*p > '9')) return false;
+    value = 0;
+    while ((*p >= '0') && (*p <= '9')) {
+      value = value * 10 + (*p++ - '0');
+      if (value > max) return false;
+    }
+    return true;
+  }
+
+  bool parse_name(const char*& p, std::string& name) {
+    const char* begin = p;
+    if (*p == '<') {
+      begin = ++p;
+      while (*p && (*p != '>')) ++p;
+      if (*p != '>') return false;
+      name.assign(begin, p++);
+    } else {
+      while (((*p >= 'a') && (*p <= 'z')) || ((*p >= 'A') && (*p <= 'Z'))) ++p;
+      name.assign(begin, p);
+    }
+    return name.size() >= 3;
+  }
+
+  // @NOTE: [+-]hh[:mm[:ss]]
+  bool parse_hms(const char*& p, int32_t& seconds, int32_t max_hours) {
+    int32_t sign = 1;
+    if ((*p == '+') || (*p == '-')) sign = (*p++ == '-') ? -1 : 1;
+
+    int32_t hours = 0, minutes = 0, secs = 0;
+    if (!parse_number(p, hours, max_hours)) return false;
+    if ((*p == ':') && !parse_number(++p, minutes, 59)) return false;
+    if ((*p == ':') && !parse_number(++p, secs, 59)) return false;
+    seconds = sign * (hours * 3600 + minutes * 60 + secs);
+    return true;
+  }
+
+  bool parse_date(const char*& p, PosixDate& date) {
+    if (*p == 'M') {
+      date.kind = 'M';
+      if (!parse_number(++p, date.month, 12) || (date.month < 1) || (*p != '.')) return false;
+      if (!parse_number(++p, date.week, 5) || (date.week < 1) || (*p != '.')) return false;
+      if (!parse_number(++p, date.day, 6)) return false;
+    } else if (*p == 'J') {
+      date.kind = 'J';
+      if (!parse_number(++p, date.day, 365) || (date.day < 1)) return false;
+    } else {
+      date.kind = 'D';
+      if (!parse_number(p, date.day, 365)) return false;
+    }
+    date.time = 7200;
+    return (*p != '/') || parse_hms(++p, date.time, 167);
+  }
+
+  bool parse_posix_rule(const char* p, PosixRule& rule) {
+    int32_t offset = 0;
+    if (!parse_name(p, rule.std_name) || !parse_hms(p, offset, 24)) return false;
+    rule.std_offset = -offset;
+    if (!*p) return true;
+
+    if (!parse_name(p, rule.dst_name)) return false;
+    rule.has_dst = true;
+    rule.dst_offset = rule.std_offset + 3600;
+    if ((*p != ',') && *p) {
+      if (!parse_hms(p, offset, 24)) return false;
+      rule.dst_offset = -offset;
+    }
+    if (*p != ',') return false;
+    if (!parse_date(++p, rule.start) || (*p != ',') || !parse_date(++p, rule.end)) return false;
+    rule.has_rule = true;
+    return *p == '\0';
+  }
+
+  // Local seconds since the epoch at which `date` happens in `year`.
+  int64_t posix_date_local_seconds(const PosixDate& date, int64_t year) {
+    int64_t days = 0;
+    if (date.kind == 'M') {
+      const uint32_t month = static_cast<uint32_t>(date.month);
+      const int64_t first = days_from_civil(year, month, 1);
+      const int32_t first_day_of_week = static_cast<int32_t>(((first % 7) + 11) % 7); // @NOTE: 1970-01-01 was a Thursday
+      int32_t day = 1 + ((date.day - first_day_of_week + 7) % 7) + (date.week - 1) * 7;
+      while (day > static_cast<int32_t>(days_in_month(year, month))) day -= 7;
+      days = first + day - 1;
+    } else if (date.kind == 'J') {
+      days = days_from_civil(year, 1, 1) + date.day - 1 + (((date.day >= 60) && is_leap_year(year)) ? 1 : 0);
+    } else {
+      days = days_from_civil(year, 1, 1) + date.day;
+    }
+    return days * 86400 + date.time;
+  }
+
+  uint8_t find_or_add_type(TimeZone& zone, int32_t offset, bool dst, const std::string& abbreviation) {
+    for (size_t i = 0; i < zone.zone_types.size(); ++i) {
+      const ZoneType& type = zone.zone_types[i];
+      if ((type.offset == offset) && (type.dst == dst) && (abbreviation == time_zone_abbreviation(zone, static_cast<uint8_t>(i)))) return static_cast<uint8_t>(i);
+    }
+    if (zone.zone_types.size() == 256) return 0;
+
+    size_t at = zone.abbreviations.find(abbreviation + '\0');
+    if (at == std::string::npos) {
+      at = zone.abbreviations.size();
+      zone.abbreviations += abbreviation;
+      zone.abbreviations += '\0';
+    }
+    zone.zone_types.push_back(ZoneType{.offset = offset, .dst = dst, .abbreviation = static_cast<uint8_t>(std::min<size_t>(at, 255))});
+    return static_cast<uint8_t>(zone.zone_types.size() - 1);
+  }
+
+  void append_transition(TimeZone& zone, int64_t at, uint8_t type) {
+    if (at <= zone.starts.back()) {
+      // @NOTE: Transitions at the same instant, e.g. all-year DST, the later wins.
+      if (at == zone.starts.back()) zone.types.back() = type;
+      return;
+    }
+    if (type == zone.types.back()) return;
+    zone.starts.push_back(at);
+    zone.types.push_back(type);
+  }
+
+  // Expands the footer rule into explicit transitions after the last one
+  // from the file.
+  void expand_posix_rule(TimeZone& zone, const PosixRule& rule) {
+    const uint8_t std_type = find_or_add_type(zone, rule.std_offset, false, rule.std_name);
+    if (!rule.has_rule) {
+      if (zone.starts.size() == 1) zone.types.back() = std_type;
+      return;
+    }
+    const uint8_t dst_type = find_or_add_type(zone, rule.dst_offset, true, rule.dst_name);
+
+    const int64_t first_year = (zone.starts.size() > 1) ? year_of(zone.starts.back()) : 1970;
+    std::vector<std::pair<int64_t, uint8_t>> transitions;
+    for (int64_t year = first_year; year <= kTimeZoneLastYear; ++year) {
+      // @NOTE: DST starts at standard local time and ends at daylight local time.
+      transitions.push_back({posix_date_local_seconds(rule.start, year) - rule.std_offset, dst_type});
+      transitions.push_back({posix_date_local_seconds(rule.end, year) - rule.dst_offset, std_type});
+    }
+    std::stable_sort(transitions.begin(), transitions.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    const int64_t last = zone.starts.back();
+    for (const auto& [at, type] : transitions) {
+      if (at > last) append_transition(zone, at, type);
+    }
+  }
+
+  bool is_safe_zone_name(const std::string& name) {
+    if (name.empty() || (name.size() > 255) || (name[0] == '/') || (name[0] == '\\')) return false;
+    if (name.find("..") != std::string::npos) return false;
+    for (char ch : name) {
+      const bool ok = ((ch >= 'a') && (ch <= 'z')) || ((ch >= 'A') && (ch <= 'Z')) || ((ch >= '0') && (ch <= '9')) || (ch == '/') || (ch == '_') || (ch == '-') || (ch == '+') || (ch == '.');
+      if (!ok) return false;
+    }
+    return true;
+  }
+
+  bool is_space(char ch) {
+    return (ch == ' ') || (ch == '\t') || (ch == '\r');
+  }
+}
+
+bool time_zone_parse(const uint8_t* data, size_t size, TimeZone& zone) {
+  TzifHeader header;
+  if (!read_header(data, size, header)) return false;
+
+  // @NOTE: Version 2 and later repeat the data with 64-bit times after the
+  // version 1 block, followed by the footer.
+  size_t time_size = 4;
+  if (header.version >= '2') {
+    const size_t skip = kTzifHeaderSize + block_size(header, 4);
+    if ((size < skip) || !read_header(data + skip, size - skip, header)) return false;
+    data += skip;
+    size -= skip;
+    time_size = 8;
+  }
+  if (size < kTzifHeaderSize + block_size(header, time_size)) return false;
+
+  const uint8_t* times = data + kTzifHeaderSize;
+  const uint8_t* indices = times + static_cast<size_t>(header.timecnt) * time_size;
+  const uint8_t* infos = indices + header.timecnt;
+  const uint8_t* chars = infos + static_cast<size_t>(header.typecnt) * 6;
+
+  zone.starts.clear();
+  zone.types.clear();
+  zone.zone_types.clear();
+  zone.abbreviations.assign(reinterpret_cast<const char*>(chars), header.charcnt);
+  if (zone.abbreviations.back() != '\0') zone.abbreviations += '\0';
+
+  for (uint32_t i = 0; i < header.typecnt; ++i) {
+    const uint8_t* info = infos + static_cast<size_t>(i) * 6;
+    if (info[5] >= header.charcnt) return false;
+    zone.zone_types.push_back(ZoneType{.offset = static_cast<int32_t>(read_u32(info)), .dst = info[4] != 0, .abbreviation = info[5]});
+  }
+
+  zone.starts.push_back(kMinTime);
+  zone.types.push_back(0);
+  for (uint32_t i = 0; i < header.timecnt; ++i) {
+    const uint8_t type = indices[i];
+    if (type >= header.typecnt) return false;
+    append_transition(zone, read_time(times + static_cast<size_t>(i) * time_size, time_size), type);
+  }
+
+  if (time_size == 8) {
+    const char* footer = reinterpret_cast<const char*>(data + kTzifHeaderSize + block_size(header, 8));
+    const char* end = reinterpret_cast<const char*>(data + size);
+    if ((footer < end) && (*footer == '\n')) {
+      const char* newline = static_cast<const char*>(memchr(footer + 1, '\n', static_cast<size_t>(end - footer - 1)));
+      const std::string tz = newline ? std::string(footer + 1, newline) : std::string();
+      PosixRule rule;
+      if (!tz.empty() && parse_posix_rule(tz.c_str(), rule)) expand_posix_rule(zone, rule);
+    }
+  }
+  return true;
+}
+
+bool time_zone_load(const std::filesystem::path& directory, const std::string& name, TimeZone& zone) {
+  if (!is_safe_zone_name(name)) return false;
+
+  const std::filesystem::path path = directory / std::filesystem::path(name).make_preferred();
+  #ifdef _WIN32
+  FILE* f = _wfopen(path.c_str(), L"rb");
+  #else
+  FILE* f = fopen(path.c_str(), "rb");
+  #endif
+  if (!f) return false;
+
+  std::vector<uint8_t> data(kMaxZoneFileSize);
+  const size_t size = fread(data.data(), 1, data.size(), f);
+  fclose(f);
+
+  zone.name = name;
+  return (size < kMaxZoneFileSize) && time_zone_parse(data.data(), size, zone);
+}
+
+int32_t time_zone_offset_search(const TimeZone& zone, int64_t utc_seconds) {
+  const auto it = std::upper_bound(zone.starts.begin(), zone.starts.end(), utc_seconds);
+  return zone.zone_types[zone.types[static_cast<size_t>(it - zone.starts.begin()) - 1]].offset;
+}
+
+int32_t time_zone_offset(const TimeZone& zone, ZoneCursor& cursor, int64_t utc_seconds, ZoneStats* stats) {
+  if (stats) stats->conversions++;
+  if (static_cast<uint64_t>(utc_seconds) - static_cast<uint64_t>(cursor.begin) < cursor.span) return cursor.offset;
+
+  if (stats) stats->misses++;
+  const size_t i = static_cast<size_t>(std::upper_bound(zone.starts.begin(), zone.starts.end(), utc_seconds) - zone.starts.begin()) - 1;
+  const int64_t end = (i + 1 < zone.starts.size()) ? zone.starts[i + 1] : kMaxTime;
+  cursor = ZoneCursor{
+    .begin = zone.starts[i],
+    .span = static_cast<uint64_t>(end) - static_cast<uint64_t>(zone.starts[i]),
+    .offset = zone.zone_types[zone.types[i]].offset,
+    .type = zone.types[i],
+  };
+  return cursor.offset;
+}
+
+const char* time_zone_abbreviation(const TimeZone& zone, uint8_t type) {
+  return zone.abbreviations.c_str() + zone.zone_types[type].abbreviation;
+}
+
+CivilTime time_zone_civil(const TimeZone& zone, ZoneCursor& cursor, int64_t utc_ms, ZoneStats* stats) {
+  const int32_t offset = time_zone_offset(zone, cursor, floor_div(utc_ms, 1000), stats);
+  const int64_t local_ms = utc_ms + static_cast<int64_t>(offset) * 1000;
+  const int64_t day = floor_div(local_ms, 86'400'000);
+  if (day != cursor.local_day) {
+    cursor.local_day = day;
+    cursor.date = civil_from_unix_ms(day * 86'400'000);
+  }
+
+  const uint32_t ms = static_cast<uint32_t>(local_ms - day * 86'400'000);
+  CivilTime time = cursor.date;
+  time.hour = static_cast<uint16_t>(ms / 3'600'000);
+  time.minute = static_cast<uint16_t>((ms / 60'000) % 60);
+  time.second = static_cast<uint16_t>((ms / 1000) % 60);
+  time.milliseconds = static_cast<uint16_t>(ms % 1000);
+  return time;
+}
+
+CivilTime civil_from_unix_ms(int64_t unix_ms) {
+  const int64_t seconds = floor_div(unix_ms, 1000);
+  const int64_t days = floor_div(seconds, 86400);
+  const int64_t second_of_day = seconds - days * 86400;
+
+  const int64_t z = days + 719468;
+  const int64_t era = floor_div(z, 146097);
+  const uint32_t day_of_era = static_cast<uint32_t>(z - era * 146097);
+  const uint32_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  const uint32_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  const uint32_t mp = (5 * day_of_year + 2) / 153;
+  const uint32_t day = day_of_year - (153 * mp + 2) / 5 + 1;
+  const uint32_t month = (mp < 10) ? mp + 3 : mp - 9;
+  const int64_t year = static_cast<int64_t>(year_of_era) + era * 400 + ((month <= 2) ? 1 : 0);
+
+  return CivilTime{
+    .year = static_cast<uint16_t>(year),
+    .month = static_cast<uint16_t>(month),
+    .day_of_week = static_cast<uint16_t>(((days % 7) + 11) % 7),
+    .day = static_cast<uint16_t>(day),
+    .hour = static_cast<uint16_t>(second_of_day / 3600),
+    .minute = static_cast<uint16_t>((second_of_day / 60) % 60),
+    .second = static_cast<uint16_t>(second_of_day % 60),
+    .milliseconds = static_cast<uint16_t>(unix_ms - seconds * 1000),
+  };
+}
+
+int64_t unix_seconds_from_civil(CivilTime time) {
+  return days_from_civil(time.year, time.month, time.day) * 86400 + time.hour * 3600 + time.minute * 60 + time.second;
+}
+
+std::shared_ptr<const TimeZone> time_zone_database_get(TimeZoneDatabase& database, const std::string& name) {
+  if (auto it = database.zones.find(name); it != database.zones.end()) return it->second;
+
+  auto zone = std::make_shared<TimeZone>();
+  std::shared_ptr<const TimeZone> result;
+  if (time_zone_load(database.directory, name, *zone)) result = zone;
+  database.zones.emplace(name, result);
+  return result;
+}
+
+std::vector<ZoneConfigEntry> parse_zone_config(const char* text, size_t length) {
+  std::vector<ZoneConfigEntry> entries;
+  const char* end = text + length;
+  for (const char* p = text; p < end;) {
+    const char* line_end = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+    if (!line_end) line_end = end;
+    const char* comment = static_cast<const char*>(memchr(p, '#', static_cast<size_t>(line_end - p)));
+    const char* content_end = comment ? comment : line_end;
+
+    while ((p < content_end) && is_space(*p)) ++p;
+    const char* name_end = p;
+    while ((name_end < content_end) && !is_space(*name_end)) ++name_end;
+    const char* label = name_end;
+    while ((label < content_end) && is_space(*label)) ++label;
+    const char* label_end = content_end;
+    while ((label_end > label) && is_space(label_end[-1])) --label_end;
+
+    if (name_end > p) {
+      ZoneConfigEntry entry = {.name = std::string(p, name_end), .label = std::string(label, label_end)};
+      if (entry.label.empty()) {
+        const size_t slash = entry.name.rfind('/');
+        entry.label = (slash == std::string::npos) ? entry.name : entry.name.substr(slash + 1);
+        std::replace(entry.label.begin(), entry.label.end(), '_', ' ');
+      }
+      entries.push_back(entry);
+    }
+    p = line_end + 1;
+  }
+  return entries;
+}
+
+bool render_zone_line(const std::vector<ZoneClock>& zones, const FormatProgram& time, const LocaleNames& names, int64_t utc_ms, ZoneLine& line, FormattedText& out) {
+  line.cursors.resize(zones.size());
+  line.times.resize(zones.size());
+
+  wchar_t text[kFormattedTextCapacity];
+  uint32_t length = 0;
+  auto append = [&](const wchar_t* source, size_t count) {
+    count = std::min<size_t>(count, kFormattedTextCapacity - 1 - length);
+    memcpy(text + length, source, count * sizeof(wchar_t));
+    length += static_cast<uint32_t>(count);
+  };
+
+  for (size_t i = 0; i < zones.size(); ++i) {
+    if (!zones[i].zone) continue;
+
+    const CivilTime civil = time_zone_civil(*zones[i].zone, line.cursors[i], utc_ms, &line.stats);
+    render_format(time, names, civil, line.times[i]);
+    if (length > 0) append(L"  ", 2);
+    append(zones[i].label.data(), zones[i].label.size());
+    append(L" ", 1);
+    append(line.times[i].text, line.times[i].length);
+  }
+
+  const bool changed = !out.valid || (out.length != length) || (memcmp(out.text, text, length * sizeof(wchar_t)) != 0);
+  if (changed) {
+    memcpy(out.text, text, length * sizeof(wchar_t));
+    out.text[length] = L'\0';
+    out.length = length;
+    out.valid = true;
+  }
+  return changed;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "base.h"
+#include "datetime_format.h"
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// IANA time zones from compiled tzdata (TZif files, e.g. zoneinfo/Asia/Tokyo).
+// A zone is loaded once and compiled into a sorted table of UTC instants at
+// which its offset changes. Rules in the file's POSIX TZ footer are expanded
+// into the table up to kTimeZoneLastYear, after that the last offset holds.
+//
+// Converting goes through a ZoneCursor caching the offset interval of the
+// previous conversion, so as long as the clock stays between two
+// transitions a conversion is one comparison and an add.
+
+constexpr int32_t kTimeZoneLastYear = 2100;
+
+struct ZoneType {
+  int32_t offset = 0; // @NOTE: seconds east of UTC
+  bool dst = false;
+  uint8_t abbreviation = 0; // @NOTE: offset into TimeZone::abbreviations
+};
+
+struct TimeZone {
+  std::string name;
+  std::vector<int64_t> starts; // @NOTE: UTC seconds, starts[0] is INT64_MIN
+  std::vector<uint8_t> types; // @NOTE: ZoneType index of each interval
+  std::vector<ZoneType> zone_types;
+  std::string abbreviations; // @NOTE: NUL separated
+};
+
+// The interval [begin, begin + span) has `offset`. `span` 0 never matches.
+// The local date of the previous conversion is kept as well.
+struct ZoneCursor {
+  int64_t begin = 0;
+  uint64_t span = 0;
+  int32_t offset = 0;
+  uint8_t type = 0;
+  int64_t local_day = INT64_MIN; // @NOTE: days since the epoch
+  CivilTime date = { };
+};
+
+struct ZoneStats {
+  uint64_t conversions = 0;
+  uint64_t misses = 0; // @NOTE: conversions that had to search the table
+};
+
+// Compiles TZif data, any version. Leap second records are ignored.
+bool time_zone_parse(const uint8_t* data, size_t size, TimeZone& zone);
+
+// Loads `name`, e.g. "America/New_York", from `directory`. Names that are
+// not plain relative paths are rejected.
+bool time_zone_load(const std::filesystem::path& directory, const std::string& name, TimeZone& zone);
+
+// Offset of the interval containing `utc_seconds`.
+int32_t time_zone_offset(const TimeZone& zone, ZoneCursor& cursor, int64_t utc_seconds, ZoneStats* stats = nullptr);
+
+// Reference lookup without a cursor.
+int32_t time_zone_offset_search(const TimeZone& zone, int64_t utc_seconds);
+
+const char* time_zone_abbreviation(const TimeZone& zone, uint8_t type);
+
+CivilTime time_zone_civil(const TimeZone& zone, ZoneCursor& cursor, int64_t utc_ms, ZoneStats* stats = nullptr);
+
+CivilTime civil_from_unix_ms(int64_t unix_ms);
+int64_t unix_seconds_from_civil(CivilTime time);
+
+// Every zone is loaded at most once, failures included.
+struct TimeZoneDatabase {
+  std::filesystem::path directory;
+  std::unordered_map<std::string, std::shared_ptr<const TimeZone>> zones = { };
+};
+
+// Returns null if the zone does not exist or cannot be parsed.
+std::shared_ptr<const TimeZone> time_zone_database_get(TimeZoneDatabase& database, const std::string& name);
+
+// One zone shown on a clock.
+struct ZoneClock {
+  std::shared_ptr<const TimeZone> zone;
+  std::wstring label;
+};
+
+struct ZoneConfigEntry {
+  std::string name;
+  std::string label; // @NOTE: UTF-8, defaults to the city, e.g. "New York"
+};
+
+// One zone per line, an optional label after it, '#' starts a comment:
+//
+//   America/New_York NYC
+//   Asia/Tokyo
+std::vector<ZoneConfigEntry> parse_zone_config(const char* text, size_t length);
+
+// Render thread state for one zone line.
+struct ZoneLine {
+  std::vector<ZoneCursor> cursors;
+  std::vector<FormattedText> times;
+  ZoneStats stats;
+};
+
+// Renders "label time  label time ..." with the `time` program into `out`.
+// Returns true if the text changed.
+bool render_zone_line(const std::vector<ZoneClock>& zones, const FormatProgram& time, const LocaleNames& names, int64_t utc_ms, ZoneLine& line, FormattedText& out);
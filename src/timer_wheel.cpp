@@ -0,0 +1,155 @@
+#include "timer_wheel.h"
+#include <algorithm>
+#include <bit>
+
+namespace {
+  struct WheelSlot {
+    uint64_t deadline_ms = UINT64_MAX; // @NOTE: when the slot comes up
+    uint32_t level = 0;
+    uint32_t slot = 0;
+  };
+
+  // @NOTE: Slots are looked at from the current one on; above level 0 the
+  // current slot comes last, it already started. Only the top level can
+  // wrap around, for deadlines past the end of its current rotation.
+  WheelSlot next_slot(const TimerWheel& wheel, uint32_t level) {
+    if (wheel.occupied[level] == 0) return { };
+
+    const uint32_t shift = level * kTimerWheelSlotBits;
+    const uint32_t now_slot = static_cast<uint32_t>(wheel.now_ms >> shift) & (kTimerWheelSlots - 1);
+    const uint32_t first = (now_slot + ((level > 0) ? 1u : 0u)) & (kTimerWheelSlots - 1);
+    const uint32_t distance = static_cast<uint32_t>(std::countr_zero(std::rotr(wheel.occupied[level], static_cast<int>(first))));
+    const uint32_t slot = (first + distance) & (kTimerWheelSlots - 1);
+
+    const uint64_t level_range = 1ull << (shift + kTimerWheelSlotBits);
+    uint64_t deadline = (wheel.now_ms & ~(level_range - 1)) + (static_cast<uint64_t>(slot) << shift);
+    if ((slot < now_slot) || ((level > 0) && (slot == now_slot))) deadline += level_range;
+    return WheelSlot{.deadline_ms = deadline, .level = level, .slot = slot};
+  }
+
+  WheelSlot earliest_slot(const TimerWheel& wheel) {
+    WheelSlot best;
+    for (uint32_t level = 0; level < kTimerWheelLevels; ++level) {
+      const WheelSlot candidate = next_slot(wheel, level);
+      if (candidate.deadline_ms < best.deadline_ms) best = candidate;
+    }
+    return best;
+  }
+
+  void place(TimerWheel& wheel, uint32_t index) {
+    TimerNode& node = wheel.nodes[index];
+    uint64_t placement = std::max(node.deadline_ms, wheel.now_ms);
+    if (placement - wheel.now_ms >= kTimerWheelRangeMs) placement = wheel.now_ms + kTimerWheelRangeMs - 1;
+
+    // @NOTE: The highest bit in which the deadline differs from now picks
+    // the level.
+    uint64_t masked = (wheel.now_ms ^ placement) | (kTimerWheelSlots - 1);
+    if (masked >= kTimerWheelRangeMs) masked = kTimerWheelRangeMs - 1;
+    const uint32_t level = static_cast<uint32_t>(63 - std::countl_zero(masked)) / kTimerWheelSlotBits;
+    const uint32_t slot = static_cast<uint32_t>(placement >> (level * kTimerWheelSlotBits)) & (kTimerWheelSlots - 1);
+
+    node.level = static_cast<uint8_t>(level);
+    node.slot = static_cast<uint8_t>(slot);
+    node.prev = kTimerWheelNil;
+    node.next = wheel.heads[level][slot];
+    if (node.next != kTimerWheelNil) wheel.nodes[node.next].prev = index;
+    wheel.heads[level][slot] = index;
+    wheel.occupied[level] |= 1ull << slot;
+  }
+
+  void unlink(TimerWheel& wheel, uint32_t index) {
+    TimerNode& node = wheel.nodes[index];
+    if (node.prev != kTimerWheelNil) wheel.nodes[node.prev].next = node.next;
+    else wheel.heads[node.level][node.slot] = node.next;
+    if (node.next != kTimerWheelNil) wheel.nodes[node.next].prev = node.prev;
+    if (wheel.heads[node.level][node.slot] == kTimerWheelNil) wheel.occupied[node.level] &= ~(1ull << node.slot);
+  }
+
+  void release(TimerWheel& wheel, uint32_t index) {
+    TimerNode& node = wheel.nodes[index];
+    node.pending = false;
+    node.generation = (node.generation == UINT32_MAX) ? 1 : node.generation + 1;
+    node.next = wheel.free;
+    wheel.free = index;
+    wheel.count--;
+  }
+
+  TimerId timer_id(const TimerWheel& wheel, uint32_t index) {
+    return (static_cast<uint64_t>(wheel.nodes[index].generation) << 32) | index;
+  }
+}
+
+void timer_wheel_init(TimerWheel& wheel, uint64_t now_ms) {
+  wheel = { };
+  wheel.now_ms = now_ms;
+  for (auto& level : wheel.heads) std::fill(std::begin(level), std::end(level), kTimerWheelNil);
+}
+
+TimerId timer_wheel_schedule(TimerWheel& wheel, uint64_t deadline_ms, uint64_t payload) {
+  uint32_t index = wheel.free;
+  if (index != kTimerWheelNil) {
+    wheel.free = wheel.nodes[index].next;
+  } else {
+    index = static_cast<uint32_t>(wheel.nodes.size());
+    wheel.nodes.emplace_back();
+  }
+
+  TimerNode& node = wheel.nodes[index];
+  node.deadline_ms = deadline_ms;
+  node.payload = payload;
+  node.pending = true;
+  wheel.count++;
+  place(wheel, index);
+  return timer_id(wheel, index);
+}
+
+bool timer_wheel_cancel(TimerWheel& wheel, TimerId id) {
+  const uint32_t index = static_cast<uint32_t>(id);
+  if ((index >= wheel.nodes.size()) || !wheel.nodes[index].pending || (timer_id(wheel, index) != id)) return false;
+
+  unlink(wheel, index);
+  release(wheel, index);
+  return true;
+}
+
+uint64_t timer_wheel_deadline(const TimerWheel& wheel, TimerId id) {
+  const uint32_t index = static_cast<uint32_t>(id);
+  if ((index >= wheel.nodes.size()) || !wheel.nodes[index].pending || (timer_id(wheel, index) != id)) return UINT64_MAX;
+  return wheel.nodes[index].deadline_ms;
+}
+
+void timer_wheel_advance(TimerWheel& wheel, uint64_t now_ms, std::vector<TimerExpiry>& expired) {
+  const size_t begin = expired.size();
+  bool ordered = true;
+  for (WheelSlot next = earliest_slot(wheel); next.deadline_ms <= now_ms; next = earliest_slot(wheel)) {
+    wheel.now_ms = std::max(wheel.now_ms, next.deadline_ms);
+
+    uint32_t index = wheel.heads[next.level][next.slot];
+    wheel.heads[next.level][next.slot] = kTimerWheelNil;
+    wheel.occupied[next.level] &= ~(1ull << next.slot);
+    while (index != kTimerWheelNil) {
+      TimerNode& node = wheel.nodes[index];
+      const uint32_t following = node.next;
+      if (node.deadline_ms <= wheel.now_ms) {
+        ordered = ordered && ((expired.size() == begin) || (expired.back().deadline_ms <= node.deadline_ms));
+        expired.push_back(TimerExpiry{.id = timer_id(wheel, index), .deadline_ms = node.deadline_ms, .payload = node.payload});
+        release(wheel, index);
+      } else {
+        place(wheel, index); // @NOTE: cascades into a lower level
+      }
+      index = following;
+    }
+  }
+  wheel.now_ms = std::max(wheel.now_ms, now_ms);
+
+  // @NOTE: Only timers scheduled after their deadline can come out of order.
+  if (!ordered) {
+    std::stable_sort(expired.begin() + static_cast<ptrdiff_t>(begin), expired.end(), [](const TimerExpiry& lhs, const TimerExpiry& rhs) {
+      return lhs.deadline_ms < rhs.deadline_ms;
+    });
+  }
+}
+
+uint64_t timer_wheel_next_deadline(const TimerWheel& wheel) {
+  return (wheel.count == 0) ? UINT64_MAX : earliest_slot(wheel).deadline_ms;
+}
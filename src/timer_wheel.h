@@ -0,0 +1,76 @@
+#pragma once
+
+#include "base.h"
+#include <vector>
+
+// Hierarchical timer wheel for the alarms. Deadlines are monotonic
+// milliseconds. Six levels of 64 slots each cover 2^36 ms (about two
+// years); a level-L slot spans 64^L ms. A timer sits in the lowest level
+// whose span still separates its deadline from the wheel's current time,
+// and moves down a level each time its slot comes up (cascading), so every
+// timer is touched at most once per level however long it waits.
+//
+// Scheduling and cancelling are O(1): timers live in a slab and are linked
+// into their slot by index. A 64 bit mask per level records the occupied
+// slots, so finding the next deadline is a few bit scans, independent of
+// the number of pending timers. Deadlines further out than the wheel
+// covers wait in the last slot of the top level and are placed again when
+// it comes up.
+
+constexpr uint32_t kTimerWheelLevels = 6;
+constexpr uint32_t kTimerWheelSlotBits = 6;
+constexpr uint32_t kTimerWheelSlots = 1u << kTimerWheelSlotBits;
+constexpr uint64_t kTimerWheelRangeMs = 1ull << (kTimerWheelLevels * kTimerWheelSlotBits);
+constexpr uint32_t kTimerWheelNil = 0xffffffff;
+
+// @NOTE: Slab index in the low half, the slot's generation in the high
+// half, so a stale id never cancels a reused slot. 0 is never an id.
+using TimerId = uint64_t;
+
+struct TimerNode {
+  uint64_t deadline_ms = 0;
+  uint64_t payload = 0;
+  uint32_t next = kTimerWheelNil; // @NOTE: in the slot list, or the free list
+  uint32_t prev = kTimerWheelNil;
+  uint32_t generation = 1;
+  uint8_t level = 0;
+  uint8_t slot = 0;
+  bool pending = false;
+};
+
+struct TimerWheel {
+  uint64_t now_ms = 0; // @NOTE: everything up to here has expired
+  std::vector<TimerNode> nodes;
+  uint32_t free = kTimerWheelNil;
+  uint32_t count = 0; // @NOTE: pending timers
+  uint64_t occupied[kTimerWheelLevels] = { };
+  uint32_t heads[kTimerWheelLevels][kTimerWheelSlots];
+};
+
+struct TimerExpiry {
+  TimerId id = 0;
+  uint64_t deadline_ms = 0;
+  uint64_t payload = 0;
+};
+
+void timer_wheel_init(TimerWheel& wheel, uint64_t now_ms);
+
+// A deadline that already passed expires on the next advance.
+TimerId timer_wheel_schedule(TimerWheel& wheel, uint64_t deadline_ms, uint64_t payload);
+
+// Returns false if the timer already expired or was cancelled.
+bool timer_wheel_cancel(TimerWheel& wheel, TimerId id);
+
+// UINT64_MAX if the timer is not pending.
+uint64_t timer_wheel_deadline(const TimerWheel& wheel, TimerId id);
+
+// Moves the wheel to `now_ms` and appends the timers that expired, in
+// deadline order.
+void timer_wheel_advance(TimerWheel& wheel, uint64_t now_ms, std::vector<TimerExpiry>& expired);
+
+// When to call timer_wheel_advance next, UINT64_MAX with nothing pending.
+// Exact when the next timer is in the lowest level, otherwise the start of
+// the slot it sits in: advancing there cascades it down and the next call
+// is closer. Never later than the earliest deadline, or than the wheel's
+// time if a timer was scheduled after its deadline.
+uint64_t timer_wheel_next_deadline(const TimerWheel& wheel);
@@ -0,0 +1,67 @@
+#include "topmost_guard.h"
+
+namespace {
+  bool intersects(Rect a, Rect b) {
+    return (a.left < b.right) && (b.left < a.right) && (a.top < b.bottom) && (b.top < a.bottom);
+  }
+
+  bool arm(TopmostGuard& guard, uint64_t now_ms) {
+    if (guard.deadline_ms != 0) return false;
+
+    guard.deadline_ms = now_ms + guard.coalesce_ms;
+    return true;
+  }
+}
+
+void topmost_guard_watch(TopmostGuard& guard, const std::vector<Rect>& frames) {
+  guard.watched = frames;
+  guard.dirty.assign(frames.size(), false);
+}
+
+bool topmost_guard_trigger(TopmostGuard& guard, uint64_t now_ms, Rect frame, bool topmost) {
+  guard.stats.triggers++;
+  guard.stats.naive_raises += guard.watched.size();
+
+  // @NOTE: A window outside the topmost band can never be above a clock.
+  bool any = false;
+  if (topmost) {
+    for (size_t i = 0; i < guard.watched.size(); ++i) {
+      if (intersects(guard.watched[i], frame)) {
+        guard.dirty[i] = true;
+        any = true;
+      }
+    }
+  }
+
+  if (!any) {
+    guard.stats.ignored++;
+    return false;
+  }
+  return arm(guard, now_ms);
+}
+
+bool topmost_guard_trigger_all(TopmostGuard& guard, uint64_t now_ms) {
+  guard.stats.triggers++;
+  guard.stats.naive_raises += guard.watched.size();
+
+  if (guard.watched.empty()) return false;
+
+  guard.dirty.assign(guard.watched.size(), true);
+  return arm(guard, now_ms);
+}
+
+bool topmost_guard_is_dirty(const TopmostGuard& guard, uint32_t index) {
+  return (index < guard.dirty.size()) && guard.dirty[index];
+}
+
+void topmost_guard_record(TopmostGuard& guard, bool lost) {
+  guard.stats.checks++;
+  if (lost) guard.stats.raises++;
+}
+
+void topmost_guard_finish(TopmostGuard& guard) {
+  if (guard.deadline_ms != 0) guard.stats.enforcements++;
+
+  guard.dirty.assign(guard.watched.size(), false);
+  guard.deadline_ms = 0;
+}
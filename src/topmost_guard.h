@@ -0,0 +1,65 @@
+#pragma once
+
+#include "base.h"
+#include <vector>
+
+// Keeps the clocks on top without re-asserting HWND_TOPMOST for every clock
+// on every foreground change. Triggers are coalesced for `coalesce_ms`, and
+// only clocks whose monitor was touched by a window that can actually cover
+// them (a topmost one) are marked for a check.
+
+struct TopmostGuardStats {
+  uint64_t triggers = 0;
+  uint64_t ignored = 0; // @NOTE: triggers that could not have covered any clock
+  uint64_t enforcements = 0; // @NOTE: coalesced batches
+  uint64_t checks = 0; // @NOTE: clocks checked for lost z-order
+  uint64_t raises = 0; // @NOTE: clocks that really had lost it, i.e. SetWindowPos calls
+  uint64_t naive_raises = 0; // @NOTE: SetWindowPos calls the raise-every-clock-per-trigger approach would issue
+};
+
+constexpr uint32_t kTopmostCoalesceMs = 100;
+
+struct TopmostGuard {
+  std::vector<Rect> watched; // @NOTE: one frame per clock, usually the monitor rectangles
+  std::vector<bool> dirty;
+  uint64_t deadline_ms = 0; // @NOTE: monotonic, 0 = nothing pending
+  uint32_t coalesce_ms = kTopmostCoalesceMs;
+  TopmostGuardStats stats;
+};
+
+void topmost_guard_watch(TopmostGuard& guard, const std::vector<Rect>& frames);
+
+// A window became the foreground window. Returns true if a batch was not
+// pending yet and the platform timer has to be armed for `coalesce_ms`.
+bool topmost_guard_trigger(TopmostGuard& guard, uint64_t now_ms, Rect frame, bool topmost);
+
+// Same, for when the foreground window is unknown: every clock is marked.
+bool topmost_guard_trigger_all(TopmostGuard& guard, uint64_t now_ms);
+
+bool topmost_guard_is_dirty(const TopmostGuard& guard, uint32_t index);
+
+// Records the result of checking one dirty clock.
+void topmost_guard_record(TopmostGuard& guard, bool lost);
+
+// Ends the pending batch.
+void topmost_guard_finish(TopmostGuard& guard);
+
+// Runs the pending batch and ends it: asks `is_covered(index)` about every
+// dirty clock that is shown and calls `raise(index)` for the ones that lost
+// their place in the topmost band. Returns the number of clocks raised.
+template <typename IsCovered, typename Raise>
+uint32_t topmost_guard_enforce(TopmostGuard& guard, const std::vector<uint8_t>& hidden, IsCovered&& is_covered, Raise&& raise) {
+  uint32_t raised = 0;
+  for (uint32_t i = 0; i < guard.dirty.size(); ++i) {
+    if (!guard.dirty[i] || ((i < hidden.size()) && hidden[i])) continue;
+
+    const bool lost = is_covered(i);
+    topmost_guard_record(guard, lost);
+    if (lost) {
+      raise(i);
+      raised++;
+    }
+  }
+  topmost_guard_finish(guard);
+  return raised;
+}
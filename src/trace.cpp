@@ -0,0 +1,173 @@
+#include "trace.h"
+#include <string.h>
+#include <chrono>
+#include <iterator>
+
+namespace {
+  constexpr char kTraceMagic[8] = {'C', 'L', 'K', 'T', 'R', 'A', 'C', 'E'};
+  constexpr uint32_t kTraceVersion = 2; // @NOTE: bumped whenever TraceName changes, the dumps store its values
+
+  struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t event_size;
+    uint64_t count;
+  };
+
+  const char* kTraceNames[] = {
+    "tick",
+    "update_datetime",
+    "get_desktop_windows",
+    "covering_window_lookup",
+    "reconcile_clocks",
+    "BeginDraw",
+    "DrawText",
+    "EndDraw",
+    "UpdateLayeredWindow",
+    "visible_clocks",
+    "render_frame",
+    "publish_frame",
+    "dropped_frames",
+    "missed_frames",
+    "sample_backdrop",
+    "startup",
+    "calendar_index",
+    "alarms",
+    "sample_metrics",
+  };
+
+  static_assert(std::size(kTraceNames) == static_cast<size_t>(TraceName::Count));
+
+  std::atomic<uint32_t> next_thread_id{1};
+
+  // @NOTE: A producer claims a slot by swapping its sequence for this one
+  // and publishes the event by storing the event's own sequence, so the
+  // sequences of written slots never take this value.
+  constexpr uint32_t kTraceSlotWriting = UINT32_MAX;
+
+  uint32_t trace_slot_sequence(uint64_t index) {
+    return static_cast<uint32_t>(index % (UINT32_MAX - 1)) + 1;
+  }
+
+  // @NOTE: The payload is copied field by field through atomic_ref, relaxed
+  // is enough as the sequence orders it. A plain copy would be a data race
+  // with a producer that claims the slot while it is being read.
+  template <typename T>
+  void trace_store(T& field, T value) {
+    std::atomic_ref<T>(field).store(value, std::memory_order_relaxed);
+  }
+
+  template <typename T>
+  T trace_load(const T& field) {
+    return std::atomic_ref<T>(const_cast<T&>(field)).load(std::memory_order_relaxed);
+  }
+}
+
+#ifdef CLOCK_TRACE
+TraceBuffer g_trace;
+#endif
+
+const char* trace_name_string(TraceName name) {
+  const size_t index = static_cast<size_t>(name);
+  return (index < std::size(kTraceNames)) ? kTraceNames[index] : "unknown";
+}
+
+uint64_t trace_now_ns() {
+  using namespace std::chrono;
+  return static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+uint32_t trace_thread_id() {
+  thread_local uint32_t id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+  return id;
+}
+
+void trace_emit(TraceBuffer& buffer, TraceName name, TraceEventKind kind, uint64_t timestamp_ns, int64_t value) {
+  const uint64_t index = buffer.write_index.fetch_add(1, std::memory_order_relaxed);
+  TraceEvent& e = buffer.events[index & (kTraceCapacity - 1)];
+
+  // @NOTE: Only one producer writes a slot at a time. Two only meet on a
+  // slot when one of them got a whole buffer behind, the later one drops
+  // its event instead of waiting or interleaving its fields with the other.
+  // A reader that sees the same published sequence before and after copying
+  // a slot got a consistent event.
+  std::atomic_ref<uint32_t> sequence(e.sequence);
+  uint32_t previous = sequence.load(std::memory_order_relaxed);
+  do {
+    if (previous == kTraceSlotWriting) {
+      buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  } while (!sequence.compare_exchange_weak(previous, kTraceSlotWriting, std::memory_order_relaxed));
+  std::atomic_thread_fence(std::memory_order_release);
+
+  trace_store(e.timestamp_ns, timestamp_ns);
+  trace_store(e.value, value);
+  trace_store(e.thread, trace_thread_id());
+  trace_store(e.name, name);
+  trace_store(e.kind, kind);
+  sequence.store(trace_slot_sequence(index), std::memory_order_release);
+}
+
+bool trace_dump(const TraceBuffer& buffer, FILE* f) {
+  const uint64_t end = buffer.write_index.load(std::memory_order_acquire);
+  const uint64_t begin = (end > kTraceCapacity) ? end - kTraceCapacity : 0;
+
+  TraceFileHeader header = { };
+  memcpy(header.magic, kTraceMagic, sizeof(kTraceMagic));
+  header.version = kTraceVersion;
+  header.event_size = static_cast<uint32_t>(sizeof(TraceEvent));
+  header.count = 0;
+
+  const long header_offset = ftell(f);
+  if (fwrite(&header, sizeof(header), 1, f) != 1) return false;
+
+  for (uint64_t i = begin; i < end; ++i) {
+    const TraceEvent& slot = buffer.events[i & (kTraceCapacity - 1)];
+    std::atomic_ref<uint32_t> sequence(const_cast<uint32_t&>(slot.sequence));
+
+    const uint32_t expected = trace_slot_sequence(i);
+    if (sequence.load(std::memory_order_acquire) != expected) continue;
+    TraceEvent e = { };
+    e.timestamp_ns = trace_load(slot.timestamp_ns);
+    e.value = trace_load(slot.value);
+    e.sequence = expected;
+    e.thread = trace_load(slot.thread);
+    e.name = trace_load(slot.name);
+    e.kind = trace_load(slot.kind);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence.load(std::memory_order_relaxed) != expected) continue;
+
+    if (fwrite(&e, sizeof(e), 1, f) != 1) return false;
+    header.count++;
+  }
+
+  if (fseek(f, header_offset, SEEK_SET) != 0) return false;
+  if (fwrite(&header, sizeof(header), 1, f) != 1) return false;
+  return fseek(f, 0, SEEK_END) == 0;
+}
+
+bool trace_convert_to_chrome_json(FILE* in, FILE* out) {
+  TraceFileHeader header;
+  if (fread(&header, sizeof(header), 1, in) != 1) return false;
+  if (memcmp(header.magic, kTraceMagic, sizeof(kTraceMagic)) != 0) return false;
+  if ((header.version != kTraceVersion) || (header.event_size != sizeof(TraceEvent))) return false;
+
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  for (uint64_t i = 0; i < header.count; ++i) {
+    TraceEvent e;
+    if (fread(&e, sizeof(e), 1, in) != 1) return false;
+
+    // @NOTE: Chrome trace timestamps are in microseconds.
+    const double ts = static_cast<double>(e.timestamp_ns) / 1000.0;
+    const char* separator = (i + 1 < header.count) ? "," : "";
+    if (e.kind == TraceEventKind::Scope) {
+      const double dur = static_cast<double>(e.value) / 1000.0;
+      fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n", trace_name_string(e.name), e.thread, ts, dur, separator);
+    } else {
+      fprintf(out, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%lld}}%s\n", trace_name_string(e.name), e.thread, ts, static_cast<long long>(e.value), separator);
+    }
+  }
+  fprintf(out, "]}\n");
+  return true;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "base.h"
+#include <stdio.h>
+#include <atomic>
+
+// In-process trace of the hot paths. Scoped timers and counters write fixed
+// size events into a lock-free ring buffer that can be dumped to a compact
+// binary file and converted to Chrome trace JSON (chrome://tracing, Perfetto).
+//
+// Everything compiles out unless CLOCK_TRACE is defined, debug builds
+// (CLOCK_DEBUG) turn it on.
+
+#if defined(CLOCK_DEBUG) && !defined(CLOCK_TRACE)
+#define CLOCK_TRACE
+#endif
+
+enum class TraceName : uint16_t {
+  Tick,
+  UpdateDateTime,
+  GetDesktopWindows,
+  CoveringWindowLookup,
+  ReconcileClocks,
+  D2DBeginDraw,
+  D2DDrawText, // @NOTE: not DrawText, windows.h defines that as a macro
+  D2DEndDraw,
+  UpdateLayeredWindow,
+  VisibleClocks,
+  RenderFrame,
+  PublishFrame,
+  DroppedFrames,
+  MissedFrames,
+  SampleBackdrop,
+  Startup,
+  CalendarIndex,
+  Alarms,
+  SampleMetrics,
+  Count,
+};
+
+const char* trace_name_string(TraceName name);
+
+enum class TraceEventKind : uint8_t {
+  Scope, // @NOTE: complete event, `value` is the duration in ns
+  Counter,
+};
+
+struct TraceEvent {
+  uint64_t timestamp_ns = 0;
+  int64_t value = 0;
+  uint32_t sequence = 0; // @NOTE: 0 = slot not written yet, see trace_emit
+  uint32_t thread = 0;
+  TraceName name = TraceName::Tick;
+  TraceEventKind kind = TraceEventKind::Scope;
+  uint8_t padding[4] = { };
+};
+
+static_assert(sizeof(TraceEvent) == 32);
+
+constexpr uint32_t kTraceCapacity = 1u << 14; // @NOTE: must be a power of two
+
+struct TraceBuffer {
+  std::atomic<uint64_t> write_index{0};
+  std::atomic<uint64_t> dropped{0}; // @NOTE: events whose slot another producer was still writing
+  TraceEvent events[kTraceCapacity];
+};
+
+uint64_t trace_now_ns();
+uint32_t trace_thread_id();
+
+// Multiple producers may emit concurrently, the oldest events are overwritten.
+// An event is dropped if a producer a whole buffer ahead is still writing its
+// slot.
+void trace_emit(TraceBuffer& buffer, TraceName name, TraceEventKind kind, uint64_t timestamp_ns, int64_t value);
+
+// Writes the events currently in the buffer, oldest first. May race with
+// producers, slots being written meanwhile are skipped.
+bool trace_dump(const TraceBuffer& buffer, FILE* f);
+
+// Reads a file written by trace_dump and writes it as Chrome trace JSON.
+bool trace_convert_to_chrome_json(FILE* in, FILE* out);
+
+#ifdef CLOCK_TRACE
+
+extern TraceBuffer g_trace;
+
+struct TraceScope {
+  TraceName name;
+  uint64_t start_ns;
+
+  explicit TraceScope(TraceName scope_name) : name(scope_name), start_ns(trace_now_ns()) { }
+  ~TraceScope() { trace_emit(g_trace, name, TraceEventKind::Scope, start_ns, static_cast<int64_t>(trace_now_ns() - start_ns)); }
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator =(const TraceScope&) = delete;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(TraceName::name)
+#define TRACE_COUNTER(name, value) trace_emit(g_trace, TraceName::name, TraceEventKind::Counter, trace_now_ns(), static_cast<int64_t>(value))
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+
+#endif
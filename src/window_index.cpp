@@ -0,0 +1,79 @@
+#include "window_index.h"
+#include <algorithm>
+
+namespace {
+  // Returns true if `frame` is watched.
+  bool set_watched_covered(WindowIndex& index, Rect frame, bool covered) {
+    bool watched = false;
+    for (size_t i = 0; i < index.watched.size(); ++i) {
+      if (index.watched[i] != frame) continue;
+      index.covered[i] = static_cast<uint8_t>(covered);
+      watched = true;
+    }
+    return watched;
+  }
+
+  // Returns true if the frame went from uncovered to covered.
+  bool add_visible_frame(WindowIndex& index, Rect frame) {
+    return (index.visible_frames[frame]++ == 0) && set_watched_covered(index, frame, true);
+  }
+
+  // Returns true if the frame went from covered to uncovered.
+  bool remove_visible_frame(WindowIndex& index, Rect frame) {
+    auto it = index.visible_frames.find(frame);
+    if (it == index.visible_frames.end()) return false;
+
+    if (--it->second > 0) return false;
+
+    index.visible_frames.erase(it);
+    return set_watched_covered(index, frame, false);
+  }
+}
+
+bool window_index_update(WindowIndex& index, WindowId id, WindowState state) {
+  auto [it, inserted] = index.windows.try_emplace(id, state);
+  if (inserted) return state.visible ? add_visible_frame(index, state.frame) : false;
+
+  const WindowState previous = it->second;
+  if ((previous.visible == state.visible) && (previous.frame == state.frame)) return false;
+
+  it->second = state;
+
+  bool changed = false;
+  if (previous.visible) changed |= remove_visible_frame(index, previous.frame);
+  if (state.visible) changed |= add_visible_frame(index, state.frame);
+  return changed;
+}
+
+bool window_index_remove(WindowIndex& index, WindowId id) {
+  auto it = index.windows.find(id);
+  if (it == index.windows.end()) return false;
+
+  const WindowState previous = it->second;
+  index.windows.erase(it);
+
+  return previous.visible ? remove_visible_frame(index, previous.frame) : false;
+}
+
+void window_index_clear(WindowIndex& index) {
+  index.windows.clear();
+  index.visible_frames.clear();
+  std::fill(index.covered.begin(), index.covered.end(), uint8_t{0});
+}
+
+void window_index_watch(WindowIndex& index, const std::vector<Rect>& frames) {
+  index.watched = frames;
+  index.covered.resize(frames.size());
+  for (size_t i = 0; i < frames.size(); ++i) index.covered[i] = static_cast<uint8_t>(window_index_has_covering_window(index, frames[i]));
+}
+
+bool window_index_has_covering_window(const WindowIndex& index, Rect frame) {
+  return index.visible_frames.find(frame) != index.visible_frames.end();
+}
+
+bool naive_has_covering_window(const std::vector<WindowState>& windows, Rect frame) {
+  for (const WindowState& window : windows) {
+    if (window.visible && (window.frame == frame)) return true;
+  }
+  return false;
+}
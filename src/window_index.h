@@ -0,0 +1,35 @@
+#pragma once
+
+#include "base.h"
+#include <unordered_map>
+#include <vector>
+
+// Incrementally maintained index of top-level window frames. It is fed by
+// create/destroy/move/show/hide events instead of enumerating every desktop
+// window on every tick, so asking whether a monitor is covered by a
+// fullscreen window is a single hash lookup.
+
+using WindowId = uint64_t;
+
+struct WindowState {
+  Rect frame = { };
+  bool visible = false;
+};
+
+struct WindowIndex {
+  std::unordered_map<WindowId, WindowState> windows;
+  std::unordered_map<Rect, uint32_t, RectHash> visible_frames; // @NOTE: frame -> number of visible windows with exactly that frame
+  std::vector<Rect> watched; // @NOTE: usually the monitor rectangles
+  std::vector<uint8_t> covered; // @NOTE: per watched frame, kept up to date so a tick reads it without hashing
+};
+
+// Both return true if a watched frame went from covered to uncovered or back.
+bool window_index_update(WindowIndex& index, WindowId id, WindowState state);
+bool window_index_remove(WindowIndex& index, WindowId id);
+
+void window_index_clear(WindowIndex& index);
+void window_index_watch(WindowIndex& index, const std::vector<Rect>& frames);
+bool window_index_has_covering_window(const WindowIndex& index, Rect frame);
+
+// Reference implementation the index replaces, kept for comparison.
+bool naive_has_covering_window(const std::vector<WindowState>& windows, Rect frame);